@@ -0,0 +1,435 @@
+/**
+ * @file booking_benchmarks.cpp
+ * @brief Google Benchmark microbenchmarks for the booking hot paths
+ * @details Covers Theater seat operations, CentralDataStore lookups, TcpServer request
+ *          processing per command and ThreadPool task dispatch. Benchmarks are
+ *          parameterized by seat count, thread count and catalog size. To track
+ *          regressions between releases, keep the JSON output of each run:
+ *          ./benchmarks --benchmark_out=results.json --benchmark_out_format=json
+ * @author Alejandro Martinez Lopez
+ * @date 2025
+ */
+
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "Controller/TcpServer.h"
+#include "Controller/RequestScanner.h"
+#include "Controller/ServerMetrics.h"
+#include "Models/CentralDataStore.h"
+#include "Models/BookingService.h"
+#include "Models/AdministrationService.h"
+#include "Models/Theater.h"
+#include "Models/Movie.h"
+#include "Utils/ThreadPool.h"
+
+namespace {
+
+/// Heap allocations made by the process, counted by the operator new replacement below
+std::atomic<std::uint64_t> g_allocations{0};
+
+}
+
+void* operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+constexpr int kMoviesPerTheater = 5;
+
+/// Catalog of movie_count movies, one theater per ten movies, each showing five of them
+struct Catalog {
+  std::shared_ptr<CentralDataStore> data_store = std::make_shared<CentralDataStore>();
+  BookingService booking_service{data_store};
+  AdministrationService admin_service{data_store};
+  int movie_count = 0;
+  int theater_count = 0;
+
+  explicit Catalog(int movies, int seat_count = 20) : movie_count(movies), theater_count(movies / 10 + 1) {
+    for (int id = 1; id <= movie_count; ++id) {
+      admin_service.add_movie(Movie(id, "Movie " + std::to_string(id)));
+    }
+    for (int id = 1; id <= theater_count; ++id) {
+      auto theater = std::make_shared<Theater>(id, "Theater " + std::to_string(id), seat_count);
+      for (int k = 0; k < kMoviesPerTheater; ++k) {
+        int movie_id = (id * 7 + k) % movie_count + 1;
+        if (!theater->shows_movie(movie_id)) {
+          theater->add_movie(Movie(movie_id, "Movie " + std::to_string(movie_id)));
+        }
+      }
+      admin_service.add_theater(theater);
+    }
+  }
+};
+
+// ---- Theater ----
+
+std::unique_ptr<Theater> g_theater;
+std::vector<std::string> g_seats;
+
+void setup_theater(const benchmark::State& state) {
+  g_theater = std::make_unique<Theater>(1, "Bench Cinema", static_cast<int>(state.range(0)));
+  g_theater->add_movie(Movie(1, "Bench Movie"));
+  g_seats = g_theater->get_available_seats(1);
+}
+
+void teardown_theater(const benchmark::State&) {
+  g_theater.reset();
+}
+
+// Every thread books and releases its own seat of the same showing: the flash sale shape
+void BM_TheaterBookRelease(benchmark::State& state) {
+  const std::vector<std::string> seat{g_seats[state.thread_index() % g_seats.size()]};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(g_theater->book_seats(1, seat));
+    g_theater->release_seats(1, seat);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TheaterBookRelease)
+    ->Setup(setup_theater)->Teardown(teardown_theater)
+    ->ArgName("seats")->Arg(20)->Arg(400)
+    ->Threads(1)->Threads(4)->Threads(8)->UseRealTime();
+
+void BM_TheaterGetAvailableSeats(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(g_theater->get_available_seats(1));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TheaterGetAvailableSeats)
+    ->Setup(setup_theater)->Teardown(teardown_theater)
+    ->ArgName("seats")->Arg(20)->Arg(100)->Arg(400)
+    ->Threads(1)->Threads(4)->UseRealTime();
+
+// ---- CentralDataStore ----
+
+std::unique_ptr<Catalog> g_catalog;
+
+void setup_catalog(const benchmark::State& state) {
+  g_catalog = std::make_unique<Catalog>(static_cast<int>(state.range(0)));
+}
+
+void teardown_catalog(const benchmark::State&) {
+  g_catalog.reset();
+}
+
+void BM_DataStoreGetTheater(benchmark::State& state) {
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> pick(1, g_catalog->theater_count);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(g_catalog->data_store->get_theater(pick(rng)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DataStoreGetTheater)
+    ->Setup(setup_catalog)->Teardown(teardown_catalog)
+    ->ArgName("movies")->Arg(100)->Arg(10000)
+    ->Threads(1)->Threads(4)->UseRealTime();
+
+void BM_DataStoreTheatersShowingMovie(benchmark::State& state) {
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> pick(1, g_catalog->movie_count);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(g_catalog->data_store->get_theaters_showing_movie(pick(rng)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DataStoreTheatersShowingMovie)
+    ->Setup(setup_catalog)->Teardown(teardown_catalog)
+    ->ArgName("movies")->Arg(100)->Arg(10000)
+    ->Threads(1)->Threads(4)->UseRealTime();
+
+void BM_DataStoreMoviesPage(benchmark::State& state) {
+  CatalogQuery query;
+  query.after_id = g_catalog->movie_count / 2;
+  query.limit = 50;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(g_catalog->data_store->get_movies_page(query));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DataStoreMoviesPage)
+    ->Setup(setup_catalog)->Teardown(teardown_catalog)
+    ->ArgName("movies")->Arg(100)->Arg(10000);
+
+void BM_DataStoreSearchMovies(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(g_catalog->data_store->search_movies("ovie 12", 10));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DataStoreSearchMovies)
+    ->Setup(setup_catalog)->Teardown(teardown_catalog)
+    ->ArgName("movies")->Arg(100)->Arg(10000);
+
+// ---- TcpServer::process_request_json ----
+
+/// Server bound to an ephemeral port; the io_context never runs, requests are fed directly
+struct ServerFixture {
+  boost::asio::io_context io_context;
+  Catalog catalog;
+  TcpServer server;
+
+  explicit ServerFixture(int movies, int seat_count = 20)
+    : catalog(movies, seat_count), server(io_context, 0, catalog.booking_service, catalog.admin_service, 1) {}
+};
+
+struct SampleRequest {
+  const char* label;
+  std::string json;
+};
+
+std::vector<SampleRequest> sample_requests() {
+  return {
+    {"LIST_MOVIES", R"({"command":"LIST_MOVIES","limit":50})"},
+    {"LIST_THEATERS", R"({"command":"LIST_THEATERS","movie_id":8})"},
+    {"LIST_SEATS", R"({"command":"LIST_SEATS","theater_id":1,"movie_id":8})"},
+    {"BOOK (seat taken)", R"({"command":"BOOK","theater_id":1,"movie_id":8,"seats":["a1"]})"},
+    {"SEARCH_MOVIES", R"({"command":"SEARCH_MOVIES","query":"ovie 12","limit":10})"},
+    {"LOOKUP_BOOKING", R"({"command":"LOOKUP_BOOKING","confirmation":"3QF7ZK2M9XH4C"})"},
+    {"UNKNOWN", R"({"command":"FOO"})"},
+    {"MALFORMED", R"({"command":)"}
+  };
+}
+
+void BM_ProcessRequestJson(benchmark::State& state) {
+  ServerFixture fixture(static_cast<int>(state.range(1)));
+  const SampleRequest request = sample_requests().at(state.range(0));
+  fixture.server.process_request_json(R"({"command":"BOOK","theater_id":1,"movie_id":8,"seats":["a1"]})");
+  state.SetLabel(request.label);
+  const std::uint64_t allocations = g_allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fixture.server.process_request_json(request.json));
+  }
+  state.SetItemsProcessed(state.iterations());
+  // Includes the std::string process_request_json returns; sessions write from the arena instead
+  state.counters["allocs_per_request"] = benchmark::Counter(
+      static_cast<double>(g_allocations.load(std::memory_order_relaxed) - allocations) / state.iterations());
+}
+BENCHMARK(BM_ProcessRequestJson)
+    ->ArgNames({"command", "movies"})
+    ->ArgsProduct({benchmark::CreateDenseRange(0, 7, 1), {100, 10000}});
+
+// Request decoding alone: the generic parser with field lookups vs the fast-path scanner
+const std::string kScanLine = R"({"command":"BOOK","theater_id":12,"movie_id":345,"seats":["a1","a2","b7"]})";
+
+void BM_ParseRequest(benchmark::State& state) {
+  RequestArena arena;
+  for (auto _ : state) {
+    arena.reset();
+    const json::value request = arena.parse(kScanLine);
+    benchmark::DoNotOptimize(request.at("command").as_string().size());
+    benchmark::DoNotOptimize(request.at("theater_id").as_int64() + request.at("movie_id").as_int64());
+    benchmark::DoNotOptimize(request.at("seats").as_array().size());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseRequest);
+
+void BM_ScanRequest(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(scan_request(kScanLine));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ScanRequest);
+
+// LIST_SEATS of a half-booked showing in each format; response_bytes is the size on the wire
+void BM_ListSeatsFormat(benchmark::State& state) {
+  static const char* const kFormats[] = {"list", "bitmap", "rle"};
+  const int seat_count = static_cast<int>(state.range(1));
+  ServerFixture fixture(100, seat_count);
+  for (int index = 0; index < seat_count; index += 2) {
+    fixture.catalog.booking_service.book_seats(1, 8, {fixture.catalog.data_store->get_theater(1)->seat_label(index)});
+  }
+  const std::string request = std::string(R"({"command":"LIST_SEATS","theater_id":1,"movie_id":8,"format":")") +
+                              kFormats[state.range(0)] + "\"}";
+  state.SetLabel(kFormats[state.range(0)]);
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    bytes = fixture.server.process_request_json(request).size();
+    benchmark::DoNotOptimize(bytes);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["response_bytes"] = static_cast<double>(bytes);
+}
+BENCHMARK(BM_ListSeatsFormat)->ArgNames({"format", "seats"})->ArgsProduct({{0, 1, 2}, {20, 2000}});
+
+// Conditional LIST_SEATS of a half-booked 676 seat showing: current if_version vs a stale one
+void BM_ListSeatsIfVersion(benchmark::State& state) {
+  ServerFixture fixture(100, 676);
+  for (int index = 0; index < 676; index += 2) {
+    fixture.catalog.booking_service.book_seats(1, 8, {fixture.catalog.data_store->get_theater(1)->seat_label(index)});
+  }
+  const bool current = state.range(0) == 1;
+  const std::uint64_t version = fixture.catalog.booking_service.get_seat_version(1, 8).value() - (current ? 0 : 1);
+  const std::string request = R"({"command":"LIST_SEATS","theater_id":1,"movie_id":8,"if_version":)" +
+                              std::to_string(version) + "}";
+  state.SetLabel(current ? "not_modified" : "changed");
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    bytes = fixture.server.process_request_json(request).size();
+    benchmark::DoNotOptimize(bytes);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["response_bytes"] = static_cast<double>(bytes);
+}
+BENCHMARK(BM_ListSeatsIfVersion)->ArgName("current")->Arg(0)->Arg(1);
+
+// Successful BOOK followed by CANCEL, so the showing never runs out of seats
+void BM_ProcessBookCancel(benchmark::State& state) {
+  ServerFixture fixture(static_cast<int>(state.range(0)));
+  const std::string book = R"({"command":"BOOK","theater_id":1,"movie_id":8,"seats":["a1","a2"]})";
+  const std::string marker = "\"confirmation\":\"";
+  for (auto _ : state) {
+    std::string response = fixture.server.process_request_json(book);
+    auto start = response.find(marker) + marker.size();
+    std::string code = response.substr(start, response.find('"', start) - start);
+    benchmark::DoNotOptimize(fixture.server.process_request_json(
+        R"({"command":"CANCEL","confirmation":")" + code + "\"}"));
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_ProcessBookCancel)->ArgName("movies")->Arg(100)->Arg(10000);
+
+// ---- Transports ----
+
+/// Server with a running io_context, listening on an ephemeral TCP port and on a Unix socket
+struct RunningServer {
+  Catalog catalog{100};
+  std::string unix_path = "/tmp/booking_bench_" + std::to_string(::getpid()) + ".sock";
+  boost::asio::io_context io_context;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{io_context.get_executor()};
+  std::unique_ptr<TcpServer> server;
+  std::thread io_thread;
+
+  explicit RunningServer(NetworkBackend backend = NetworkBackend::Asio) {
+    ServerConfig config;
+    config.network_backend = backend;
+    config.rate_limits = RateLimits{0, 0, 0, 0, 0};  // Measure the transport, not the shedding
+    config.trace_sample_period = 0;
+    config.unix_socket_path = unix_path;
+    server = std::make_unique<TcpServer>(io_context, 0, catalog.booking_service, catalog.admin_service, 2, config);
+    server->start();
+    io_thread = std::thread([this]() { io_context.run(); });
+  }
+
+  ~RunningServer() {
+    work.reset();
+    io_context.stop();
+    io_thread.join();
+    server.reset();
+    std::remove(unix_path.c_str());
+  }
+};
+
+template <typename Socket>
+void round_trips(benchmark::State& state, Socket& socket) {
+  const std::string request = "{\"command\":\"LIST_SEATS\",\"theater_id\":1,\"movie_id\":8}\n";
+  boost::asio::streambuf buf;
+  for (auto _ : state) {
+    boost::asio::write(socket, boost::asio::buffer(request));
+    const std::size_t n = boost::asio::read_until(socket, buf, "\n\n");  // Response, then its blank line
+    buf.consume(n);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// One client doing LIST_SEATS round trips over loopback TCP vs the AF_UNIX listener, and over
+// loopback TCP served by the io_uring backend (labelled as a fallback where it is unavailable)
+void BM_TransportRoundTrip(benchmark::State& state) {
+  RunningServer running(state.range(0) == 2 ? NetworkBackend::IoUring : NetworkBackend::Asio);
+  boost::asio::io_context ctx;
+  if (state.range(0) != 1) {
+    state.SetLabel(state.range(0) == 0 ? "tcp_loopback"
+                   : UringTransport::available() ? "tcp_io_uring" : "tcp_io_uring_fallback_asio");
+    boost::asio::ip::tcp::socket socket(ctx);
+    socket.connect({boost::asio::ip::address_v4::loopback(), running.server->port()});
+    socket.set_option(boost::asio::ip::tcp::no_delay(true));
+    round_trips(state, socket);
+  } else {
+    state.SetLabel("unix");
+    boost::asio::local::stream_protocol::socket socket(ctx);
+    socket.connect(boost::asio::local::stream_protocol::endpoint(running.unix_path));
+    round_trips(state, socket);
+  }
+}
+BENCHMARK(BM_TransportRoundTrip)->ArgName("transport")->Arg(0)->Arg(1)->Arg(2)->UseRealTime();
+
+// ---- ServerMetrics ----
+
+std::unique_ptr<ServerMetrics> g_metrics;
+
+void setup_metrics(const benchmark::State& state) {
+  g_metrics = std::make_unique<ServerMetrics>(std::vector<std::string>{"BOOK", "INVALID"},
+                                              static_cast<std::uint32_t>(state.range(0)));
+}
+
+void teardown_metrics(const benchmark::State&) {
+  g_metrics.reset();
+}
+
+// Cost the metrics add to one request; compare with BM_ProcessRequestJson to keep it under 1%
+void BM_RequestRecorder(benchmark::State& state) {
+  for (auto _ : state) {
+    RequestRecorder recorder(*g_metrics);
+    recorder.set_command(0);
+    recorder.end_phase(RequestPhase::Parse);
+    recorder.end_phase(RequestPhase::Service);
+    recorder.end_phase(RequestPhase::Serialize);
+    recorder.end_phase(RequestPhase::Write);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RequestRecorder)
+    ->Setup(setup_metrics)->Teardown(teardown_metrics)
+    ->ArgName("sample_period")->Arg(1)->Arg(64)->Threads(1)->Threads(4)->UseRealTime();
+
+// ---- ThreadPool ----
+
+constexpr std::int64_t kMaxBacklog = 1024;
+
+void BM_ThreadPoolPost(benchmark::State& state) {
+  ThreadPool pool(static_cast<std::size_t>(state.range(0)));
+  std::atomic<std::int64_t> executed{0};
+  std::int64_t posted = 0;
+  for (auto _ : state) {
+    pool.post([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); });
+    // Bound the backlog so the result reflects dispatch, not just enqueueing
+    while (++posted - executed.load(std::memory_order_relaxed) > kMaxBacklog) {
+      --posted;
+      std::this_thread::yield();
+    }
+  }
+  while (executed.load(std::memory_order_relaxed) < posted) {
+    std::this_thread::yield(); // Tasks capture locals, let them finish before returning
+  }
+  state.SetItemsProcessed(posted);
+}
+BENCHMARK(BM_ThreadPoolPost)->ArgName("workers")->Arg(1)->Arg(4)->Arg(8)->UseRealTime();
+
+}
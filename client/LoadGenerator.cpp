@@ -0,0 +1,370 @@
+/**
+ * @file LoadGenerator.cpp
+ * @brief Multi-connection load generator for the movie booking server
+ * @details Opens many persistent connections and drives them with a configurable
+ *          command mix, either closed loop (each connection sends its next request as
+ *          soon as the previous response arrives) or open loop (requests are scheduled
+ *          at a constant total rate). In open loop, latency is measured from the time a
+ *          request was scheduled, not from when it could actually be sent, so a stalled
+ *          server shows up in the percentiles instead of silently lowering the load
+ *          (coordinated omission). Each worker thread runs its own io_context, its share
+ *          of the connections and its own histograms; they are merged for the report.
+ *
+ * Example:
+ *   loadgen --connections 2000 --threads 4 --duration 30 --mode open --rate 50000 \
+ *           --mix LIST_SEATS=80,BOOK=15,LIST_MOVIES=5 --hot-fraction 0.9
+ */
+
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Utils/LatencyHistogram.h"
+
+namespace json = boost::json;
+using boost::asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @struct Showing
+ * @brief Theater and movie a request targets
+ */
+struct Showing {
+  int theater_id;
+  int movie_id;
+};
+
+/**
+ * @struct CommandWeight
+ * @brief One entry of the command mix
+ */
+struct CommandWeight {
+  std::string command;
+  double weight;
+};
+
+/**
+ * @struct Options
+ * @brief Command line settings of a run
+ */
+struct Options {
+  std::string host = "127.0.0.1";
+  unsigned short port = 12345;
+  int connections = 100;
+  int threads = 2;
+  double duration_s = 10;
+  bool open_loop = false;
+  double rate = 10000;                 ///< Open loop: total requests per second over all connections
+  std::vector<CommandWeight> mix{{"LIST_SEATS", 80}, {"BOOK", 15}, {"LIST_MOVIES", 5}};
+  std::vector<Showing> showings{{1, 1}, {1, 2}, {2, 2}, {3, 2}, {3, 3}};  ///< Sample data of main.cpp
+  double hot_fraction = 0;             ///< Share of requests sent to the first showing
+};
+
+/**
+ * @struct WorkerStats
+ * @brief Results collected by one worker thread
+ */
+struct WorkerStats {
+  std::vector<LatencyHistogram> latency_ns;  ///< One histogram per command of the mix
+  std::uint64_t ok = 0;
+  std::uint64_t rejected = 0;      ///< FAILED bookings and NOT_ADMITTED
+  std::uint64_t errors = 0;        ///< Error responses and broken connections
+  std::uint64_t overloaded = 0;    ///< Requests shed by the server
+};
+
+void print_usage() {
+  std::cout << "Usage: loadgen [options]\n"
+            << "  --host H            server address (127.0.0.1)\n"
+            << "  --port P            server port (12345)\n"
+            << "  --connections N     persistent connections (100)\n"
+            << "  --threads T         worker threads, each with its own io_context (2)\n"
+            << "  --duration S        run time in seconds (10)\n"
+            << "  --mode closed|open  closed loop or constant arrival rate (closed)\n"
+            << "  --rate R            open loop total requests per second (10000)\n"
+            << "  --mix C=W,...       command weights (LIST_SEATS=80,BOOK=15,LIST_MOVIES=5)\n"
+            << "                      commands: LIST_MOVIES LIST_THEATERS LIST_SEATS BOOK SEARCH_MOVIES\n"
+            << "  --showings T:M,...  showings to target (1:1,1:2,2:2,3:2,3:3)\n"
+            << "  --hot-fraction F    share of requests for the first showing, rest uniform (0)\n";
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+  std::vector<std::string> parts;
+  std::stringstream ss(text);
+  std::string part;
+  while (std::getline(ss, part, separator)) {
+    if (!part.empty()) parts.push_back(part);
+  }
+  return parts;
+}
+
+Options parse_options(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string key = argv[i];
+    if (key == "--help" || key == "-h") {
+      print_usage();
+      std::exit(0);
+    }
+    if (i + 1 >= argc) {
+      throw std::invalid_argument("Missing value for " + key);
+    }
+    const std::string value = argv[++i];
+    if (key == "--host") options.host = value;
+    else if (key == "--port") options.port = static_cast<unsigned short>(std::stoi(value));
+    else if (key == "--connections") options.connections = std::stoi(value);
+    else if (key == "--threads") options.threads = std::stoi(value);
+    else if (key == "--duration") options.duration_s = std::stod(value);
+    else if (key == "--mode") options.open_loop = (value == "open");
+    else if (key == "--rate") options.rate = std::stod(value);
+    else if (key == "--hot-fraction") options.hot_fraction = std::stod(value);
+    else if (key == "--mix") {
+      options.mix.clear();
+      for (const auto& entry : split(value, ',')) {
+        auto eq = entry.find('=');
+        if (eq == std::string::npos) throw std::invalid_argument("Bad mix entry: " + entry);
+        options.mix.push_back({entry.substr(0, eq), std::stod(entry.substr(eq + 1))});
+      }
+    } else if (key == "--showings") {
+      options.showings.clear();
+      for (const auto& entry : split(value, ',')) {
+        auto colon = entry.find(':');
+        if (colon == std::string::npos) throw std::invalid_argument("Bad showing: " + entry);
+        options.showings.push_back({std::stoi(entry.substr(0, colon)), std::stoi(entry.substr(colon + 1))});
+      }
+    } else {
+      throw std::invalid_argument("Unknown option " + key);
+    }
+  }
+  if (options.connections <= 0 || options.threads <= 0 || options.mix.empty() || options.showings.empty()) {
+    throw std::invalid_argument("connections, threads, mix and showings must not be empty");
+  }
+  options.threads = std::min(options.threads, options.connections);
+  return options;
+}
+
+/**
+ * @class Connection
+ * @brief One persistent client connection driven by a chain of async operations
+ * @details Exactly one operation of a connection is pending at any time, so its
+ *          state needs no synchronization even though the io_context is shared.
+ */
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+  Connection(boost::asio::io_context& io_context, const Options& options, WorkerStats& stats,
+             Clock::time_point start, Clock::time_point stop, std::uint64_t seed)
+    : socket_(io_context), timer_(io_context), options_(options), stats_(stats),
+      stop_(stop), rng_(seed), command_pick_(command_distribution(options)) {
+    if (options_.open_loop) {
+      // Per-connection share of the total rate, with a random phase so connections do not fire together
+      interval_ = std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(options_.connections / options_.rate));
+      std::uniform_int_distribution<Clock::rep> phase(0, std::max<Clock::rep>(0, interval_.count() - 1));
+      next_send_ = start + Clock::duration(phase(rng_));
+    }
+  }
+
+  void start(const tcp::endpoint& endpoint) {
+    auto self = shared_from_this();
+    socket_.async_connect(endpoint, [self](boost::system::error_code ec) {
+      if (ec) {
+        ++self->stats_.errors;
+        return;
+      }
+      self->socket_.set_option(tcp::no_delay(true));
+      self->schedule();
+    });
+  }
+
+private:
+  static std::discrete_distribution<std::size_t> command_distribution(const Options& options) {
+    std::vector<double> weights;
+    for (const auto& entry : options.mix) weights.push_back(entry.weight);
+    return std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+  }
+
+  void schedule() {
+    if (!options_.open_loop) {
+      if (Clock::now() < stop_) send(Clock::now());
+      return;
+    }
+    if (next_send_ >= stop_) {
+      return;
+    }
+    const Clock::time_point intended = next_send_;
+    next_send_ += interval_;
+    auto self = shared_from_this();
+    timer_.expires_at(intended); // Already in the past if the server fell behind: fires at once
+    timer_.async_wait([self, intended](boost::system::error_code ec) {
+      if (!ec) self->send(intended);
+    });
+  }
+
+  const Showing& pick_showing() {
+    std::uniform_real_distribution<double> coin(0, 1);
+    if (coin(rng_) < options_.hot_fraction) {
+      return options_.showings.front();
+    }
+    std::uniform_int_distribution<std::size_t> any(0, options_.showings.size() - 1);
+    return options_.showings[any(rng_)];
+  }
+
+  std::string build_request(const std::string& command) {
+    const Showing& showing = pick_showing();
+    json::object request{{"command", command}};
+    if (command == "LIST_MOVIES") {
+      request["limit"] = 50;
+    } else if (command == "LIST_THEATERS") {
+      request["movie_id"] = showing.movie_id;
+    } else if (command == "SEARCH_MOVIES") {
+      request["query"] = "the";
+    } else {
+      request["theater_id"] = showing.theater_id;
+      request["movie_id"] = showing.movie_id;
+      if (command == "BOOK") {
+        // Default 20 seat layout: rows a-d, seats 1-5
+        std::uniform_int_distribution<int> row(0, 3);
+        std::uniform_int_distribution<int> number(1, 5);
+        request["seats"] = json::array{std::string(1, static_cast<char>('a' + row(rng_))) + std::to_string(number(rng_))};
+      }
+    }
+    return json::serialize(request) + "\n";
+  }
+
+  void send(Clock::time_point intended) {
+    command_ = command_pick_(rng_);
+    request_ = build_request(options_.mix[command_].command);
+    intended_ = intended;
+    auto self = shared_from_this();
+    boost::asio::async_write(socket_, boost::asio::buffer(request_), [self](boost::system::error_code ec, std::size_t) {
+      if (ec) {
+        ++self->stats_.errors;
+        return;
+      }
+      self->receive();
+    });
+  }
+
+  void receive() {
+    auto self = shared_from_this();
+    boost::asio::async_read_until(socket_, buffer_, '\n', [self](boost::system::error_code ec, std::size_t) {
+      if (ec) {
+        ++self->stats_.errors;
+        return;
+      }
+      std::istream is(&self->buffer_);
+      std::string line;
+      std::getline(is, line);
+      if (line.empty()) {
+        self->receive(); // Blank separator line, the response is still to come
+        return;
+      }
+      self->complete(line);
+    });
+  }
+
+  void complete(const std::string& response) {
+    const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - intended_);
+    stats_.latency_ns[command_].record(static_cast<std::uint64_t>(latency.count()));
+    // Classify by substring; parsing every response would load the generator, not the server
+    if (response.find("OVERLOADED") != std::string::npos) ++stats_.overloaded;
+    else if (response.find("\"error\"") != std::string::npos) ++stats_.errors;
+    else if (response.find("FAILED") != std::string::npos || response.find("NOT_ADMITTED") != std::string::npos) ++stats_.rejected;
+    else ++stats_.ok;
+    schedule();
+  }
+
+  tcp::socket socket_;
+  boost::asio::steady_timer timer_;
+  boost::asio::streambuf buffer_;
+  const Options& options_;
+  WorkerStats& stats_;
+  Clock::time_point stop_;
+  Clock::time_point next_send_;
+  Clock::time_point intended_;
+  Clock::duration interval_{};
+  std::mt19937_64 rng_;
+  std::discrete_distribution<std::size_t> command_pick_;
+  std::size_t command_ = 0;
+  std::string request_;
+};
+
+void print_latency_row(const std::string& name, const LatencyHistogram& histogram) {
+  auto us = [](std::uint64_t ns) { return ns / 1000.0; };
+  std::printf("%-16s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name.c_str(),
+              static_cast<unsigned long long>(histogram.count()), us(histogram.mean()),
+              us(histogram.value_at_percentile(50)), us(histogram.value_at_percentile(90)),
+              us(histogram.value_at_percentile(99)), us(histogram.value_at_percentile(99.9)), us(histogram.max()));
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    const Options options = parse_options(argc, argv);
+    const tcp::endpoint endpoint(boost::asio::ip::make_address(options.host), options.port);
+
+    std::vector<WorkerStats> stats(options.threads);
+    for (auto& worker : stats) worker.latency_ns.resize(options.mix.size());
+
+    std::cout << "Running " << (options.open_loop ? "open" : "closed") << " loop against " << options.host << ":"
+              << options.port << " with " << options.connections << " connections on " << options.threads
+              << " threads for " << options.duration_s << " s" << std::endl;
+
+    const auto start = Clock::now() + std::chrono::milliseconds(200); // Time to open the connections
+    const auto stop = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration_s));
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; ++t) {
+      workers.emplace_back([&, t]() {
+        boost::asio::io_context io_context;
+        const int count = options.connections / options.threads + (t < options.connections % options.threads ? 1 : 0);
+        for (int i = 0; i < count; ++i) {
+          auto connection = std::make_shared<Connection>(io_context, options, stats[t], start, stop,
+                                                         static_cast<std::uint64_t>(t) << 32 | i);
+          connection->start(endpoint);
+        }
+        io_context.run();
+      });
+    }
+    for (auto& worker : workers) worker.join();
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    WorkerStats total;
+    total.latency_ns.resize(options.mix.size());
+    LatencyHistogram all;
+    for (const auto& worker : stats) {
+      for (std::size_t c = 0; c < options.mix.size(); ++c) {
+        total.latency_ns[c].merge(worker.latency_ns[c]);
+        all.merge(worker.latency_ns[c]);
+      }
+      total.ok += worker.ok;
+      total.rejected += worker.rejected;
+      total.errors += worker.errors;
+      total.overloaded += worker.overloaded;
+    }
+
+    std::printf("\nThroughput: %.0f responses/s over %.2f s\n", all.count() / elapsed, elapsed);
+    std::printf("Responses: %llu ok, %llu rejected, %llu overloaded, %llu errors\n\n",
+                static_cast<unsigned long long>(total.ok), static_cast<unsigned long long>(total.rejected),
+                static_cast<unsigned long long>(total.overloaded), static_cast<unsigned long long>(total.errors));
+    std::printf("%-16s %10s %10s %10s %10s %10s %10s %10s\n", "latency (us)", "count", "mean", "p50", "p90", "p99",
+                "p99.9", "max");
+    for (std::size_t c = 0; c < options.mix.size(); ++c) {
+      print_latency_row(options.mix[c].command, total.latency_ns[c]);
+    }
+    print_latency_row("ALL", all);
+  } catch (const std::exception& e) {
+    std::cerr << "loadgen: " << e.what() << "\n";
+    print_usage();
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,530 @@
+/**
+ * @file TrafficReplay.cpp
+ * @brief Replays a traffic capture against a movie booking server and checks the responses
+ * @details Reads a file written by the server's capture mode (ServerConfig::capture_path,
+ *          BOOKING_CAPTURE_FILE for the main app) and reopens every captured connection.
+ *          Each connection sends its requests in their original order, one at a time, no
+ *          earlier than their captured time divided by the speed factor; with --speed max
+ *          every connection sends as fast as the server answers. Every response is compared
+ *          with the captured one, except for fields that change on every run such as
+ *          confirmation codes (--volatile); those codes are carried over into the later
+ *          requests that quote them. Latency is measured from the scheduled send time, as in
+ *          loadgen, so a server falling behind the original pacing shows in the percentiles.
+ *          Replay against a server started with the same data as the captured one; answers
+ *          that depend on how connections interleave (e.g. two clients racing for one seat)
+ *          may legitimately differ when the pacing changes.
+ *
+ * Example:
+ *   BOOKING_CAPTURE_FILE=prod.cap ./movie_booking        # capture
+ *   replay --file prod.cap --speed 4 --threads 4          # replay at 4x against a fresh server
+ */
+
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Utils/LatencyHistogram.h"
+#include "Utils/TrafficCapture.h"
+
+namespace json = boost::json;
+using boost::asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @struct Options
+ * @brief Command line settings of a replay
+ */
+struct Options {
+  std::string host = "127.0.0.1";
+  unsigned short port = 12345;
+  std::string file;
+  double speed = 1.0;                           ///< Pacing factor, 0 for as fast as possible
+  int threads = 2;
+  std::set<std::string> ignored{"STATS"};       ///< Commands whose responses are not compared
+  std::vector<std::string> volatile_keys{"timestamp", "confirmation", "queue_token"};  ///< Fields allowed to differ
+  std::size_t show_mismatches = 5;
+};
+
+/**
+ * @struct Step
+ * @brief One captured request of a connection
+ */
+struct Step {
+  std::uint64_t offset_ns = 0;          ///< Since the first captured record
+  std::string request;
+  std::string command;                  ///< Value of "command", INVALID if the line is not such JSON
+  std::optional<std::string> expected;  ///< Captured response, missing if the capture ended first
+};
+
+/**
+ * @struct Script
+ * @brief Everything one captured connection did
+ */
+struct Script {
+  std::uint32_t connection = 0;
+  std::uint64_t open_ns = 0;
+  std::uint64_t close_ns = 0;
+  std::vector<Step> steps;
+};
+
+/**
+ * @struct Mismatch
+ * @brief A response that differs from the captured one
+ */
+struct Mismatch {
+  std::uint32_t connection;
+  std::string request;
+  std::string expected;
+  std::string received;
+};
+
+/**
+ * @struct WorkerStats
+ * @brief Results collected by one worker thread
+ */
+struct WorkerStats {
+  std::map<std::string, LatencyHistogram> latency_ns;  ///< By command
+  std::uint64_t matched = 0;
+  std::uint64_t mismatched = 0;
+  std::uint64_t unchecked = 0;   ///< Ignored commands and requests without a captured response
+  std::uint64_t errors = 0;      ///< Failed connects, writes and reads
+  std::vector<Mismatch> examples;
+};
+
+void print_usage() {
+  std::cout << "Usage: replay --file CAPTURE [options]\n"
+            << "  --host H             server address (127.0.0.1)\n"
+            << "  --port P             server port (12345)\n"
+            << "  --speed N|max        pacing: 1 original, 2 twice as fast, max as fast as possible (1)\n"
+            << "  --threads T          worker threads, each with its own io_context (2)\n"
+            << "  --ignore C,...       commands whose responses are not compared (STATS)\n"
+            << "  --volatile K,...     response fields allowed to differ (timestamp,confirmation,queue_token)\n"
+            << "  --show-mismatches N  mismatching responses printed (5)\n";
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+  std::vector<std::string> parts;
+  std::stringstream ss(text);
+  std::string part;
+  while (std::getline(ss, part, separator)) {
+    if (!part.empty()) parts.push_back(part);
+  }
+  return parts;
+}
+
+Options parse_options(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string key = argv[i];
+    if (key == "--help" || key == "-h") {
+      print_usage();
+      std::exit(0);
+    }
+    if (i + 1 >= argc) {
+      throw std::invalid_argument("Missing value for " + key);
+    }
+    const std::string value = argv[++i];
+    if (key == "--host") options.host = value;
+    else if (key == "--port") options.port = static_cast<unsigned short>(std::stoi(value));
+    else if (key == "--file") options.file = value;
+    else if (key == "--speed") options.speed = (value == "max") ? 0.0 : std::stod(value);
+    else if (key == "--threads") options.threads = std::stoi(value);
+    else if (key == "--show-mismatches") options.show_mismatches = static_cast<std::size_t>(std::stoul(value));
+    else if (key == "--volatile") options.volatile_keys = split(value, ',');
+    else if (key == "--ignore") {
+      const auto commands = split(value, ',');
+      options.ignored = std::set<std::string>(commands.begin(), commands.end());
+    } else {
+      throw std::invalid_argument("Unknown option " + key);
+    }
+  }
+  if (options.file.empty() || options.threads <= 0 || options.speed < 0) {
+    throw std::invalid_argument("--file is required, threads must be positive and speed not negative");
+  }
+  return options;
+}
+
+std::string command_of(const std::string& request) {
+  try {
+    const json::value parsed = json::parse(request);
+    if (const auto* object = parsed.if_object()) {
+      if (const auto* command = object->if_contains("command"); command && command->is_string()) {
+        return std::string(command->as_string());
+      }
+    }
+  } catch (const std::exception&) {
+  }
+  return "INVALID";
+}
+
+/**
+ * @struct FieldValue
+ * @brief Position of the value of a "key": field in compact JSON text
+ */
+struct FieldValue {
+  std::size_t begin;
+  std::size_t end;
+};
+
+/// Values of the given keys anywhere in a JSON line, in text order
+std::vector<FieldValue> find_fields(const std::string& text, const std::vector<std::string>& keys) {
+  std::vector<FieldValue> fields;
+  for (const std::string& key : keys) {
+    const std::string pattern = "\"" + key + "\":";
+    for (std::size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+      const std::size_t begin = text.find_first_not_of(' ', pos + pattern.size());
+      if (begin == std::string::npos) {
+        break;
+      }
+      std::size_t end = begin;
+      if (text[end] == '"') {
+        for (++end; end < text.size() && text[end] != '"'; ++end) {
+          if (text[end] == '\\') ++end;
+        }
+        end = std::min(end + 1, text.size());
+      } else {
+        end = text.find_first_of(",}]", begin);
+        end = (end == std::string::npos) ? text.size() : end;
+      }
+      fields.push_back({begin, end});
+    }
+  }
+  std::sort(fields.begin(), fields.end(), [](const FieldValue& a, const FieldValue& b) { return a.begin < b.begin; });
+  return fields;
+}
+
+/**
+ * @class TokenMap
+ * @brief Captured values of volatile fields mapped to the values the replayed server returned
+ * @details A confirmation code or queue token differs on every run. Once a replayed
+ *          response has been matched to the captured one, later requests quoting the
+ *          captured value (LOOKUP_BOOKING, CANCEL, BOOK with a queue_token) are rewritten
+ *          to carry the replayed one. Shared by every worker, since a client may reuse a
+ *          value on another connection.
+ */
+class TokenMap {
+public:
+  explicit TokenMap(const std::vector<std::string>& keys) : keys_(keys) {}
+
+  /**
+   * @brief Compare a replayed response with the captured one, ignoring volatile fields
+   * @details Learns the value pairs of matching responses for rewrite().
+   * @return true if both lines are equal once the volatile values are masked
+   */
+  bool equivalent(const std::string& expected, const std::string& received) {
+    const auto expected_fields = find_fields(expected, keys_);
+    const auto received_fields = find_fields(received, keys_);
+    if (expected_fields.size() != received_fields.size() ||
+        mask(expected, expected_fields) != mask(received, received_fields)) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < expected_fields.size(); ++i) {
+      const auto& field = expected_fields[i];
+      if (expected[field.begin] == '"') {
+        values_[expected.substr(field.begin, field.end - field.begin)] =
+            received.substr(received_fields[i].begin, received_fields[i].end - received_fields[i].begin);
+      }
+    }
+    return true;
+  }
+
+  /// The request with every known captured value replaced by its replayed counterpart
+  std::string rewrite(const std::string& request) const {
+    const auto fields = find_fields(request, keys_);
+    if (fields.empty()) {
+      return request;
+    }
+    std::string result;
+    std::size_t copied = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& field : fields) {
+      const auto it = values_.find(request.substr(field.begin, field.end - field.begin));
+      if (it != values_.end()) {
+        result.append(request, copied, field.begin - copied);
+        result += it->second;
+        copied = field.end;
+      }
+    }
+    result.append(request, copied, std::string::npos);
+    return result;
+  }
+
+private:
+  static std::string mask(const std::string& text, const std::vector<FieldValue>& fields) {
+    std::string masked;
+    std::size_t copied = 0;
+    for (const auto& field : fields) {
+      masked.append(text, copied, field.begin - copied);
+      masked += '?';
+      copied = field.end;
+    }
+    masked.append(text, copied, std::string::npos);
+    return masked;
+  }
+
+  const std::vector<std::string> keys_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::string> values_;
+};
+
+/**
+ * @brief Group the records of a capture by connection
+ * @details Responses are matched to requests in order, since a session answers its
+ *          requests one by one. Offsets are rebased on the first record.
+ */
+std::vector<Script> build_scripts(const CaptureFile& capture) {
+  std::map<std::uint32_t, Script> scripts;
+  std::map<std::uint32_t, std::size_t> answered;
+  const std::uint64_t base = capture.records.empty() ? 0 : capture.records.front().offset_ns;
+  for (const CaptureRecord& record : capture.records) {
+    const std::uint64_t offset = record.offset_ns - base;
+    auto [it, inserted] = scripts.try_emplace(record.connection);
+    Script& script = it->second;
+    if (inserted) {
+      script.connection = record.connection;
+      script.open_ns = offset;
+    }
+    script.close_ns = offset;
+    switch (record.kind) {
+      case CaptureKind::Open:
+        script.open_ns = offset;
+        break;
+      case CaptureKind::Request:
+        script.steps.push_back({offset, record.payload, command_of(record.payload), std::nullopt});
+        break;
+      case CaptureKind::Response: {
+        std::size_t& next = answered[record.connection];
+        if (next < script.steps.size()) {
+          script.steps[next++].expected = record.payload;
+        }
+        break;
+      }
+      case CaptureKind::Close:
+        break;
+    }
+  }
+  std::vector<Script> result;
+  result.reserve(scripts.size());
+  for (auto& [connection, script] : scripts) {
+    result.push_back(std::move(script));
+  }
+  return result;
+}
+
+/**
+ * @class Connection
+ * @brief Replays one captured connection as a chain of async operations
+ * @details Exactly one operation of a connection is pending at any time, so its
+ *          state needs no synchronization even though the io_context is shared.
+ */
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+  Connection(boost::asio::io_context& io_context, const Options& options, const Script& script,
+             WorkerStats& stats, TokenMap& tokens, Clock::time_point start)
+    : socket_(io_context), timer_(io_context), options_(options), script_(script), stats_(stats),
+      tokens_(tokens), start_(start) {}
+
+  void start(const tcp::endpoint& endpoint) {
+    auto self = shared_from_this();
+    wait_until(script_.open_ns, [self, endpoint]() {
+      self->socket_.async_connect(endpoint, [self](boost::system::error_code ec) {
+        if (ec) {
+          ++self->stats_.errors;
+          return;
+        }
+        self->socket_.set_option(tcp::no_delay(true));
+        self->next_step();
+      });
+    });
+  }
+
+private:
+  Clock::time_point scheduled(std::uint64_t offset_ns) const {
+    if (options_.speed == 0) {
+      return start_;
+    }
+    return start_ + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::nano>(offset_ns / options_.speed));
+  }
+
+  template<class Handler>
+  void wait_until(std::uint64_t offset_ns, Handler handler) {
+    timer_.expires_at(scheduled(offset_ns)); // Already in the past if the server fell behind: fires at once
+    timer_.async_wait([handler](boost::system::error_code ec) {
+      if (!ec) handler();
+    });
+  }
+
+  void next_step() {
+    auto self = shared_from_this();
+    if (index_ == script_.steps.size()) {
+      wait_until(script_.close_ns, [self]() {
+        boost::system::error_code ignored;
+        self->socket_.shutdown(tcp::socket::shutdown_both, ignored);
+        self->socket_.close(ignored);
+      });
+      return;
+    }
+    const Step& step = script_.steps[index_];
+    wait_until(step.offset_ns, [self, &step]() {
+      self->intended_ = self->scheduled(step.offset_ns);
+      self->request_ = self->tokens_.rewrite(step.request) + "\n";
+      boost::asio::async_write(self->socket_, boost::asio::buffer(self->request_),
+        [self](boost::system::error_code ec, std::size_t) {
+          if (ec) {
+            ++self->stats_.errors;
+            return;
+          }
+          self->receive();
+        });
+    });
+  }
+
+  void receive() {
+    auto self = shared_from_this();
+    boost::asio::async_read_until(socket_, buffer_, '\n', [self](boost::system::error_code ec, std::size_t) {
+      if (ec) {
+        ++self->stats_.errors;
+        return;
+      }
+      std::istream is(&self->buffer_);
+      std::string line;
+      std::getline(is, line);
+      if (line.empty()) {
+        self->receive(); // Blank separator line, the response is still to come
+        return;
+      }
+      self->complete(line);
+    });
+  }
+
+  void complete(const std::string& response) {
+    const Step& step = script_.steps[index_++];
+    const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - intended_);
+    stats_.latency_ns[step.command].record(static_cast<std::uint64_t>(latency.count()));
+    if (!step.expected || options_.ignored.count(step.command) != 0) {
+      ++stats_.unchecked;
+    } else if (response == *step.expected || tokens_.equivalent(*step.expected, response)) {
+      ++stats_.matched;
+    } else {
+      ++stats_.mismatched;
+      if (stats_.examples.size() < options_.show_mismatches) {
+        stats_.examples.push_back({script_.connection, step.request, *step.expected, response});
+      }
+    }
+    next_step();
+  }
+
+  tcp::socket socket_;
+  boost::asio::steady_timer timer_;
+  boost::asio::streambuf buffer_;
+  const Options& options_;
+  const Script& script_;
+  WorkerStats& stats_;
+  TokenMap& tokens_;
+  const Clock::time_point start_;
+  Clock::time_point intended_;
+  std::size_t index_ = 0;
+  std::string request_;
+};
+
+void print_latency_row(const std::string& name, const LatencyHistogram& histogram) {
+  auto us = [](std::uint64_t ns) { return ns / 1000.0; };
+  std::printf("%-16s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name.c_str(),
+              static_cast<unsigned long long>(histogram.count()), us(histogram.mean()),
+              us(histogram.value_at_percentile(50)), us(histogram.value_at_percentile(90)),
+              us(histogram.value_at_percentile(99)), us(histogram.value_at_percentile(99.9)), us(histogram.max()));
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    const Options options = parse_options(argc, argv);
+    const tcp::endpoint endpoint(boost::asio::ip::make_address(options.host), options.port);
+    const CaptureFile capture = TrafficCapture::read_file(options.file);
+    const std::vector<Script> scripts = build_scripts(capture);
+
+    std::uint64_t requests = 0;
+    std::uint64_t captured_ns = 0;
+    for (const Script& script : scripts) {
+      requests += script.steps.size();
+      captured_ns = std::max(captured_ns, script.close_ns);
+    }
+    const double captured_s = captured_ns / 1e9;
+    std::cout << "Replaying " << requests << " requests on " << scripts.size() << " connections (" << captured_s
+              << " s captured) against " << options.host << ":" << options.port << " at "
+              << (options.speed == 0 ? std::string("max") : std::to_string(options.speed) + "x") << " speed"
+              << std::endl;
+
+    const int threads = std::max(1, std::min<int>(options.threads, static_cast<int>(scripts.size())));
+    std::vector<WorkerStats> stats(threads);
+    TokenMap tokens(options.volatile_keys);
+    const auto start = Clock::now() + std::chrono::milliseconds(200); // Time to set the connections up
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t]() {
+        boost::asio::io_context io_context;
+        for (std::size_t i = t; i < scripts.size(); i += threads) {
+          std::make_shared<Connection>(io_context, options, scripts[i], stats[t], tokens, start)->start(endpoint);
+        }
+        io_context.run();
+      });
+    }
+    for (auto& worker : workers) worker.join();
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    WorkerStats total;
+    LatencyHistogram all;
+    for (const auto& worker : stats) {
+      for (const auto& [command, histogram] : worker.latency_ns) {
+        total.latency_ns[command].merge(histogram);
+        all.merge(histogram);
+      }
+      total.matched += worker.matched;
+      total.mismatched += worker.mismatched;
+      total.unchecked += worker.unchecked;
+      total.errors += worker.errors;
+      for (const auto& example : worker.examples) {
+        if (total.examples.size() < options.show_mismatches) total.examples.push_back(example);
+      }
+    }
+
+    std::printf("\nReplayed %llu of %llu requests in %.2f s (%.1fx the captured time), %.0f responses/s\n",
+                static_cast<unsigned long long>(all.count()), static_cast<unsigned long long>(requests), elapsed,
+                elapsed > 0 ? captured_s / elapsed : 0.0, all.count() / elapsed);
+    std::printf("Responses: %llu matched, %llu mismatched, %llu unchecked, %llu errors\n\n",
+                static_cast<unsigned long long>(total.matched), static_cast<unsigned long long>(total.mismatched),
+                static_cast<unsigned long long>(total.unchecked), static_cast<unsigned long long>(total.errors));
+    std::printf("%-16s %10s %10s %10s %10s %10s %10s %10s\n", "latency (us)", "count", "mean", "p50", "p90", "p99",
+                "p99.9", "max");
+    for (const auto& [command, histogram] : total.latency_ns) {
+      print_latency_row(command, histogram);
+    }
+    print_latency_row("ALL", all);
+
+    for (const auto& example : total.examples) {
+      std::cout << "\nMismatch on connection " << example.connection << "\n  request:  " << example.request
+                << "\n  expected: " << example.expected << "\n  received: " << example.received << "\n";
+    }
+    return (total.mismatched != 0 || total.errors != 0) ? 2 : 0;
+  } catch (const std::exception& e) {
+    std::cerr << "replay: " << e.what() << "\n";
+    print_usage();
+    return 1;
+  }
+}
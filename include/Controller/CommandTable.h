@@ -0,0 +1,249 @@
+/**
+ * @file CommandTable.h
+ * @brief Compile-time table of the JSON protocol commands: names, argument schemas and samples
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+/**
+ * @enum CommandType
+ * @brief Commands of the JSON protocol, in kCommands order; Unknown is any other name
+ */
+enum class CommandType : std::uint8_t {
+  ListMovies,
+  ListTheaters,
+  ListSeats,
+  Book,
+  SearchMovies,
+  LookupBooking,
+  Cancel,
+  JoinQueue,
+  QueueStatus,
+  Stats,
+  Batch,
+  SubscribeSeats,
+  Unknown
+};
+
+/**
+ * @enum ArgumentType
+ * @brief JSON type a command argument must have
+ */
+enum class ArgumentType : std::uint8_t {
+  Integer,     ///< Signed 64-bit integer
+  Id,          ///< Integer within the range of int, e.g. a movie or theater id
+  String,
+  Boolean,
+  StringArray, ///< Array whose elements are all strings
+  ObjectArray  ///< Array whose elements are all objects
+};
+
+/**
+ * @struct ArgumentSpec
+ * @brief One field a command reads besides "command"
+ */
+struct ArgumentSpec {
+  std::string_view name;
+  ArgumentType type;
+  bool required;
+};
+
+/**
+ * @struct CommandSpec
+ * @brief Name, argument schema and sample request of a command
+ */
+struct CommandSpec {
+  std::string_view name;
+  CommandType type;
+  std::span<const ArgumentSpec> arguments;  ///< Checked before the handler runs; other fields are ignored
+  std::string_view sample;                  ///< Example request shown in INVALID_REQUEST responses
+};
+
+namespace command_schema {
+
+inline constexpr ArgumentSpec kListMovies[] = {
+  {"after_id", ArgumentType::Id, false},
+  {"limit", ArgumentType::Integer, false},
+  {"theater_id", ArgumentType::Id, false},
+  {"fields", ArgumentType::StringArray, false},
+  {"if_version", ArgumentType::Integer, false}
+};
+inline constexpr ArgumentSpec kListTheaters[] = {
+  {"movie_id", ArgumentType::Id, true},
+  {"after_id", ArgumentType::Id, false},
+  {"limit", ArgumentType::Integer, false},
+  {"fields", ArgumentType::StringArray, false},
+  {"if_version", ArgumentType::Integer, false}
+};
+inline constexpr ArgumentSpec kShowing[] = {
+  {"theater_id", ArgumentType::Id, true},
+  {"movie_id", ArgumentType::Id, true}
+};
+inline constexpr ArgumentSpec kListSeats[] = {
+  {"theater_id", ArgumentType::Id, true},
+  {"movie_id", ArgumentType::Id, true},
+  {"format", ArgumentType::String, false},
+  {"layout_version", ArgumentType::Integer, false},
+  {"if_version", ArgumentType::Integer, false}
+};
+inline constexpr ArgumentSpec kBook[] = {
+  {"theater_id", ArgumentType::Id, true},
+  {"movie_id", ArgumentType::Id, true},
+  {"seats", ArgumentType::StringArray, true},
+  {"request_id", ArgumentType::String, false},
+  {"queue_token", ArgumentType::String, false}
+};
+inline constexpr ArgumentSpec kSearchMovies[] = {
+  {"query", ArgumentType::String, true},
+  {"limit", ArgumentType::Integer, false},
+  {"fields", ArgumentType::StringArray, false}
+};
+inline constexpr ArgumentSpec kConfirmation[] = {
+  {"confirmation", ArgumentType::String, true}
+};
+inline constexpr ArgumentSpec kQueueStatus[] = {
+  {"theater_id", ArgumentType::Id, true},
+  {"movie_id", ArgumentType::Id, true},
+  {"queue_token", ArgumentType::String, true}
+};
+inline constexpr ArgumentSpec kBatch[] = {
+  {"requests", ArgumentType::ObjectArray, true},
+  {"atomic", ArgumentType::Boolean, false}
+};
+
+}  // namespace command_schema
+
+/// Every command, indexed by CommandType
+inline constexpr CommandSpec kCommands[] = {
+  {"LIST_MOVIES", CommandType::ListMovies, command_schema::kListMovies,
+   R"({"command":"LIST_MOVIES"})"},
+  {"LIST_THEATERS", CommandType::ListTheaters, command_schema::kListTheaters,
+   R"({"command":"LIST_THEATERS","movie_id":123})"},
+  {"LIST_SEATS", CommandType::ListSeats, command_schema::kListSeats,
+   R"({"command":"LIST_SEATS","theater_id":456,"movie_id":789})"},
+  {"BOOK", CommandType::Book, command_schema::kBook,
+   R"({"command":"BOOK","theater_id":456,"movie_id":789,"seats":["A1","A2","B3"]})"},
+  {"SEARCH_MOVIES", CommandType::SearchMovies, command_schema::kSearchMovies,
+   R"({"command":"SEARCH_MOVIES","query":"matr","limit":10})"},
+  {"LOOKUP_BOOKING", CommandType::LookupBooking, command_schema::kConfirmation,
+   R"({"command":"LOOKUP_BOOKING","confirmation":"3QF7ZK2M9XH4C"})"},
+  {"CANCEL", CommandType::Cancel, command_schema::kConfirmation,
+   R"({"command":"CANCEL","confirmation":"3QF7ZK2M9XH4C"})"},
+  {"JOIN_QUEUE", CommandType::JoinQueue, command_schema::kShowing,
+   R"({"command":"JOIN_QUEUE","theater_id":456,"movie_id":789})"},
+  {"QUEUE_STATUS", CommandType::QueueStatus, command_schema::kQueueStatus,
+   R"({"command":"QUEUE_STATUS","theater_id":456,"movie_id":789,"queue_token":"0000D2N8Q0G7M4ZJ3VB9WQHX1P"})"},
+  {"STATS", CommandType::Stats, {},
+   R"({"command":"STATS"})"},
+  {"BATCH", CommandType::Batch, command_schema::kBatch,
+   R"({"command":"BATCH","requests":[{"command":"LIST_THEATERS","movie_id":123},{"command":"LIST_SEATS","theater_id":456,"movie_id":123}]})"},
+  {"SUBSCRIBE_SEATS", CommandType::SubscribeSeats, command_schema::kShowing,
+   R"({"command":"SUBSCRIBE_SEATS","theater_id":456,"movie_id":789})"}
+};
+
+inline constexpr std::size_t kCommandCount = std::size(kCommands);
+
+namespace command_table_detail {
+
+/// Slots of the hash table; a power of two so the slot is a mask. The seed only reaches
+/// the low bits through the basis, so 32 slots have no perfect seed past eleven commands.
+inline constexpr std::size_t kSlots = 64;
+
+constexpr std::uint32_t hash(std::string_view name, std::uint32_t seed) {
+  std::uint32_t h = 2166136261u ^ seed;  // FNV-1a
+  for (const char c : name) {
+    h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return h;
+}
+
+/// First seed for which every command name gets its own slot
+constexpr std::uint32_t find_seed() {
+  for (std::uint32_t seed = 0; seed < 100000; ++seed) {
+    std::array<bool, kSlots> used{};
+    bool collision = false;
+    for (const auto& command : kCommands) {
+      const std::size_t slot = hash(command.name, seed) & (kSlots - 1);
+      collision = collision || used[slot];
+      used[slot] = true;
+    }
+    if (!collision) {
+      return seed;
+    }
+  }
+  return UINT32_MAX;
+}
+
+inline constexpr std::uint32_t kSeed = find_seed();
+static_assert(kSeed != UINT32_MAX, "No perfect hash seed for the command names");
+
+/// Command index + 1 per slot, 0 for an empty slot
+constexpr std::array<std::uint8_t, kSlots> build_slots() {
+  std::array<std::uint8_t, kSlots> slots{};
+  for (std::size_t i = 0; i < kCommandCount; ++i) {
+    slots[hash(kCommands[i].name, kSeed) & (kSlots - 1)] = static_cast<std::uint8_t>(i + 1);
+  }
+  return slots;
+}
+
+inline constexpr std::array<std::uint8_t, kSlots> kSlotTable = build_slots();
+
+constexpr bool indexed_by_type() {
+  for (std::size_t i = 0; i < kCommandCount; ++i) {
+    if (static_cast<std::size_t>(kCommands[i].type) != i) return false;
+  }
+  return kCommandCount == static_cast<std::size_t>(CommandType::Unknown);
+}
+static_assert(indexed_by_type(), "kCommands must list every CommandType in declaration order");
+
+}  // namespace command_table_detail
+
+/**
+ * @brief Look up a command by name: one hash, one table load and one string compare
+ * @param name Value of the "command" field
+ * @return The command's entry, nullptr for an unknown name
+ */
+constexpr const CommandSpec* find_command(std::string_view name) {
+  using namespace command_table_detail;
+  const std::uint8_t index = kSlotTable[hash(name, kSeed) & (kSlots - 1)];
+  if (index == 0 || kCommands[index - 1].name != name) {
+    return nullptr;
+  }
+  return &kCommands[index - 1];
+}
+
+static_assert(find_command("BOOK") == &kCommands[static_cast<std::size_t>(CommandType::Book)]);
+static_assert(find_command("BOOKS") == nullptr);
+
+/**
+ * @brief The "sample_format" object of INVALID_REQUEST responses
+ * @return {"LIST_MOVIES":{...},...} from the samples of kCommands, in table order
+ */
+inline std::string sample_format_json() {
+  std::string json = "{";
+  for (const auto& command : kCommands) {
+    if (json.size() > 1) json += ',';
+    json.append("\"").append(command.name).append("\":").append(command.sample);
+  }
+  return json + "}";
+}
+
+/**
+ * @brief The "valid_commands" array of UNKNOWN_COMMAND responses
+ * @return ["LIST_MOVIES",...] in table order
+ */
+inline std::string command_names_json() {
+  std::string json = "[";
+  for (const auto& command : kCommands) {
+    if (json.size() > 1) json += ',';
+    json.append("\"").append(command.name).append("\"");
+  }
+  return json + "]";
+}
@@ -0,0 +1,155 @@
+/**
+ * @file ConnectionReaper.h
+ * @brief Read and write deadlines of every connection, enforced by one shared timer
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+/**
+ * @class ConnectionReaper
+ * @brief Shuts down connections that overrun their current deadline
+ * @details Each watched connection owns a slot that holds its deadline and what the deadline is
+ *          for. Setting a deadline reads the monotonic clock and stores two words to the slot, with
+ *          no lock and no timer. One steady_timer of the io_context ticks every `tick` while any
+ *          connection is watched and scans the slots. It calls shutdown() on the socket of every
+ *          connection past its deadline. That makes a blocked read return end of
+ *          stream and a blocked write fail on whichever thread owns the connection, and the owner
+ *          then closes it as usual.
+ *
+ *          A scan reads one word per slot, well under a millisecond for 100k connections. A
+ *          deadline fires between timeout and timeout plus one tick after it was set.
+ *
+ *          Slots are handed out and given back under a mutex that the scan also holds, so a
+ *          connection that stopped being watched is never shut down afterwards, even if its
+ *          descriptor number is reused at once.
+ */
+class ConnectionReaper {
+public:
+  /// What a connection's deadline is for
+  enum class Deadline : std::uint8_t {
+    None,   ///< No deadline
+    Idle,   ///< Waiting for the next request line
+    Write   ///< Waiting for the client to take a response
+  };
+
+private:
+  struct Slot {
+    std::atomic<std::int64_t> deadline{0};  ///< Milliseconds since epoch_, 0 when there is none
+    std::atomic<Deadline> kind{Deadline::None};
+    std::atomic<Deadline> expired{Deadline::None};
+    int fd = -1;                            ///< -1 while the slot is free; guarded by mutex_
+  };
+
+public:
+
+  /// Lower case name of a deadline kind, for logs and STATS
+  static const char* name(Deadline deadline) {
+    switch (deadline) {
+      case Deadline::Idle: return "idle";
+      case Deadline::Write: return "write";
+      case Deadline::None: break;
+    }
+    return "none";
+  }
+
+  /**
+   * @class Watch
+   * @brief One watched connection; stops watching when destroyed or reset
+   */
+  class Watch {
+  public:
+    Watch() = default;
+    Watch(Watch&& other) noexcept
+      : reaper_(std::exchange(other.reaper_, nullptr)), slot_(other.slot_) {}
+    Watch& operator=(Watch&& other) noexcept {
+      if (this != &other) {
+        reset();
+        reaper_ = std::exchange(other.reaper_, nullptr);
+        slot_ = other.slot_;
+      }
+      return *this;
+    }
+    ~Watch() { reset(); }
+
+    /**
+     * @brief Give the connection a new deadline, replacing the current one
+     * @param deadline What the connection waits for
+     * @param timeout How long it may wait; zero clears the deadline
+     */
+    void expect(Deadline deadline, std::chrono::milliseconds timeout) {
+      if (reaper_) reaper_->expect(slot_, deadline, timeout);
+    }
+
+    /// Deadline that shut the connection down, None if it was not reaped
+    Deadline expired() const {
+      return reaper_ ? reaper_->expired(slot_) : Deadline::None;
+    }
+
+    /// Stop watching; call before the descriptor is closed or handed over
+    void reset() {
+      if (reaper_) std::exchange(reaper_, nullptr)->release(slot_);
+    }
+
+  private:
+    friend class ConnectionReaper;
+    Watch(ConnectionReaper* reaper, Slot* slot) : reaper_(reaper), slot_(slot) {}
+
+    ConnectionReaper* reaper_ = nullptr;
+    Slot* slot_ = nullptr;  ///< Never moves, so it is used without the reaper's lock
+  };
+
+  /**
+   * @brief Constructor; the timer runs only while some connection is watched
+   * @param io_context Context the shared timer runs on
+   * @param tick Period of the timer, the resolution of every deadline
+   */
+  ConnectionReaper(boost::asio::io_context& io_context, std::chrono::milliseconds tick);
+  ~ConnectionReaper();
+
+  ConnectionReaper(const ConnectionReaper&) = delete;
+  ConnectionReaper& operator=(const ConnectionReaper&) = delete;
+
+  /**
+   * @brief Start watching a connection, without a deadline
+   * @param fd The connection's socket; must stay open while the watch lives
+   * @return The watch, which must not outlive the reaper
+   */
+  Watch watch(int fd);
+
+  /// Connections shut down so far because of a deadline of this kind
+  std::uint64_t expired_total(Deadline deadline) const {
+    return expired_[static_cast<std::size_t>(deadline)].load(std::memory_order_relaxed);
+  }
+
+  /// Connections watched right now
+  std::size_t watched() const { return watched_.load(std::memory_order_relaxed); }
+
+private:
+  void expect(Slot* slot, Deadline deadline, std::chrono::milliseconds timeout);
+  static Deadline expired(const Slot* slot) { return slot->expired.load(std::memory_order_relaxed); }
+  void release(Slot* slot);
+  void arm_timer();
+  void scan();
+  std::int64_t now_ms() const;
+
+  const std::chrono::milliseconds tick_;
+  const std::chrono::steady_clock::time_point epoch_;  ///< Deadlines count milliseconds from here, from 1
+  boost::asio::steady_timer timer_;
+  std::mutex mutex_;                          ///< Guards slots_, free_, the fds, timer_ and timer_armed_
+  std::deque<Slot> slots_;                    ///< A deque, so slots never move
+  std::vector<Slot*> free_;
+  bool timer_armed_ = false;
+  std::atomic<std::size_t> watched_{0};
+  std::atomic<std::uint64_t> expired_[3] = {};
+};
@@ -0,0 +1,92 @@
+/**
+ * @file LoadShedder.h
+ * @brief Admission control for TcpServer: session cap and per-connection / per-client rate limits
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "Controller/ServerConfig.h"
+#include "Utils/TokenBucket.h"
+
+/**
+ * @class LoadShedder
+ * @brief Decides, before any parsing, whether a session or a request is served
+ * @details Each connection owns a token bucket and every client address maps to one
+ *          of a fixed number of shared buckets (addresses that hash to the same bucket
+ *          share its budget, which keeps memory bounded under address churn). A global
+ *          counter caps concurrent sessions. All checks are atomics only, and the limits
+ *          themselves are atomics so they can be changed while requests are admitted.
+ */
+class LoadShedder {
+public:
+  /**
+   * @brief Constructor
+   * @param limits Initial limits
+   * @param client_buckets Number of shared per-client buckets
+   */
+  LoadShedder(const RateLimits& limits, std::size_t client_buckets);
+
+  /**
+   * @brief Replace the limits; takes effect on the next admission check
+   * @param limits New limits
+   */
+  void set_limits(const RateLimits& limits);
+
+  /**
+   * @brief Reserve a session slot for a new connection
+   * @return false if max_sessions sessions are already running
+   */
+  bool try_open_session();
+
+  /**
+   * @brief Release a slot taken by try_open_session
+   */
+  void close_session();
+
+  /**
+   * @brief Bucket index for a client, computed once per connection
+   * @param client_key Client identity, typically the remote address
+   * @return Index to pass to admit_request
+   */
+  std::size_t client_slot(std::string_view client_key) const;
+
+  /**
+   * @brief Charge one request to its connection and client buckets
+   * @details A request refused by either bucket is charged to neither.
+   * @param connection Bucket owned by the session
+   * @param client_slot Result of client_slot for the session's client
+   * @return true if the request may be processed
+   */
+  bool admit_request(TokenBucket& connection, std::size_t client_slot);
+
+  /**
+   * @brief Number of sessions currently open
+   * @return Active session count
+   */
+  std::size_t active_sessions() const;
+
+  /**
+   * @brief Response sent instead of processing a shed request or session
+   * @return Newline terminated JSON built once at startup
+   */
+  static const std::string& overloaded_response();
+
+private:
+  std::unique_ptr<TokenBucket[]> client_buckets_;
+  std::size_t client_bucket_count_;
+  std::atomic<std::size_t> active_sessions_{0};
+
+  // Limits in TokenBucket units, each field replaced atomically by set_limits
+  std::atomic<std::int64_t> connection_interval_ns_{0};
+  std::atomic<std::int64_t> connection_tolerance_ns_{0};
+  std::atomic<std::int64_t> client_interval_ns_{0};
+  std::atomic<std::int64_t> client_tolerance_ns_{0};
+  std::atomic<std::size_t> max_sessions_{0};
+};
@@ -0,0 +1,51 @@
+/**
+ * @file RequestScanner.h
+ * @brief Single-pass scanner for the most frequent request shapes, used before the generic JSON parser
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+/**
+ * @enum ScannedCommand
+ * @brief Commands the scanner recognizes
+ */
+enum class ScannedCommand : std::uint8_t { ListMovies, ListTheaters, ListSeats, Book };
+
+/**
+ * @struct ScannedRequest
+ * @brief Fields of a request in one of the fixed shapes, without a DOM
+ */
+struct ScannedRequest {
+  /// Longest seat list taken by the fast path; longer BOOKs go through the parser
+  static constexpr std::size_t kMaxSeats = 32;
+
+  ScannedCommand command = ScannedCommand::ListMovies;
+  int theater_id = 0;
+  int movie_id = 0;
+  std::size_t seat_count = 0;
+  std::array<std::string_view, kMaxSeats> seats{};  ///< Views into the scanned line
+};
+
+/**
+ * @brief Recognize a request of one of the fixed shapes in a single pass
+ * @details Accepted shapes, keys in any order, JSON whitespace anywhere:
+ *          - {"command":"LIST_MOVIES"}
+ *          - {"command":"LIST_THEATERS","movie_id":M}
+ *          - {"command":"LIST_SEATS","theater_id":T,"movie_id":M}
+ *          - {"command":"BOOK","theater_id":T,"movie_id":M,"seats":["a1",...]}
+ *
+ *          Ids are integers of at most 9 digits, strings are printable ASCII without
+ *          escapes. Anything else, including optional parameters (limit, fields,
+ *          request_id, queue_token...), duplicate keys and malformed JSON, returns
+ *          std::nullopt so the caller falls back to the generic parser, which gives
+ *          such requests their usual answer or error.
+ * @param line Request line without its newline
+ * @return Extracted fields, or std::nullopt to fall back
+ */
+std::optional<ScannedRequest> scan_request(std::string_view line);
@@ -0,0 +1,141 @@
+/**
+ * @file RequestTracer.h
+ * @brief Sampled per-request spans in per-thread ring buffers, exported as Chrome trace JSON
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Controller/ServerMetrics.h"
+#include "Utils/PerThread.h"
+
+/**
+ * @enum TraceSpan
+ * @brief Kinds of events recorded for a traced session or request
+ */
+enum class TraceSpan : std::uint8_t {
+  Accept,     ///< Instant: connection accepted on the io_context thread
+  PoolQueue,  ///< From enqueue on the thread pool to dequeue by a worker
+  Request,    ///< Whole request, parent of the four phases below
+  Parse,
+  Service,
+  Serialize,
+  Write
+};
+
+/**
+ * @class RequestTracer
+ * @brief Records spans of sampled requests for offline inspection of latency outliers
+ * @details Each thread appends to its own fixed-size ring buffer: three relaxed stores
+ *          and a release store of the head, no lock, and the oldest events are
+ *          overwritten. chrome_trace_json() copies every buffer, discarding events a
+ *          writer may have overwritten meanwhile, and renders the Trace Event Format
+ *          that chrome://tracing and Perfetto open directly. One session or request in
+ *          sample_period per thread is traced; untraced requests cost one countdown.
+ */
+class RequestTracer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Command index of events not tied to a command (Accept, PoolQueue)
+  static constexpr std::size_t kNoCommand = 0xFF;
+
+  /**
+   * @brief Constructor
+   * @param command_names Name of each command index, as given to ServerMetrics
+   * @param sample_period Trace one session or request in this many per thread, 0 disables tracing
+   * @param buffer_events Events kept per thread
+   */
+  RequestTracer(std::vector<std::string> command_names, std::uint32_t sample_period, std::size_t buffer_events);
+  ~RequestTracer();
+
+  RequestTracer(const RequestTracer&) = delete;
+  RequestTracer& operator=(const RequestTracer&) = delete;
+
+  /// Whether tracing is on at all
+  bool enabled() const { return sample_period_ != 0; }
+
+  /**
+   * @brief Decide whether the calling thread traces its next session or request
+   * @return true one time in sample_period, always false when disabled
+   */
+  bool sample();
+
+  /**
+   * @brief Append an event to the calling thread's buffer
+   * @param span Event kind; Accept is recorded as an instant at start
+   * @param session Session id
+   * @param sequence Request number within the session
+   * @param command Command index, or kNoCommand
+   * @param start Start of the event
+   * @param end End of the event
+   */
+  void record(TraceSpan span, std::uint32_t session, std::uint16_t sequence, std::size_t command,
+              Clock::time_point start, Clock::time_point end);
+
+  /**
+   * @brief Render every buffered event in the Chrome Trace Event Format
+   * @return JSON object with a traceEvents array, timestamps in microseconds since construction
+   */
+  std::string chrome_trace_json() const;
+
+private:
+  struct ThreadBuffer;
+
+  const std::vector<std::string> command_names_;
+  const std::uint32_t sample_period_;
+  const std::size_t buffer_events_;
+  const Clock::time_point epoch_;
+  std::atomic<std::uint32_t> next_thread_{1};
+  PerThread<ThreadBuffer> buffers_;
+};
+
+/**
+ * @class RequestTrace
+ * @brief Trace of one request, fed phase by phase by its RequestRecorder
+ * @details Decides on construction whether the request is sampled; an inactive trace
+ *          records nothing. The enclosing Request span is recorded on destruction.
+ */
+class RequestTrace {
+public:
+  /**
+   * @brief Constructor
+   * @param tracer Tracer to record into
+   * @param session Session the request arrived on
+   * @param sequence Request number within the session
+   */
+  RequestTrace(RequestTracer& tracer, std::uint32_t session, std::uint16_t sequence);
+  ~RequestTrace();
+
+  RequestTrace(const RequestTrace&) = delete;
+  RequestTrace& operator=(const RequestTrace&) = delete;
+
+  /// Whether this request is traced; pass it to RequestRecorder only if so
+  bool active() const { return active_; }
+
+  /**
+   * @brief Record one finished phase
+   * @param phase Phase that ended
+   * @param command Command index of the request
+   * @param start Start of the phase
+   * @param end End of the phase
+   */
+  void record_phase(RequestPhase phase, std::size_t command, RequestTracer::Clock::time_point start,
+                    RequestTracer::Clock::time_point end);
+
+private:
+  RequestTracer& tracer_;
+  const std::uint32_t session_;
+  const std::uint16_t sequence_;
+  const bool active_;
+  std::size_t command_ = RequestTracer::kNoCommand;
+  RequestTracer::Clock::time_point start_{};
+  RequestTracer::Clock::time_point end_{};
+};
@@ -0,0 +1,133 @@
+/**
+ * @file SeatSubscriptions.h
+ * @brief Pushes seat changes of subscribed showings to their connections, coalesced per time window
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <compare>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "Interfaces/IBookingService.h"
+#include "Models/SeatMap.h"
+
+/**
+ * @struct ShowingKey
+ * @brief Theater and movie of one showing
+ */
+struct ShowingKey {
+  int theater_id = 0;
+  int movie_id = 0;
+
+  auto operator<=>(const ShowingKey&) const = default;
+};
+
+/**
+ * @class SeatSubscriptions
+ * @brief Owns the connections that sent SUBSCRIBE_SEATS and streams seat events to them
+ * @details A subscribed connection leaves the thread pool: its socket is handed over and
+ *          served asynchronously on the io_context, so an idle subscriber costs a socket
+ *          and a few hundred bytes, not a worker. It first receives a SEATS_SNAPSHOT event
+ *          (base64 bitmap, as LIST_SEATS "bitmap"), then one SEATS_CHANGED event per time
+ *          window in which the showing changed, listing the seat indexes booked and
+ *          released since the previous event.
+ *
+ *          Once per window the timer compares each subscribed showing's seat version with
+ *          the version last published, one atomic load per showing. Only a changed showing
+ *          has its seat map read and diffed; the event is serialized once and the same
+ *          buffer is queued on every subscriber. A subscriber whose queue reaches
+ *          max_queued events is disconnected, since skipping an event would corrupt its
+ *          view; it resubscribes for a fresh snapshot. Anything a subscriber sends is
+ *          discarded; closing the connection unsubscribes.
+ *
+ *          All state is owned by a strand of the io_context; subscribe() may be called
+ *          from any thread.
+ */
+class SeatSubscriptions {
+public:
+  using Socket = boost::asio::generic::stream_protocol::socket;  ///< TCP or Unix domain connection
+
+  /**
+   * @brief Constructor
+   * @param io_context Context the sockets and the publish timer run on
+   * @param booking_service Source of seat versions and seat maps
+   * @param window Changes within one window are coalesced into one event
+   * @param max_subscribers Subscriptions accepted at the same time
+   * @param max_queued Events waiting to be written to one subscriber before it is dropped
+   */
+  SeatSubscriptions(boost::asio::io_context& io_context, IBookingService& booking_service,
+                    std::chrono::milliseconds window, std::size_t max_subscribers, std::size_t max_queued);
+  ~SeatSubscriptions();
+
+  SeatSubscriptions(const SeatSubscriptions&) = delete;
+  SeatSubscriptions& operator=(const SeatSubscriptions&) = delete;
+
+  /**
+   * @brief Take over a connection and subscribe it to a showing
+   * @details Returns at once; the snapshot is written from the io_context.
+   * @param socket Connected socket; the caller must not use it afterwards
+   * @param showing Showing to follow, checked to exist by the caller
+   */
+  void subscribe(std::shared_ptr<Socket> socket, ShowingKey showing);
+
+  /// Whether another subscription is accepted
+  bool has_capacity() const { return active() < max_subscribers_; }
+
+  /// Subscriptions open right now
+  std::size_t active() const { return active_.load(std::memory_order_relaxed); }
+
+  /// Coalescing window
+  std::chrono::milliseconds window() const { return window_; }
+
+  /**
+   * @brief SEATS_SNAPSHOT event of a showing
+   * @param showing Showing the map belongs to
+   * @param map Seat map to send
+   * @return One JSON line, newline terminated
+   */
+  static std::string snapshot_event(ShowingKey showing, const SeatMap& map);
+
+  /**
+   * @brief SEATS_CHANGED event between two seat maps of a showing
+   * @param showing Showing the maps belong to
+   * @param before Map last sent to the subscribers
+   * @param after Current map, of the same layout
+   * @return One JSON line, newline terminated
+   */
+  static std::string delta_event(ShowingKey showing, const SeatMap& before, const SeatMap& after);
+
+private:
+  struct Subscriber;
+
+  /// Subscribers of one showing and the map their last event described
+  struct Topic {
+    SeatMap last;
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+  };
+
+  void add(const std::shared_ptr<Subscriber>& subscriber);
+  void publish();
+  void arm_timer();
+  void send(const std::shared_ptr<Subscriber>& subscriber, std::shared_ptr<const std::string> event);
+  void write_next(const std::shared_ptr<Subscriber>& subscriber);
+  void read_until_closed(const std::shared_ptr<Subscriber>& subscriber);
+  void drop(const std::shared_ptr<Subscriber>& subscriber);
+
+  IBookingService& booking_service_;
+  const std::chrono::milliseconds window_;
+  const std::size_t max_subscribers_;
+  const std::size_t max_queued_;
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+  boost::asio::steady_timer timer_;   ///< Armed only while some showing has subscribers
+  bool timer_armed_ = false;
+  std::map<ShowingKey, Topic> topics_;
+  std::atomic<std::size_t> active_{0};
+};
@@ -0,0 +1,123 @@
+/**
+ * @file ServerConfig.h
+ * @brief Tunable settings of the TCP server
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @struct RateLimits
+ * @brief Load shedding limits, adjustable while the server runs (TcpServer::set_rate_limits)
+ * @details A rate of 0 disables the corresponding token bucket and a max_sessions
+ *          of 0 disables the session cap.
+ */
+struct RateLimits {
+  /// Sustained requests per second allowed on one connection
+  double connection_rate = 1000.0;
+
+  /// Requests one connection may send back to back
+  double connection_burst = 200.0;
+
+  /// Sustained requests per second allowed from one client address, over all its connections
+  double client_rate = 5000.0;
+
+  /// Requests one client address may send back to back
+  double client_burst = 1000.0;
+
+  /// Sessions served at the same time; further connections get OVERLOADED and are closed
+  std::size_t max_sessions = 10000;
+};
+
+/**
+ * @struct SessionLimits
+ * @brief Deadlines and size limit that keep one connection from pinning the server
+ * @details A connection past a deadline is shut down by the server's ConnectionReaper. A
+ *          timeout of 0 disables the corresponding deadline.
+ */
+struct SessionLimits {
+  /// How long a client may take to send a complete request line, counted from the previous response
+  std::chrono::milliseconds idle_timeout{120000};
+
+  /// How long a response may wait for the client to read it
+  std::chrono::milliseconds write_timeout{10000};
+
+  /// Longest request line, newline included; a longer one gets REQUEST_TOO_LARGE and the connection is closed
+  std::size_t max_request_bytes = 64 * 1024;
+};
+
+/**
+ * @enum NetworkBackend
+ * @brief What serves the TCP port
+ */
+enum class NetworkBackend : std::uint8_t {
+  Asio,    ///< Asio acceptor, one worker of the pool per session
+  IoUring  ///< io_uring rings (UringTransport); falls back to Asio where unavailable
+};
+
+/**
+ * @struct ServerConfig
+ * @brief Optional settings passed to TcpServer on construction
+ * @details Every field has a production default, so a default constructed
+ *          ServerConfig reproduces the server's standard behavior.
+ */
+struct ServerConfig {
+  /// Maximum number of BOOK request_id values remembered for replay
+  std::size_t booking_dedup_capacity = 1 << 18;
+
+  /// How long a BOOK request_id is replayed after its first use
+  std::chrono::seconds booking_dedup_ttl{300};
+
+  /// Clients admitted per second from each showing's waiting room
+  double waiting_room_rate = 50.0;
+
+  /// How long an admitted queue token may be used to book
+  std::chrono::seconds waiting_room_window{120};
+
+  /// Maximum number of showings with a waiting room at the same time
+  std::size_t waiting_room_showings = 4096;
+
+  /// Initial load shedding limits
+  RateLimits rate_limits;
+
+  /// Number of per-client token buckets; client addresses are hashed onto them
+  std::size_t client_buckets = 4096;
+
+  /// Phase latencies are timed on one request in this many per thread; counters see all of them
+  std::uint32_t metrics_sample_period = 64;
+
+  /// Port of the Prometheus metrics listener (GET /metrics, and GET /trace), 0 disables it
+  unsigned short metrics_port = 0;
+
+  /// Sessions and requests traced: one in this many per thread, 0 disables tracing
+  std::uint32_t trace_sample_period = 1024;
+
+  /// Trace events kept per thread; older ones are overwritten
+  std::size_t trace_buffer_events = 8192;
+
+  /// File every session's requests and responses are captured to for replay, empty disables capture
+  std::string capture_path;
+
+  /// Bytes of records captured before capture stops, 0 for no limit
+  std::uint64_t capture_max_bytes = 0;
+  /// SUBSCRIBE_SEATS changes within one window are pushed as a single event
+  std::chrono::milliseconds subscription_window{50};
+  /// Connections subscribed at the same time; further SUBSCRIBE_SEATS get SUBSCRIPTIONS_FULL
+  std::size_t max_subscribers = 10000;
+  /// Seat events queued for one slow subscriber before it is disconnected
+  std::size_t subscriber_queue_limit = 64;
+  /// Path of an AF_UNIX stream listener served like the TCP port, empty disables it
+  std::string unix_socket_path;
+  /// Backend of the TCP port; the Unix socket and metrics listeners always use Asio
+  NetworkBackend network_backend = NetworkBackend::Asio;
+  /// io_uring rings, each with its own thread and listener; 0 for one per worker of the pool
+  std::size_t io_uring_rings = 0;
+  /// Deadlines and request size limit of the TCP and Unix socket sessions
+  SessionLimits session_limits;
+  /// Period of the one timer that enforces every session's deadlines, their resolution
+  std::chrono::milliseconds reaper_tick{500};
+};
@@ -0,0 +1,191 @@
+/**
+ * @file ServerMetrics.h
+ * @brief Per-thread request metrics of TcpServer, merged on demand for STATS and Prometheus
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Utils/LatencyHistogram.h"
+#include "Utils/PerThread.h"
+
+class RequestTrace;
+
+/**
+ * @enum RequestPhase
+ * @brief Stages of handling one request, timed separately
+ */
+enum class RequestPhase {
+  Parse,      ///< JSON parse and command lookup
+  Service,    ///< Work done by the services for the command
+  Serialize,  ///< Building the response text
+  Write       ///< Writing the response to the socket
+};
+
+constexpr std::size_t kRequestPhaseCount = 4;
+
+/**
+ * @class ServerMetrics
+ * @brief Counters and latency histograms per command, recorded without locks
+ * @details Every thread that records gets its own slot (PerThread). A slot is only written by its
+ *          thread, so updates are plain relaxed loads and stores on atomics: no lock,
+ *          no read-modify-write, no shared cache line. Readers (STATS, Prometheus) walk
+ *          all slots and merge them, which is the only place that pays for aggregation.
+ *          Counters see every request; phase latencies are timed on one request in
+ *          sample_period per thread, which keeps clock reads off most requests.
+ */
+class ServerMetrics {
+  struct ThreadSlot;  // Defined in ServerMetrics.cpp
+
+public:
+  /// Latency histogram used for the merged view: within about 6% of the true value
+  using Histogram = BasicLatencyHistogram<5>;
+
+  /**
+   * @struct PhaseSummary
+   * @brief Latency of one phase of one command, in nanoseconds
+   */
+  struct PhaseSummary {
+    std::uint64_t samples = 0;
+    double mean = 0;
+    std::uint64_t p50 = 0;
+    std::uint64_t p90 = 0;
+    std::uint64_t p99 = 0;
+    std::uint64_t p999 = 0;
+    std::uint64_t max = 0;
+  };
+
+  /**
+   * @struct CommandSummary
+   * @brief Request count and phase latencies of one command
+   */
+  struct CommandSummary {
+    std::string name;
+    std::uint64_t requests = 0;
+    std::array<PhaseSummary, kRequestPhaseCount> phases;
+  };
+
+  /**
+   * @struct Snapshot
+   * @brief Merged view of all threads at one point in time
+   */
+  struct Snapshot {
+    double uptime_s = 0;
+    std::uint32_t sample_period = 1;
+    std::uint64_t connections_active = 0;
+    std::uint64_t connections_total = 0;
+    std::uint64_t requests_shed = 0;
+    std::uint64_t sessions_shed = 0;
+    std::uint64_t bookings_succeeded = 0;
+    std::uint64_t bookings_failed = 0;
+    std::vector<CommandSummary> commands;  ///< Commands with at least one request, in command order
+  };
+
+  /**
+   * @brief Constructor
+   * @param command_names Name of each command index; requests are recorded by index
+   * @param sample_period Time one request in this many per thread (1 times every request)
+   */
+  ServerMetrics(std::vector<std::string> command_names, std::uint32_t sample_period);
+  ~ServerMetrics();
+
+  ServerMetrics(const ServerMetrics&) = delete;
+  ServerMetrics& operator=(const ServerMetrics&) = delete;
+
+  /// A session was accepted
+  void connection_opened();
+
+  /// A session ended
+  void connection_closed();
+
+  /// A request was answered with OVERLOADED without being processed
+  void request_shed();
+
+  /// A connection was refused at accept because of the session cap
+  void session_shed();
+
+  /**
+   * @brief Count the outcome of a booking attempt
+   * @param success true if the seats were booked
+   */
+  void booking_result(bool success);
+
+  /**
+   * @brief Merge every thread's slot
+   * @return Current totals and latency percentiles
+   */
+  Snapshot snapshot() const;
+
+  /**
+   * @brief Render the metrics in the Prometheus text exposition format (version 0.0.4)
+   * @return Metrics page body
+   */
+  std::string prometheus_text() const;
+
+  /**
+   * @class RequestRecorder
+   * @brief Records one request: its command, and the duration of each phase when sampled
+   * @details Create one per request on the thread handling it. The request is counted
+   *          when the recorder is destroyed, under the last command set (or the last
+   *          command index if set_command was never called, e.g. unparseable input).
+   *          When given an active trace, every phase is timed and also handed to it.
+   */
+  class RequestRecorder {
+  public:
+    /**
+     * @brief Constructor
+     * @param metrics Metrics to record into
+     * @param trace Trace of the request, or nullptr when the request is not traced
+     */
+    explicit RequestRecorder(ServerMetrics& metrics, RequestTrace* trace = nullptr);
+    ~RequestRecorder();
+
+    RequestRecorder(const RequestRecorder&) = delete;
+    RequestRecorder& operator=(const RequestRecorder&) = delete;
+
+    /**
+     * @brief Attribute the request to a command
+     * @param command Index into the command names given to ServerMetrics
+     */
+    void set_command(std::size_t command);
+
+    /**
+     * @brief Close a phase: time since the previous phase ended (or since construction)
+     * @param phase Phase that just finished
+     */
+    void end_phase(RequestPhase phase);
+
+  private:
+    ThreadSlot& slot_;
+    RequestTrace* trace_;
+    std::size_t command_;
+    bool sampled_;
+    std::chrono::steady_clock::time_point last_;
+  };
+
+private:
+  friend class RequestRecorder;
+
+  /// The calling thread's slot, registered on first use
+  ThreadSlot& local();
+
+  const std::vector<std::string> command_names_;
+  const std::uint32_t sample_period_;
+  const std::chrono::steady_clock::time_point started_;
+  PerThread<ThreadSlot> slots_;
+
+  std::atomic<std::uint64_t> connections_active_{0};
+  std::atomic<std::uint64_t> connections_total_{0};
+  std::atomic<std::uint64_t> requests_shed_{0};
+  std::atomic<std::uint64_t> sessions_shed_{0};
+};
+
+using RequestRecorder = ServerMetrics::RequestRecorder;
@@ -14,12 +14,28 @@
 
 #include <boost/asio.hpp>
 #include <boost/json.hpp>
+#include <atomic>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 
 #include "Models/BookingService.h"
 #include "Models/AdministrationService.h"
+#include "Controller/CommandTable.h"
+#include "Controller/ConnectionReaper.h"
+#include "Controller/ServerConfig.h"
+#include "Controller/WaitingRoom.h"
+#include "Controller/LoadShedder.h"
+#include "Controller/ServerMetrics.h"
+#include "Controller/RequestTracer.h"
+#include "Controller/RequestArena.h"
+#include "Controller/RequestScanner.h"
+#include "Controller/SeatSubscriptions.h"
+#include "Controller/UringTransport.h"
+#include "Utils/DedupTable.h"
 #include "Utils/ThreadPool.h"
+#include "Utils/TrafficCapture.h"
 
 namespace json = boost::json;
 
@@ -29,9 +45,15 @@ namespace json = boost::json;
  * @details Handles client connections using Boost.Asio, processes both JSON and plain text
  *          requests, and delegates business logic to BookingService and AdministrationService.
  *          Uses a thread pool for concurrent client session handling to ensure scalability
- *          and responsiveness under high load conditions.
+ *          and responsiveness under high load conditions. Besides its TCP port it can listen
+ *          on an AF_UNIX stream socket (ServerConfig::unix_socket_path) with the same sessions.
+ *          Every session is bounded by ServerConfig::session_limits: a ConnectionReaper shuts
+ *          down connections that stay silent or stop reading past their deadline, and a request
+ *          line over the size limit is answered with REQUEST_TOO_LARGE and the connection closed.
+ *          With ServerConfig::network_backend set to IoUring, the TCP port is served by a
+ *          UringTransport instead, when the build and the kernel allow it.
  */
-class TcpServer {
+class TcpServer : private UringTransport::Handler {
 public:
   /**
    * @brief Construct TCP server with booking and administration services
@@ -43,11 +65,12 @@ public:
    * @param booking_service Reference to BookingService instance for seat booking operations
    * @param admin_service Reference to AdministrationService instance for system administration
    * @param thread_pool_size Number of worker threads in the thread pool for request handling
+   * @param config Optional tuning settings, defaults suit production use
    * @throws std::runtime_error if port binding fails or socket configuration errors occur
    */
   TcpServer(boost::asio::io_context& io_context, unsigned short port,
             IBookingService& booking_service, IAdministrationService& admin_service,
-            std::size_t thread_pool_size);
+            std::size_t thread_pool_size, const ServerConfig& config = ServerConfig{});
 
   /**
    * @brief Start accepting client connections
@@ -57,7 +80,67 @@ public:
    */
   void start();
 
+  /**
+   * @brief Change the load shedding limits of the running server
+   * @details Thread-safe; applies to the next accepted connection and the next request
+   *          of every open session, without resetting any bucket.
+   * @param limits New limits
+   */
+  void set_rate_limits(const RateLimits& limits);
+
+  /**
+   * @brief TCP port the server listens on
+   * @return The bound port, also when constructed with port 0
+   */
+  unsigned short port() const;
+
+  /**
+   * @brief Process a JSON request from client
+   * @details Parses JSON requests, validates command structure, and processes commands
+   *          through BookingService or AdministrationService as appropriate. Handles
+   *          all supported commands: LIST_MOVIES, LIST_THEATERS, LIST_SEATS, BOOK, SEARCH_MOVIES,
+   *          LOOKUP_BOOKING, CANCEL, JOIN_QUEUE, QUEUE_STATUS, STATS and BATCH;
+   *          SUBSCRIBE_SEATS needs a session and is rejected here.
+   *          Provides comprehensive error handling for malformed JSON and invalid requests.
+   *          Public so benchmarks and embedders can drive the protocol without a socket;
+   *          calls share one RequestArena per calling thread.
+   * @param request JSON request string from client
+   * @return JSON response string with results or error information
+   * @throws std::exception for JSON parsing errors (caught and converted to error response)
+   */
+  std::string process_request_json(const std::string& request);
+
 private:
+  /// Socket sessions run on: TCP and Unix domain connections alike
+  using SessionSocket = SeatSubscriptions::Socket;
+
+  /**
+   * @struct SessionContext
+   * @brief Per-connection state of the request loop, whichever transport carries the session
+   */
+  struct SessionContext {
+    SessionContext(std::uint32_t id, std::size_t client_slot, std::string_view client)
+      : id(id), client_slot(client_slot), client(client) {}
+
+    const std::uint32_t id;         ///< Session id used in traces and logs
+    const std::size_t client_slot;  ///< Token bucket of the session's client
+    const std::string client;       ///< Peer address, or "local"; scopes BOOK request_ids
+    std::uint16_t sequence = 0;     ///< Requests admitted so far
+    TokenBucket connection_bucket;
+    RequestArena arena;             ///< Parser, DOM memory and response buffer reused by every request
+  };
+
+  class UringSession;
+
+  /**
+   * @struct CommandResult
+   * @brief Response of one command: a DOM, or text already serialized
+   */
+  struct CommandResult {
+    json::value response;    ///< Response DOM, unused when serialized is set
+    std::string serialized;  ///< Replayed BOOK response from booking_dedup_, with its newline
+  };
+
   /**
    * @brief Begin asynchronous accept operation for new client connections
    * @details Initiates an asynchronous accept operation and sets up the completion handler
@@ -66,15 +149,90 @@ private:
    */
   void do_accept();
 
+  /**
+   * @brief Open, bind and listen the Asio acceptor on the TCP port
+   * @param port Port to bind, 0 for an ephemeral one
+   * @throws std::runtime_error if the port cannot be bound
+   */
+  void open_acceptor(unsigned short port);
+
+  /**
+   * @brief Accept the next connection on the Unix domain listener
+   * @details Same sessions as do_accept(); open only if ServerConfig::unix_socket_path is set.
+   */
+  void do_accept_local();
+
+  /**
+   * @brief Admit an accepted connection and post its session to the thread pool
+   * @details Over the session cap the connection gets OVERLOADED and is closed without
+   *          reaching the pool. Otherwise the socket is rewrapped as a SessionSocket, so
+   *          TCP and Unix domain connections share one session implementation.
+   * @param socket Accepted socket, of any stream protocol
+   * @param client Client identity the per-client token bucket is chosen by
+   */
+  template <typename Socket>
+  void open_session(std::shared_ptr<Socket> socket, std::string_view client);
+
+  /**
+   * @brief Accept the next connection on the Prometheus metrics listener
+   * @details Each connection gets one HTTP response: the metrics page for GET /metrics,
+   *          the Chrome trace JSON of the sampled requests for GET /trace, 404 otherwise.
+   *          Served on the io_context thread, never on the worker pool.
+   */
+  void do_accept_metrics();
+
   /**
    * @brief Handle a complete client session
    * @details Manages the entire lifecycle of a client connection, including reading requests,
    *          processing them through the appropriate service, and sending responses. Handles
    *          both JSON and plain text protocols. Continues processing requests until the
-   *          client disconnects or an error occurs.
-   * @param socket Shared pointer to the client's TCP socket connection
+   *          client disconnects, an error occurs, a request line is over the size limit or
+   *          reaper_ shuts the connection down for missing a deadline.
+   * @param socket Shared pointer to the client's connection
+   * @param session Session id used in traces and logs
+   * @param enqueued When the session was posted to the pool if the session is traced, epoch otherwise
+   * @param client_slot Token bucket of the session's client, from LoadShedder::client_slot
+   * @param client Peer address of the session, or "local"
+   */
+  void handle_session(std::shared_ptr<SessionSocket> socket, std::uint32_t session,
+                      RequestTracer::Clock::time_point enqueued, std::size_t client_slot, std::string client);
+
+  /**
+   * @brief Serve one request line of a session
+   * @details Records it for capture, sheds it if the connection or client is over its rate,
+   *          otherwise dispatches it and passes the response to write, which must have written
+   *          or queued it when it returns: the Write phase ends then.
+   * @param session State of the session
+   * @param request Request line without its newline
+   * @param subscription Set to the showing of an accepted SUBSCRIBE_SEATS
+   * @param write Called once as write(response, terminator), both std::string_view
    */
-  void handle_session(std::shared_ptr<boost::asio::ip::tcp::socket> socket);
+  template <typename Write>
+  void serve_request(SessionContext& session, const std::string& request, std::optional<ShowingKey>& subscription,
+                     Write&& write);
+
+  /**
+   * @brief Admit a connection accepted by the io_uring transport
+   * @details Same session cap, counters, trace and capture records as open_session().
+   * @param client Peer address
+   * @param out Receives the OVERLOADED response when the session cap is reached
+   * @return The connection's session, nullptr over the session cap
+   */
+  std::unique_ptr<UringTransport::Session> open(std::string_view client, std::string& out) override;
+
+  /**
+   * @brief Give a connection of the io_uring transport that sent SUBSCRIBE_SEATS to seat_subscriptions_
+   * @param fd The connection's socket
+   * @param showing Showing subscribed to
+   */
+  void hand_over(int fd, ShowingKey showing) override;
+
+  /**
+   * @brief Count and log a request line over SessionLimits::max_request_bytes
+   * @param session Session id used in logs
+   * @return REQUEST_TOO_LARGE response, with its terminating blank line
+   */
+  const std::string& request_too_large(std::uint32_t session);
 
   /**
    * @brief Process a plain text request from client
@@ -87,29 +245,144 @@ private:
   std::string process_request(const std::string& request);
 
   /**
-   * @brief Process a JSON request from client
-   * @details Parses JSON requests, validates command structure, and processes commands
-   *          through BookingService or AdministrationService as appropriate. Handles
-   *          all supported commands: LIST_MOVIES, LIST_THEATERS, LIST_SEATS, and BOOK.
-   *          Provides comprehensive error handling for malformed JSON and invalid requests.
+   * @brief Process a JSON request, recording its command and phase timings
+   * @details Resets the arena, then parses the request and builds the response in it.
    * @param request JSON request string from client
-   * @return JSON response string with results or error information
-   * @throws std::exception for JSON parsing errors (caught and converted to error response)
+   * @param arena Memory of the calling session
+   * @param recorder Recorder of the request; the caller ends the Write phase
+   * @param subscription Set to the showing of an accepted SUBSCRIBE_SEATS, after which the
+   *        caller hands its connection to seat_subscriptions_; nullptr rejects SUBSCRIBE_SEATS
+   * @param client Client identity BOOK request_ids are scoped to; empty outside a session
+   * @return JSON response with results or error information, valid until the arena's next request
    */
-  std::string process_request_json(const std::string& request);
+  std::string_view dispatch_request_json(std::string_view request, RequestArena& arena, RequestRecorder& recorder,
+                                         std::optional<ShowingKey>* subscription = nullptr,
+                                         std::string_view client = {});
+
+  /**
+   * @brief Build the STATS response from a metrics snapshot
+   * @return JSON object with uptime, connection, shedding, booking and per-command latency figures
+   */
+  json::value stats_json() const;
+
+  /**
+   * @brief Execute a request recognized by scan_request, without a DOM
+   * @details Gives the same response as the generic path for the same request.
+   * @param request Scanned fields
+   * @param recorder Recorder of the request; the Parse phase ends here
+   * @param sp Storage of the response, the session's arena
+   * @return JSON response
+   */
+  json::value handle_scanned(const ScannedRequest& request, RequestRecorder& recorder, const json::storage_ptr& sp);
+
+  /**
+   * @brief Run one command whose fields have been checked against its schema
+   * @param request The request object
+   * @param command_type Its command
+   * @param client Client identity BOOK request_ids are scoped to
+   * @param sp Storage of the response, the session's arena
+   * @param subscription Where an accepted SUBSCRIBE_SEATS stores its showing, nullptr outside a session
+   * @return The response
+   * @throws std::exception for values the schema cannot express, e.g. a non-positive limit
+   */
+  CommandResult execute_command(const json::object& request, CommandType command_type, std::string_view client,
+                                const json::storage_ptr& sp, std::optional<ShowingKey>* subscription = nullptr);
+
+  /**
+   * @brief Execute a BATCH request
+   * @details Entries run one after the other on the calling thread and each gets its own
+   *          response, errors included. With "atomic": true every entry must be a BOOK and
+   *          either all of them are booked or none is.
+   * @param request The BATCH request
+   * @param client Client identity BOOK request_ids are scoped to
+   * @param sp Storage of the response, the session's arena
+   * @return {"responses": [...]}, plus "status" for an atomic batch
+   * @throws std::invalid_argument for an empty or oversized batch, or a malformed atomic one
+   */
+  json::value handle_batch(const json::object& request, std::string_view client, const json::storage_ptr& sp);
+
+  /**
+   * @brief Response of one entry of a non-atomic batch
+   * @param entry The entry's request object
+   * @param client Client identity BOOK request_ids are scoped to
+   * @param sp Storage of the response, the session's arena
+   * @return The command's response, or an UNKNOWN_COMMAND / INVALID_REQUEST error
+   */
+  json::value batch_entry_response(const json::object& entry, std::string_view client, const json::storage_ptr& sp);
+
+  /**
+   * @brief Book every entry of an atomic batch, or none
+   * @param entries BOOK requests
+   * @param sp Storage of the response, the session's arena
+   * @return BOOKED/FAILED status with one BOOK response per entry, or the NOT_ADMITTED
+   *         response of the first entry refused by its waiting room
+   * @throws std::invalid_argument if an entry is not a valid BOOK or carries a request_id
+   */
+  json::value handle_atomic_batch(const json::array& entries, const json::storage_ptr& sp);
+
+  /**
+   * @brief Execute a BOOK request
+   * @details Books the requested seats through the booking service and builds the
+   *          BOOKED/FAILED response. Requests carrying a request_id are routed through
+   *          booking_dedup_ first, so only the first attempt reaches this method.
+   * @param theater_id Theater of the showing
+   * @param movie_id Movie of the showing
+   * @param seats Seat ids to book
+   * @param request_id Client request_id echoed in the response, nullptr if none
+   * @param sp Storage of the response, the session's arena
+   * @return JSON response for the booking
+   */
+  json::value handle_book(int theater_id, int movie_id, const std::vector<std::string>& seats,
+                          const json::value* request_id, const json::storage_ptr& sp);
+
+  /**
+   * @brief Build the BOOKED/FAILED response of a booking attempt
+   * @param theater_id Theater of the showing
+   * @param movie_id Movie of the showing
+   * @param seats Seat ids requested
+   * @param booking The booking made, nullptr if it failed
+   * @param request_id Client request_id echoed in the response, nullptr if none
+   * @param sp Storage of the response, the session's arena
+   * @return JSON response for the booking
+   */
+  static json::value booking_response(int theater_id, int movie_id, const std::vector<std::string>& seats,
+                                      const Booking* booking, const json::value* request_id,
+                                      const json::storage_ptr& sp);
 
   /**
-   * @brief Generate sample JSON request formats for error responses
-   * @details Creates a JSON object containing example request formats for all supported
-   *          commands. Used in error responses to help clients understand the expected
-   *          request structure when they send malformed or invalid requests.
-   * @return JSON value containing sample request formats for all commands
+   * @brief Enforce the showing's waiting room on a BOOK request
+   * @details While clients are waiting in the showing's queue, a request must present an
+   *          admitted, unused queue_token for the same showing, which is claimed here. When
+   *          nobody is waiting, requests get through with or without a token.
+   * @param theater_id Theater of the showing
+   * @param movie_id Movie of the showing
+   * @param token queue_token of the request, nullptr if none
+   * @param claimed_token Receives the token if it was claimed, to be released if the booking fails
+   * @return NOT_ADMITTED response if the request has to wait, std::nullopt otherwise
+   * @throws std::exception if the token is not a string
    */
-  json::value get_sample_format();
+  std::optional<json::value> check_admission(int theater_id, int movie_id, const json::value* token,
+                                             std::string* claimed_token = nullptr);
 
   boost::asio::ip::tcp::acceptor acceptor_;  ///< TCP acceptor for incoming connections
+  boost::asio::ip::tcp::acceptor metrics_acceptor_;  ///< Prometheus listener, open only if a metrics port is set
+  boost::asio::local::stream_protocol::acceptor local_acceptor_;  ///< AF_UNIX listener, open only if a path is set
   IBookingService& booking_service_;          ///< Reference to booking service for seat operations
   IAdministrationService& admin_service_;     ///< Reference to administration service for system management
   std::size_t threadpool_size_;              ///< Number of threads in the worker thread pool
+  std::unique_ptr<TrafficCapture> capture_;  ///< Request/response recorder, set only when capturing; outlives the pool
+  const SessionLimits session_limits_;       ///< Deadlines and request size limit of every session
+  std::string request_too_large_response_;   ///< REQUEST_TOO_LARGE response, built once
+  std::atomic<std::uint64_t> oversized_requests_{0};  ///< Request lines rejected by size, for STATS
+  ConnectionReaper reaper_;                  ///< Enforces the session deadlines; outlives the pool and the rings
+  DedupTable<std::string> booking_dedup_;    ///< Serialized BOOK responses by client and request_id, replayed on retries
+  WaitingRoom waiting_room_;                 ///< Per-showing admission queues in front of BOOK
+  LoadShedder load_shedder_;                 ///< Session cap and token buckets checked before parsing
+  ServerMetrics metrics_;                    ///< Per-command counters and latencies behind STATS and /metrics
+  RequestTracer tracer_;                     ///< Sampled request spans served on /trace
+  SeatSubscriptions seat_subscriptions_;     ///< Connections handed over by SUBSCRIBE_SEATS
+  std::atomic<std::uint32_t> next_session_id_{1};  ///< Numbers accepted sessions for traces and logs
+  // Sessions use every member above; declared after them, the pool is joined before any is destroyed
   ThreadPool thread_pool_;                   ///< Thread pool for concurrent client session handling
+  std::unique_ptr<UringTransport> uring_;    ///< Serves the TCP port when the io_uring backend is active; stopped first
 };
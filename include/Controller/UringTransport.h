@@ -0,0 +1,156 @@
+/**
+ * @file UringTransport.h
+ * @brief io_uring network backend of TcpServer: multishot accept and receive, batched sends
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Controller/ConnectionReaper.h"
+#include "Controller/SeatSubscriptions.h"
+#include "Controller/ServerConfig.h"
+
+/// Whether this build contains the io_uring backend (CMake option BOOKING_IO_URING)
+#ifdef BOOKING_IO_URING
+constexpr bool kIoUringCompiled = true;
+#else
+constexpr bool kIoUringCompiled = false;
+#endif
+
+/**
+ * @class UringTransport
+ * @brief Serves the TCP port from io_uring rings instead of the Asio acceptor and worker pool
+ * @details Each ring is driven by one thread and owns a listening socket; the rings share the
+ *          port through SO_REUSEPORT, so the kernel spreads connections over them. A ring keeps
+ *          one multishot accept armed on its listener and one multishot receive per connection,
+ *          so accepting and reading cost no SQE per event. Receives draw from a ring of provided
+ *          buffers (kBuffers of kBufferSize bytes) that is shared by all of the ring's
+ *          connections, so an idle connection pins no receive buffer. A buffer is given back to
+ *          the kernel as soon as its bytes are copied into the connection's line buffer. A
+ *          ring first checks that the kernel receives into its buffer ring. If not, it hands
+ *          the buffers back with IORING_OP_PROVIDE_BUFFERS instead.
+ *
+ *          Requests are served inline on the ring thread. Their responses are appended to the
+ *          connection's output, and each connection has at most one send in flight. All sends
+ *          queued while a batch of completions is processed go to the kernel in the same
+ *          io_uring_enter call that waits for the next batch. A connection whose queued output
+ *          reaches 64 KiB stops being read and served until the client takes it.
+ *
+ *          Every connection is watched by the server's ConnectionReaper: it has the idle
+ *          deadline while waiting for a request line and the write deadline while a send is in
+ *          flight. A reaped connection sees end of stream or a failed send and is closed as
+ *          usual. A line longer than SessionLimits::max_request_bytes is not buffered further;
+ *          the session answers it and the connection is closed.
+ *
+ *          The protocol itself stays in TcpServer, behind Handler and Session. The transport
+ *          only frames lines and moves bytes.
+ */
+class UringTransport {
+public:
+  /**
+   * @class Session
+   * @brief Server side of one connection; destroyed when the connection closes or is handed over
+   */
+  class Session {
+  public:
+    virtual ~Session() = default;
+
+    /**
+     * @brief Serve one request line
+     * @param line Request without its newline
+     * @param out Response bytes are appended here
+     * @return Showing of an accepted SUBSCRIBE_SEATS; the transport then stops reading, sends
+     *         what out holds and passes the connection to Handler::hand_over()
+     */
+    virtual std::optional<ShowingKey> handle_line(const std::string& line, std::string& out) = 0;
+
+    /**
+     * @brief Answer a request line longer than the limit; the connection is closed after out is sent
+     * @param out Response bytes are appended here
+     */
+    virtual void reject_line(std::string& out) = 0;
+
+    /**
+     * @brief Note that the connection was shut down by the reaper; it closes right after
+     * @param deadline Deadline it missed
+     */
+    virtual void timed_out(ConnectionReaper::Deadline deadline) = 0;
+  };
+
+  /**
+   * @class Handler
+   * @brief What the transport needs from the server that owns it; called on the ring threads
+   */
+  class Handler {
+  public:
+    virtual ~Handler() = default;
+
+    /**
+     * @brief Admit a new connection
+     * @param client Peer address, the key of its client token bucket
+     * @param out Refusal to send before closing, when the connection is not admitted
+     * @return The connection's session, nullptr to refuse it
+     */
+    virtual std::unique_ptr<Session> open(std::string_view client, std::string& out) = 0;
+
+    /**
+     * @brief Take over a connection whose session subscribed to a showing
+     * @param fd Connected TCP socket, now owned by the handler
+     * @param showing Showing returned by Session::handle_line()
+     */
+    virtual void hand_over(int fd, ShowingKey showing) = 0;
+  };
+
+  static constexpr unsigned kQueueDepth = 1024;      ///< Submission queue entries per ring
+  static constexpr unsigned kBuffers = 512;          ///< Provided receive buffers per ring, a power of two
+  static constexpr std::size_t kBufferSize = 4096;   ///< Bytes of one provided receive buffer
+
+  /**
+   * @brief Whether this build and the running kernel support the transport
+   * @details Needs the backend compiled in and Linux 6.0 or later, the first kernel with
+   *          multishot receive; ring setup can still fail, e.g. where a seccomp profile
+   *          blocks io_uring.
+   * @param reason Set to why not, if not
+   */
+  static bool available(std::string* reason = nullptr);
+
+  /**
+   * @brief Set up the rings and bind their listeners
+   * @param handler Server serving the connections; must outlive the transport
+   * @param reaper Enforces the connections' deadlines; must outlive the transport
+   * @param limits Deadlines and request line limit of every connection
+   * @param port TCP port, 0 for an ephemeral one shared by every ring
+   * @param rings Number of rings and ring threads, at least one
+   * @throws std::runtime_error if the transport is unavailable or setup fails; nothing is left bound
+   */
+  UringTransport(Handler& handler, ConnectionReaper& reaper, const SessionLimits& limits, unsigned short port,
+                 std::size_t rings);
+
+  /// Stops the ring threads and closes every connection still open
+  ~UringTransport();
+
+  UringTransport(const UringTransport&) = delete;
+  UringTransport& operator=(const UringTransport&) = delete;
+
+  /**
+   * @brief Start the ring threads; connections are accepted from then on
+   * @throws std::runtime_error if a ring fails to start; the caller should then destroy the transport
+   */
+  void start();
+
+  /// Port the rings listen on
+  unsigned short port() const { return port_; }
+
+private:
+  class Ring;
+
+  Handler& handler_;
+  unsigned short port_ = 0;
+  std::vector<std::unique_ptr<Ring>> rings_;
+};
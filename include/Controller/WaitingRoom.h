@@ -0,0 +1,164 @@
+/**
+ * @file WaitingRoom.h
+ * @brief Per-showing admission queue placed in front of BOOK during on-sales
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+#include "Utils/SipHash.h"
+
+/**
+ * @enum AdmissionState
+ * @brief Where a queue token stands
+ */
+enum class AdmissionState {
+  Waiting,   ///< Admission time not reached yet
+  Admitted,  ///< May book until the admission window closes
+  Expired,   ///< Admission window is over, the client has to queue again
+  Used,      ///< Already claimed by a booking; every token books once
+  Invalid    ///< Malformed, forged or issued for another showing
+};
+
+/**
+ * @struct QueueStatus
+ * @brief Admission state of a queue token
+ */
+struct QueueStatus {
+  AdmissionState state = AdmissionState::Invalid;
+  std::uint64_t position = 0;                        ///< Estimated number of clients admitted before this one
+  std::chrono::milliseconds estimated_wait{0};       ///< Time left until admission
+};
+
+/**
+ * @struct QueueTicket
+ * @brief Result of joining a showing's queue
+ */
+struct QueueTicket {
+  std::string token;   ///< Opaque token to poll with and to present on BOOK
+  QueueStatus status;  ///< Status right after joining
+};
+
+/**
+ * @class WaitingRoom
+ * @brief FIFO admission of clients to each showing at a fixed rate
+ * @details Every showing with a queue owns one lane in a fixed-size open-addressing
+ *          table. A lane only stores the time at which the next joiner will be
+ *          admitted: joining reserves the next admission time with one CAS (clients
+ *          are therefore admitted in join order, one per 1/rate seconds) and the
+ *          reserved time is sealed into the token together with a SipHash-2-4 tag
+ *          of it and the showing. Polling decodes and checks the token without
+ *          touching the table or the seat inventory.
+ *          Tokens stay valid for the admission window after their admission time,
+ *          and book once: claim() marks an admitted token used, release() hands it
+ *          back if the booking failed. Used tokens are remembered under a mutex only
+ *          until their window closes. A lane whose last admitted token has expired is
+ *          idle and is taken over by the next showing that needs one; claiming a lane
+ *          is serialized, looking one up is not.
+ */
+class WaitingRoom {
+public:
+  /**
+   * @brief Constructor: allocates the lane table
+   * @param admissions_per_second Clients admitted per second on each showing
+   * @param admission_window How long an admitted token may be used to book
+   * @param max_showings Number of showings that can have a queue at the same time
+   * @throws std::invalid_argument if admissions_per_second or max_showings is not positive
+   */
+  WaitingRoom(double admissions_per_second, std::chrono::seconds admission_window, std::size_t max_showings);
+
+  /**
+   * @brief Enter the queue of a showing
+   * @param theater_id Theater of the showing
+   * @param movie_id Movie of the showing
+   * @return Token and initial status, or std::nullopt if every lane is taken
+   */
+  std::optional<QueueTicket> join(int theater_id, int movie_id);
+
+  /**
+   * @brief Check a token
+   * @param theater_id Theater the token must have been issued for
+   * @param movie_id Movie the token must have been issued for
+   * @param token Token returned by join
+   * @return Current admission state, position and remaining wait
+   */
+  QueueStatus status(int theater_id, int movie_id, std::string_view token) const;
+
+  /**
+   * @brief Use an admitted token for a booking
+   * @param theater_id Theater the token must have been issued for
+   * @param movie_id Movie the token must have been issued for
+   * @param token Token returned by join
+   * @return Admitted if the token was admitted and unused, and is now used; its status otherwise
+   */
+  QueueStatus claim(int theater_id, int movie_id, std::string_view token);
+
+  /**
+   * @brief Give back a token claimed by a booking that did not go through
+   * @param theater_id Theater the token was issued for
+   * @param movie_id Movie the token was issued for
+   * @param token Token passed to claim
+   */
+  void release(int theater_id, int movie_id, std::string_view token);
+
+  /**
+   * @brief Whether clients are still waiting to be admitted to a showing
+   * @details While this is true, bookings without an admitted token would jump the queue.
+   * @param theater_id Theater of the showing
+   * @param movie_id Movie of the showing
+   * @return true if the last admission handed out for the showing lies in the future
+   */
+  bool is_backlogged(int theater_id, int movie_id) const;
+
+private:
+  // Aligned to a cache line so joins on different showings do not false-share
+  struct alignas(64) Lane {
+    std::atomic<std::uint64_t> key;                ///< Packed showing, kEmptyLane while unused
+    std::atomic<std::int64_t> next_admission_us{0};  ///< Admission time of the next joiner
+  };
+
+  static constexpr std::uint64_t kEmptyLane = ~std::uint64_t{0};
+
+  /// Find the lane of a showing, nullptr if it has none
+  Lane* find_lane(std::uint64_t showing) const;
+
+  /// Find the lane of a showing or take an empty or idle one; nullptr if every lane is busy
+  Lane* claim_lane(std::uint64_t showing, std::int64_t now);
+
+  /// Admission time and tag of a token issued for the showing, std::nullopt if it is not one
+  std::optional<std::pair<std::int64_t, std::uint64_t>> decode(std::uint64_t showing, std::string_view token) const;
+
+  /// Microseconds since construction
+  std::int64_t now_us() const;
+
+  /// Status of a token admitted at admission_us
+  QueueStatus status_at(std::int64_t admission_us, std::int64_t now) const;
+
+  /// SipHash-2-4 of the token word and its showing: binds them, and cannot be computed without the key
+  std::uint64_t tag(std::uint64_t word, std::uint64_t showing) const;
+
+  std::unique_ptr<Lane[]> lanes_;
+  std::size_t lane_count_;
+  std::int64_t interval_us_;                   ///< Time between two admissions on a showing
+  std::int64_t window_us_;                     ///< Validity of an admitted token
+  std::chrono::steady_clock::time_point epoch_;
+  std::atomic<std::uint64_t> next_sequence_{0};  ///< Low bits make tokens unique across showings
+  const SipHashKey token_key_;                 ///< Random per process, never leaves it; tokens cannot be forged
+
+  std::mutex lane_mutex_;                        ///< Serializes claiming lanes; lookups do not take it
+  mutable std::mutex used_mutex_;                ///< Guards used_ and used_order_
+  std::unordered_set<std::uint64_t> used_;       ///< Tags of claimed tokens still inside their window
+  std::deque<std::pair<std::int64_t, std::uint64_t>> used_order_;  ///< (window end, tag) in claim order, pruned from the front
+};
@@ -9,6 +9,11 @@
 #include <string>
 #include <memory>
 #include "Models/Movie.h"
+#include "Models/CatalogQuery.h"
+#include "Models/SeatMap.h"
+#include "Models/Booking.h"
+#include <optional>
+#include <future>
 
 // Forward declaration
 class ITheater;
@@ -30,6 +35,30 @@ public:
    */
   virtual std::vector<Movie> get_all_movies() const = 0;
 
+  /**
+   * @brief Retrieve one page of movies ordered by ID
+   * @param query Cursor, page size and optional theater filter
+   * @return Page of movies and whether more remain after it
+   */
+  virtual CatalogPage<Movie> get_movies_page(const CatalogQuery& query) const = 0;
+
+  /**
+   * @brief Get the catalog version
+   * @details Changes whenever a movie, a theater or a showing is added or removed, so
+   *          callers can skip re-reading a catalog page that has not changed.
+   * @return Current version
+   */
+  virtual std::uint64_t get_catalog_version() const = 0;
+
+  /**
+   * @brief Search movies whose title contains the query
+   * @details Matching ignores case, punctuation and repeated whitespace.
+   * @param query Free text, typically what the user typed so far
+   * @param limit Maximum number of movies to return
+   * @return Matching movies ordered by ID
+   */
+  virtual std::vector<Movie> search_movies(const std::string& query, std::size_t limit) const = 0;
+
   /**
    * @brief Get all theaters showing a specific movie
    * @param movie_id Unique identifier of the movie
@@ -37,6 +66,14 @@ public:
    */
   virtual std::vector<std::shared_ptr<ITheater>> get_theaters_showing_movie(int movie_id) const = 0;
 
+  /**
+   * @brief Get one page of the theaters showing a specific movie, ordered by ID
+   * @param movie_id Unique identifier of the movie
+   * @param query Cursor and page size
+   * @return Page of theaters and whether more remain after it
+   */
+  virtual CatalogPage<std::shared_ptr<ITheater>> get_theaters_page(int movie_id, const CatalogQuery& query) const = 0;
+
   /**
    * @brief Get available seats for a specific movie in a theater
    * @param theater_id Unique identifier of the theater
@@ -45,6 +82,25 @@ public:
    */
   virtual std::vector<std::string> get_available_seats(int theater_id, int movie_id) const = 0;
 
+  /**
+   * @brief Get seat availability for a specific movie in a theater as a bitmap
+   * @details Same information as get_available_seats() without a string per seat.
+   * @param theater_id Unique identifier of the theater
+   * @param movie_id Unique identifier of the movie
+   * @return Layout and one bit per seat, all empty if the showing does not exist
+   */
+  virtual SeatMap get_seat_map(int theater_id, int movie_id) const = 0;
+
+  /**
+   * @brief Get the seat version of a showing
+   * @details Changes whenever a seat of the showing is booked or released, so callers
+   *          can skip re-reading a seat map that has not changed.
+   * @param theater_id Unique identifier of the theater
+   * @param movie_id Unique identifier of the movie
+   * @return Current version, std::nullopt if the showing does not exist
+   */
+  virtual std::optional<std::uint64_t> get_seat_version(int theater_id, int movie_id) const = 0;
+
   /**
    * @brief Attempt to book specified seats for a movie showing
    * @param theater_id Unique identifier of the theater
@@ -54,6 +110,64 @@ public:
    */
   virtual bool book_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) = 0;
 
+  /**
+   * @brief Book seats and record the booking in the ledger
+   * @param theater_id Unique identifier of the theater
+   * @param movie_id Unique identifier of the movie
+   * @param seat_ids Vector of seat IDs to book
+   * @return The confirmed booking with its confirmation code, or std::nullopt if it failed
+   */
+  virtual std::optional<Booking> create_booking(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) = 0;
+
+  /**
+   * @brief Queue a booking and return immediately
+   * @param request Showing and seats to book
+   * @return Future holding the booking, or std::nullopt if it failed
+   */
+  virtual std::future<std::optional<Booking>> book_seats_async(BookingRequest request) = 0;
+
+  /**
+   * @brief Queue a booking and invoke a callback when it completes
+   * @param request Showing and seats to book
+   * @param on_complete Called once with the result, on a service thread; whatever it
+   *                    throws is logged and dropped
+   */
+  virtual void book_seats_async(BookingRequest request, BookingCallback on_complete) = 0;
+
+  /**
+   * @brief Book many independent requests in one call
+   * @details Each request is all-or-nothing on its own; one failing request does not
+   *          affect the others. Requests for the same showing are applied in order.
+   * @param requests Bookings to make
+   * @return One result per request, in request order
+   */
+  virtual std::vector<std::optional<Booking>> book_batch(const std::vector<BookingRequest>& requests) = 0;
+
+  /**
+   * @brief Book many requests as one: either every request is kept or none is
+   * @details Every showing involved is held (ITheater::hold_seats) in (theater id, movie id)
+   *          order, every seat of every request is checked, and only then are the seats
+   *          booked, with one seat version bump per showing. Other clients never see part
+   *          of the batch booked. A seat listed twice anywhere in one showing fails the batch.
+   * @param requests Bookings to make
+   * @return Every booking in request order, or std::nullopt if any request failed
+   */
+  virtual std::optional<std::vector<Booking>> book_all_or_nothing(const std::vector<BookingRequest>& requests) = 0;
+
+  /**
+   * @brief Look up a booking by confirmation code
+   * @param confirmation_code Code returned by create_booking()
+   * @return The booking if it exists and has not been cancelled
+   */
+  virtual std::optional<Booking> lookup_booking(const std::string& confirmation_code) const = 0;
+
+  /**
+   * @brief Cancel a booking and return its seats to the inventory
+   * @param confirmation_code Code returned by create_booking()
+   * @return true if the booking existed and its seats were released
+   */
+  virtual bool cancel_booking(const std::string& confirmation_code) = 0;
+
   /**
    * @brief Check if specified seats can be booked without actually booking them
    * @param theater_id Unique identifier of the theater
@@ -8,7 +8,10 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <optional>
 #include "Models/Movie.h"
+#include "Models/CatalogQuery.h"
+#include "Models/SeatMap.h"
 
 // Forward declaration to avoid circular dependency
 class ITheater;
@@ -50,6 +53,30 @@ public:
    */
   virtual std::vector<Movie> get_all_movies() const = 0;
 
+  /**
+   * @brief Retrieve one page of movies ordered by ID
+   * @param query Cursor, page size and optional theater filter
+   * @return Page of movies, cost proportional to the page size
+   */
+  virtual CatalogPage<Movie> get_movies_page(const CatalogQuery& query) const = 0;
+
+  /**
+   * @brief Get the catalog version
+   * @details Grows with every change to the movies, the theaters or the schedule; seat
+   *          bookings do not change it. Reading it takes no lock.
+   * @return Current version
+   */
+  virtual std::uint64_t get_catalog_version() const = 0;
+
+  /**
+   * @brief Search movies whose title contains the query
+   * @details Matching ignores case, punctuation and repeated whitespace.
+   * @param query Free text, typically what the user typed so far
+   * @param limit Maximum number of movies to return
+   * @return Matching movies ordered by ID
+   */
+  virtual std::vector<Movie> search_movies(const std::string& query, std::size_t limit) const = 0;
+
   /**
    * @brief Check if a movie exists in the data store
    * @param movie_id Unique identifier of the movie
@@ -89,6 +116,22 @@ public:
    */
   virtual std::vector<std::shared_ptr<ITheater>> get_theaters_showing_movie(int movie_id) const = 0;
 
+  /**
+   * @brief Retrieve one page of the theaters showing a movie, ordered by ID
+   * @param movie_id Unique identifier of the movie
+   * @param query Cursor and page size
+   * @return Page of theaters, cost proportional to the page size
+   */
+  virtual CatalogPage<std::shared_ptr<ITheater>> get_theaters_page(int movie_id, const CatalogQuery& query) const = 0;
+
+  /**
+   * @brief Schedule a movie in a theater and index the new showing
+   * @param theater_id Unique identifier of the theater
+   * @param movie Movie object to schedule (moved for efficiency)
+   * @return true if the theater exists, false otherwise
+   */
+  virtual bool schedule_movie(int theater_id, Movie&& movie) = 0;
+
   /**
    * @brief Check if a theater exists in the data store
    * @param theater_id Unique identifier of the theater
@@ -104,6 +147,22 @@ public:
    */
   virtual std::vector<std::string> get_available_seats(int theater_id, int movie_id) const = 0;
 
+  /**
+   * @brief Get the availability of every seat for a movie in a theater as a bitmap
+   * @param theater_id Unique identifier of the theater
+   * @param movie_id Unique identifier of the movie
+   * @return Layout and one bit per seat, all empty if the showing does not exist
+   */
+  virtual SeatMap get_seat_map(int theater_id, int movie_id) const = 0;
+
+  /**
+   * @brief Get the seat version of a showing, see ITheater::seat_version()
+   * @param theater_id Unique identifier of the theater
+   * @param movie_id Unique identifier of the movie
+   * @return Current version, std::nullopt if the showing does not exist
+   */
+  virtual std::optional<std::uint64_t> get_seat_version(int theater_id, int movie_id) const = 0;
+
   /**
    * @brief Book seats for a movie in a theater
    * @param theater_id Unique identifier of the theater
@@ -112,4 +171,13 @@ public:
    * @return true if booking successful, false otherwise
    */
   virtual bool book_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) = 0;
+
+  /**
+   * @brief Return booked seats of a movie in a theater to the available pool
+   * @param theater_id Unique identifier of the theater
+   * @param movie_id Unique identifier of the movie
+   * @param seat_ids Vector of seat IDs to release
+   * @return true if all seats were released, false if nothing changed
+   */
+  virtual bool release_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) = 0;
 };
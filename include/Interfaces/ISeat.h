@@ -37,6 +37,13 @@ public:
    */
   virtual bool book() = 0;
 
+  /**
+   * @brief Return a booked seat to the available pool atomically
+   * @return true if the seat was booked and is now available, false if it was not booked
+   * @details Mirror of book(), used when a booking is cancelled.
+   */
+  virtual bool release() = 0;
+
   /**
    * @brief Get the seat's unique identifier
    * @return Seat ID as string (e.g., "a1", "b2", "c3")
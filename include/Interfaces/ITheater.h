@@ -7,8 +7,37 @@
 
 #include <vector>
 #include <string>
+#include <functional>
 #include <memory>
+#include <optional>
 #include "Models/Movie.h"
+#include "Models/SeatMap.h"
+
+/**
+ * @class SeatHold
+ * @brief Exclusive hold on one showing's seats, for a booking that spans showings
+ * @details Taken by ITheater::hold_seats(). Bookings and releases of the showing wait until the
+ *          hold is destroyed. Callers holding several showings take them in (theater id, movie id)
+ *          order, so two such bookings never deadlock.
+ */
+class SeatHold {
+public:
+  virtual ~SeatHold() = default;
+
+  /**
+   * @brief Check seats without changing them
+   * @param seat_ids Seats to book
+   * @return true if every seat exists, is free and is listed once
+   */
+  virtual bool can_book(const std::vector<std::string>& seat_ids) const = 0;
+
+  /**
+   * @brief Book seats that can_book() accepted under this hold
+   * @param seat_ids Seats to book
+   * @details The showing's seat version grows by one, however many seats are booked.
+   */
+  virtual void book(const std::vector<std::string>& seat_ids) = 0;
+};
 
 /**
  * @interface ITheater
@@ -19,14 +48,28 @@
  */
 class ITheater {
 public:
+  /// Told the id of every movie add_movie() schedules
+  using ScheduleListener = std::function<void(int movie_id)>;
+
   virtual ~ITheater() = default;
 
   /**
    * @brief Add a movie to the theater's schedule
    * @param movie Movie object to add (moved for efficiency)
+   * @details The schedule listener, if any, is called once the movie is scheduled.
    */
   virtual void add_movie(Movie&& movie) = 0;
 
+  /**
+   * @brief Watch the schedule for movies added by anyone
+   * @details Lets a data store that indexes showings keep up with add_movie() calls it does
+   *          not make itself. The listener runs after the schedule changed, with none of the
+   *          theater's locks held except the one that serializes listener calls; replacing
+   *          the listener waits for a running call to finish.
+   * @param listener Replaces the previous listener; an empty function removes it
+   */
+  virtual void set_schedule_listener(ScheduleListener listener) = 0;
+
   /**
    * @brief Get available seats for a specific movie
    * @param movie_id Unique identifier of the movie
@@ -34,6 +77,22 @@ public:
    */
   virtual std::vector<std::string> get_available_seats(int movie_id) const = 0;
 
+  /**
+   * @brief Get the availability of every seat of a movie as a bitmap
+   * @param movie_id Unique identifier of the movie
+   * @return Layout and one bit per seat, all empty if the movie is not shown here
+   */
+  virtual SeatMap get_seat_map(int movie_id) const = 0;
+
+  /**
+   * @brief Get the seat version of a movie's showing
+   * @details Starts at 0 and grows by one with every booking or release that changes a
+   *          seat; reading it takes no seat lock.
+   * @param movie_id Unique identifier of the movie
+   * @return Current version, std::nullopt if the movie is not shown here
+   */
+  virtual std::optional<std::uint64_t> seat_version(int movie_id) const = 0;
+
   /**
    * @brief Book specified seats for a movie
    * @param movie_id Unique identifier of the movie
@@ -42,6 +101,36 @@ public:
    */
   virtual bool book_seats(int movie_id, const std::vector<std::string>& seat_ids) = 0;
 
+  /**
+   * @brief Hold a movie's seats to check and book them with other showings as one
+   * @param movie_id Unique identifier of the movie
+   * @return The hold, or nullptr if the movie is not shown here
+   */
+  virtual std::unique_ptr<SeatHold> hold_seats(int movie_id) = 0;
+
+  /**
+   * @brief Return booked seats of a movie to the available pool
+   * @param movie_id Unique identifier of the movie
+   * @param seat_ids Vector of seat IDs to release
+   * @return true if every seat was booked and has been released, false if nothing changed
+   * @details All-or-nothing like book_seats(), so a cancellation is applied atomically.
+   */
+  virtual bool release_seats(int movie_id, const std::vector<std::string>& seat_ids) = 0;
+
+  /**
+   * @brief Convert a seat ID to its position in the theater layout
+   * @param seat_id Seat ID such as "b3"
+   * @return Zero-based row-major seat index, or -1 if the ID is not part of the layout
+   */
+  virtual int seat_index(const std::string& seat_id) const = 0;
+
+  /**
+   * @brief Convert a seat index back to its seat ID
+   * @param seat_index Zero-based row-major seat index
+   * @return Seat ID such as "b3", empty if the index is outside the layout
+   */
+  virtual std::string seat_label(int seat_index) const = 0;
+
   /**
    * @brief Get the theater's unique identifier
    * @return Theater ID
@@ -60,4 +149,10 @@ public:
    * @return true if theater shows the movie, false otherwise
    */
   virtual bool shows_movie(int movie_id) const = 0;
+
+  /**
+   * @brief Get the movies scheduled in this theater
+   * @return Copy of the theater's schedule
+   */
+  virtual std::vector<Movie> get_movies() const = 0;
 };
@@ -0,0 +1,37 @@
+/**
+ * @file Booking.h
+ * @brief Confirmed booking as seen by clients of the booking service
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @struct Booking
+ * @brief A confirmed booking identified by its confirmation code
+ */
+struct Booking {
+  std::string confirmation_code;      ///< Code handed to the customer, e.g. "3QF7ZK2M9XH4C"
+  int theater_id = 0;                 ///< Theater of the showing
+  int movie_id = 0;                   ///< Movie of the showing
+  std::vector<std::string> seat_ids;  ///< Booked seats, e.g. {"a1", "a2"}
+  std::int64_t timestamp = 0;         ///< Unix epoch seconds when the booking was made
+};
+
+/**
+ * @struct BookingRequest
+ * @brief Seats a client wants to book for one showing
+ */
+struct BookingRequest {
+  int theater_id = 0;                 ///< Theater of the showing
+  int movie_id = 0;                   ///< Movie of the showing
+  std::vector<std::string> seat_ids;  ///< Seats to book all-or-nothing
+};
+
+/// Completion handler of an asynchronous booking: the booking, or std::nullopt if it failed
+using BookingCallback = std::function<void(std::optional<Booking>)>;
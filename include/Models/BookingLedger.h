@@ -0,0 +1,124 @@
+/**
+ * @file BookingLedger.h
+ * @brief Thread-safe record of every confirmed booking, keyed by confirmation code
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Utils/SipHash.h"
+
+/**
+ * @struct BookingRecord
+ * @brief Compact ledger entry for one booking
+ * @details Seats are kept as layout indices (see ITheater::seat_index) rather than
+ *          strings, so a typical booking costs one small allocation for its seats.
+ */
+struct BookingRecord {
+  std::int32_t theater_id = 0;
+  std::int32_t movie_id = 0;
+  std::uint32_t created_at = 0;        ///< Unix epoch seconds
+  std::vector<std::uint16_t> seats;    ///< Row-major seat indices
+};
+
+/**
+ * @class BookingLedger
+ * @brief Maps confirmation codes to booking records
+ * @details Confirmation codes are the SipHash-2-4 of a sequence number under a random
+ *          128-bit key that never leaves the process: knowing any number of codes tells
+ *          nothing about the others, so a code is as good as a 64-bit password for its
+ *          booking. The rare collision with a live code is retried with the next sequence
+ *          number. Codes are shown to customers as 13 character Crockford base32 strings.
+ *          Lookups and cancellations are O(1) hash map operations under a shared_mutex.
+ *
+ *          Retention: a record is kept for at least `retention` after it was recorded,
+ *          unless the ledger holds `capacity` records, in which case the oldest go first.
+ *          Records past either limit are dropped by the next record() call, oldest first, in
+ *          amortized O(1); their codes then answer like unknown ones. The defaults keep a
+ *          month of bookings, up to a million records (on the order of 100 MB).
+ */
+class BookingLedger {
+public:
+  static constexpr std::size_t kDefaultCapacity = 1'000'000;
+  static constexpr std::chrono::hours kDefaultRetention{24 * 30};
+
+  /**
+   * @brief Constructor
+   * @param capacity Most records kept; the oldest are dropped beyond it
+   * @param retention How long a record is kept at least, capacity permitting
+   */
+  explicit BookingLedger(std::size_t capacity = kDefaultCapacity,
+                         std::chrono::seconds retention = kDefaultRetention);
+
+  /**
+   * @brief Store a booking and allocate its confirmation code
+   * @param record Booking to remember (moved)
+   * @return Numeric confirmation code
+   */
+  std::uint64_t record(BookingRecord record);
+
+  /**
+   * @brief Find a booking by confirmation code
+   * @param code Numeric confirmation code
+   * @return Copy of the record if the booking exists
+   */
+  std::optional<BookingRecord> find(std::uint64_t code) const;
+
+  /**
+   * @brief Remove a booking if a step that depends on it succeeds
+   * @details The step runs under the ledger's write lock, so only one caller can act on a
+   *          given code, which makes cancellation idempotent. If the step fails the record
+   *          stays, so it can be retried.
+   * @param code Numeric confirmation code
+   * @param step Called with the record; returns whether it may be removed
+   * @return The removed record, or std::nullopt if it did not exist or the step failed
+   */
+  std::optional<BookingRecord> take_if(std::uint64_t code, const std::function<bool(const BookingRecord&)>& step);
+
+  /**
+   * @brief Number of live bookings
+   * @return Count of records
+   */
+  std::size_t size() const;
+
+  /**
+   * @brief Render a confirmation code for customers
+   * @param code Numeric confirmation code
+   * @return 13 character Crockford base32 string
+   */
+  static std::string encode(std::uint64_t code);
+
+  /**
+   * @brief Parse a confirmation code typed by a customer
+   * @details Case-insensitive; accepts the usual Crockford substitutions (O->0, I/L->1).
+   * @param text Code as entered
+   * @return Numeric code, or std::nullopt if text is not a valid code
+   */
+  static std::optional<std::uint64_t> decode(std::string_view text);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /// Drop records past the capacity or the retention, oldest first; caller holds mutex_
+  void expire(Clock::time_point now);
+
+  const std::size_t capacity_;
+  const std::chrono::seconds retention_;
+  mutable std::shared_mutex mutex_;
+  std::unordered_map<std::uint64_t, BookingRecord> records_;
+  std::deque<std::pair<Clock::time_point, std::uint64_t>> order_;  ///< Codes by record time, taken ones included
+  std::atomic<std::uint64_t> next_sequence_{0};
+  const SipHashKey code_key_;  ///< Random per process; codes cannot be derived from the sequence without it
+};
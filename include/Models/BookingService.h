@@ -8,7 +8,11 @@
 #include "Interfaces/IDataStore.h"
 #include "Interfaces/ITheater.h"
 #include "Models/Movie.h"
+#include "Models/BookingLedger.h"
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 
@@ -17,18 +21,60 @@
  * @brief Service responsible for booking operations only
  * @details Handles seat booking, availability queries, and booking-related
  *          operations. Uses dependency injection for loose coupling.
+ *          Successful bookings are recorded in a BookingLedger so they can be
+ *          looked up and cancelled by confirmation code.
+ *          Asynchronous bookings are queued to a dedicated booking thread, started
+ *          by the first of them, that drains everything pending at once and books
+ *          it through book_batch, so callers never block and concurrent requests
+ *          reach the theaters grouped by theater instead of interleaved.
  *          Implements the IBookingService interface.
  */
 class BookingService : public IBookingService {
 public:
   explicit BookingService(std::shared_ptr<IDataStore> data_store);
+  ~BookingService() override;
   
   std::vector<Movie> get_all_movies() const override;
+  CatalogPage<Movie> get_movies_page(const CatalogQuery& query) const override;
+  std::uint64_t get_catalog_version() const override;
+  std::vector<Movie> search_movies(const std::string& query, std::size_t limit) const override;
   std::vector<std::shared_ptr<ITheater>> get_theaters_showing_movie(int movie_id) const override;
+  CatalogPage<std::shared_ptr<ITheater>> get_theaters_page(int movie_id, const CatalogQuery& query) const override;
   std::vector<std::string> get_available_seats(int theater_id, int movie_id) const override;
+  SeatMap get_seat_map(int theater_id, int movie_id) const override;
+  std::optional<std::uint64_t> get_seat_version(int theater_id, int movie_id) const override;
   bool book_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) override;
+  std::optional<Booking> create_booking(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) override;
+  std::future<std::optional<Booking>> book_seats_async(BookingRequest request) override;
+  void book_seats_async(BookingRequest request, BookingCallback on_complete) override;
+  std::vector<std::optional<Booking>> book_batch(const std::vector<BookingRequest>& requests) override;
+  std::optional<std::vector<Booking>> book_all_or_nothing(const std::vector<BookingRequest>& requests) override;
+  std::optional<Booking> lookup_booking(const std::string& confirmation_code) const override;
+  bool cancel_booking(const std::string& confirmation_code) override;
   bool can_book_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) const override;
 
 private:
+  /// Expand a compact ledger record into the client facing booking
+  Booking to_booking(std::uint64_t code, const BookingRecord& record) const;
+
+  /// Ledger record of a booking, std::nullopt if it has no seats or a seat is not in the layout
+  static std::optional<BookingRecord> make_record(const ITheater& theater, int theater_id, int movie_id,
+                                                  const std::vector<std::string>& seat_ids);
+
+  /// create_booking once the theater has been looked up; books on it without another lookup
+  std::optional<Booking> book_in_theater(ITheater& theater, int theater_id, int movie_id,
+                                         const std::vector<std::string>& seat_ids);
+
+  /// Booking thread: drain the pending queue in batches until shutdown
+  void run_async_bookings();
+
   std::shared_ptr<IDataStore> data_store_;
+  BookingLedger ledger_;  ///< Every confirmed booking by confirmation code
+
+  std::vector<BookingRequest> pending_requests_;     ///< Queued by book_seats_async
+  std::vector<BookingCallback> pending_callbacks_;   ///< Completion handler per queued request
+  std::mutex pending_mutex_;                         ///< Protects the pending queue and stopping_
+  std::condition_variable pending_cond_;             ///< Wakes the booking thread
+  bool stopping_ = false;                            ///< Set by the destructor
+  std::thread booking_thread_;                       ///< Started by the first async booking, under pending_mutex_
 };
@@ -0,0 +1,34 @@
+/**
+ * @file CatalogQuery.h
+ * @brief Cursor-based paging parameters and results for catalog listings
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+/**
+ * @struct CatalogQuery
+ * @brief Cursor, page size and filters for a catalog listing
+ * @details Listings are always ordered by ascending id. The cursor is exclusive,
+ *          so the id of the last entry of one page is the after_id of the next one.
+ *          A default constructed query returns the whole collection.
+ */
+struct CatalogQuery {
+  std::optional<int> after_id;    ///< Only return entries with an id greater than this one
+  std::size_t limit = 0;          ///< Maximum number of entries in the page, 0 means no limit
+  std::optional<int> theater_id;  ///< Movie listings only: keep movies scheduled in this theater
+};
+
+/**
+ * @struct CatalogPage
+ * @brief One page of a catalog listing
+ * @tparam T Type of the listed entries
+ */
+template<typename T>
+struct CatalogPage {
+  std::vector<T> items;   ///< Entries of this page in ascending id order
+  bool has_more = false;  ///< true if entries remain after the last one of this page
+};
@@ -7,7 +7,12 @@
 #include "Interfaces/IDataStore.h"
 #include "Interfaces/ITheater.h"
 #include "Models/Movie.h"
-#include <unordered_map>
+#include "Models/TitleIndex.h"
+#include "Utils/LockProfiler.h"
+#include <map>
+#include <set>
+#include <utility>
+#include <atomic>
 #include <shared_mutex>
 
 /**
@@ -15,17 +20,25 @@
  * @brief Thread-safe central repository for all system data
  * @details Provides unified access to movies and theaters with proper thread safety.
  *          Uses shared_mutex to allow multiple readers or single writer access patterns.
+ *          Movies, theaters and showings are kept in ordered indexes so that paged
+ *          listings seek straight to their cursor instead of scanning the catalog.
+ *          Every stored theater reports the movies added to its schedule, through
+ *          schedule_movie() or directly with ITheater::add_movie(), so the showing
+ *          indexes never miss one. A theater reports to the last store it was added to.
  *          Implements the IDataStore interface for dependency injection.
  */
 class CentralDataStore : public IDataStore {
 public:
   CentralDataStore() = default;
-  ~CentralDataStore() = default;
+  ~CentralDataStore();
   
   void add_movie(Movie&& movie) override;
   void remove_movie(int movie_id) override;
   Movie get_movie(int movie_id) const override;
   std::vector<Movie> get_all_movies() const override;
+  CatalogPage<Movie> get_movies_page(const CatalogQuery& query) const override;
+  std::uint64_t get_catalog_version() const override;
+  std::vector<Movie> search_movies(const std::string& query, std::size_t limit) const override;
   bool movie_exists(int movie_id) const override;
   
   void add_theater(std::shared_ptr<ITheater> theater) override;
@@ -33,13 +46,28 @@ public:
   std::shared_ptr<ITheater> get_theater(int theater_id) const override;
   std::vector<std::shared_ptr<ITheater>> get_all_theaters() const override;
   std::vector<std::shared_ptr<ITheater>> get_theaters_showing_movie(int movie_id) const override;
+  CatalogPage<std::shared_ptr<ITheater>> get_theaters_page(int movie_id, const CatalogQuery& query) const override;
   bool theater_exists(int theater_id) const override;
+  bool schedule_movie(int theater_id, Movie&& movie) override;
   
   std::vector<std::string> get_available_seats(int theater_id, int movie_id) const override;
+  SeatMap get_seat_map(int theater_id, int movie_id) const override;
+  std::optional<std::uint64_t> get_seat_version(int theater_id, int movie_id) const override;
   bool book_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) override;
+  bool release_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) override;
 
 private:
-  mutable std::shared_mutex data_mutex_;
-  std::unordered_map<int, Movie> movies_;
-  std::unordered_map<int, std::shared_ptr<ITheater>> theaters_;
+  /// Drop every showing of a theater from both indexes; caller holds the unique lock
+  void unindex_showings(int theater_id);
+
+  /// Schedule listener of a stored theater: index the showing if the theater is still stored
+  void index_showing(const ITheater* theater, int movie_id);
+
+  mutable InstrumentedMutex<std::shared_mutex> data_mutex_{"CentralDataStore::data_mutex_"};
+  std::map<int, Movie> movies_;
+  std::map<int, std::shared_ptr<ITheater>> theaters_;
+  std::set<std::pair<int, int>> theaters_by_movie_;  ///< Showings as (movie_id, theater_id)
+  std::set<std::pair<int, int>> movies_by_theater_;  ///< Showings as (theater_id, movie_id)
+  TitleIndex title_index_;                            ///< Substring index over movie titles
+  std::atomic<std::uint64_t> catalog_version_{0};    ///< Bumped under the unique lock by every catalog change
 };
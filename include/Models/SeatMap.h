@@ -0,0 +1,44 @@
+/**
+ * @file SeatMap.h
+ * @brief Seat layout of a theater and availability of one showing as a bitmap
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @struct SeatLayout
+ * @brief Geometry of a theater's seats
+ * @details Seats are numbered row-major: index = row * seats_per_row + number - 1, where
+ *          row 0 is "a". Only the last row may be shorter than seats_per_row.
+ */
+struct SeatLayout {
+  int rows = 0;
+  int seats_per_row = 0;
+  int seat_count = 0;
+
+  /// Tag clients cache the layout under; equal layouts have equal versions
+  std::uint32_t version() const {
+    std::uint32_t h = 2166136261u;  // FNV-1a over the three dimensions
+    for (const int value : {rows, seats_per_row, seat_count}) {
+      h = (h ^ static_cast<std::uint32_t>(value)) * 16777619u;
+    }
+    return h & 0x7FFFFFFF;  // Fits a JSON integer on every client
+  }
+};
+
+/**
+ * @struct SeatMap
+ * @brief Availability of every seat of one showing
+ */
+struct SeatMap {
+  SeatLayout layout;                 ///< All zero if the showing does not exist
+  std::vector<std::uint8_t> bitmap;  ///< Bit i % 8 of byte i / 8 set if seat index i is free
+  int total_available = 0;
+  std::uint64_t version = 0;         ///< Seat version of the showing the bitmap was read at
+
+  /// Whether the seat at this index is free
+  bool is_available(int index) const { return (bitmap[index / 8] >> (index % 8)) & 1; }
+};
@@ -7,11 +7,14 @@
 #include "Interfaces/ITheater.h"
 #include "Interfaces/ISeat.h"
 #include "Models/Movie.h"
+#include "Utils/LockProfiler.h"
 #include <unordered_map>
 #include <vector>
 #include <memory>
 #include <mutex>
 #include <map>
+#include <array>
+#include <atomic>
 
 /**
  * @class Theater
@@ -19,31 +22,84 @@
  * @details Manages movie scheduling and seat booking for a theater.
  *          Provides thread-safe operations for concurrent booking requests.
  *          Implements the ITheater interface for polymorphic behavior.
+ *
+ *          Each showing (movie) has its own seat lock, so bookings for different
+ *          movies never wait on each other. When a showing's lock is contended,
+ *          book_seats switches to flat combining: the request is published in the
+ *          showing's slot array and whichever thread holds the lock applies every
+ *          published request in one pass, then hands each result back. Under a flash
+ *          sale this replaces one lock handoff per booking with one per batch.
  */
 class Theater : public ITheater {
 public:
   // Name of theater could be bigger than SSO, so pass-by-balue and move is preferred.
-  Theater(int id,std::string name);
+  // seat_count is the size of every showing; rows are lettered a-z, then aa, ab and so on.
+  // Throws std::invalid_argument unless 1 <= seat_count <= kMaxSeats.
+  Theater(int id,std::string name, int seat_count = 20);
+
+  /// Largest showing: seat indices must fit the uint16 of a BookingRecord
+  static constexpr int kMaxSeats = 65536;
   
   void add_movie(Movie&& movie) override;
+  void set_schedule_listener(ScheduleListener listener) override;
   std::vector<std::string> get_available_seats(int movie_id) const override;
+  SeatMap get_seat_map(int movie_id) const override;
+  std::optional<std::uint64_t> seat_version(int movie_id) const override;
   bool book_seats(int movie_id, const std::vector<std::string>& seat_ids) override;
+  std::unique_ptr<SeatHold> hold_seats(int movie_id) override;
+  bool release_seats(int movie_id, const std::vector<std::string>& seat_ids) override;
+  int seat_index(const std::string& seat_id) const override;
+  std::string seat_label(int seat_index) const override;
   int get_id() const override;
   std::string get_name() const override;
   bool shows_movie(int movie_id) const override;
+  std::vector<Movie> get_movies() const override;
   
   void initialize_seats(int movie_id, int seat_count = 20);
 
 private:
+  /// Number of publication slots per showing; more waiting threads fall back to plain locking
+  static constexpr std::size_t kCombiningSlots = 64;
+
+  /// Booking published by a thread that found the showing's lock taken
+  struct CombiningRequest {
+    const std::vector<std::string>* seat_ids;  ///< Seats to book, owned by the waiting thread
+    bool result = false;                       ///< Written by the combiner before done is set
+    std::atomic<bool> done{false};             ///< Set once the combiner has applied the request
+  };
+
+  /// Seat inventory of one movie plus its combining slots
+  struct Showing {
+    explicit Showing(int theater_id) : mtx("Theater::Showing::mtx", theater_id) {}
+
+    std::map<std::string, std::shared_ptr<ISeat>> seats;
+    mutable InstrumentedMutex<std::mutex> mtx;  ///< Serializes seat state changes of this showing
+    std::array<std::atomic<CombiningRequest*>, kCombiningSlots> slots{};
+    std::atomic<std::uint64_t> version{0};     ///< Bumped under mtx by every change to seats
+  };
+
+  /// SeatHold on one showing: owns its seat lock until destroyed
+  class ShowingHold;
+
+  /// Find a showing; the pointer stays valid since showings are never removed
+  Showing* find_showing(int movie_id) const;
+
+  /// All-or-nothing booking; caller holds showing.mtx
+  static bool apply_booking(Showing& showing, const std::vector<std::string>& seat_ids);
+
+  /// Apply every published request of the showing; caller holds showing.mtx
+  static void combine_pending(Showing& showing);
+
   int id_;
-  int seats_per_row;
+  int seats_per_row = 0;
   int seat_count_ = 20;
   std::string name_;
   std::vector<Movie> movies_;
-  std::unordered_map<int, std::map<std::string, std::shared_ptr<ISeat>>> seats_per_movie_;
-  //std::unordered_map<int, std::unordered_map<std::string, std::shared_ptr<Seat>>> seats_per_movie_;
+  std::unordered_map<int, std::unique_ptr<Showing>> showings_;
 
-  mutable std::mutex mtx_;
+  mutable InstrumentedMutex<std::mutex> mtx_;  ///< Guards the schedule, the showings map and the layout
+  std::mutex listener_mtx_;                    ///< Guards schedule_listener_ and serializes its calls
+  ScheduleListener schedule_listener_;         ///< Set by the data store that indexes this theater
 };
 
 
@@ -0,0 +1,69 @@
+/**
+ * @file TitleIndex.h
+ * @brief N-gram inverted index over normalized movie titles
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class TitleIndex
+ * @brief Substring search index for movie titles
+ * @details Every normalized title is split into all of its 1, 2 and 3 character grams,
+ *          and each gram keeps a sorted posting list of the movie ids containing it.
+ *          A query intersects the posting lists of its own grams, starting from the
+ *          shortest one, and verifies each candidate against the stored title, so a
+ *          lookup only touches the movies that can actually match. Adding or removing
+ *          a title updates O(title length) posting lists.
+ *          Not thread-safe: the owner (CentralDataStore) guards it with its own lock.
+ */
+class TitleIndex {
+public:
+  /**
+   * @brief Index a movie title, replacing any previous title of the same movie
+   * @param movie_id Unique identifier of the movie
+   * @param title Title as stored in the catalog
+   */
+  void add(int movie_id, const std::string& title);
+
+  /**
+   * @brief Drop a movie from the index
+   * @param movie_id Unique identifier of the movie
+   */
+  void remove(int movie_id);
+
+  /**
+   * @brief Find movies whose normalized title contains the normalized query
+   * @param query Free text typed by the user
+   * @param limit Maximum number of ids to return
+   * @return Matching movie ids in ascending order
+   */
+  std::vector<int> search(std::string_view query, std::size_t limit) const;
+
+  /**
+   * @brief Normalize text for indexing and matching
+   * @details Lowercases ASCII letters, collapses every run of punctuation and
+   *          whitespace into one space and trims both ends. Bytes outside ASCII
+   *          are kept as they are.
+   * @param text Text to normalize
+   * @return Normalized text
+   */
+  static std::string normalize(std::string_view text);
+
+private:
+  using GramKey = std::uint32_t;
+
+  /// Unique keys of the grams of a normalized string with a length in [min_length, max_length]
+  static std::vector<GramKey> grams_of(std::string_view normalized, std::size_t min_length, std::size_t max_length);
+
+  static constexpr std::size_t kGramLength = 3;
+
+  std::unordered_map<GramKey, std::vector<int>> postings_;  ///< Sorted movie ids per gram
+  std::unordered_map<int, std::string> titles_;             ///< Normalized title per movie
+};
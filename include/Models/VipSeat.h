@@ -20,6 +20,7 @@ public:
     
     bool is_available() const override;
     bool book() override;
+    bool release() override;
     std::string get_id() const override;
     
     double get_premium_price() const;
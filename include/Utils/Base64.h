@@ -0,0 +1,76 @@
+/**
+ * @file Base64.h
+ * @brief Standard base64 (RFC 4648, padded) for binary fields of JSON responses
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Append the base64 encoding of a byte range
+ * @tparam Out String-like type with push_back(char), e.g. std::string or boost::json::string
+ * @param data Bytes to encode
+ * @param size Number of bytes
+ * @param out Receives 4 * ceil(size / 3) characters
+ */
+template<typename Out>
+void base64_encode(const std::uint8_t* data, std::size_t size, Out& out) {
+  static constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::size_t i = 0;
+  for (; i + 3 <= size; i += 3) {
+    const std::uint32_t v = data[i] << 16 | data[i + 1] << 8 | data[i + 2];
+    out.push_back(kAlphabet[v >> 18]);
+    out.push_back(kAlphabet[v >> 12 & 63]);
+    out.push_back(kAlphabet[v >> 6 & 63]);
+    out.push_back(kAlphabet[v & 63]);
+  }
+  if (i < size) {
+    const std::uint32_t v = data[i] << 16 | (i + 1 < size ? data[i + 1] << 8 : 0);
+    out.push_back(kAlphabet[v >> 18]);
+    out.push_back(kAlphabet[v >> 12 & 63]);
+    out.push_back(i + 1 < size ? kAlphabet[v >> 6 & 63] : '=');
+    out.push_back('=');
+  }
+}
+
+/**
+ * @brief Decode padded base64
+ * @param text Encoded text, no whitespace
+ * @return Decoded bytes, or std::nullopt if text is not valid base64
+ */
+inline std::optional<std::vector<std::uint8_t>> base64_decode(std::string_view text) {
+  auto value_of = [](char c) -> int {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+  };
+  if (text.size() % 4 != 0) {
+    return std::nullopt;
+  }
+  std::vector<std::uint8_t> bytes;
+  bytes.reserve(text.size() / 4 * 3);
+  for (std::size_t i = 0; i < text.size(); i += 4) {
+    const bool last = i + 4 == text.size();
+    const int padding = last ? (text[i + 3] == '=') + (text[i + 2] == '=') : 0;
+    std::uint32_t v = 0;
+    for (std::size_t j = 0; j < 4; ++j) {
+      const int digit = j >= 4 - static_cast<std::size_t>(padding) ? 0 : value_of(text[i + j]);
+      if (digit < 0) {
+        return std::nullopt;
+      }
+      v = v << 6 | static_cast<std::uint32_t>(digit);
+    }
+    bytes.push_back(static_cast<std::uint8_t>(v >> 16));
+    if (padding < 2) bytes.push_back(static_cast<std::uint8_t>(v >> 8 & 0xFF));
+    if (padding < 1) bytes.push_back(static_cast<std::uint8_t>(v & 0xFF));
+  }
+  return bytes;
+}
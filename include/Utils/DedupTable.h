@@ -0,0 +1,169 @@
+/**
+ * @file DedupTable.h
+ * @brief Bounded, time-expiring concurrent table that runs each keyed operation once
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * @class DedupTable
+ * @brief Remembers the result of keyed operations so retries replay instead of re-running
+ * @tparam Value Result type stored for each key (copied out to every duplicate)
+ * @details The key space is split over independently locked shards, so concurrent
+ * requests only serialize when their keys hash to the same shard and no global lock
+ * is ever taken. Each shard evicts its oldest entries once they exceed the time to
+ * live or the shard's share of the capacity, which bounds memory during retry storms.
+ * A duplicate that arrives while the first attempt is still running waits for that
+ * attempt's result instead of starting a second one. Each key also remembers a
+ * fingerprint of the operation it was first used for; reusing the key for a different
+ * operation is refused rather than answered with the first one's result.
+ */
+template<typename Value>
+class DedupTable {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief Constructor: sizes the shards
+   * @param capacity Maximum number of remembered keys across all shards
+   * @param ttl How long a result is replayed after it was first requested
+   * @param shard_count Number of independently locked shards
+   */
+  DedupTable(std::size_t capacity, Clock::duration ttl, std::size_t shard_count = 64)
+    : shards_(std::make_unique<Shard[]>(shard_count)),
+      shard_count_(shard_count),
+      per_shard_capacity_(std::max<std::size_t>(1, capacity / shard_count)),
+      ttl_(ttl) {}
+
+  /**
+   * @brief Return the remembered result for key, or compute and remember it
+   * @param key Client supplied idempotency key
+   * @param compute Operation to run if the key is new; runs outside any lock
+   * @return Result of the first execution for this key
+   * @details If compute throws, the key is forgotten so that a retry can run again,
+   * and the exception is rethrown to the caller and to any waiting duplicates.
+   */
+  Value get_or_compute(const std::string& key, const std::function<Value()>& compute) {
+    return *get_or_compute(key, std::string(), compute);
+  }
+
+  /**
+   * @brief Like get_or_compute(key, compute), refusing a key reused for another operation
+   * @param key Client supplied idempotency key, scoped by the caller to the client
+   * @param fingerprint What the operation does, e.g. its command and arguments
+   * @param compute Operation to run if the key is new; runs outside any lock
+   * @return Result of the first execution for this key, or std::nullopt if the key was
+   *         first used with a different fingerprint (compute is not run)
+   */
+  std::optional<Value> get_or_compute(const std::string& key, const std::string& fingerprint,
+                                      const std::function<Value()>& compute) {
+    const auto now = Clock::now();
+    Shard& shard = shard_for(key);
+    std::promise<Value> promise;
+    std::shared_future<Value> result;
+    std::uint64_t generation = 0;
+
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      evict(shard, now);
+      auto it = shard.entries.find(key);
+      if (it != shard.entries.end()) {
+        if (it->second.fingerprint != fingerprint) {
+          return std::nullopt;
+        }
+        result = it->second.result;
+      } else {
+        generation = ++shard.next_generation;
+        shard.entries.emplace(key, Entry{promise.get_future().share(), fingerprint, now + ttl_, generation});
+        shard.order.emplace_back(key, generation);
+      }
+    }
+
+    if (generation == 0) {
+      return result.get(); // Duplicate: replay, waiting if the first attempt is still running
+    }
+
+    try {
+      Value value = compute();
+      promise.set_value(value);
+      return value;
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end() && it->second.generation == generation) {
+          shard.entries.erase(it);
+        }
+      }
+      promise.set_exception(std::current_exception());
+      throw;
+    }
+  }
+
+  /**
+   * @brief Number of keys currently remembered (expired keys may still be counted)
+   * @return Sum of all shard sizes
+   */
+  std::size_t size() const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < shard_count_; ++i) {
+      std::lock_guard<std::mutex> lock(shards_[i].mutex);
+      total += shards_[i].entries.size();
+    }
+    return total;
+  }
+
+private:
+  struct Entry {
+    std::shared_future<Value> result;  ///< Result shared by the first attempt and its duplicates
+    std::string fingerprint;           ///< Operation the key was first used for
+    Clock::time_point expires_at;      ///< After this point the key is forgotten
+    std::uint64_t generation;          ///< Distinguishes re-inserted keys in the order queue
+  };
+
+  // Aligned to a cache line so neighbouring shard locks do not false-share
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::deque<std::pair<std::string, std::uint64_t>> order;  ///< Insertion order, oldest first
+    std::uint64_t next_generation = 0;
+  };
+
+  Shard& shard_for(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % shard_count_];
+  }
+
+  // Drop expired entries and make room for one more; caller holds the shard lock
+  void evict(Shard& shard, Clock::time_point now) {
+    while (!shard.order.empty()) {
+      const auto& [key, generation] = shard.order.front();
+      auto it = shard.entries.find(key);
+      if (it != shard.entries.end() && it->second.generation == generation) {
+        if (it->second.expires_at > now && shard.entries.size() < per_shard_capacity_) {
+          break; // Oldest live entry is still valid, so are all the newer ones
+        }
+        shard.entries.erase(it);
+      }
+      shard.order.pop_front();
+    }
+  }
+
+  std::unique_ptr<Shard[]> shards_;
+  std::size_t shard_count_;
+  std::size_t per_shard_capacity_;
+  Clock::duration ttl_;
+};
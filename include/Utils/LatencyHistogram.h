@@ -0,0 +1,166 @@
+/**
+ * @file LatencyHistogram.h
+ * @brief Fixed-size log-linear latency histogram with bounded relative error
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class BasicLatencyHistogram
+ * @brief Records latencies and reports percentiles, HdrHistogram style
+ * @tparam SubBucketBits Precision: values below 2^SubBucketBits get one bucket each;
+ *         above that every power-of-two range is split into 2^(SubBucketBits-1) equal
+ *         buckets, so a reported percentile is within 2^(1-SubBucketBits) of the true value.
+ * @details Values up to 2^40 (about 18 minutes in nanoseconds) are tracked, larger ones
+ *          are clamped. Recording is a couple of shifts and one increment, with no
+ *          allocation, so a histogram can sit on a hot path. Not thread-safe: give each
+ *          thread its own and merge them at the end.
+ *          Kept C++17 compatible so the client tools can use it.
+ */
+template<int SubBucketBits>
+class BasicLatencyHistogram {
+  static constexpr int kMaxValueBits = 40;
+  static constexpr std::size_t kSubBucketCount = std::size_t{1} << SubBucketBits;
+  static constexpr std::size_t kHalfSubBucketCount = kSubBucketCount / 2;
+
+public:
+  /// Largest value tracked; larger values are recorded as this one
+  static constexpr std::uint64_t kMaxValue = (std::uint64_t{1} << kMaxValueBits) - 1;
+
+  /// Number of buckets, for callers that keep their own bucket arrays
+  static constexpr std::size_t kBucketCount = kSubBucketCount + (kMaxValueBits - SubBucketBits) * kHalfSubBucketCount;
+
+  /**
+   * @brief Record one value
+   * @param value Latency, in whatever unit the caller uses consistently (typically ns)
+   */
+  void record(std::uint64_t value) {
+    value = std::min(value, kMaxValue);
+    ++counts_[bucket_index(value)];
+    ++count_;
+    sum_ += value;
+    max_ = std::max(max_, value);
+  }
+
+  /**
+   * @brief Add count values to one bucket, e.g. when merging an externally kept bucket array
+   * @details The values are accounted at the bucket's highest equivalent value, so
+   *          max() and mean() become upper bounds.
+   * @param index Bucket index as returned by bucket_index
+   * @param count Number of values in the bucket
+   */
+  void record_bucket(std::size_t index, std::uint64_t count) {
+    const std::uint64_t value = highest_equivalent(index);
+    counts_[index] += count;
+    count_ += count;
+    sum_ += value * count;
+    max_ = std::max(max_, value);
+  }
+
+  /**
+   * @brief Bucket a value falls into
+   * @param value Value to locate (clamped to kMaxValue)
+   * @return Index in [0, kBucketCount)
+   */
+  static std::size_t bucket_index(std::uint64_t value) {
+    value = std::min(value, kMaxValue);
+    if (value < kSubBucketCount) {
+      return static_cast<std::size_t>(value);
+    }
+    // Octave k covers [2^(SubBucketBits+k-1), 2^(SubBucketBits+k)) with buckets of width 2^k
+    const int k = most_significant_bit(value) - SubBucketBits + 1;
+    return kSubBucketCount + (k - 1) * kHalfSubBucketCount + static_cast<std::size_t>((value >> k) - kHalfSubBucketCount);
+  }
+
+  /**
+   * @brief Largest value that falls into a bucket
+   * @param index Bucket index
+   * @return Highest equivalent value
+   */
+  static std::uint64_t highest_equivalent(std::size_t index) {
+    if (index < kSubBucketCount) {
+      return index;
+    }
+    const std::size_t offset = index - kSubBucketCount;
+    const int k = static_cast<int>(offset / kHalfSubBucketCount) + 1;
+    const std::uint64_t lowest = static_cast<std::uint64_t>(offset % kHalfSubBucketCount + kHalfSubBucketCount) << k;
+    return lowest + (std::uint64_t{1} << k) - 1;
+  }
+
+  /**
+   * @brief Add every value recorded in another histogram
+   * @param other Histogram to merge into this one
+   */
+  void merge(const BasicLatencyHistogram& other) {
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  /**
+   * @brief Number of recorded values
+   * @return Count
+   */
+  std::uint64_t count() const { return count_; }
+
+  /**
+   * @brief Largest recorded value (exact)
+   * @return Maximum, 0 if empty
+   */
+  std::uint64_t max() const { return max_; }
+
+  /**
+   * @brief Mean of the recorded values (exact)
+   * @return Mean, 0 if empty
+   */
+  double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+  /**
+   * @brief Value at a percentile
+   * @param percentile Percentile in [0, 100], e.g. 99.9
+   * @return Highest value equivalent to the bucket holding the percentile, capped at max()
+   */
+  std::uint64_t value_at_percentile(double percentile) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    const double clamped = std::min(std::max(percentile, 0.0), 100.0);
+    const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(clamped / 100.0 * count_)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::min(highest_equivalent(i), max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  static int most_significant_bit(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) ++bit;
+    return bit;
+#endif
+  }
+
+  std::array<std::uint64_t, kBucketCount> counts_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t sum_ = 0;
+  std::uint64_t max_ = 0;
+};
+
+/// Default precision: 128 exact buckets, then 64 per octave (within 1.6%)
+using LatencyHistogram = BasicLatencyHistogram<7>;
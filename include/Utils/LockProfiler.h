@@ -0,0 +1,336 @@
+/**
+ * @file LockProfiler.h
+ * @brief Build-time selectable mutex instrumentation: acquisitions, wait and hold times per lock site
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Utils/LatencyHistogram.h"
+
+/**
+ * @struct LockTimes
+ * @brief Distribution of wait or hold times of a lock site, in nanoseconds
+ */
+struct LockTimes {
+  std::uint64_t samples = 0;
+  std::uint64_t total_ns = 0;
+  double mean_ns = 0;
+  std::uint64_t p50_ns = 0;
+  std::uint64_t p99_ns = 0;
+  std::uint64_t max_ns = 0;
+};
+
+/**
+ * @struct LockSiteReport
+ * @brief Figures of one lock site for one theater, merged over every mutex registered for it
+ */
+struct LockSiteReport {
+  std::string site;                  ///< Name given to the mutex, e.g. "Theater::Showing::mtx"
+  int theater_id = -1;               ///< Theater the mutex belongs to, -1 for global locks
+  std::uint64_t acquisitions = 0;    ///< Successful lock, lock_shared and try_lock calls
+  std::uint64_t contended = 0;       ///< Acquisitions that had to block
+  std::uint64_t failed_try_locks = 0;
+  LockTimes wait;                    ///< Time blocked before acquiring (0 when uncontended)
+  LockTimes hold;                    ///< Time held, exclusive acquisitions only
+};
+
+/**
+ * @struct TheaterContention
+ * @brief Contention of one theater, summed over all its lock sites
+ */
+struct TheaterContention {
+  int theater_id = -1;
+  std::uint64_t acquisitions = 0;
+  std::uint64_t contended = 0;
+  std::uint64_t failed_try_locks = 0;
+  std::uint64_t total_wait_ns = 0;
+  std::uint64_t max_wait_ns = 0;
+};
+
+/**
+ * @class LockProfiler
+ * @brief Registry of instrumented mutexes and their statistics
+ * @details Every ProfiledMutex registers a counter block keyed by (site, theater id).
+ *          Blocks are shared with the registry, so figures survive the mutex. Reports
+ *          merge the blocks of the same key, which groups e.g. all showings of a theater.
+ */
+class LockProfiler {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Histogram = BasicLatencyHistogram<5>;
+
+  /**
+   * @struct Counters
+   * @brief Statistics of one mutex, updated concurrently by its users
+   */
+  struct Counters {
+    Counters(std::string site, int theater_id) : site(std::move(site)), theater_id(theater_id) {}
+
+    /// Histogram of atomic buckets, safe to record into from several threads
+    struct Times {
+      std::array<std::atomic<std::uint64_t>, Histogram::kBucketCount> buckets{};
+      std::atomic<std::uint64_t> count{0};
+      std::atomic<std::uint64_t> total{0};
+      std::atomic<std::uint64_t> max{0};
+
+      void record(std::uint64_t ns) {
+        buckets[Histogram::bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(ns, std::memory_order_relaxed);
+        std::uint64_t seen = max.load(std::memory_order_relaxed);
+        while (ns > seen && !max.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {
+        }
+      }
+    };
+
+    void acquired(std::uint64_t wait_ns, bool blocked) {
+      acquisitions.fetch_add(1, std::memory_order_relaxed);
+      if (blocked) {
+        contended.fetch_add(1, std::memory_order_relaxed);
+      }
+      wait.record(wait_ns);
+    }
+
+    const std::string site;
+    const int theater_id;
+    std::atomic<std::uint64_t> acquisitions{0};
+    std::atomic<std::uint64_t> contended{0};
+    std::atomic<std::uint64_t> failed_try_locks{0};
+    Times wait;
+    Times hold;
+  };
+
+  /// Process-wide profiler used by default
+  static LockProfiler& global() {
+    static LockProfiler profiler;
+    return profiler;
+  }
+
+  /**
+   * @brief Create the counter block of a new mutex
+   * @param site Lock site name
+   * @param theater_id Owning theater, -1 for none
+   * @return Counter block, also kept by the profiler
+   */
+  std::shared_ptr<Counters> register_lock(const char* site, int theater_id) {
+    auto counters = std::make_shared<Counters>(site, theater_id);
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    counters_.push_back(counters);
+    return counters;
+  }
+
+  /**
+   * @brief Lock sites ordered by total wait time, most contended first
+   * @param limit Maximum number of entries, 0 for all
+   * @return One entry per (site, theater id)
+   */
+  std::vector<LockSiteReport> site_report(std::size_t limit = 0) const {
+    std::map<std::pair<std::string, int>, std::vector<const Counters*>> groups;
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (const auto& counters : counters_) {
+      groups[{counters->site, counters->theater_id}].push_back(counters.get());
+    }
+    std::vector<LockSiteReport> report;
+    report.reserve(groups.size());
+    for (const auto& [key, members] : groups) {
+      LockSiteReport entry;
+      entry.site = key.first;
+      entry.theater_id = key.second;
+      std::vector<const Counters::Times*> waits, holds;
+      for (const Counters* counters : members) {
+        entry.acquisitions += counters->acquisitions.load(std::memory_order_relaxed);
+        entry.contended += counters->contended.load(std::memory_order_relaxed);
+        entry.failed_try_locks += counters->failed_try_locks.load(std::memory_order_relaxed);
+        waits.push_back(&counters->wait);
+        holds.push_back(&counters->hold);
+      }
+      entry.wait = merge(waits);
+      entry.hold = merge(holds);
+      report.push_back(std::move(entry));
+    }
+    sort_and_trim(report, limit, [](const LockSiteReport& a, const LockSiteReport& b) {
+      return a.wait.total_ns > b.wait.total_ns;
+    });
+    return report;
+  }
+
+  /**
+   * @brief Theaters ordered by total wait time over all their lock sites
+   * @param limit Maximum number of entries, 0 for all
+   * @return One entry per theater id (global locks excluded)
+   */
+  std::vector<TheaterContention> top_contended_theaters(std::size_t limit = 10) const {
+    std::map<int, TheaterContention> theaters;
+    for (const auto& site : site_report()) {
+      if (site.theater_id < 0) {
+        continue;
+      }
+      TheaterContention& entry = theaters[site.theater_id];
+      entry.theater_id = site.theater_id;
+      entry.acquisitions += site.acquisitions;
+      entry.contended += site.contended;
+      entry.failed_try_locks += site.failed_try_locks;
+      entry.total_wait_ns += site.wait.total_ns;
+      entry.max_wait_ns = std::max(entry.max_wait_ns, site.wait.max_ns);
+    }
+    std::vector<TheaterContention> report;
+    report.reserve(theaters.size());
+    for (const auto& [theater_id, entry] : theaters) {
+      report.push_back(entry);
+    }
+    sort_and_trim(report, limit, [](const TheaterContention& a, const TheaterContention& b) {
+      return a.total_wait_ns > b.total_wait_ns || (a.total_wait_ns == b.total_wait_ns && a.contended > b.contended);
+    });
+    return report;
+  }
+
+private:
+  static LockTimes merge(const std::vector<const Counters::Times*>& parts) {
+    Histogram histogram;
+    LockTimes times;
+    for (const auto* part : parts) {
+      times.samples += part->count.load(std::memory_order_relaxed);
+      times.total_ns += part->total.load(std::memory_order_relaxed);
+      times.max_ns = std::max(times.max_ns, part->max.load(std::memory_order_relaxed));
+      for (std::size_t i = 0; i < Histogram::kBucketCount; ++i) {
+        if (const auto count = part->buckets[i].load(std::memory_order_relaxed)) {
+          histogram.record_bucket(i, count);
+        }
+      }
+    }
+    times.mean_ns = times.samples ? static_cast<double>(times.total_ns) / times.samples : 0.0;
+    times.p50_ns = std::min(histogram.value_at_percentile(50.0), times.max_ns);
+    times.p99_ns = std::min(histogram.value_at_percentile(99.0), times.max_ns);
+    return times;
+  }
+
+  template<class T, class Less>
+  static void sort_and_trim(std::vector<T>& entries, std::size_t limit, Less less) {
+    std::stable_sort(entries.begin(), entries.end(), less);
+    if (limit != 0 && entries.size() > limit) {
+      entries.resize(limit);
+    }
+  }
+
+  mutable std::mutex registry_mutex_;
+  std::vector<std::shared_ptr<Counters>> counters_;
+};
+
+/**
+ * @class ProfiledMutex
+ * @brief Mutex wrapper recording acquisitions, wait times and hold times into a LockProfiler
+ * @details Meets the Lockable requirements, and SharedLockable when Mutex does, so it
+ *          works with std::scoped_lock, std::unique_lock and std::shared_lock. Every
+ *          acquisition first tries the lock; only a failed try pays for clock reads
+ *          around the blocking call. Hold times are measured for exclusive ownership.
+ * @tparam Mutex std::mutex, std::shared_mutex or a compatible type
+ */
+template<class Mutex>
+class ProfiledMutex {
+public:
+  /**
+   * @brief Constructor
+   * @param site Lock site name, reported as is
+   * @param theater_id Theater the lock belongs to, -1 for global locks
+   * @param profiler Registry receiving the figures
+   */
+  explicit ProfiledMutex(const char* site, int theater_id = -1, LockProfiler& profiler = LockProfiler::global())
+    : counters_(profiler.register_lock(site, theater_id)) {}
+
+  ProfiledMutex(const ProfiledMutex&) = delete;
+  ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+  void lock() {
+    if (mutex_.try_lock()) {
+      counters_->acquired(0, false);
+    } else {
+      const auto start = LockProfiler::Clock::now();
+      mutex_.lock();
+      counters_->acquired(elapsed_ns(start), true);
+    }
+    held_since_ = LockProfiler::Clock::now();
+  }
+
+  bool try_lock() {
+    if (!mutex_.try_lock()) {
+      counters_->failed_try_locks.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    counters_->acquired(0, false);
+    held_since_ = LockProfiler::Clock::now();
+    return true;
+  }
+
+  void unlock() {
+    const std::uint64_t held = elapsed_ns(held_since_);
+    mutex_.unlock();
+    counters_->hold.record(held);
+  }
+
+  void lock_shared() requires requires(Mutex& m) { m.lock_shared(); } {
+    if (mutex_.try_lock_shared()) {
+      counters_->acquired(0, false);
+      return;
+    }
+    const auto start = LockProfiler::Clock::now();
+    mutex_.lock_shared();
+    counters_->acquired(elapsed_ns(start), true);
+  }
+
+  bool try_lock_shared() requires requires(Mutex& m) { m.try_lock_shared(); } {
+    if (!mutex_.try_lock_shared()) {
+      counters_->failed_try_locks.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    counters_->acquired(0, false);
+    return true;
+  }
+
+  void unlock_shared() requires requires(Mutex& m) { m.unlock_shared(); } {
+    mutex_.unlock_shared();
+  }
+
+private:
+  static std::uint64_t elapsed_ns(LockProfiler::Clock::time_point since) {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(LockProfiler::Clock::now() - since).count());
+  }
+
+  Mutex mutex_;
+  std::shared_ptr<LockProfiler::Counters> counters_;
+  LockProfiler::Clock::time_point held_since_{};  ///< Written and read by the exclusive owner only
+};
+
+/**
+ * @class UnprofiledMutex
+ * @brief Plain mutex taking the same constructor arguments as ProfiledMutex
+ */
+template<class Mutex>
+class UnprofiledMutex : public Mutex {
+public:
+  explicit UnprofiledMutex(const char*, int = -1) {}
+};
+
+/// Mutex type of the instrumented lock sites: profiled only when built with BOOKING_LOCK_PROFILING
+#ifdef BOOKING_LOCK_PROFILING
+template<class Mutex>
+using InstrumentedMutex = ProfiledMutex<Mutex>;
+constexpr bool kLockProfilingEnabled = true;
+#else
+template<class Mutex>
+using InstrumentedMutex = UnprofiledMutex<Mutex>;
+constexpr bool kLockProfilingEnabled = false;
+#endif
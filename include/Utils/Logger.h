@@ -0,0 +1,356 @@
+/**
+ * @file Logger.h
+ * @brief Asynchronous structured logger: per-thread lock-free rings, formatting on a writer thread
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Utils/PerThread.h"
+#include "Utils/TokenBucket.h"
+
+/**
+ * @enum LogLevel
+ * @brief Severity of a log record; records below the logger's level are skipped
+ */
+enum class LogLevel : std::uint8_t { Debug, Info, Warn, Error, Off };
+
+/**
+ * @class LogField
+ * @brief One key=value pair of a record, captured by value so formatting can be deferred
+ * @details Numbers are stored as is; text is copied inline and truncated to
+ *          kTextCapacity bytes, so capturing a field never allocates.
+ */
+class LogField {
+public:
+  static constexpr std::size_t kTextCapacity = 46;
+
+  enum class Kind : std::uint8_t { Signed, Unsigned, Double, Bool, Text };
+
+  /**
+   * @brief Numeric or boolean field
+   * @param key Field name, must be a string literal (it is kept by pointer)
+   * @param value Value
+   */
+  template<class T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+  LogField(const char* key, T value) : key_(key) {
+    if constexpr (std::is_same_v<T, bool>) {
+      kind_ = Kind::Bool;
+      unsigned_ = value;
+    } else if constexpr (std::is_floating_point_v<T>) {
+      kind_ = Kind::Double;
+      double_ = value;
+    } else if constexpr (std::is_signed_v<T>) {
+      kind_ = Kind::Signed;
+      signed_ = value;
+    } else {
+      kind_ = Kind::Unsigned;
+      unsigned_ = value;
+    }
+  }
+
+  /**
+   * @brief Text field
+   * @param key Field name, must be a string literal (it is kept by pointer)
+   * @param value Text, copied and truncated to kTextCapacity bytes
+   */
+  LogField(const char* key, std::string_view value) : key_(key), kind_(Kind::Text) {
+    text_size_ = static_cast<std::uint8_t>(std::min(value.size(), kTextCapacity));
+    std::copy_n(value.data(), text_size_, text_.data());
+  }
+
+  LogField(const char* key, const char* value) : LogField(key, std::string_view(value)) {}
+  LogField(const char* key, const std::string& value) : LogField(key, std::string_view(value)) {}
+
+  /// Append " key=value" in logfmt; text is quoted when it needs to be
+  void append_to(std::string& out) const {
+    out += ' ';
+    out += key_;
+    out += '=';
+    switch (kind_) {
+      case Kind::Signed: out += std::to_string(signed_); break;
+      case Kind::Unsigned: out += std::to_string(unsigned_); break;
+      case Kind::Double: out += std::to_string(double_); break;
+      case Kind::Bool: out += unsigned_ ? "true" : "false"; break;
+      case Kind::Text: {
+        const std::string_view text(text_.data(), text_size_);
+        if (!text.empty() && text.find_first_of(" =\"\\\n") == std::string_view::npos) {
+          out += text;
+          break;
+        }
+        out += '"';
+        for (char c : text) {
+          if (c == '"' || c == '\\') out += '\\';
+          out += c == '\n' ? ' ' : c;
+        }
+        out += '"';
+        break;
+      }
+    }
+  }
+
+private:
+  const char* key_;
+  Kind kind_ = Kind::Signed;
+  std::uint8_t text_size_ = 0;
+  union {
+    std::int64_t signed_;
+    std::uint64_t unsigned_;
+    double double_;
+  };
+  std::array<char, kTextCapacity> text_;
+};
+
+/**
+ * @struct LogSite
+ * @brief Per call site state of BOOKING_LOG: rate limiter and count of suppressed records
+ */
+struct LogSite {
+  TokenBucket bucket;
+  std::atomic<std::uint64_t> suppressed{0};
+};
+
+/**
+ * @class Logger
+ * @brief Structured logger that keeps formatting and I/O off the calling threads
+ * @details log() copies the event name pointer, a timestamp and the fields into the
+ *          calling thread's single-producer ring: no lock, no allocation, no syscall.
+ *          A full ring drops the record and counts it instead of blocking. A background
+ *          writer drains all rings, formats records as logfmt lines and writes each
+ *          batch with one fwrite. Every call site is rate limited (set_rate_limit);
+ *          the first record let through after a burst carries suppressed=N.
+ */
+class Logger {
+public:
+  /// Records buffered per thread
+  static constexpr std::size_t kRingCapacity = 512;
+
+  /// How long the writer sleeps when every ring is empty
+  static constexpr std::chrono::milliseconds kIdleInterval{2};
+
+  /**
+   * @brief Constructor: starts the writer thread
+   * @param output Stream the writer appends to
+   */
+  explicit Logger(std::FILE* output = stdout)
+    : output_(output),
+      rings_([this]() { return std::make_unique<Ring>(next_thread_.fetch_add(1, std::memory_order_relaxed)); }) {
+    set_rate_limit(20.0, 50.0);
+    writer_ = std::thread([this]() { run(); });
+  }
+
+  /// Destructor: writes every record still buffered, then stops the writer
+  ~Logger() {
+    running_.store(false, std::memory_order_release);
+    writer_.join();
+  }
+
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+
+  /// Process-wide logger used by BOOKING_LOG, writing to stdout
+  static Logger& global() {
+    static Logger logger;
+    return logger;
+  }
+
+  void set_level(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+  LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+
+  /// Whether records of this level are kept; BOOKING_LOG checks it before building fields
+  bool enabled(LogLevel level) const { return level >= level_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Limit how often each call site may log
+   * @param per_second Sustained records per second per site, 0 for no limit
+   * @param burst Records a site may log back to back
+   */
+  void set_rate_limit(double per_second, double burst) {
+    const auto limit = TokenBucket::Limit::per_second(per_second, burst);
+    interval_ns_.store(limit.interval_ns, std::memory_order_relaxed);
+    tolerance_ns_.store(limit.tolerance_ns, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Queue a record
+   * @param site Call site state (rate limiting)
+   * @param level Severity
+   * @param event Event name, must be a string literal
+   * @param fields Key=value pairs
+   */
+  void log(LogSite& site, LogLevel level, const char* event, std::initializer_list<LogField> fields) {
+    if (!enabled(level)) {
+      return;
+    }
+    const TokenBucket::Limit limit{interval_ns_.load(std::memory_order_relaxed),
+                                   tolerance_ns_.load(std::memory_order_relaxed)};
+    if (!site.bucket.try_acquire(TokenBucket::Clock::now(), limit)) {
+      site.suppressed.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    Ring& ring = rings_.local();
+    const std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == kRingCapacity) {
+      ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return;
+    }
+    Record& record = ring.records[head % kRingCapacity];
+    record.time = std::chrono::system_clock::now();
+    record.level = level;
+    record.event = event;
+    record.suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    record.field_count = 0;
+    for (const LogField& field : fields) {
+      if (record.field_count == kMaxFields) break;
+      record.fields[record.field_count++] = field;
+    }
+    ring.head.store(head + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief Wait until every record queued before the call has been written and flushed
+   */
+  void flush() {
+    std::vector<std::pair<const Ring*, std::uint64_t>> targets;
+    rings_.for_each([&targets](const Ring& ring) {
+      targets.emplace_back(&ring, ring.head.load(std::memory_order_acquire));
+    });
+    for (const auto& [ring, head] : targets) {
+      while (ring->tail.load(std::memory_order_acquire) < head) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+    }
+  }
+
+private:
+  static constexpr std::size_t kMaxFields = 4;
+
+  struct Record {
+    std::chrono::system_clock::time_point time;
+    LogLevel level = LogLevel::Info;
+    const char* event = "";
+    std::uint64_t suppressed = 0;
+    std::uint8_t field_count = 0;
+    std::array<LogField, kMaxFields> fields{{{"", 0}, {"", 0}, {"", 0}, {"", 0}}};
+  };
+
+  /// Single-producer single-consumer ring of one thread's records
+  struct Ring {
+    explicit Ring(std::uint32_t thread) : thread(thread) {}
+
+    std::array<Record, kRingCapacity> records;
+    alignas(64) std::atomic<std::uint64_t> head{0};          ///< Written by the producing thread
+    alignas(64) mutable std::atomic<std::uint64_t> tail{0};  ///< Written by the writer thread
+    std::atomic<std::uint64_t> dropped{0};                   ///< Records lost to a full ring
+    mutable std::uint64_t dropped_reported = 0;              ///< Writer-owned
+    const std::uint32_t thread;
+  };
+
+  void run() {
+    while (true) {
+      const bool stopping = !running_.load(std::memory_order_acquire);
+      const bool wrote = drain();
+      if (stopping) {
+        return; // The final drain happened after the stop flag was seen
+      }
+      if (!wrote) {
+        std::this_thread::sleep_for(kIdleInterval);
+      }
+    }
+  }
+
+  /// Write out every queued record; true if anything was written
+  bool drain() {
+    std::string batch;
+    std::vector<std::pair<const Ring*, std::uint64_t>> consumed;
+    rings_.for_each([&](const Ring& ring) {
+      const std::uint64_t head = ring.head.load(std::memory_order_acquire);
+      const std::uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+      for (std::uint64_t i = tail; i < head; ++i) {
+        format(ring.records[i % kRingCapacity], ring.thread, batch);
+      }
+      const std::uint64_t dropped = ring.dropped.load(std::memory_order_relaxed);
+      if (dropped != ring.dropped_reported) {
+        batch += "log_records_dropped thread=" + std::to_string(ring.thread) +
+                 " count=" + std::to_string(dropped - ring.dropped_reported) + "\n";
+        ring.dropped_reported = dropped;
+      }
+      if (head != tail) {
+        consumed.emplace_back(&ring, head);
+      }
+    });
+    if (batch.empty()) {
+      return false;
+    }
+    std::fwrite(batch.data(), 1, batch.size(), output_);
+    std::fflush(output_);
+    // Slots are handed back only once written, so flush() can wait on the tails
+    for (const auto& [ring, head] : consumed) {
+      ring->tail.store(head, std::memory_order_release);
+    }
+    return true;
+  }
+
+  static void format(const Record& record, std::uint32_t thread, std::string& out) {
+    static constexpr const char* kLevelNames[] = {"DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+    const auto since_epoch = record.time.time_since_epoch();
+    const std::time_t seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count();
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(since_epoch).count() % 1000000;
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    char stamp[40];
+    const std::size_t length = std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(stamp + length, sizeof(stamp) - length, ".%06lldZ", static_cast<long long>(micros));
+
+    out += stamp;
+    out += ' ';
+    out += kLevelNames[static_cast<std::size_t>(record.level)];
+    out += ' ';
+    out += record.event;
+    LogField("thread", thread).append_to(out);
+    for (std::size_t i = 0; i < record.field_count; ++i) {
+      record.fields[i].append_to(out);
+    }
+    if (record.suppressed != 0) {
+      LogField("suppressed", record.suppressed).append_to(out);
+    }
+    out += '\n';
+  }
+
+  std::FILE* const output_;
+  std::atomic<LogLevel> level_{LogLevel::Info};
+  std::atomic<std::int64_t> interval_ns_{0};
+  std::atomic<std::int64_t> tolerance_ns_{0};
+  std::atomic<std::uint32_t> next_thread_{1};
+  std::atomic<bool> running_{true};
+  PerThread<Ring> rings_;
+  std::thread writer_;
+};
+
+/**
+ * @brief Log an event through Logger::global(), e.g.
+ *        BOOKING_LOG(LogLevel::Warn, "session_read_failed", {"session", id}, {"error", ec.message()});
+ * @details Fields are only evaluated when the level is enabled; each call site has its own rate limit.
+ */
+#define BOOKING_LOG(level, event, ...)                                   \
+  do {                                                                   \
+    if (Logger::global().enabled(level)) {                               \
+      static LogSite booking_log_site;                                   \
+      Logger::global().log(booking_log_site, level, event, {__VA_ARGS__}); \
+    }                                                                    \
+  } while (0)
@@ -0,0 +1,96 @@
+/**
+ * @file PerThread.h
+ * @brief Registry of per-thread slots, each written by one thread and read by everyone
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * @class PerThread
+ * @brief Gives every calling thread its own Slot, created on first use
+ * @details The first call from a thread creates its slot under a mutex; later calls
+ *          find it through thread_local caches, the last one used being a single TLS
+ *          load and compare. Slots live as long as the registry, so readers can walk
+ *          them with for_each while their threads keep writing (with atomics).
+ * @tparam Slot Per-thread state; may be incomplete where PerThread is only declared
+ */
+template<class Slot>
+class PerThread {
+public:
+  using Factory = std::function<std::unique_ptr<Slot>()>;
+
+  /**
+   * @brief Constructor
+   * @param factory Creates the slot of a thread on its first call to local()
+   */
+  explicit PerThread(Factory factory) : factory_(std::move(factory)), instance_id_(next_instance_id()) {}
+
+  PerThread(const PerThread&) = delete;
+  PerThread& operator=(const PerThread&) = delete;
+
+  /**
+   * @brief The calling thread's slot
+   * @return Slot, registered on first use
+   */
+  Slot& local() {
+    // Last slot used by this thread: trivially destructible, so reading it is a plain TLS load
+    thread_local std::uint64_t last_id = 0;
+    thread_local Slot* last_slot = nullptr;
+    if (last_id == instance_id_) {
+      return *last_slot;
+    }
+    thread_local std::vector<std::pair<std::uint64_t, Slot*>> cache;
+    auto it = std::find_if(cache.begin(), cache.end(), [this](const auto& entry) { return entry.first == instance_id_; });
+    if (it == cache.end()) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slots_.push_back(factory_());
+      it = cache.emplace(cache.end(), instance_id_, slots_.back().get());
+    }
+    last_id = instance_id_;
+    last_slot = it->second;
+    return *last_slot;
+  }
+
+  /**
+   * @brief Visit every registered slot, in registration order
+   * @details Holds the registry mutex, so threads registering meanwhile wait.
+   * @param visit Callable taking const Slot&
+   */
+  template<class Visitor>
+  void for_each(Visitor&& visit) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& slot : slots_) {
+      visit(static_cast<const Slot&>(*slot));
+    }
+  }
+
+  /// Same as the const overload, for readers that also hand state back to the slots (drain, reset)
+  template<class Visitor>
+  void for_each(Visitor&& visit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& slot : slots_) {
+      visit(*slot);
+    }
+  }
+
+private:
+  // Ids are never reused, so a thread_local cache entry of a destroyed registry never matches again
+  static std::uint64_t next_instance_id() {
+    static std::atomic<std::uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Factory factory_;
+  const std::uint64_t instance_id_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+};
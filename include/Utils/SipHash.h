@@ -0,0 +1,111 @@
+/**
+ * @file SipHash.h
+ * @brief SipHash-2-4 keyed PRF for tags and identifiers that clients must not be able to forge
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+
+/**
+ * @struct SipHashKey
+ * @brief 128-bit secret key of SipHash
+ */
+struct SipHashKey {
+  std::uint64_t k0 = 0;
+  std::uint64_t k1 = 0;
+
+  /**
+   * @brief Draw a key from the operating system's random source
+   * @return Fresh key, secret for the life of the process
+   */
+  static SipHashKey random() {
+    std::random_device device;
+    auto word = [&device]() { return (std::uint64_t{device()} << 32) | device(); };
+    const std::uint64_t k0 = word();
+    return SipHashKey{k0, word()};
+  }
+};
+
+namespace siphash_detail {
+
+inline std::uint64_t rotl(std::uint64_t x, int b) {
+  return (x << b) | (x >> (64 - b));
+}
+
+/// SipHash state after the key is loaded
+struct State {
+  explicit State(const SipHashKey& key)
+    : v0(0x736f6d6570736575ULL ^ key.k0), v1(0x646f72616e646f6dULL ^ key.k1),
+      v2(0x6c7967656e657261ULL ^ key.k0), v3(0x7465646279746573ULL ^ key.k1) {}
+
+  void round() {
+    v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+    v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+  }
+
+  void compress(std::uint64_t m) {
+    v3 ^= m;
+    round();
+    round();
+    v0 ^= m;
+  }
+
+  std::uint64_t finish() {
+    v2 ^= 0xff;
+    round();
+    round();
+    round();
+    round();
+    return v0 ^ v1 ^ v2 ^ v3;
+  }
+
+  std::uint64_t v0, v1, v2, v3;
+};
+
+} // namespace siphash_detail
+
+/**
+ * @brief SipHash-2-4 of a byte string
+ * @param key Secret key
+ * @param data Message bytes
+ * @param size Number of bytes
+ * @return 64-bit tag; without the key it can neither be predicted nor inverted
+ */
+inline std::uint64_t siphash24(const SipHashKey& key, const std::uint8_t* data, std::size_t size) {
+  siphash_detail::State state(key);
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    std::uint64_t m = 0;
+    for (int b = 7; b >= 0; --b) {
+      m = (m << 8) | data[i + b];
+    }
+    state.compress(m);
+  }
+  std::uint64_t last = static_cast<std::uint64_t>(size) << 56;
+  for (std::size_t b = 0; i + b < size; ++b) {
+    last |= std::uint64_t{data[i + b]} << (8 * b);
+  }
+  state.compress(last);
+  return state.finish();
+}
+
+/**
+ * @brief SipHash-2-4 of 64-bit words, hashed as their little-endian bytes
+ * @param key Secret key
+ * @param words Message, e.g. {sequence} or {word, showing}
+ * @return Same value as siphash24 over the 8 * words.size() bytes
+ */
+inline std::uint64_t siphash24(const SipHashKey& key, std::initializer_list<std::uint64_t> words) {
+  siphash_detail::State state(key);
+  for (std::uint64_t m : words) {
+    state.compress(m);
+  }
+  state.compress(static_cast<std::uint64_t>(words.size() * 8) << 56);
+  return state.finish();
+}
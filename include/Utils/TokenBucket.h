@@ -0,0 +1,86 @@
+/**
+ * @file TokenBucket.h
+ * @brief Lock-free token bucket rate limiter
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * @class TokenBucket
+ * @brief Admits events at a sustained rate with a bounded burst
+ * @details Implemented as the generic cell rate algorithm: instead of a token count
+ *          and a refill timestamp, the bucket keeps a single "theoretical arrival
+ *          time" that advances by one emission interval per admitted event. An event
+ *          is admitted while that time stays within the burst tolerance of now, which
+ *          is equivalent to a bucket of burst tokens refilled at rate per second.
+ *          One atomic and one compare-and-swap per event, so a bucket can be shared
+ *          by many threads without a lock. The rate is passed on every call, which
+ *          lets the caller retune limits at runtime without touching the buckets.
+ */
+class TokenBucket {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @struct Limit
+   * @brief Rate and burst expressed in the units the algorithm works with
+   */
+  struct Limit {
+    std::int64_t interval_ns = 0;   ///< Time per event, 0 means unlimited
+    std::int64_t tolerance_ns = 0;  ///< How far ahead of now the bucket may run (burst - 1 intervals)
+
+    /**
+     * @brief Convert a rate and burst into a Limit
+     * @param rate Sustained events per second, 0 or less means unlimited
+     * @param burst Events that may be admitted back to back, at least 1
+     * @return Limit for try_acquire
+     */
+    static Limit per_second(double rate, double burst) {
+      if (!(rate > 0)) {
+        return Limit{};
+      }
+      const auto interval = std::max<std::int64_t>(1, std::llround(1e9 / rate));
+      return Limit{interval, static_cast<std::int64_t>((std::max(burst, 1.0) - 1) * interval)};
+    }
+  };
+
+  /**
+   * @brief Try to admit one event
+   * @param now Current time
+   * @param limit Rate to enforce
+   * @return true if the event is within the limit
+   */
+  bool try_acquire(Clock::time_point now, const Limit& limit) {
+    if (limit.interval_ns == 0) {
+      return true;
+    }
+    const std::int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    std::int64_t tat = tat_ns_.load(std::memory_order_relaxed);
+    std::int64_t next = 0;
+    do {
+      const std::int64_t start = std::max(tat, now_ns);
+      if (start - now_ns > limit.tolerance_ns) {
+        return false; // Bucket empty: the next token arrives at start - tolerance
+      }
+      next = start + limit.interval_ns;
+    } while (!tat_ns_.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+    return true;
+  }
+
+  /**
+   * @brief Give back an event admitted by try_acquire that was not let through after all
+   * @param limit Limit the event was admitted under
+   */
+  void refund(const Limit& limit) {
+    tat_ns_.fetch_sub(limit.interval_ns, std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::int64_t> tat_ns_{0};  ///< Theoretical arrival time of the next event
+};
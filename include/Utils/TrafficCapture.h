@@ -0,0 +1,244 @@
+/**
+ * @file TrafficCapture.h
+ * @brief Binary capture of the protocol traffic of every session, and its reader for replay
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Utils/PerThread.h"
+
+/**
+ * @enum CaptureKind
+ * @brief What a capture record stands for
+ */
+enum class CaptureKind : std::uint8_t {
+  Open,      ///< Session started; no payload
+  Request,   ///< Request line as received, without the newline
+  Response,  ///< Response line as sent, without the newline
+  Close      ///< Session ended; no payload
+};
+
+/**
+ * @struct CaptureRecord
+ * @brief One decoded capture record
+ */
+struct CaptureRecord {
+  std::uint64_t offset_ns = 0;   ///< Time since the capture started
+  std::uint32_t connection = 0;  ///< Session id
+  CaptureKind kind = CaptureKind::Open;
+  std::string payload;
+};
+
+/**
+ * @struct CaptureFile
+ * @brief Decoded capture file
+ */
+struct CaptureFile {
+  std::uint64_t started_unix_ns = 0;   ///< Wall clock time the capture started
+  std::vector<CaptureRecord> records;  ///< Ordered by offset, records of one connection in capture order
+};
+
+/**
+ * @class TrafficCapture
+ * @brief Appends session traffic to a compact binary file without blocking the sessions
+ * @details File layout, all integers little endian:
+ *          - header: the 8 magic bytes "BKCAP001", then the start time in Unix nanoseconds (u64)
+ *          - records: offset_ns (u64), connection (u32), kind << 24 | payload length (u32), payload
+ *
+ *          record() encodes into the calling thread's own buffer under a lock nobody else
+ *          takes except the writer, which swaps the buffers out every few milliseconds and
+ *          writes them. Threads' records are therefore interleaved by batch; read_file()
+ *          restores the time order. Once max_bytes have been accepted, further records are
+ *          dropped and counted.
+ */
+class TrafficCapture {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::array<char, 8> kMagic{'B', 'K', 'C', 'A', 'P', '0', '0', '1'};
+  static constexpr std::size_t kHeaderSize = 16;
+  static constexpr std::size_t kRecordHeaderSize = 16;
+
+  /// Longest payload a record can hold (24 bit length)
+  static constexpr std::size_t kMaxPayload = (1u << 24) - 1;
+
+  /// How often the writer thread drains the buffers
+  static constexpr std::chrono::milliseconds kDrainInterval{5};
+
+  /**
+   * @brief Create the capture file and start the writer thread
+   * @param path File to create, truncated if it exists
+   * @param max_bytes Bytes of records accepted before capture stops, 0 for no limit
+   * @throws std::runtime_error if the file cannot be opened
+   */
+  explicit TrafficCapture(const std::string& path, std::uint64_t max_bytes = 0)
+    : file_(std::fopen(path.c_str(), "wb")),
+      max_bytes_(max_bytes),
+      epoch_(Clock::now()),
+      buffers_([]() { return std::make_unique<Buffer>(); }) {
+    if (file_ == nullptr) {
+      throw std::runtime_error("Cannot open capture file " + path);
+    }
+    std::string header(kMagic.begin(), kMagic.end());
+    put_u64(header, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count()));
+    std::fwrite(header.data(), 1, header.size(), file_);
+    writer_ = std::thread([this]() { run(); });
+  }
+
+  /// Destructor: writes every buffered record and closes the file
+  ~TrafficCapture() {
+    running_.store(false, std::memory_order_release);
+    writer_.join();
+    drain();
+    std::fclose(file_);
+  }
+
+  TrafficCapture(const TrafficCapture&) = delete;
+  TrafficCapture& operator=(const TrafficCapture&) = delete;
+
+  /**
+   * @brief Append a record, timestamped now
+   * @param kind Record kind
+   * @param connection Session id
+   * @param payload Line without its newline, empty for Open and Close; truncated to kMaxPayload
+   */
+  void record(CaptureKind kind, std::uint32_t connection, std::string_view payload = {}) {
+    const std::uint64_t offset = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch_).count());
+    payload = payload.substr(0, kMaxPayload);
+    const std::uint64_t size = kRecordHeaderSize + payload.size();
+    if (max_bytes_ != 0 && accepted_bytes_.fetch_add(size, std::memory_order_relaxed) + size > max_bytes_) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    Buffer& buffer = buffers_.local();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    put_u64(buffer.pending, offset);
+    put_u32(buffer.pending, connection);
+    put_u32(buffer.pending, static_cast<std::uint32_t>(kind) << 24 | static_cast<std::uint32_t>(payload.size()));
+    buffer.pending.append(payload.data(), payload.size());
+  }
+
+  /// Write every record recorded before the call and flush the file
+  void flush() {
+    drain();
+  }
+
+  /// Records lost because max_bytes was reached
+  std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Decode a capture file
+   * @param path File written by a TrafficCapture
+   * @return Header fields and records sorted by offset
+   * @throws std::runtime_error if the file cannot be read or is not a capture; a record
+   *         cut short at the end (capture killed mid-write) is ignored
+   */
+  static CaptureFile read_file(const std::string& path) {
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+    if (!file) {
+      throw std::runtime_error("Cannot open capture file " + path);
+    }
+    std::string data;
+    char chunk[1 << 16];
+    while (const std::size_t n = std::fread(chunk, 1, sizeof(chunk), file.get())) {
+      data.append(chunk, n);
+    }
+    if (data.size() < kHeaderSize || !std::equal(kMagic.begin(), kMagic.end(), data.begin())) {
+      throw std::runtime_error(path + " is not a capture file");
+    }
+
+    CaptureFile capture;
+    capture.started_unix_ns = get_u64(data, kMagic.size());
+    std::size_t pos = kHeaderSize;
+    while (data.size() - pos >= kRecordHeaderSize) {
+      CaptureRecord record;
+      record.offset_ns = get_u64(data, pos);
+      record.connection = get_u32(data, pos + 8);
+      const std::uint32_t kind_and_size = get_u32(data, pos + 12);
+      record.kind = static_cast<CaptureKind>(kind_and_size >> 24);
+      const std::size_t size = kind_and_size & kMaxPayload;
+      if (data.size() - pos - kRecordHeaderSize < size || record.kind > CaptureKind::Close) {
+        break;
+      }
+      record.payload.assign(data, pos + kRecordHeaderSize, size);
+      capture.records.push_back(std::move(record));
+      pos += kRecordHeaderSize + size;
+    }
+    // Stable: a connection's records come from one thread at a time, already in order
+    std::stable_sort(capture.records.begin(), capture.records.end(),
+                     [](const CaptureRecord& a, const CaptureRecord& b) { return a.offset_ns < b.offset_ns; });
+    return capture;
+  }
+
+private:
+  struct Buffer {
+    std::mutex mutex;
+    std::string pending;
+  };
+
+  static void put_u32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) out += static_cast<char>(value >> (8 * i) & 0xFF);
+  }
+
+  static void put_u64(std::string& out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) out += static_cast<char>(value >> (8 * i) & 0xFF);
+  }
+
+  static std::uint32_t get_u32(const std::string& in, std::size_t pos) {
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) value |= static_cast<std::uint32_t>(static_cast<unsigned char>(in[pos + i])) << (8 * i);
+    return value;
+  }
+
+  static std::uint64_t get_u64(const std::string& in, std::size_t pos) {
+    return get_u32(in, pos) | static_cast<std::uint64_t>(get_u32(in, pos + 4)) << 32;
+  }
+
+  void run() {
+    while (running_.load(std::memory_order_acquire)) {
+      std::this_thread::sleep_for(kDrainInterval);
+      drain();
+    }
+  }
+
+  /// Swap out and write every thread's buffer; serialized so flush() and the writer do not interleave
+  void drain() {
+    std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+    buffers_.for_each([this](Buffer& buffer) {
+      {
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        spare_.swap(buffer.pending); // The thread keeps appending into the spare's capacity
+      }
+      std::fwrite(spare_.data(), 1, spare_.size(), file_);
+      spare_.clear();
+    });
+    std::fflush(file_);
+  }
+
+  std::FILE* const file_;
+  const std::uint64_t max_bytes_;
+  const Clock::time_point epoch_;
+  std::atomic<std::uint64_t> accepted_bytes_{0};
+  std::atomic<std::uint64_t> dropped_{0};
+  std::atomic<bool> running_{true};
+  std::mutex drain_mutex_;
+  std::string spare_;  ///< Guarded by drain_mutex_
+  PerThread<Buffer> buffers_;
+  std::thread writer_;
+};
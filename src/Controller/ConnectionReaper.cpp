@@ -0,0 +1,84 @@
+#include "Controller/ConnectionReaper.h"
+#include <algorithm>
+#include <sys/socket.h>
+
+ConnectionReaper::ConnectionReaper(boost::asio::io_context& io_context, std::chrono::milliseconds tick)
+  : tick_(std::max(tick, std::chrono::milliseconds(1))),
+    epoch_(std::chrono::steady_clock::now() - std::chrono::milliseconds(1)),
+    timer_(io_context) {}
+
+ConnectionReaper::~ConnectionReaper() {
+  std::lock_guard lock(mutex_);
+  timer_.cancel();
+}
+
+ConnectionReaper::Watch ConnectionReaper::watch(int fd) {
+  std::lock_guard lock(mutex_);
+  Slot* slot;
+  if (free_.empty()) {
+    slot = &slots_.emplace_back();
+  } else {
+    slot = free_.back();
+    free_.pop_back();
+  }
+  slot->fd = fd;
+  slot->deadline.store(0, std::memory_order_relaxed);
+  slot->kind.store(Deadline::None, std::memory_order_relaxed);
+  slot->expired.store(Deadline::None, std::memory_order_relaxed);
+  watched_.fetch_add(1, std::memory_order_relaxed);
+  arm_timer();
+  return Watch(this, slot);
+}
+
+void ConnectionReaper::expect(Slot* slot, Deadline deadline, std::chrono::milliseconds timeout) {
+  const bool armed = deadline != Deadline::None && timeout.count() > 0;
+  slot->kind.store(armed ? deadline : Deadline::None, std::memory_order_relaxed);
+  slot->deadline.store(armed ? now_ms() + timeout.count() : 0, std::memory_order_relaxed);
+}
+
+void ConnectionReaper::release(Slot* slot) {
+  std::lock_guard lock(mutex_);
+  slot->fd = -1;
+  slot->deadline.store(0, std::memory_order_relaxed);
+  free_.push_back(slot);
+  watched_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ConnectionReaper::arm_timer() {
+  if (timer_armed_ || watched_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  timer_armed_ = true;
+  timer_.expires_after(tick_);
+  timer_.async_wait([this](boost::system::error_code ec) {
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    }
+    scan();
+  });
+}
+
+void ConnectionReaper::scan() {
+  const std::int64_t now = now_ms();
+  std::lock_guard lock(mutex_);
+  timer_armed_ = false;
+  for (Slot& slot : slots_) {
+    std::int64_t deadline = slot.deadline.load(std::memory_order_relaxed);
+    if (deadline == 0 || deadline > now) {
+      continue;
+    }
+    const Deadline kind = slot.kind.load(std::memory_order_relaxed);
+    // Fails if the owner set a new deadline since the load; that one is checked next tick
+    if (!slot.deadline.compare_exchange_strong(deadline, 0, std::memory_order_relaxed)) {
+      continue;
+    }
+    slot.expired.store(kind, std::memory_order_relaxed);
+    expired_[static_cast<std::size_t>(kind)].fetch_add(1, std::memory_order_relaxed);
+    ::shutdown(slot.fd, SHUT_RDWR);
+  }
+  arm_timer();
+}
+
+std::int64_t ConnectionReaper::now_ms() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_).count();
+}
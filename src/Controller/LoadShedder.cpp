@@ -0,0 +1,64 @@
+#include "Controller/LoadShedder.h"
+#include <algorithm>
+#include <functional>
+
+LoadShedder::LoadShedder(const RateLimits& limits, std::size_t client_buckets)
+  : client_buckets_(std::make_unique<TokenBucket[]>(std::max<std::size_t>(1, client_buckets))),
+    client_bucket_count_(std::max<std::size_t>(1, client_buckets)) {
+  set_limits(limits);
+}
+
+void LoadShedder::set_limits(const RateLimits& limits) {
+  const auto connection = TokenBucket::Limit::per_second(limits.connection_rate, limits.connection_burst);
+  const auto client = TokenBucket::Limit::per_second(limits.client_rate, limits.client_burst);
+  connection_interval_ns_.store(connection.interval_ns, std::memory_order_relaxed);
+  connection_tolerance_ns_.store(connection.tolerance_ns, std::memory_order_relaxed);
+  client_interval_ns_.store(client.interval_ns, std::memory_order_relaxed);
+  client_tolerance_ns_.store(client.tolerance_ns, std::memory_order_relaxed);
+  max_sessions_.store(limits.max_sessions, std::memory_order_relaxed);
+}
+
+bool LoadShedder::try_open_session() {
+  const std::size_t limit = max_sessions_.load(std::memory_order_relaxed);
+  const std::size_t previous = active_sessions_.fetch_add(1, std::memory_order_relaxed);
+  if (limit != 0 && previous >= limit) {
+    active_sessions_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void LoadShedder::close_session() {
+  active_sessions_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+std::size_t LoadShedder::client_slot(std::string_view client_key) const {
+  return std::hash<std::string_view>{}(client_key) % client_bucket_count_;
+}
+
+bool LoadShedder::admit_request(TokenBucket& connection, std::size_t client_slot) {
+  const auto now = TokenBucket::Clock::now();
+  const TokenBucket::Limit connection_limit{connection_interval_ns_.load(std::memory_order_relaxed),
+                                            connection_tolerance_ns_.load(std::memory_order_relaxed)};
+  const TokenBucket::Limit client_limit{client_interval_ns_.load(std::memory_order_relaxed),
+                                        client_tolerance_ns_.load(std::memory_order_relaxed)};
+  // Connection first: a flooding connection then stops draining its client's shared budget.
+  // The session owns its connection bucket, so giving its token back is exact.
+  if (!connection.try_acquire(now, connection_limit)) {
+    return false;
+  }
+  if (!client_buckets_[client_slot].try_acquire(now, client_limit)) {
+    connection.refund(connection_limit);
+    return false;
+  }
+  return true;
+}
+
+std::size_t LoadShedder::active_sessions() const {
+  return active_sessions_.load(std::memory_order_relaxed);
+}
+
+const std::string& LoadShedder::overloaded_response() {
+  static const std::string response = "{\"error\":\"OVERLOADED\"}\n";
+  return response;
+}
@@ -0,0 +1,41 @@
+#include "Controller/RequestArena.h"
+
+RequestArena::RequestArena(std::size_t size)
+  : buffer_(std::make_unique<unsigned char[]>(size)),
+    resource_(buffer_.get(), size),
+    storage_(&resource_) {}
+
+void RequestArena::reset() {
+  resource_.release(); // Back to the start of buffer_, spilled blocks returned to the heap
+}
+
+json::value RequestArena::parse(std::string_view text) {
+  parser_.reset(storage_);
+  parser_.write(text.data(), text.size());
+  return parser_.release();
+}
+
+std::string_view RequestArena::serialize(const json::value& response) {
+  response_.clear();
+  serializer_.reset(&response);
+  char chunk[4096];
+  while (!serializer_.done()) {
+    const auto part = serializer_.read(chunk, sizeof(chunk));
+    response_.append(part.data(), part.size());
+  }
+  response_ += '\n';
+  return response_;
+}
+
+std::string_view RequestArena::set_response(std::string_view text) {
+  response_.assign(text.data(), text.size());
+  return response_;
+}
+
+std::string_view RequestArena::set_response(std::initializer_list<std::string_view> parts) {
+  response_.clear();
+  for (const auto part : parts) {
+    response_.append(part.data(), part.size());
+  }
+  return response_;
+}
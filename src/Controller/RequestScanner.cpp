@@ -0,0 +1,151 @@
+#include "Controller/RequestScanner.h"
+
+namespace {
+
+// Cursor over the request line; every method returns false as soon as the shape does not fit
+class Cursor {
+public:
+  explicit Cursor(std::string_view text) : text_(text) {}
+
+  void skip_whitespace() {
+    while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\r' || text_[pos_] == '\n')) {
+      ++pos_;
+    }
+  }
+
+  // Next non-whitespace character is c; consume it
+  bool consume(char c) {
+    skip_whitespace();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  // String of printable ASCII without escapes
+  bool string(std::string_view& out) {
+    if (!consume('"')) {
+      return false;
+    }
+    const std::size_t begin = pos_;
+    while (pos_ < text_.size()) {
+      const char c = text_[pos_];
+      if (c == '"') {
+        out = text_.substr(begin, pos_ - begin);
+        ++pos_;
+        return true;
+      }
+      if (c == '\\' || c < 0x20 || c > 0x7E) {
+        return false;
+      }
+      ++pos_;
+    }
+    return false;
+  }
+
+  // JSON integer of at most 9 digits, so it fits an int like the parser's as_int64() result
+  bool integer(int& out) {
+    skip_whitespace();
+    bool negative = false;
+    if (pos_ < text_.size() && text_[pos_] == '-') {
+      negative = true;
+      ++pos_;
+    }
+    const std::size_t begin = pos_;
+    int value = 0;
+    while (pos_ < text_.size() && text_[pos_] >= '0' && text_[pos_] <= '9') {
+      value = value * 10 + (text_[pos_] - '0');
+      ++pos_;
+    }
+    const std::size_t digits = pos_ - begin;
+    if (digits == 0 || digits > 9 || (digits > 1 && text_[begin] == '0')) {
+      return false;
+    }
+    // A fraction or exponent makes it a double, which the generic path rejects
+    if (pos_ < text_.size() && (text_[pos_] == '.' || text_[pos_] == 'e' || text_[pos_] == 'E')) {
+      return false;
+    }
+    out = negative ? -value : value;
+    return true;
+  }
+
+  bool at_end() {
+    skip_whitespace();
+    return pos_ == text_.size();
+  }
+
+private:
+  std::string_view text_;
+  std::size_t pos_ = 0;
+};
+
+enum Field : unsigned { kCommand = 1, kTheaterId = 2, kMovieId = 4, kSeats = 8 };
+
+bool command_of(std::string_view name, ScannedCommand& command, unsigned& required) {
+  if (name == "LIST_SEATS") {
+    command = ScannedCommand::ListSeats;
+    required = kCommand | kTheaterId | kMovieId;
+  } else if (name == "BOOK") {
+    command = ScannedCommand::Book;
+    required = kCommand | kTheaterId | kMovieId | kSeats;
+  } else if (name == "LIST_MOVIES") {
+    command = ScannedCommand::ListMovies;
+    required = kCommand;
+  } else if (name == "LIST_THEATERS") {
+    command = ScannedCommand::ListTheaters;
+    required = kCommand | kMovieId;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+}
+
+std::optional<ScannedRequest> scan_request(std::string_view line) {
+  Cursor cursor(line);
+  ScannedRequest request;
+  unsigned seen = 0;
+  unsigned required = 0;
+  if (!cursor.consume('{')) {
+    return std::nullopt;
+  }
+  do {
+    std::string_view key;
+    if (!cursor.string(key) || !cursor.consume(':')) {
+      return std::nullopt;
+    }
+    unsigned field = 0;
+    bool ok = false;
+    if (key == "command") {
+      field = kCommand;
+      std::string_view name;
+      ok = cursor.string(name) && command_of(name, request.command, required);
+    } else if (key == "theater_id") {
+      field = kTheaterId;
+      ok = cursor.integer(request.theater_id);
+    } else if (key == "movie_id") {
+      field = kMovieId;
+      ok = cursor.integer(request.movie_id);
+    } else if (key == "seats") {
+      field = kSeats;
+      ok = cursor.consume('[');
+      if (ok && !cursor.consume(']')) {
+        do {
+          ok = request.seat_count < ScannedRequest::kMaxSeats && cursor.string(request.seats[request.seat_count++]);
+        } while (ok && cursor.consume(','));
+        ok = ok && cursor.consume(']');
+      }
+    }
+    if (!ok || (seen & field) != 0) {
+      return std::nullopt; // Unknown key, bad value or duplicate
+    }
+    seen |= field;
+  } while (cursor.consume(','));
+
+  if (!cursor.consume('}') || !cursor.at_end() || seen != required) {
+    return std::nullopt; // Missing fields, or fields the command does not take
+  }
+  return request;
+}
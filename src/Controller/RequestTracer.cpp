@@ -0,0 +1,156 @@
+#include "Controller/RequestTracer.h"
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+constexpr const char* kSpanNames[] = {"accept", "pool_queue", "request", "parse", "service", "serialize", "write"};
+
+/// One ring buffer entry; atomics so a concurrent dump never reads a torn value
+struct TraceEvent {
+  std::atomic<std::int64_t> start_ns{0};     ///< Since the tracer's epoch
+  std::atomic<std::int64_t> duration_ns{0};
+  std::atomic<std::uint64_t> info{0};        ///< span(8) | command(8) | sequence(16) | session(32)
+};
+
+std::uint64_t pack_info(TraceSpan span, std::size_t command, std::uint16_t sequence, std::uint32_t session) {
+  return static_cast<std::uint64_t>(span) << 56 | static_cast<std::uint64_t>(command & 0xFF) << 48 |
+         static_cast<std::uint64_t>(sequence) << 32 | session;
+}
+
+}
+
+struct RequestTracer::ThreadBuffer {
+  ThreadBuffer(std::size_t capacity, std::uint32_t tid)
+    : events(std::make_unique<TraceEvent[]>(capacity)), capacity(capacity), tid(tid) {}
+
+  std::unique_ptr<TraceEvent[]> events;
+  const std::size_t capacity;
+  const std::uint32_t tid;                 ///< Thread number shown in the trace
+  std::atomic<std::uint64_t> head{0};      ///< Events ever written; published with release
+  std::uint32_t countdown = 0;             ///< Sampling state, owned by the thread
+};
+
+RequestTracer::RequestTracer(std::vector<std::string> command_names, std::uint32_t sample_period,
+                             std::size_t buffer_events)
+  : command_names_(std::move(command_names)),
+    sample_period_(sample_period),
+    buffer_events_(std::max<std::size_t>(1, buffer_events)),
+    epoch_(Clock::now()),
+    buffers_([this]() {
+      return std::make_unique<ThreadBuffer>(buffer_events_, next_thread_.fetch_add(1, std::memory_order_relaxed));
+    }) {}
+
+RequestTracer::~RequestTracer() = default;
+
+bool RequestTracer::sample() {
+  if (sample_period_ == 0) {
+    return false;
+  }
+  ThreadBuffer& buffer = buffers_.local();
+  if (buffer.countdown == 0) {
+    buffer.countdown = sample_period_ - 1;
+    return true;
+  }
+  --buffer.countdown;
+  return false;
+}
+
+void RequestTracer::record(TraceSpan span, std::uint32_t session, std::uint16_t sequence, std::size_t command,
+                           Clock::time_point start, Clock::time_point end) {
+  ThreadBuffer& buffer = buffers_.local();
+  const std::uint64_t index = buffer.head.load(std::memory_order_relaxed);
+  TraceEvent& event = buffer.events[index % buffer.capacity];
+  event.start_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch_).count(),
+                       std::memory_order_relaxed);
+  event.duration_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+                          std::memory_order_relaxed);
+  event.info.store(pack_info(span, command, sequence, session), std::memory_order_relaxed);
+  buffer.head.store(index + 1, std::memory_order_release);
+}
+
+std::string RequestTracer::chrome_trace_json() const {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  auto separator = [&]() -> std::ostream& {
+    if (!first) out << ",";
+    first = false;
+    return out;
+  };
+
+  buffers_.for_each([&](const ThreadBuffer& buffer) {
+    separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.tid
+                << ",\"args\":{\"name\":\"thread " << buffer.tid << "\"}}";
+
+    const std::uint64_t head = buffer.head.load(std::memory_order_acquire);
+    const std::uint64_t begin = head > buffer.capacity ? head - buffer.capacity : 0;
+    std::vector<std::pair<std::uint64_t, std::array<std::uint64_t, 3>>> copied;
+    copied.reserve(static_cast<std::size_t>(head - begin));
+    for (std::uint64_t i = begin; i < head; ++i) {
+      const TraceEvent& event = buffer.events[i % buffer.capacity];
+      copied.push_back({i, {static_cast<std::uint64_t>(event.start_ns.load(std::memory_order_relaxed)),
+                            static_cast<std::uint64_t>(event.duration_ns.load(std::memory_order_relaxed)),
+                            event.info.load(std::memory_order_relaxed)}});
+    }
+    // Events the writer reached while we copied may be torn; the one at the new head may be in progress
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const std::uint64_t now_head = buffer.head.load(std::memory_order_relaxed);
+    const std::uint64_t valid = now_head + 1 > buffer.capacity ? now_head + 1 - buffer.capacity : 0;
+
+    for (const auto& [index, fields] : copied) {
+      if (index < valid) {
+        continue;
+      }
+      const auto info = fields[2];
+      const auto span = static_cast<std::size_t>(info >> 56);
+      const auto command = static_cast<std::size_t>((info >> 48) & 0xFF);
+      const auto sequence = static_cast<unsigned>((info >> 32) & 0xFFFF);
+      const auto session = static_cast<std::uint32_t>(info);
+      const double ts = static_cast<std::int64_t>(fields[0]) / 1000.0;
+      separator() << "{\"name\":\"" << kSpanNames[std::min<std::size_t>(span, std::size(kSpanNames) - 1)]
+                  << "\",\"cat\":\"request\",\"pid\":1,\"tid\":" << buffer.tid << ",\"ts\":" << ts;
+      if (static_cast<TraceSpan>(span) == TraceSpan::Accept) {
+        out << ",\"ph\":\"i\",\"s\":\"t\"";
+      } else {
+        out << ",\"ph\":\"X\",\"dur\":" << static_cast<std::int64_t>(fields[1]) / 1000.0;
+      }
+      out << ",\"args\":{\"session\":" << session;
+      if (command != kNoCommand) {
+        out << ",\"seq\":" << sequence;
+        if (command < command_names_.size()) {
+          out << ",\"command\":\"" << command_names_[command] << "\"";
+        }
+      }
+      out << "}}";
+    }
+  });
+  out << "]}";
+  return out.str();
+}
+
+RequestTrace::RequestTrace(RequestTracer& tracer, std::uint32_t session, std::uint16_t sequence)
+  : tracer_(tracer), session_(session), sequence_(sequence), active_(tracer.sample()) {}
+
+RequestTrace::~RequestTrace() {
+  if (active_ && start_ != RequestTracer::Clock::time_point{}) {
+    tracer_.record(TraceSpan::Request, session_, sequence_, command_, start_, end_);
+  }
+}
+
+void RequestTrace::record_phase(RequestPhase phase, std::size_t command, RequestTracer::Clock::time_point start,
+                                RequestTracer::Clock::time_point end) {
+  if (!active_) {
+    return;
+  }
+  if (start_ == RequestTracer::Clock::time_point{}) {
+    start_ = start;
+  }
+  end_ = end;
+  command_ = command;
+  const auto span = static_cast<TraceSpan>(static_cast<std::uint8_t>(TraceSpan::Parse) + static_cast<std::uint8_t>(phase));
+  tracer_.record(span, session_, sequence_, command, start, end);
+}
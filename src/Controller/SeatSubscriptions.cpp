@@ -0,0 +1,192 @@
+#include "Controller/SeatSubscriptions.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <deque>
+#include <boost/json.hpp>
+#include "Utils/Base64.h"
+#include "Utils/Logger.h"
+
+namespace json = boost::json;
+
+struct SeatSubscriptions::Subscriber {
+  Subscriber(std::shared_ptr<Socket> socket, ShowingKey showing) : socket(std::move(socket)), showing(showing) {}
+
+  std::shared_ptr<Socket> socket;
+  const ShowingKey showing;
+  std::deque<std::shared_ptr<const std::string>> queue;  ///< Front is being written
+  std::array<char, 256> discard;                          ///< Sink for whatever the client sends
+  bool closed = false;
+};
+
+SeatSubscriptions::SeatSubscriptions(boost::asio::io_context& io_context, IBookingService& booking_service,
+                                     std::chrono::milliseconds window, std::size_t max_subscribers,
+                                     std::size_t max_queued)
+  : booking_service_(booking_service),
+    window_(window),
+    max_subscribers_(max_subscribers),
+    max_queued_(std::max<std::size_t>(1, max_queued)),
+    strand_(boost::asio::make_strand(io_context)),
+    timer_(strand_) {}
+
+SeatSubscriptions::~SeatSubscriptions() = default;
+
+void SeatSubscriptions::subscribe(std::shared_ptr<Socket> socket, ShowingKey showing) {
+  active_.fetch_add(1, std::memory_order_relaxed);
+  auto subscriber = std::make_shared<Subscriber>(std::move(socket), showing);
+  boost::asio::post(strand_, [this, subscriber]() { add(subscriber); });
+}
+
+void SeatSubscriptions::add(const std::shared_ptr<Subscriber>& subscriber) {
+  auto [it, created] = topics_.try_emplace(subscriber->showing);
+  Topic& topic = it->second;
+  if (created) {
+    topic.last = booking_service_.get_seat_map(subscriber->showing.theater_id, subscriber->showing.movie_id);
+  }
+  topic.subscribers.push_back(subscriber);
+  // Deltas are computed against topic.last, so that is the snapshot every newcomer starts from
+  send(subscriber, std::make_shared<const std::string>(snapshot_event(subscriber->showing, topic.last)));
+  read_until_closed(subscriber);
+  arm_timer();
+}
+
+void SeatSubscriptions::arm_timer() {
+  if (timer_armed_ || topics_.empty()) {
+    return;
+  }
+  timer_armed_ = true;
+  timer_.expires_after(window_);
+  timer_.async_wait([this](boost::system::error_code ec) {
+    timer_armed_ = false;
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    }
+    publish();
+    arm_timer();
+  });
+}
+
+void SeatSubscriptions::publish() {
+  for (auto& [showing, topic] : topics_) {
+    const auto version = booking_service_.get_seat_version(showing.theater_id, showing.movie_id);
+    if (!version || *version == topic.last.version) {
+      continue;  // Showing gone, or nothing booked or released during the window
+    }
+    SeatMap current = booking_service_.get_seat_map(showing.theater_id, showing.movie_id);
+    if (current.layout.seat_count != topic.last.layout.seat_count) {
+      continue;  // Showing gone or rebuilt; keep the subscribers on their last view
+    }
+    auto event = std::make_shared<const std::string>(delta_event(showing, topic.last, current));
+    topic.last = std::move(current);
+    // send() may drop a subscriber and erase it from this vector
+    const auto subscribers = topic.subscribers;
+    for (const auto& subscriber : subscribers) {
+      send(subscriber, event);
+    }
+  }
+  std::erase_if(topics_, [](const auto& entry) { return entry.second.subscribers.empty(); });
+}
+
+void SeatSubscriptions::send(const std::shared_ptr<Subscriber>& subscriber, std::shared_ptr<const std::string> event) {
+  if (subscriber->closed) {
+    return;
+  }
+  if (subscriber->queue.size() >= max_queued_) {
+    BOOKING_LOG(LogLevel::Warn, "subscriber_dropped", {"theater_id", subscriber->showing.theater_id},
+                {"movie_id", subscriber->showing.movie_id}, {"queued", subscriber->queue.size()});
+    drop(subscriber);
+    return;
+  }
+  const bool idle = subscriber->queue.empty();
+  subscriber->queue.push_back(std::move(event));
+  if (idle) {
+    write_next(subscriber);
+  }
+}
+
+void SeatSubscriptions::write_next(const std::shared_ptr<Subscriber>& subscriber) {
+  const std::string& event = *subscriber->queue.front();
+  boost::asio::async_write(*subscriber->socket, boost::asio::buffer(event),
+    boost::asio::bind_executor(strand_, [this, subscriber](boost::system::error_code ec, std::size_t) {
+      if (ec) {
+        drop(subscriber);
+        return;
+      }
+      subscriber->queue.pop_front();
+      if (!subscriber->queue.empty() && !subscriber->closed) {
+        write_next(subscriber);
+      }
+    }));
+}
+
+void SeatSubscriptions::read_until_closed(const std::shared_ptr<Subscriber>& subscriber) {
+  subscriber->socket->async_read_some(boost::asio::buffer(subscriber->discard),
+    boost::asio::bind_executor(strand_, [this, subscriber](boost::system::error_code ec, std::size_t) {
+      if (ec) {
+        drop(subscriber);
+        return;
+      }
+      read_until_closed(subscriber);
+    }));
+}
+
+void SeatSubscriptions::drop(const std::shared_ptr<Subscriber>& subscriber) {
+  if (subscriber->closed) {
+    return;
+  }
+  subscriber->closed = true;
+  boost::system::error_code ignored;
+  subscriber->socket->shutdown(Socket::shutdown_both, ignored);
+  subscriber->socket->close(ignored);  // Aborts the pending read and write
+  active_.fetch_sub(1, std::memory_order_relaxed);
+  auto it = topics_.find(subscriber->showing);
+  if (it != topics_.end()) {
+    std::erase(it->second.subscribers, subscriber);
+    // An empty topic is erased by the next publish(), which may be iterating over it now
+  }
+}
+
+std::string SeatSubscriptions::snapshot_event(ShowingKey showing, const SeatMap& map) {
+  std::string available;
+  available.reserve((map.bitmap.size() + 2) / 3 * 4);
+  base64_encode(map.bitmap.data(), map.bitmap.size(), available);
+  const json::object event{
+    {"event", "SEATS_SNAPSHOT"},
+    {"theater_id", showing.theater_id},
+    {"movie_id", showing.movie_id},
+    {"version", map.version},
+    {"layout_version", map.layout.version()},
+    {"layout", json::object{
+      {"rows", map.layout.rows},
+      {"seats_per_row", map.layout.seats_per_row},
+      {"seat_count", map.layout.seat_count}
+    }},
+    {"available", available},
+    {"total_available", map.total_available}
+  };
+  return json::serialize(event) + "\n";
+}
+
+std::string SeatSubscriptions::delta_event(ShowingKey showing, const SeatMap& before, const SeatMap& after) {
+  json::array booked;
+  json::array released;
+  for (std::size_t byte = 0; byte < after.bitmap.size(); ++byte) {
+    std::uint8_t changed = before.bitmap[byte] ^ after.bitmap[byte];  // Eight seats per compare
+    while (changed != 0) {
+      const int bit = std::countr_zero(changed);
+      changed &= changed - 1;
+      const int index = static_cast<int>(byte) * 8 + bit;
+      (before.is_available(index) ? booked : released).emplace_back(index);
+    }
+  }
+  const json::object event{
+    {"event", "SEATS_CHANGED"},
+    {"theater_id", showing.theater_id},
+    {"movie_id", showing.movie_id},
+    {"version", after.version},
+    {"booked", std::move(booked)},
+    {"released", std::move(released)},
+    {"total_available", after.total_available}
+  };
+  return json::serialize(event) + "\n";
+}
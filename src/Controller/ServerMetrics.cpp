@@ -0,0 +1,235 @@
+#include "Controller/ServerMetrics.h"
+#include "Controller/RequestTracer.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::array<const char*, kRequestPhaseCount> kPhaseNames{"parse", "service", "serialize", "write"};
+
+// Increment of a counter written by one thread only: no locked read-modify-write needed
+void bump(std::atomic<std::uint64_t>& counter, std::uint64_t delta = 1) {
+  counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+std::uint64_t read(const std::atomic<std::uint64_t>& counter) {
+  return counter.load(std::memory_order_relaxed);
+}
+
+/// Bucket counts of one phase of one command, written by the owning thread only
+struct PhaseBuckets {
+  std::array<std::atomic<std::uint64_t>, ServerMetrics::Histogram::kBucketCount> buckets{};
+  std::atomic<std::uint64_t> count{0};
+  std::atomic<std::uint64_t> sum{0};
+  std::atomic<std::uint64_t> max{0};
+
+  void record(std::uint64_t ns) {
+    bump(buckets[ServerMetrics::Histogram::bucket_index(ns)]);
+    bump(count);
+    bump(sum, ns);
+    if (ns > read(max)) {
+      max.store(ns, std::memory_order_relaxed);
+    }
+  }
+};
+
+struct CommandSlot {
+  std::atomic<std::uint64_t> requests{0};
+  std::array<PhaseBuckets, kRequestPhaseCount> phases;
+};
+
+}
+
+struct ServerMetrics::ThreadSlot {
+  ThreadSlot(std::size_t command_count, std::uint32_t sample_period)
+    : commands(std::make_unique<CommandSlot[]>(command_count)), sample_period(sample_period) {}
+
+  /// Whether the next request is timed; touches only this thread's countdown
+  bool sample() {
+    if (countdown == 0) {
+      countdown = sample_period - 1;
+      return true;
+    }
+    --countdown;
+    return false;
+  }
+
+  std::unique_ptr<CommandSlot[]> commands;
+  std::atomic<std::uint64_t> bookings_succeeded{0};
+  std::atomic<std::uint64_t> bookings_failed{0};
+  const std::uint32_t sample_period;
+  std::uint32_t countdown = 0;  ///< Owned by the thread, never read by others
+};
+
+ServerMetrics::ServerMetrics(std::vector<std::string> command_names, std::uint32_t sample_period)
+  : command_names_(std::move(command_names)),
+    sample_period_(std::max<std::uint32_t>(1, sample_period)),
+    started_(Clock::now()),
+    slots_([this]() { return std::make_unique<ThreadSlot>(command_names_.size(), sample_period_); }) {}
+
+ServerMetrics::~ServerMetrics() = default;
+
+ServerMetrics::ThreadSlot& ServerMetrics::local() {
+  return slots_.local();
+}
+
+void ServerMetrics::connection_opened() {
+  connections_active_.fetch_add(1, std::memory_order_relaxed);
+  connections_total_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerMetrics::connection_closed() {
+  connections_active_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ServerMetrics::request_shed() {
+  requests_shed_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerMetrics::session_shed() {
+  sessions_shed_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerMetrics::booking_result(bool success) {
+  ThreadSlot& slot = local();
+  bump(success ? slot.bookings_succeeded : slot.bookings_failed);
+}
+
+ServerMetrics::Snapshot ServerMetrics::snapshot() const {
+  Snapshot result;
+  result.uptime_s = std::chrono::duration<double>(Clock::now() - started_).count();
+  result.sample_period = sample_period_;
+  result.connections_active = read(connections_active_);
+  result.connections_total = read(connections_total_);
+  result.requests_shed = read(requests_shed_);
+  result.sessions_shed = read(sessions_shed_);
+
+  std::vector<const ThreadSlot*> slots;
+  slots_.for_each([&slots](const ThreadSlot& slot) { slots.push_back(&slot); });
+  for (const ThreadSlot* slot : slots) {
+    result.bookings_succeeded += read(slot->bookings_succeeded);
+    result.bookings_failed += read(slot->bookings_failed);
+  }
+  for (std::size_t command = 0; command < command_names_.size(); ++command) {
+    CommandSummary summary;
+    summary.name = command_names_[command];
+    for (const ThreadSlot* slot : slots) {
+      summary.requests += read(slot->commands[command].requests);
+    }
+    if (summary.requests == 0) {
+      continue;
+    }
+    for (std::size_t phase = 0; phase < kRequestPhaseCount; ++phase) {
+      Histogram merged;
+      std::uint64_t sum = 0;
+      std::uint64_t max = 0;
+      PhaseSummary& out = summary.phases[phase];
+      for (const ThreadSlot* slot : slots) {
+        const PhaseBuckets& buckets = slot->commands[command].phases[phase];
+        out.samples += read(buckets.count);
+        sum += read(buckets.sum);
+        max = std::max(max, read(buckets.max));
+        for (std::size_t i = 0; i < Histogram::kBucketCount; ++i) {
+          if (const auto count = read(buckets.buckets[i])) {
+            merged.record_bucket(i, count);
+          }
+        }
+      }
+      // Mean and max are exact; percentiles come from the buckets and never exceed the max
+      out.mean = out.samples ? static_cast<double>(sum) / out.samples : 0.0;
+      out.max = max;
+      out.p50 = std::min(merged.value_at_percentile(50.0), max);
+      out.p90 = std::min(merged.value_at_percentile(90.0), max);
+      out.p99 = std::min(merged.value_at_percentile(99.0), max);
+      out.p999 = std::min(merged.value_at_percentile(99.9), max);
+    }
+    result.commands.push_back(std::move(summary));
+  }
+  return result;
+}
+
+std::string ServerMetrics::prometheus_text() const {
+  const Snapshot stats = snapshot();
+  const auto seconds = [](double ns) { return ns / 1e9; };
+  std::ostringstream out;
+  out << std::setprecision(9);
+
+  out << "# HELP booking_uptime_seconds Time since the server started\n"
+      << "# TYPE booking_uptime_seconds gauge\n"
+      << "booking_uptime_seconds " << stats.uptime_s << "\n";
+
+  out << "# HELP booking_requests_total Requests processed, by command\n"
+      << "# TYPE booking_requests_total counter\n";
+  for (const auto& command : stats.commands) {
+    out << "booking_requests_total{command=\"" << command.name << "\"} " << command.requests << "\n";
+  }
+
+  out << "# HELP booking_request_phase_seconds Duration of each request phase, sampled one request in "
+      << stats.sample_period << " per thread\n"
+      << "# TYPE booking_request_phase_seconds summary\n";
+  for (const auto& command : stats.commands) {
+    for (std::size_t phase = 0; phase < kRequestPhaseCount; ++phase) {
+      const PhaseSummary& p = command.phases[phase];
+      const std::string labels = "command=\"" + command.name + "\",phase=\"" + kPhaseNames[phase] + "\"";
+      const std::pair<const char*, std::uint64_t> quantiles[] = {
+        {"0.5", p.p50}, {"0.9", p.p90}, {"0.99", p.p99}, {"0.999", p.p999}};
+      for (const auto& [quantile, value] : quantiles) {
+        out << "booking_request_phase_seconds{" << labels << ",quantile=\"" << quantile << "\"} "
+            << seconds(static_cast<double>(value)) << "\n";
+      }
+      out << "booking_request_phase_seconds_sum{" << labels << "} " << seconds(p.mean * p.samples) << "\n"
+          << "booking_request_phase_seconds_count{" << labels << "} " << p.samples << "\n";
+    }
+  }
+
+  out << "# HELP booking_connections_active Sessions currently open\n"
+      << "# TYPE booking_connections_active gauge\n"
+      << "booking_connections_active " << stats.connections_active << "\n"
+      << "# HELP booking_connections_total Sessions accepted\n"
+      << "# TYPE booking_connections_total counter\n"
+      << "booking_connections_total " << stats.connections_total << "\n";
+
+  out << "# HELP booking_bookings_total Booking attempts, by outcome\n"
+      << "# TYPE booking_bookings_total counter\n"
+      << "booking_bookings_total{result=\"success\"} " << stats.bookings_succeeded << "\n"
+      << "booking_bookings_total{result=\"failure\"} " << stats.bookings_failed << "\n";
+
+  out << "# HELP booking_shed_total Work refused by load shedding\n"
+      << "# TYPE booking_shed_total counter\n"
+      << "booking_shed_total{kind=\"request\"} " << stats.requests_shed << "\n"
+      << "booking_shed_total{kind=\"session\"} " << stats.sessions_shed << "\n";
+  return out.str();
+}
+
+ServerMetrics::RequestRecorder::RequestRecorder(ServerMetrics& metrics, RequestTrace* trace)
+  : slot_(metrics.local()),
+    trace_(trace),
+    command_(metrics.command_names_.size() - 1),
+    sampled_(slot_.sample()),
+    last_(sampled_ || trace_ ? Clock::now() : Clock::time_point{}) {}
+
+ServerMetrics::RequestRecorder::~RequestRecorder() {
+  bump(slot_.commands[command_].requests);
+}
+
+void ServerMetrics::RequestRecorder::set_command(std::size_t command) {
+  command_ = command;
+}
+
+void ServerMetrics::RequestRecorder::end_phase(RequestPhase phase) {
+  if (!sampled_ && !trace_) {
+    return;
+  }
+  const auto now = Clock::now();
+  if (sampled_) {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count();
+    slot_.commands[command_].phases[static_cast<std::size_t>(phase)].record(static_cast<std::uint64_t>(elapsed));
+  }
+  if (trace_) {
+    trace_->record_phase(phase, command_, last_, now);
+  }
+  last_ = now;
+}
@@ -1,33 +1,460 @@
 #include "Controller/TcpServer.h"
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <boost/json.hpp>
+#include "Utils/Base64.h"
+#include "Utils/LockProfiler.h"
+#include "Utils/Logger.h"
 
 namespace json = boost::json;
 
-enum class CommandType {
-    ListMovies,
-    ListTheaters,
-    ListSeats,
-    Book,
-    Unknown
+// Check a request's fields against its command's schema, so handlers can read them without checks
+void validate_arguments(const json::object& request, const CommandSpec& command) {
+    for (const auto& argument : command.arguments) {
+        const auto* value = request.if_contains(argument.name);
+        if (!value) {
+            if (argument.required) {
+                throw std::invalid_argument("missing field: " + std::string(argument.name));
+            }
+            continue;
+        }
+        switch (argument.type) {
+            case ArgumentType::Integer:
+                if (!value->is_int64()) {
+                    throw std::invalid_argument(std::string(argument.name) + " must be an integer");
+                }
+                break;
+            case ArgumentType::Id:
+                if (!value->is_int64()) {
+                    throw std::invalid_argument(std::string(argument.name) + " must be an integer");
+                }
+                if (value->as_int64() < std::numeric_limits<int>::min() ||
+                    value->as_int64() > std::numeric_limits<int>::max()) {
+                    throw std::invalid_argument(std::string(argument.name) + " is out of range");
+                }
+                break;
+            case ArgumentType::String:
+                if (!value->is_string()) {
+                    throw std::invalid_argument(std::string(argument.name) + " must be a string");
+                }
+                break;
+            case ArgumentType::Boolean:
+                if (!value->is_bool()) {
+                    throw std::invalid_argument(std::string(argument.name) + " must be a boolean");
+                }
+                break;
+            case ArgumentType::StringArray: {
+                const auto* array = value->if_array();
+                if (!array || !std::all_of(array->begin(), array->end(), [](const json::value& v) { return v.is_string(); })) {
+                    throw std::invalid_argument(std::string(argument.name) + " must be an array of strings");
+                }
+                break;
+            }
+            case ArgumentType::ObjectArray: {
+                const auto* array = value->if_array();
+                if (!array || !std::all_of(array->begin(), array->end(), [](const json::value& v) { return v.is_object(); })) {
+                    throw std::invalid_argument(std::string(argument.name) + " must be an array of objects");
+                }
+                break;
+            }
+        }
+    }
+}
+
+// Constant tails of the error responses, serialized once
+const std::string& unknown_command_tail() {
+    static const std::string tail = ",\"valid_commands\":" + command_names_json() + "}\n";
+    return tail;
+}
+
+const std::string& invalid_request_tail() {
+    static const std::string tail = ",\"sample_format\":" + sample_format_json() + "}\n";
+    return tail;
+}
+
+// Metric names of the commands, by CommandType value; requests that fail to parse count as INVALID
+std::vector<std::string> metric_command_names() {
+    std::vector<std::string> names;
+    for (const auto& command : kCommands) {
+        names.emplace_back(command.name);
+    }
+    names.emplace_back("UNKNOWN");
+    names.emplace_back("INVALID");
+    return names;
+}
+
+// Text of a response without its trailing newlines, as captured for replay
+std::string_view without_newlines(std::string_view response) {
+    std::string_view line = response;
+    while (!line.empty() && line.back() == '\n') line.remove_suffix(1);
+    return line;
+}
+
+constexpr const char* kPhaseKeys[kRequestPhaseCount] = {"parse", "service", "serialize", "write"};
+
+// Nanoseconds as microseconds, for the STATS response
+double to_us(double ns) {
+    return ns / 1000.0;
+}
+
+// Number of lock sites and theaters listed by STATS in lock profiling builds
+constexpr std::size_t kLockReportSize = 10;
+
+json::object lock_times_entry(const LockTimes& times) {
+    return json::object{
+        {"mean", to_us(times.mean_ns)},
+        {"p50", to_us(times.p50_ns)},
+        {"p99", to_us(times.p99_ns)},
+        {"max", to_us(times.max_ns)},
+        {"total", to_us(times.total_ns)}
+    };
+}
+
+// Most contended lock sites and theaters, from the process-wide LockProfiler
+json::object lock_contention_entry() {
+    json::array sites;
+    for (const auto& site : LockProfiler::global().site_report(kLockReportSize)) {
+        sites.push_back(json::object{
+            {"site", site.site},
+            {"theater_id", site.theater_id},
+            {"acquisitions", site.acquisitions},
+            {"contended", site.contended},
+            {"failed_try_locks", site.failed_try_locks},
+            {"wait_us", lock_times_entry(site.wait)},
+            {"hold_us", lock_times_entry(site.hold)}
+        });
+    }
+    json::array theaters;
+    for (const auto& theater : LockProfiler::global().top_contended_theaters(kLockReportSize)) {
+        theaters.push_back(json::object{
+            {"theater_id", theater.theater_id},
+            {"acquisitions", theater.acquisitions},
+            {"contended", theater.contended},
+            {"failed_try_locks", theater.failed_try_locks},
+            {"total_wait_us", to_us(theater.total_wait_ns)},
+            {"max_wait_us", to_us(theater.max_wait_ns)}
+        });
+    }
+    return json::object{{"sites", std::move(sites)}, {"top_theaters", std::move(theaters)}};
+}
+
+// Largest page a client can request; bigger limits are clamped to it
+constexpr std::size_t kMaxPageSize = 1000;
+
+// Number of SEARCH_MOVIES results when the request does not set a limit
+constexpr std::size_t kDefaultSearchLimit = 10;
+
+// Most commands a BATCH request may hold
+constexpr std::size_t kMaxBatchSize = 32;
+
+// Fields of a movie or theater entry that a listing should include
+struct FieldSelection {
+    bool id = true;
+    bool name = true;
 };
 
-CommandType parse_command(const std::string& cmd) {
-    if (cmd == "LIST_MOVIES") return CommandType::ListMovies;
-    if (cmd == "LIST_THEATERS") return CommandType::ListTheaters;
-    if (cmd == "LIST_SEATS") return CommandType::ListSeats;
-    if (cmd == "BOOK") return CommandType::Book;
-    return CommandType::Unknown;
+// Read the optional paging and filter parameters of LIST_MOVIES / LIST_THEATERS
+CatalogQuery parse_catalog_query(const json::object& request) {
+    CatalogQuery query;
+    if (const auto* after_id = request.if_contains("after_id")) {
+        query.after_id = static_cast<int>(after_id->as_int64());
+    }
+    if (const auto* limit = request.if_contains("limit")) {
+        const auto requested = limit->as_int64();
+        if (requested <= 0) {
+            throw std::invalid_argument("limit must be a positive integer");
+        }
+        query.limit = std::min<std::size_t>(static_cast<std::size_t>(requested), kMaxPageSize);
+    }
+    if (const auto* theater_id = request.if_contains("theater_id")) {
+        query.theater_id = static_cast<int>(theater_id->as_int64());
+    }
+    return query;
+}
+
+// Read the optional "fields" projection, e.g. ["id"] to skip the names
+FieldSelection parse_fields(const json::object& request) {
+    FieldSelection fields;
+    if (const auto* requested = request.if_contains("fields")) {
+        fields = FieldSelection{false, false};
+        for (const auto& field : requested->as_array()) {
+            const std::string name = json::value_to<std::string>(field);
+            if (name == "id") {
+                fields.id = true;
+            } else if (name == "name") {
+                fields.name = true;
+            } else {
+                throw std::invalid_argument("Unknown field: " + name);
+            }
+        }
+    }
+    return fields;
+}
+
+json::object catalog_entry(int id, const std::string& name, const FieldSelection& fields, const json::storage_ptr& sp) {
+    json::object entry(sp);
+    if (fields.id) entry.emplace("id", id);
+    if (fields.name) entry.emplace("name", name);
+    return entry;
+}
+
+// JSON array of strings, e.g. seat ids
+json::array string_array(const std::vector<std::string>& items, const json::storage_ptr& sp) {
+    json::array array(sp);
+    array.reserve(items.size());
+    for (const auto& item : items) {
+        array.emplace_back(json::string_view(item));
+    }
+    return array;
+}
+
+// Seat ids of a parsed BOOK request
+std::vector<std::string> seat_list(const json::object& request) {
+    std::vector<std::string> seats;
+    for (const auto& seat : request.at("seats").as_array()) {
+        seats.push_back(json::value_to<std::string>(seat)); // convert json value to string and  push to vector
+    }
+    return seats;
+}
+
+// LIST_MOVIES response
+json::value movies_page_response(IBookingService& booking_service, const CatalogQuery& query,
+                                 const FieldSelection& fields, std::uint64_t version, const json::storage_ptr& sp) {
+    auto page = booking_service.get_movies_page(query); // Only the requested page is copied
+    json::array movies_array(sp);                       // json array for movies
+    movies_array.reserve(page.items.size());
+    for (const auto& m : page.items) {
+        movies_array.push_back(catalog_entry(m.get_id(), m.get_name(), fields, sp));
+    }
+    json::object response({{"movies", std::move(movies_array)}, {"version", version}}, sp);
+    if (page.has_more) {
+        response.emplace("next_after_id", page.items.back().get_id()); // cursor for the next page
+    }
+    return response;
+}
+
+// LIST_THEATERS response
+json::value theaters_page_response(IBookingService& booking_service, int movie_id, const CatalogQuery& query,
+                                   const FieldSelection& fields, std::uint64_t version, const json::storage_ptr& sp) {
+    auto page = booking_service.get_theaters_page(movie_id, query); // Get theaters showing movie from the service
+    json::array theaters_array(sp);
+    theaters_array.reserve(page.items.size());
+    for (const auto& t : page.items) {
+        theaters_array.push_back(catalog_entry(t->get_id(), t->get_name(), fields, sp));
+    }
+    json::object response({{"theaters", std::move(theaters_array)}, {"version", version}}, sp); // set the response to contain theaters array
+    if (page.has_more) {
+        response.emplace("next_after_id", page.items.back()->get_id());
+    }
+    return response;
+}
+
+// LIST_SEATS response; version is read before the seats, so the seats are at least that recent
+json::value available_seats_response(IBookingService& booking_service, int theater_id, int movie_id,
+                                     std::uint64_t version, const json::storage_ptr& sp) {
+    auto seats = booking_service.get_available_seats(theater_id, movie_id);
+    return json::object({
+        {"theater_id", theater_id},
+        {"movie_id", movie_id},
+        {"available_seats", string_array(seats, sp)},
+        {"total_available", seats.size()},
+        {"version", version}
+    }, sp);
+}
+
+// LIST_SEATS response in the compact "bitmap" or "rle" format, built from the seat bitmap
+json::value seat_map_response(IBookingService& booking_service, int theater_id, int movie_id, std::string_view format,
+                              const json::value* cached_layout, const json::storage_ptr& sp) {
+    const bool bitmap = format == "bitmap";
+    if (!bitmap && format != "rle") {
+        throw std::invalid_argument("format must be list, bitmap or rle");
+    }
+    const SeatMap map = booking_service.get_seat_map(theater_id, movie_id);
+    const SeatLayout& layout = map.layout;
+    json::object response({
+        {"theater_id", theater_id},
+        {"movie_id", movie_id},
+        {"format", format},
+        {"layout_version", layout.version()}
+    }, sp);
+    if (!cached_layout || cached_layout->as_int64() != layout.version()) {
+        response.emplace("layout", json::object({
+            {"rows", layout.rows},
+            {"seats_per_row", layout.seats_per_row},
+            {"seat_count", layout.seat_count}
+        }, sp));
+    }
+    if (bitmap) {
+        json::string encoded(sp);
+        encoded.reserve((map.bitmap.size() + 2) / 3 * 4);
+        base64_encode(map.bitmap.data(), map.bitmap.size(), encoded);
+        response.emplace("available", std::move(encoded));
+    } else {
+        // Per row, lengths of alternating free and taken runs, starting with free
+        json::array rows(sp);
+        rows.reserve(layout.rows);
+        for (int row = 0; row < layout.rows; ++row) {
+            json::array runs(sp);
+            const int first = row * layout.seats_per_row;
+            const int end = std::min(first + layout.seats_per_row, layout.seat_count);
+            bool free = true;
+            int run = 0;
+            for (int index = first; index < end; ++index) {
+                if (map.is_available(index) != free) {
+                    runs.emplace_back(run);
+                    free = !free;
+                    run = 0;
+                }
+                ++run;
+            }
+            runs.emplace_back(run);
+            rows.emplace_back(std::move(runs));
+        }
+        response.emplace("available", std::move(rows));
+    }
+    response.emplace("total_available", map.total_available);
+    response.emplace("version", map.version);
+    return response;
+}
+
+// NOT_MODIFIED answer, already serialized, if the request's if_version is the current version
+std::optional<std::string> not_modified(const json::object& request, std::uint64_t version) {
+    const auto* if_version = request.if_contains("if_version");
+    if (!if_version || if_version->as_int64() < 0 || static_cast<std::uint64_t>(if_version->as_int64()) != version) {
+        return std::nullopt;
+    }
+    return R"({"status":"NOT_MODIFIED","version":)" + std::to_string(version) + "}\n";
+}
+
+const char* admission_state_name(AdmissionState state) {
+    switch (state) {
+        case AdmissionState::Waiting: return "WAITING";
+        case AdmissionState::Admitted: return "ADMITTED";
+        case AdmissionState::Expired: return "EXPIRED";
+        case AdmissionState::Used: return "USED";
+        case AdmissionState::Invalid: break;
+    }
+    return "INVALID_TOKEN";
+}
+
+// JOIN_QUEUE / QUEUE_STATUS response body for a token's status
+json::object queue_status_entry(int theater_id, int movie_id, const QueueStatus& status,
+                                const json::storage_ptr& sp = {}) {
+    json::object entry({
+        {"status", admission_state_name(status.state)},
+        {"theater_id", theater_id},
+        {"movie_id", movie_id}
+    }, sp);
+    if (status.state == AdmissionState::Waiting) {
+        entry.emplace("position", status.position);
+        entry.emplace("estimated_wait_ms", status.estimated_wait.count());
+    }
+    return entry;
+}
+
+// Remove the socket file a previous run left at path. Anything that is not a socket, or a socket
+// another server still answers on, is left alone and fails startup instead.
+void remove_stale_unix_socket(const boost::asio::any_io_executor& executor, const std::string& path) {
+    struct stat info{};
+    if (::lstat(path.c_str(), &info) != 0) {
+        if (errno == ENOENT) {
+            return;
+        }
+        throw std::runtime_error("Unix socket listener error: " + path + ": " + std::strerror(errno));
+    }
+    if (!S_ISSOCK(info.st_mode)) {
+        throw std::runtime_error("Unix socket listener error: " + path + " exists and is not a socket");
+    }
+    boost::asio::local::stream_protocol::socket probe(executor);
+    boost::system::error_code ec;
+    probe.connect(boost::asio::local::stream_protocol::endpoint(path), ec);
+    if (!ec) {
+        throw std::runtime_error("Unix socket listener error: a server is already listening on " + path);
+    }
+    if (ec != boost::asio::error::connection_refused) {
+        throw std::runtime_error("Unix socket listener error: " + path + ": " + ec.message());
+    }
+    ::unlink(path.c_str());
 }
 
 TcpServer::TcpServer(boost::asio::io_context & io_context,unsigned short port,
-    IBookingService & booking_service, IAdministrationService& admin_service, std::size_t thread_pool_size) : //acceptor_(io_context,boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(),port)),
-    acceptor_(io_context),booking_service_(booking_service),admin_service_(admin_service),threadpool_size_(thread_pool_size) ,thread_pool_(thread_pool_size) {
+    IBookingService & booking_service, IAdministrationService& admin_service, std::size_t thread_pool_size,
+    const ServerConfig& config) : //acceptor_(io_context,boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(),port)),
+    acceptor_(io_context),metrics_acceptor_(io_context),local_acceptor_(io_context),booking_service_(booking_service),admin_service_(admin_service),threadpool_size_(thread_pool_size),
+    capture_(config.capture_path.empty() ? nullptr
+                                         : std::make_unique<TrafficCapture>(config.capture_path, config.capture_max_bytes)),
+    session_limits_(config.session_limits),
+    request_too_large_response_("{\"error\":\"REQUEST_TOO_LARGE\",\"max_bytes\":" +
+                                std::to_string(config.session_limits.max_request_bytes) + "}\n\n"),
+    reaper_(io_context, config.reaper_tick),
+    booking_dedup_(config.booking_dedup_capacity, config.booking_dedup_ttl),
+    waiting_room_(config.waiting_room_rate, config.waiting_room_window, config.waiting_room_showings),
+    load_shedder_(config.rate_limits, config.client_buckets),
+    metrics_(metric_command_names(), config.metrics_sample_period),
+    tracer_(metric_command_names(), config.trace_sample_period, config.trace_buffer_events),
+    seat_subscriptions_(io_context, booking_service, config.subscription_window, config.max_subscribers,
+                        config.subscriber_queue_limit),
+    thread_pool_(thread_pool_size) {
   
   using namespace boost::asio;
   boost::system::error_code ec;
 
+  if (config.network_backend == NetworkBackend::IoUring) {
+    try {
+      UringTransport::Handler& handler = *this;  // Private base: convert here, not inside make_unique
+      uring_ = std::make_unique<UringTransport>(handler, reaper_, session_limits_, port,
+                                                config.io_uring_rings ? config.io_uring_rings : thread_pool_size);
+    } catch (const std::runtime_error& e) {
+      BOOKING_LOG(LogLevel::Warn, "io_uring_fallback", {"error", e.what()});  // Serve the port with Asio
+    }
+  }
+
+  if (!uring_) {
+    open_acceptor(port);
+  }
+
+  BOOKING_LOG(LogLevel::Info, "server_bound", {"port", this->port()}, {"transport", uring_ ? "io_uring" : "asio"});
+  if (capture_) {
+    BOOKING_LOG(LogLevel::Info, "capture_started", {"path", config.capture_path});
+  }
+
+  if (config.metrics_port != 0) {
+    const ip::tcp::endpoint metrics_endpoint(ip::tcp::v4(), config.metrics_port);
+    metrics_acceptor_.open(metrics_endpoint.protocol(), ec);
+    if (!ec) metrics_acceptor_.set_option(ip::tcp::acceptor::reuse_address(true), ec);
+    if (!ec) metrics_acceptor_.bind(metrics_endpoint, ec);
+    if (!ec) metrics_acceptor_.listen(socket_base::max_listen_connections, ec);
+    if (ec) {
+        throw std::runtime_error("Metrics listener error: " + ec.message());
+    }
+    BOOKING_LOG(LogLevel::Info, "metrics_listening", {"port", config.metrics_port});
+  }
+
+  if (!config.unix_socket_path.empty()) {
+    remove_stale_unix_socket(local_acceptor_.get_executor(), config.unix_socket_path);
+    const local::stream_protocol::endpoint local_endpoint(config.unix_socket_path);
+    local_acceptor_.open(local_endpoint.protocol(), ec);
+    if (!ec) local_acceptor_.bind(local_endpoint, ec);
+    if (!ec) local_acceptor_.listen(socket_base::max_listen_connections, ec);
+    if (ec) {
+        throw std::runtime_error("Unix socket listener error: " + ec.message());
+    }
+    BOOKING_LOG(LogLevel::Info, "unix_socket_listening", {"path", config.unix_socket_path});
+  }
+
+}
+
+void TcpServer::open_acceptor(unsigned short port) {
+  using namespace boost::asio;
+  boost::system::error_code ec;
+
   // Open the acceptor
   acceptor_.open(ip::tcp::v4(), ec);
   if (ec) {
@@ -38,7 +465,7 @@ TcpServer::TcpServer(boost::asio::io_context & io_context,unsigned short port,
   acceptor_.set_option(ip::tcp::acceptor::reuse_address(true), ec);
   if (ec) {
       // Non-fatal error, log but continue
-      std::cerr << "Set option warning: " << ec.message() << std::endl;
+      BOOKING_LOG(LogLevel::Warn, "acceptor_option_failed", {"option", "reuse_address"}, {"error", ec.message()});
   }
 
   // Bind to port
@@ -52,13 +479,41 @@ TcpServer::TcpServer(boost::asio::io_context & io_context,unsigned short port,
   if (ec) {
       throw std::runtime_error("Listen error: " + ec.message());
   }
+}
 
-  std::cout << "Server bound to port " << port << std::endl;
+void TcpServer::start() {
+  if (uring_) {
+    try {
+      uring_->start();
+    } catch (const std::runtime_error& e) {
+      // A ring could not be brought up: close every ring and serve the same port with Asio
+      BOOKING_LOG(LogLevel::Warn, "io_uring_fallback", {"error", e.what()});
+      const unsigned short port = uring_->port();
+      uring_.reset();
+      open_acceptor(port);
+    }
+  }
+  if (!uring_) {
+    do_accept();
+  }
+  if (local_acceptor_.is_open()) {
+    do_accept_local();
+  }
+  if (metrics_acceptor_.is_open()) {
+    do_accept_metrics();
+  }
+}
 
+void TcpServer::set_rate_limits(const RateLimits& limits) {
+  load_shedder_.set_limits(limits);
 }
 
-void TcpServer::start() {
-  do_accept();
+unsigned short TcpServer::port() const {
+  if (uring_) {
+    return uring_->port();
+  }
+  boost::system::error_code ec;
+  return acceptor_.local_endpoint(ec).port();
 }
 
 void TcpServer::do_accept() {
@@ -67,46 +522,216 @@ void TcpServer::do_accept() {
 
   acceptor_.async_accept(*socket,[this,socket](boost::system::error_code ec) {
     if (!ec) {
-      //std::thread([this,socket](){handle_session(socket);}).detach();
-      thread_pool_.post([this,socket](){
-        handle_session(socket);
-      });
+      boost::system::error_code endpoint_ec;
+      const auto remote = socket->remote_endpoint(endpoint_ec);
+      open_session(socket, endpoint_ec ? std::string() : remote.address().to_string());
     }
     do_accept();
   });
 }
+
+void TcpServer::do_accept_local() {
+  auto socket = std::make_shared<boost::asio::local::stream_protocol::socket>(local_acceptor_.get_executor());
+
+  local_acceptor_.async_accept(*socket, [this, socket](boost::system::error_code ec) {
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    }
+    if (!ec) {
+      open_session(socket, "local"); // Co-located clients share one client bucket, as on loopback
+    }
+    do_accept_local();
+  });
+}
+
+template <typename Socket>
+void TcpServer::open_session(std::shared_ptr<Socket> socket, std::string_view client) {
+  if (!load_shedder_.try_open_session()) {
+    metrics_.session_shed();
+    // Over the session cap: answer without queuing on the pool, then hang up
+    boost::asio::async_write(*socket, boost::asio::buffer(LoadShedder::overloaded_response()),
+      [socket](boost::system::error_code, std::size_t) {
+        boost::system::error_code ignored;
+        socket->shutdown(Socket::shutdown_both, ignored);
+      });
+    return;
+  }
+  boost::system::error_code ec;
+  const auto protocol = socket->local_endpoint(ec).protocol();
+  std::shared_ptr<SessionSocket> session_socket;
+  if (!ec) {
+    const auto handle = socket->release(ec);
+    if (!ec) session_socket = std::make_shared<SessionSocket>(socket->get_executor(), SessionSocket::protocol_type(protocol), handle);
+  }
+  if (!session_socket) {
+    BOOKING_LOG(LogLevel::Warn, "session_open_failed", {"error", ec.message()});
+    load_shedder_.close_session();
+    return;
+  }
+  //std::thread([this,socket](){handle_session(socket);}).detach();
+  metrics_.connection_opened();
+  const std::uint32_t session = next_session_id_.fetch_add(1, std::memory_order_relaxed);
+  const std::size_t client_slot = load_shedder_.client_slot(client);
+  RequestTracer::Clock::time_point enqueued{};
+  if (tracer_.sample()) {
+    enqueued = RequestTracer::Clock::now();
+    tracer_.record(TraceSpan::Accept, session, 0, RequestTracer::kNoCommand, enqueued, enqueued);
+  }
+  thread_pool_.post([this,session_socket,session,enqueued,client_slot,client = std::string(client)]() mutable {
+    handle_session(session_socket, session, enqueued, client_slot, std::move(client));
+    metrics_.connection_closed();
+    load_shedder_.close_session();
+  });
+}
+
+void TcpServer::do_accept_metrics() {
+  // One request per connection: read the header block, answer, close
+  struct Exchange {
+    explicit Exchange(boost::asio::ip::tcp::acceptor& acceptor) : socket(acceptor.get_executor()) {}
+    boost::asio::ip::tcp::socket socket;
+    boost::asio::streambuf request;
+    std::string response;
+  };
+  auto exchange = std::make_shared<Exchange>(metrics_acceptor_);
+
+  metrics_acceptor_.async_accept(exchange->socket, [this, exchange](boost::system::error_code ec) {
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    }
+    if (!ec) {
+      boost::asio::async_read_until(exchange->socket, exchange->request, "\r\n\r\n",
+        [this, exchange](boost::system::error_code read_ec, std::size_t) {
+          if (read_ec) {
+            return;
+          }
+          std::istream is(&exchange->request);
+          std::string method, target;
+          is >> method >> target;
+          const std::string path = target.substr(0, target.find('?'));
+          const bool metrics = method == "GET" && path == "/metrics";
+          const bool trace = method == "GET" && path == "/trace";
+          std::string body = "Not Found\n";
+          std::string content_type = "text/plain; charset=utf-8";
+          if (metrics) {
+            body = metrics_.prometheus_text();
+            content_type = "text/plain; version=0.0.4; charset=utf-8";
+          } else if (trace) {
+            body = tracer_.chrome_trace_json();
+            content_type = "application/json";
+          }
+          exchange->response = std::string(metrics || trace ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n") +
+                               "Content-Type: " + content_type + "\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n\r\n" + body;
+          boost::asio::async_write(exchange->socket, boost::asio::buffer(exchange->response),
+            [exchange](boost::system::error_code, std::size_t) {
+              boost::system::error_code ignored;
+              exchange->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+            });
+        });
+    }
+    do_accept_metrics();
+  });
+}
+template <typename Write>
+void TcpServer::serve_request(SessionContext& session, const std::string& request,
+                              std::optional<ShowingKey>& subscription, Write&& write) {
+  if (capture_) {
+    capture_->record(CaptureKind::Request, session.id, request);
+  }
+
+  if (!load_shedder_.admit_request(session.connection_bucket, session.client_slot)) {
+    metrics_.request_shed();
+    const std::string& overloaded = LoadShedder::overloaded_response();
+    write(std::string_view(overloaded), std::string_view()); // Shed before parsing
+    if (capture_) {
+      capture_->record(CaptureKind::Response, session.id, without_newlines(overloaded));
+    }
+    return;
+  }
+
+  RequestTrace trace(tracer_, session.id, session.sequence++);
+  RequestRecorder recorder(metrics_, trace.active() ? &trace : nullptr);
+  std::string_view response;
+  try {
+    response = dispatch_request_json(request, session.arena, recorder, &subscription, session.client);
+  } catch (const std::exception &e) {
+    response = session.arena.set_response(std::string("{\"error\":\"") + e.what() + "\"}");
+  }
+  write(response, std::string_view("\n", 1));
+  recorder.end_phase(RequestPhase::Write);
+  if (capture_) {
+    capture_->record(CaptureKind::Response, session.id, without_newlines(response));
+  }
+}
+
 // Synchronous
-void TcpServer::handle_session(std::shared_ptr<boost::asio::ip::tcp::socket>socket) {
+void TcpServer::handle_session(std::shared_ptr<SessionSocket>socket, std::uint32_t session,
+                               RequestTracer::Clock::time_point enqueued, std::size_t client_slot,
+                               std::string client) {
+  if (enqueued != RequestTracer::Clock::time_point{}) {
+    tracer_.record(TraceSpan::PoolQueue, session, 0, RequestTracer::kNoCommand, enqueued, RequestTracer::Clock::now());
+  }
+  if (capture_) {
+    capture_->record(CaptureKind::Open, session);
+  }
+  SessionContext context(session, client_slot, client);
+  ConnectionReaper::Watch watch = reaper_.watch(socket->native_handle());
+  const auto write = [&socket, &watch, this](std::string_view response, std::string_view terminator) {
+    const std::array<boost::asio::const_buffer, 2> reply{boost::asio::buffer(response.data(), response.size()),
+                                                         boost::asio::buffer(terminator.data(), terminator.size())};
+    watch.expect(ConnectionReaper::Deadline::Write, session_limits_.write_timeout);
+    boost::asio::write(*socket, reply);
+  };
   try {
-    boost::asio::streambuf buf;
+    boost::asio::streambuf buf(session_limits_.max_request_bytes);  // read_until fails with not_found past it
+    std::string request;  // Keeps its capacity across requests
 
     while (true) {
       boost::system::error_code ec;
+      watch.expect(ConnectionReaper::Deadline::Idle, session_limits_.idle_timeout);
       std::size_t n = boost::asio::read_until(*socket,buf,"\n",ec);
       if (ec) {
-        if (ec == boost::asio::error::eof) {
-          std::cout << "Client disconected:" << std::endl;
+        if (ec == boost::asio::error::not_found) {
+          write(request_too_large(session), std::string_view());
+          break;
+        } else if (const auto deadline = watch.expired(); deadline != ConnectionReaper::Deadline::None) {
+          BOOKING_LOG(LogLevel::Info, "session_timed_out", {"session", session}, {"requests", context.sequence},
+                      {"deadline", ConnectionReaper::name(deadline)});
+          break;
+        } else if (ec == boost::asio::error::eof) {
+          BOOKING_LOG(LogLevel::Info, "session_closed", {"session", session}, {"requests", context.sequence});
           break;
         } else {
-          std::cerr << "Read error: " << ec.message() << std::endl;
+          BOOKING_LOG(LogLevel::Warn, "session_read_failed", {"session", session}, {"error", ec.message()});
           break;
         }
       }
       std::istream is(&buf);
-      std::string request;
       std::getline(is, request);
 
-      std::string response;
-      try {
-        response = process_request_json(request);
-      } catch (const std::exception &e) {
-        response = std::string("{\"error\":\"") + e.what() + "\"}";
+      std::optional<ShowingKey> subscription;
+      serve_request(context, request, subscription, write);
+      if (subscription) {
+        // The connection now only receives seat events; free this worker for other sessions
+        watch.reset();
+        seat_subscriptions_.subscribe(socket, *subscription);
+        BOOKING_LOG(LogLevel::Info, "session_subscribed", {"session", session}, {"requests", context.sequence},
+                    {"theater_id", subscription->theater_id}, {"movie_id", subscription->movie_id});
+        break;
       }
-      boost::asio::write(*socket, boost::asio::buffer(response + "\n"));
     }
 
   } catch (const std::exception& e) {
-    std::cerr << "Session error: " << e.what() << std::endl;
+    if (const auto deadline = watch.expired(); deadline != ConnectionReaper::Deadline::None) {
+      BOOKING_LOG(LogLevel::Info, "session_timed_out", {"session", session}, {"requests", context.sequence},
+                  {"deadline", ConnectionReaper::name(deadline)});
+    } else {
+      BOOKING_LOG(LogLevel::Error, "session_failed", {"session", session}, {"error", e.what()});
+    }
+  }
+  if (capture_) {
+    capture_->record(CaptureKind::Close, session);
   }
   // try {
   //   boost::asio::streambuf buf;
@@ -123,11 +748,93 @@ void TcpServer::handle_session(std::shared_ptr<boost::asio::ip::tcp::socket>sock
   // }
 }
 
+/**
+ * Session of a connection of the io_uring transport. Requests are served on the ring thread;
+ * their responses are queued on the connection and sent with the ring's next submission.
+ */
+class TcpServer::UringSession final : public UringTransport::Session {
+public:
+  UringSession(TcpServer& server, std::uint32_t id, std::size_t client_slot, std::string_view client)
+    : server_(server), context_(id, client_slot, client) {
+    if (server_.capture_) {
+      server_.capture_->record(CaptureKind::Open, id);
+    }
+  }
+
+  ~UringSession() override {
+    BOOKING_LOG(LogLevel::Info, "session_closed", {"session", context_.id}, {"requests", context_.sequence});
+    if (server_.capture_) {
+      server_.capture_->record(CaptureKind::Close, context_.id);
+    }
+    server_.metrics_.connection_closed();
+    server_.load_shedder_.close_session();
+  }
+
+  std::optional<ShowingKey> handle_line(const std::string& line, std::string& out) override {
+    std::optional<ShowingKey> subscription;
+    server_.serve_request(context_, line, subscription, [&out](std::string_view response, std::string_view terminator) {
+      out.append(response).append(terminator);
+    });
+    if (subscription) {
+      BOOKING_LOG(LogLevel::Info, "session_subscribed", {"session", context_.id}, {"requests", context_.sequence},
+                  {"theater_id", subscription->theater_id}, {"movie_id", subscription->movie_id});
+    }
+    return subscription;
+  }
+
+  void reject_line(std::string& out) override {
+    out.append(server_.request_too_large(context_.id));
+  }
+
+  void timed_out(ConnectionReaper::Deadline deadline) override {
+    BOOKING_LOG(LogLevel::Info, "session_timed_out", {"session", context_.id}, {"requests", context_.sequence},
+                {"deadline", ConnectionReaper::name(deadline)});
+  }
+
+private:
+  TcpServer& server_;
+  SessionContext context_;
+};
+
+std::unique_ptr<UringTransport::Session> TcpServer::open(std::string_view client, std::string& out) {
+  if (!load_shedder_.try_open_session()) {
+    metrics_.session_shed();
+    out = LoadShedder::overloaded_response();
+    return nullptr;
+  }
+  metrics_.connection_opened();
+  const std::uint32_t session = next_session_id_.fetch_add(1, std::memory_order_relaxed);
+  if (tracer_.sample()) {
+    const auto now = RequestTracer::Clock::now();
+    tracer_.record(TraceSpan::Accept, session, 0, RequestTracer::kNoCommand, now, now);
+  }
+  return std::make_unique<UringSession>(*this, session, load_shedder_.client_slot(client), client);
+}
+
+void TcpServer::hand_over(int fd, ShowingKey showing) {
+  boost::system::error_code ec;
+  auto socket = std::make_shared<SessionSocket>(acceptor_.get_executor());
+  socket->assign(SessionSocket::protocol_type(AF_INET, IPPROTO_TCP), fd, ec);
+  if (ec) {
+    BOOKING_LOG(LogLevel::Warn, "session_handover_failed", {"error", ec.message()});
+    ::close(fd);
+    return;
+  }
+  seat_subscriptions_.subscribe(std::move(socket), showing);
+}
+
+const std::string& TcpServer::request_too_large(std::uint32_t session) {
+  oversized_requests_.fetch_add(1, std::memory_order_relaxed);
+  BOOKING_LOG(LogLevel::Warn, "request_too_large", {"session", session}, {"max_bytes", session_limits_.max_request_bytes});
+  return request_too_large_response_;
+}
+
 std::string TcpServer::process_request(const std::string&request) {
   std::istringstream iss(request);
   std::string command_str;
   iss>> command_str;
-  CommandType command = parse_command(command_str);
+  const CommandSpec* spec = find_command(command_str);
+  CommandType command = spec ? spec->type : CommandType::Unknown;
 
   switch (command) {
     case (CommandType::ListMovies) : {
@@ -177,130 +884,519 @@ std::string TcpServer::process_request(const std::string&request) {
 
 
 std::string TcpServer::process_request_json(const std::string& request) {
+    thread_local RequestArena arena; // Callers without a session share their thread's arena
+    RequestRecorder recorder(metrics_);
+    return std::string(dispatch_request_json(request, arena, recorder));
+}
+
+std::string_view TcpServer::dispatch_request_json(std::string_view request, RequestArena& arena, RequestRecorder& recorder,
+                                                  std::optional<ShowingKey>* subscription, std::string_view client) {
+    arena.reset();
+    const json::storage_ptr sp = arena.storage(); // Request and response DOM live in the session's arena
     try {
+        if (const auto scanned = scan_request(request)) {
+            // The common request shapes skip the DOM; everything else takes the generic path below
+            const json::value response_json = handle_scanned(*scanned, recorder, sp);
+            recorder.end_phase(RequestPhase::Service);
+            const std::string_view response = arena.serialize(response_json);
+            recorder.end_phase(RequestPhase::Serialize);
+            return response;
+        }
+
         // Parse JSON request
-        json::value request_json = json::parse(request); // Parse the input hson into a BOOST JSON VALUE
+        json::value request_json = arena.parse(request); // Parse the input hson into a BOOST JSON VALUE
         
-        const std::string command = json::value_to<std::string>(request_json.at("command")); // Extract the command field as a string
-        json::value response_json;                               // prepare a variable for the response
+        const json::string_view command = request_json.at("command").as_string(); // Extract the command field
+        const CommandSpec* spec = find_command(command);        // Perfect hash lookup
+        const CommandType command_type = spec ? spec->type : CommandType::Unknown;
+        recorder.set_command(static_cast<std::size_t>(command_type));
+        if (spec) {
+            validate_arguments(request_json.as_object(), *spec);
+        }
+        recorder.end_phase(RequestPhase::Parse);
         
-        switch (parse_command(command)) {                   // string to enum
-            case CommandType::ListMovies: {
-                auto movies = booking_service_.get_all_movies();   // Get all movies from the booking service
-                json::array movies_array;                          // json array for movies
-                
-                for (const auto& m : movies) {
-                    movies_array.push_back(json::object{
-                        {"id", m.get_id()},
-                        {"name", m.get_name()}//,
-                        //{"duration", m.get_duration()}, 
-                        //{"rating", m.get_rating()}
-                    });
-                }
-                response_json = json::object{{"movies", movies_array}}; // Set the response
-                break;
+        if (!spec) {
+            recorder.end_phase(RequestPhase::Service);
+            const std::string_view response = arena.set_response(
+                {R"({"error":"UNKNOWN_COMMAND","received_command":)", json::serialize(command), unknown_command_tail()});
+            recorder.end_phase(RequestPhase::Serialize);
+            return response;
+        }
+        CommandResult result = execute_command(request_json.as_object(), command_type, client, sp, subscription);
+        if (!result.serialized.empty()) {
+            recorder.end_phase(RequestPhase::Service); // Serialized inside the dedup table
+            recorder.end_phase(RequestPhase::Serialize);
+            return arena.set_response(result.serialized);
+        }
+        const json::value response_json = std::move(result.response);
+        recorder.end_phase(RequestPhase::Service);
+        const std::string_view response = arena.serialize(response_json);
+        recorder.end_phase(RequestPhase::Serialize);
+        return response;
+        
+    } catch (const std::exception& e) {
+        // Handle JSON parsing errors or missing fields
+        if (subscription) {
+            subscription->reset(); // Only a SUBSCRIBED answer hands the connection over
+        }
+        recorder.end_phase(RequestPhase::Service);
+        const std::string_view response = arena.set_response(
+            {R"({"error":"INVALID_REQUEST","message":)", json::serialize(json::string_view(e.what())), invalid_request_tail()});
+        recorder.end_phase(RequestPhase::Serialize);
+        return response;
+    }
+}
+
+TcpServer::CommandResult TcpServer::execute_command(const json::object& request, CommandType command_type,
+                                                   std::string_view client, const json::storage_ptr& sp,
+                                                   std::optional<ShowingKey>* subscription) {
+    json::value response_json(sp);
+    switch (command_type) {                   // string to enum
+        case CommandType::ListMovies: {
+            const std::uint64_t version = booking_service_.get_catalog_version();
+            if (auto unchanged = not_modified(request, version)) {
+                return CommandResult{json::value(sp), std::move(*unchanged)};
             }
-            
-            case CommandType::ListTheaters: {
-                int movie_id = request_json.at("movie_id").as_int64();  // Get movie if from the request
-                auto theaters = booking_service_.get_theaters_showing_movie(movie_id); // Get theaters showing movie from the service
-                
-                json::array theaters_array;
-                for (const auto& t : theaters) {
-                    theaters_array.push_back(json::object{
-                        {"id", t->get_id()},
-                        {"name", t->get_name()}//,
-                        // {"location", t->getLocation()},
-                        // {"capacity", t->getCapacity()}
-                    });
-                }
-                response_json = json::object{{"theaters", theaters_array}}; // set the response to contain theaters array
+            response_json = movies_page_response(booking_service_, parse_catalog_query(request), parse_fields(request),
+                                                 version, sp);
+            break;
+        }
+        
+        case CommandType::ListTheaters: {
+            int movie_id = request.at("movie_id").as_int64();  // Get movie if from the request
+            const std::uint64_t version = booking_service_.get_catalog_version();
+            if (auto unchanged = not_modified(request, version)) {
+                return CommandResult{json::value(sp), std::move(*unchanged)};
+            }
+            response_json = theaters_page_response(booking_service_, movie_id, parse_catalog_query(request),
+                                                   parse_fields(request), version, sp);
+            break;
+        }
+        
+        case CommandType::ListSeats: {
+            int theater_id = request.at("theater_id").as_int64();
+            int movie_id = request.at("movie_id").as_int64();
+            const auto version = booking_service_.get_seat_version(theater_id, movie_id);
+            if (!version) {
+                throw std::invalid_argument("Showing not found"); // Before if_version: nothing to be unchanged
+            }
+            if (auto unchanged = not_modified(request, *version)) {
+                return CommandResult{json::value(sp), std::move(*unchanged)}; // Seat lock not taken
+            }
+            const auto* format = request.if_contains("format");
+            if (!format || format->as_string() == "list") {
+                response_json = available_seats_response(booking_service_, theater_id, movie_id, *version, sp);
                 break;
             }
-            
-            case CommandType::ListSeats: {
-                int theater_id = request_json.at("theater_id").as_int64();
-                int movie_id = request_json.at("movie_id").as_int64();
-                auto seats = booking_service_.get_available_seats(theater_id, movie_id);
-                
-                json::array seats_array;
-                for (const auto& s : seats) {
-                    seats_array.push_back(json::value(s));           /////////// NOTA
+            response_json = seat_map_response(booking_service_, theater_id, movie_id, format->as_string(),
+                                              request.if_contains("layout_version"), sp);
+            break;
+        }
+        
+        case CommandType::Book: {
+            const int theater_id = request.at("theater_id").as_int64();
+            const int movie_id = request.at("movie_id").as_int64();
+            // Thrown out of the dedup computation so that NOT_ADMITTED is never replayed for a request_id
+            struct NotAdmitted { json::value response; };
+            // An admitted queue_token is used up by the booking, and given back if the booking failed
+            auto admit_and_book = [&](const std::vector<std::string>& seats, const json::value* request_id) {
+                std::string claimed;
+                if (auto rejection = check_admission(theater_id, movie_id, request.if_contains("queue_token"), &claimed)) {
+                    throw NotAdmitted{std::move(*rejection)};
                 }
-                response_json = json::object{
-                    {"theater_id", theater_id},
-                    {"movie_id", movie_id},
-                    {"available_seats", seats_array},
-                    {"total_available", seats.size()}
-                };
-                break;
+                json::value response = handle_book(theater_id, movie_id, seats, request_id, sp);
+                if (!claimed.empty() && response.at("status").as_string() != "BOOKED") {
+                    waiting_room_.release(theater_id, movie_id, claimed);
+                }
+                return response;
+            };
+            try {
+                if (const auto* request_id = request.if_contains("request_id")) {
+                    // Retries with the same request_id replay the first response instead of booking again.
+                    // Ids are per client (a peer address never holds '/'), and bound to the booking they named.
+                    const std::vector<std::string> seats = seat_list(request);
+                    std::string fingerprint = std::to_string(theater_id) + ':' + std::to_string(movie_id);
+                    for (const auto& seat : seats) {
+                        // Length-prefixed: seat ids are client strings and may contain ':' themselves
+                        fingerprint.append(1, ':').append(std::to_string(seat.size())).append(1, ':').append(seat);
+                    }
+                    auto replay = booking_dedup_.get_or_compute(
+                        std::string(client) + '/' + json::value_to<std::string>(*request_id), fingerprint, [&]() {
+                            return json::serialize(admit_and_book(seats, request_id)) + "\n";
+                        });
+                    if (!replay) {
+                        response_json = json::object({{"error", "REQUEST_ID_CONFLICT"}, {"request_id", *request_id},
+                                                      {"message", "request_id was already used for a different booking"}}, sp);
+                        break;
+                    }
+                    return CommandResult{json::value(sp), std::move(*replay)};
+                }
+                response_json = admit_and_book(seat_list(request), nullptr);
+            } catch (NotAdmitted& rejection) {
+                response_json = std::move(rejection.response); // The client retries once admitted
             }
-            
-            case CommandType::Book: {
-                int theater_id = request_json.at("theater_id").as_int64();
-                int movie_id = request_json.at("movie_id").as_int64();
-                
-                json::array seats_json = request_json.at("seats").as_array();
-                std::vector<std::string> seats;
-                for (const auto& seat : seats_json) {
-                    seats.push_back(json::value_to<std::string>(seat)); // convert json value to string and  push to vector
+            break;
+        }
+        
+        case CommandType::SearchMovies: {
+            const std::string query = json::value_to<std::string>(request.at("query"));
+            std::size_t limit = kDefaultSearchLimit;
+            if (const auto* requested = request.if_contains("limit")) {
+                if (requested->as_int64() <= 0) {
+                    throw std::invalid_argument("limit must be a positive integer");
                 }
-                
-                bool success = booking_service_.book_seats(theater_id, movie_id, seats);
-                
-                response_json = json::object{
-                    {"status", success ? "BOOKED" : "FAILED"},
-                    {"theater_id", theater_id},
-                    {"movie_id", movie_id},
-                    {"seats", seats_json},
-                    {"timestamp", std::time(nullptr)}
-                    //,{"confirmation", generate_confirmation_code()} // Optional
-                };
+                limit = std::min<std::size_t>(static_cast<std::size_t>(requested->as_int64()), kMaxPageSize);
+            }
+            auto movies = booking_service_.search_movies(query, limit);
+            auto fields = parse_fields(request);
+
+            json::array movies_array(sp);
+            movies_array.reserve(movies.size());
+            for (const auto& m : movies) {
+                movies_array.push_back(catalog_entry(m.get_id(), m.get_name(), fields, sp));
+            }
+            response_json = json::object({
+                {"query", query},
+                {"movies", std::move(movies_array)}
+            }, sp);
+            break;
+        }
+        
+        case CommandType::LookupBooking: {
+            const std::string code = json::value_to<std::string>(request.at("confirmation"));
+            auto booking = booking_service_.lookup_booking(code);
+            if (!booking) {
+                response_json = json::object({{"status", "NOT_FOUND"}, {"confirmation", code}}, sp);
                 break;
             }
-            
-            default: {
-                response_json = json::object{
-                    {"error", "UNKNOWN_COMMAND"},
-                    {"received_command", command},
-                    {"valid_commands", json::array{"LIST_MOVIES", "LIST_THEATERS", "LIST_SEATS", "BOOK"}}
-                };
+            json::array seats_array(sp);
+            seats_array.reserve(booking->seat_ids.size());
+            for (const auto& s : booking->seat_ids) {
+                seats_array.emplace_back(json::string_view(s));
+            }
+            response_json = json::object({
+                {"status", "FOUND"},
+                {"confirmation", booking->confirmation_code},
+                {"theater_id", booking->theater_id},
+                {"movie_id", booking->movie_id},
+                {"seats", std::move(seats_array)},
+                {"timestamp", booking->timestamp}
+            }, sp);
+            break;
+        }
+        
+        case CommandType::Cancel: {
+            const std::string code = json::value_to<std::string>(request.at("confirmation"));
+            bool cancelled = booking_service_.cancel_booking(code);
+            response_json = json::object({
+                {"status", cancelled ? "CANCELLED" : "NOT_FOUND"},
+                {"confirmation", code}
+            }, sp);
+            break;
+        }
+        
+        case CommandType::JoinQueue: {
+            int theater_id = request.at("theater_id").as_int64();
+            int movie_id = request.at("movie_id").as_int64();
+            // Cursor lookup on the showing index, the seat inventory is not touched
+            CatalogQuery showing;
+            if (theater_id != std::numeric_limits<int>::min()) {
+                showing.after_id = theater_id - 1; // INT_MIN is the first id anyway: no cursor
+            }
+            showing.limit = 1;
+            auto page = booking_service_.get_theaters_page(movie_id, showing);
+            if (page.items.empty() || page.items.front()->get_id() != theater_id) {
+                throw std::invalid_argument("Showing not found");
+            }
+            auto ticket = waiting_room_.join(theater_id, movie_id);
+            if (!ticket) {
+                response_json = json::object({{"status", "QUEUE_FULL"}, {"theater_id", theater_id}, {"movie_id", movie_id}}, sp);
                 break;
             }
+            json::object response = queue_status_entry(theater_id, movie_id, ticket->status, sp);
+            response.emplace("queue_token", ticket->token);
+            response_json = std::move(response);
+            break;
         }
         
-        return json::serialize(response_json) + "\n";
+        case CommandType::QueueStatus: {
+            int theater_id = request.at("theater_id").as_int64();
+            int movie_id = request.at("movie_id").as_int64();
+            const std::string token = json::value_to<std::string>(request.at("queue_token"));
+            response_json = queue_status_entry(theater_id, movie_id, waiting_room_.status(theater_id, movie_id, token), sp);
+            break;
+        }
+        
+        case CommandType::Stats: {
+            response_json = stats_json();
+            break;
+        }
+        
+        case CommandType::Batch: {
+            response_json = handle_batch(request, client, sp);
+            break;
+        }
+        
+        case CommandType::SubscribeSeats: {
+            if (!subscription) {
+                throw std::invalid_argument("SUBSCRIBE_SEATS must be sent on its own over a connection");
+            }
+            const int theater_id = request.at("theater_id").as_int64();
+            const int movie_id = request.at("movie_id").as_int64();
+            if (booking_service_.get_seat_map(theater_id, movie_id).layout.seat_count == 0) {
+                throw std::invalid_argument("Showing not found");
+            }
+            if (!seat_subscriptions_.has_capacity()) {
+                response_json = json::object({{"status", "SUBSCRIPTIONS_FULL"}, {"theater_id", theater_id}, {"movie_id", movie_id}}, sp);
+                break;
+            }
+            *subscription = ShowingKey{theater_id, movie_id};
+            response_json = json::object({
+                {"status", "SUBSCRIBED"},
+                {"theater_id", theater_id},
+                {"movie_id", movie_id},
+                {"window_ms", seat_subscriptions_.window().count()}
+            }, sp);
+            break;
+        }
         
+        case CommandType::Unknown: {
+            response_json = json::object({{"error", "UNKNOWN_COMMAND"}, {"received_command", request.at("command")}}, sp);
+            break;
+        }
+    }
+    return CommandResult{std::move(response_json), {}};
+}
+
+json::value TcpServer::handle_scanned(const ScannedRequest& request, RequestRecorder& recorder,
+                                      const json::storage_ptr& sp) {
+    switch (request.command) {
+        case ScannedCommand::ListMovies:
+            recorder.set_command(static_cast<std::size_t>(CommandType::ListMovies));
+            recorder.end_phase(RequestPhase::Parse);
+            return movies_page_response(booking_service_, CatalogQuery{}, FieldSelection{},
+                                        booking_service_.get_catalog_version(), sp);
+        case ScannedCommand::ListTheaters:
+            recorder.set_command(static_cast<std::size_t>(CommandType::ListTheaters));
+            recorder.end_phase(RequestPhase::Parse);
+            return theaters_page_response(booking_service_, request.movie_id, CatalogQuery{}, FieldSelection{},
+                                          booking_service_.get_catalog_version(), sp);
+        case ScannedCommand::ListSeats: {
+            recorder.set_command(static_cast<std::size_t>(CommandType::ListSeats));
+            recorder.end_phase(RequestPhase::Parse);
+            const auto version = booking_service_.get_seat_version(request.theater_id, request.movie_id);
+            if (!version) {
+                throw std::invalid_argument("Showing not found");
+            }
+            return available_seats_response(booking_service_, request.theater_id, request.movie_id, *version, sp);
+        }
+        case ScannedCommand::Book:
+            break;
+    }
+    recorder.set_command(static_cast<std::size_t>(CommandType::Book));
+    recorder.end_phase(RequestPhase::Parse);
+    if (auto rejection = check_admission(request.theater_id, request.movie_id, nullptr)) {
+        return std::move(*rejection);
+    }
+    const std::vector<std::string> seats(request.seats.begin(), request.seats.begin() + request.seat_count);
+    return handle_book(request.theater_id, request.movie_id, seats, nullptr, sp);
+}
+
+json::value TcpServer::handle_book(int theater_id, int movie_id, const std::vector<std::string>& seats,
+                                   const json::value* request_id, const json::storage_ptr& sp) {
+    auto booking = booking_service_.create_booking(theater_id, movie_id, seats);
+    metrics_.booking_result(booking.has_value());
+    return booking_response(theater_id, movie_id, seats, booking ? &*booking : nullptr, request_id, sp);
+}
+
+json::value TcpServer::handle_batch(const json::object& request, std::string_view client, const json::storage_ptr& sp) {
+    const json::array& entries = request.at("requests").as_array();
+    if (entries.empty() || entries.size() > kMaxBatchSize) {
+        throw std::invalid_argument("requests must hold 1 to " + std::to_string(kMaxBatchSize) + " commands");
+    }
+    if (const auto* atomic = request.if_contains("atomic"); atomic && atomic->as_bool()) {
+        return handle_atomic_batch(entries, sp);
+    }
+    json::array responses(sp);
+    responses.reserve(entries.size());
+    for (const auto& entry : entries) {
+        responses.push_back(batch_entry_response(entry.as_object(), client, sp));
+    }
+    return json::object({{"responses", std::move(responses)}}, sp);
+}
+
+json::value TcpServer::batch_entry_response(const json::object& entry, std::string_view client,
+                                            const json::storage_ptr& sp) {
+    try {
+        const auto* command = entry.if_contains("command");
+        if (!command || !command->is_string()) {
+            throw std::invalid_argument("missing field: command");
+        }
+        const CommandSpec* spec = find_command(command->as_string());
+        if (spec && spec->type == CommandType::Batch) {
+            throw std::invalid_argument("BATCH cannot be nested");
+        }
+        if (spec) {
+            validate_arguments(entry, *spec);
+        }
+        CommandResult result = execute_command(entry, spec ? spec->type : CommandType::Unknown, client, sp);
+        if (!result.serialized.empty()) {
+            return json::parse(without_newlines(result.serialized), sp); // Replayed BOOK
+        }
+        return std::move(result.response);
     } catch (const std::exception& e) {
-        // Handle JSON parsing errors or missing fields
-        return json::serialize(json::object{
-            {"error", "INVALID_REQUEST"},
-            {"message", e.what()},
-            {"sample_format", get_sample_format()} // Helper function shown below
-        }) + "\n";
+        // One bad entry does not fail its neighbours; no sample_format per entry
+        return json::object({{"error", "INVALID_REQUEST"}, {"message", e.what()}}, sp);
     }
 }
 
-// Helper function for error messages
-json::value TcpServer::get_sample_format() {
-    return json::object{
-        {"LIST_MOVIES", json::object{{"command", "LIST_MOVIES"}}},
-        {"LIST_THEATERS", json::object{
-            {"command", "LIST_THEATERS"},
-            {"movie_id", 123}
+json::value TcpServer::handle_atomic_batch(const json::array& entries, const json::storage_ptr& sp) {
+    const CommandSpec& book = kCommands[static_cast<std::size_t>(CommandType::Book)];
+    std::vector<BookingRequest> requests;
+    requests.reserve(entries.size());
+    std::vector<const json::value*> tokens;
+    tokens.reserve(entries.size());
+    for (const auto& value : entries) {
+        const json::object& entry = value.as_object();
+        const auto* command = entry.if_contains("command");
+        if (!command || !command->is_string() || command->as_string() != book.name) {
+            throw std::invalid_argument("atomic batches may only hold BOOK commands");
+        }
+        validate_arguments(entry, book);
+        if (entry.contains("request_id")) {
+            throw std::invalid_argument("request_id is not supported in atomic batches");
+        }
+        requests.push_back(BookingRequest{static_cast<int>(entry.at("theater_id").as_int64()),
+                                          static_cast<int>(entry.at("movie_id").as_int64()), seat_list(entry)});
+        tokens.push_back(entry.if_contains("queue_token"));
+    }
+
+    // Every entry is valid: claim the queue tokens, and give them all back unless everything books
+    std::vector<std::string> claimed(requests.size());
+    auto release_claimed = [&]() {
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+            if (!claimed[i].empty()) {
+                waiting_room_.release(requests[i].theater_id, requests[i].movie_id, claimed[i]);
+            }
+        }
+    };
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        if (auto rejection = check_admission(requests[i].theater_id, requests[i].movie_id, tokens[i], &claimed[i])) {
+            release_claimed();
+            rejection->as_object()["index"] = i; // Nothing booked yet
+            return std::move(*rejection);
+        }
+    }
+
+    const auto bookings = booking_service_.book_all_or_nothing(requests);
+    if (!bookings) {
+        release_claimed();
+    }
+    json::array responses(sp);
+    responses.reserve(requests.size());
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        metrics_.booking_result(bookings.has_value());
+        responses.push_back(booking_response(requests[i].theater_id, requests[i].movie_id, requests[i].seat_ids,
+                                             bookings ? &(*bookings)[i] : nullptr, nullptr, sp));
+    }
+    return json::object({{"status", bookings ? "BOOKED" : "FAILED"}, {"responses", std::move(responses)}}, sp);
+}
+
+json::value TcpServer::booking_response(int theater_id, int movie_id, const std::vector<std::string>& seats,
+                                        const Booking* booking, const json::value* request_id,
+                                        const json::storage_ptr& sp) {
+    json::object response({
+        {"status", booking ? "BOOKED" : "FAILED"},
+        {"theater_id", theater_id},
+        {"movie_id", movie_id},
+        {"seats", string_array(seats, sp)},
+        {"timestamp", booking ? booking->timestamp : std::time(nullptr)}
+    }, sp);
+    if (booking) {
+        response.emplace("confirmation", booking->confirmation_code);
+    }
+    if (request_id) {
+        response.emplace("request_id", *request_id);
+    }
+    return response;
+}
+
+json::value TcpServer::stats_json() const {
+    const ServerMetrics::Snapshot stats = metrics_.snapshot();
+    const std::uint64_t attempts = stats.bookings_succeeded + stats.bookings_failed;
+
+    json::object commands;
+    for (const auto& command : stats.commands) {
+        json::object latency;
+        for (std::size_t phase = 0; phase < kRequestPhaseCount; ++phase) {
+            const auto& p = command.phases[phase];
+            latency.emplace(kPhaseKeys[phase], json::object{
+                {"samples", p.samples},
+                {"mean", to_us(p.mean)},
+                {"p50", to_us(p.p50)},
+                {"p90", to_us(p.p90)},
+                {"p99", to_us(p.p99)},
+                {"p999", to_us(p.p999)},
+                {"max", to_us(p.max)}
+            });
+        }
+        commands.emplace(command.name, json::object{{"requests", command.requests}, {"latency_us", std::move(latency)}});
+    }
+
+    json::object response{
+        {"uptime_s", stats.uptime_s},
+        {"sample_period", stats.sample_period},
+        {"connections", json::object{{"active", stats.connections_active}, {"total", stats.connections_total}}},
+        {"shed", json::object{{"requests", stats.requests_shed}, {"sessions", stats.sessions_shed}}},
+        {"subscriptions", json::object{{"active", seat_subscriptions_.active()}}},
+        {"transport", uring_ ? "io_uring" : "asio"},
+        {"timeouts", json::object{
+            {"idle", reaper_.expired_total(ConnectionReaper::Deadline::Idle)},
+            {"write", reaper_.expired_total(ConnectionReaper::Deadline::Write)}
         }},
-        {"LIST_SEATS", json::object{
-            {"command", "LIST_SEATS"},
-            {"theater_id", 456},
-            {"movie_id", 789}
+        {"oversized_requests", oversized_requests_.load(std::memory_order_relaxed)},
+        {"bookings", json::object{
+            {"succeeded", stats.bookings_succeeded},
+            {"failed", stats.bookings_failed},
+            {"success_ratio", attempts ? static_cast<double>(stats.bookings_succeeded) / attempts : 0.0}
         }},
-        {"BOOK", json::object{
-            {"command", "BOOK"},
-            {"theater_id", 456},
-            {"movie_id", 789},
-            {"seats", json::array{{"A1", "A2", "B3"}}
-        }}}
+        {"commands", std::move(commands)}
     };
+    if constexpr (kLockProfilingEnabled) {
+        response.emplace("lock_contention", lock_contention_entry());
+    }
+    return response;
+}
+
+std::optional<json::value> TcpServer::check_admission(int theater_id, int movie_id, const json::value* token,
+                                                      std::string* claimed_token) {
+    QueueStatus status;
+    if (token) {
+        std::string value = json::value_to<std::string>(*token);
+        status = waiting_room_.claim(theater_id, movie_id, value);
+        if (status.state == AdmissionState::Admitted) {
+            if (claimed_token) {
+                *claimed_token = std::move(value);
+            }
+            return std::nullopt;
+        }
+    }
+    // Without a queue to jump, a missing, stale or unusable token is no reason to turn the client away
+    if (!waiting_room_.is_backlogged(theater_id, movie_id)) {
+        return std::nullopt;
+    }
+    if (!token) {
+        return json::value(json::object{
+            {"status", "NOT_ADMITTED"},
+            {"reason", "QUEUE_REQUIRED"},
+            {"theater_id", theater_id},
+            {"movie_id", movie_id}
+        });
+    }
+    json::object response = queue_status_entry(theater_id, movie_id, status);
+    response["reason"] = admission_state_name(status.state);
+    response["status"] = "NOT_ADMITTED";
+    return json::value(std::move(response));
 }
 
 
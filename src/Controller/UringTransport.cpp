@@ -0,0 +1,815 @@
+#include "Controller/UringTransport.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <sys/utsname.h>
+
+#ifdef BOOKING_IO_URING
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "Utils/Logger.h"
+#endif
+
+namespace {
+
+// Release of the running kernel as major * 100 + minor, e.g. 601 for 6.1
+int kernel_version() {
+  utsname name{};
+  int major = 0;
+  int minor = 0;
+  if (::uname(&name) != 0 || std::sscanf(name.release, "%d.%d", &major, &minor) != 2) {
+    return 0;
+  }
+  return major * 100 + minor;
+}
+
+}  // namespace
+
+bool UringTransport::available(std::string* reason) {
+  const char* why = nullptr;
+  if (!kIoUringCompiled) {
+    why = "built without BOOKING_IO_URING";
+  } else if (kernel_version() < 600) {
+    why = "kernel older than 6.0, no multishot receive";
+  }
+  if (why && reason) {
+    *reason = why;
+  }
+  return why == nullptr;
+}
+
+#ifdef BOOKING_IO_URING
+
+namespace {
+
+// liburing is not a dependency: the three system calls are all the transport needs
+int io_uring_setup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int fd, unsigned opcode, void* arg, unsigned count) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+std::runtime_error errno_error(const std::string& what) {
+  return std::runtime_error("io_uring transport: " + what + ": " + std::strerror(errno));
+}
+
+/// What a completion belongs to, in the upper half of its user_data; the lower half is a connection id
+enum class Op : std::uint32_t { Accept = 1, Wake, Receive, Send, Cancel, Provide, Probe };
+
+constexpr std::uint64_t user_data(Op op, std::uint32_t id = 0) {
+  return static_cast<std::uint64_t>(op) << 32 | id;
+}
+
+// Listening socket on the port; SO_REUSEPORT lets every ring bind its own
+int listen_on(unsigned short port) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw errno_error("socket");
+  }
+  const int on = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0 ||
+      ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    const int error = errno;
+    ::close(fd);
+    errno = error;
+    throw errno_error("bind port " + std::to_string(port));
+  }
+  return fd;
+}
+
+unsigned short bound_port(int fd) {
+  sockaddr_in address{};
+  socklen_t length = sizeof(address);
+  ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+  return ntohs(address.sin_port);
+}
+
+std::string peer_address(int fd) {
+  sockaddr_in address{};
+  socklen_t length = sizeof(address);
+  char text[INET_ADDRSTRLEN] = "";
+  if (::getpeername(fd, reinterpret_cast<sockaddr*>(&address), &length) == 0) {
+    ::inet_ntop(AF_INET, &address.sin_addr, text, sizeof(text));
+  }
+  return text;
+}
+
+template <typename T>
+T* at(void* base, std::uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+}  // namespace
+
+/**
+ * One ring, its thread, its listener and the connections it accepted. Everything but
+ * start() and stop() runs on the ring thread, which is the only submitter. A failed system
+ * call or an inconsistent submission queue is fatal to the ring: it logs io_uring_ring_failed,
+ * closes its listener and connections and leaves the port to the other rings.
+ */
+class UringTransport::Ring {
+public:
+  Ring(Handler& handler, ConnectionReaper& reaper, const SessionLimits& limits, int listen_fd)
+    : handler_(handler), reaper_(reaper), limits_(limits), listen_fd_(listen_fd) {
+    try {
+      setup();
+    } catch (...) {
+      release();
+      throw;
+    }
+  }
+
+  ~Ring() {
+    stop();
+    release();
+  }
+
+  /**
+   * Start the ring thread and wait until it has enabled the ring and chosen how to hand
+   * buffers back; throws std::runtime_error, with the thread stopped, if that failed
+   */
+  void start() {
+    std::promise<void> ready;
+    std::future<void> started = ready.get_future();
+    thread_ = std::thread([this, &ready]() { run(ready); });
+    try {
+      started.get();
+    } catch (...) {
+      thread_.join();
+      throw;
+    }
+  }
+
+  void stop() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    stopping_.store(true, std::memory_order_release);
+    ::eventfd_write(wake_fd_, 1);
+    thread_.join();
+  }
+
+private:
+  struct Connection {
+    Connection(int fd, ConnectionReaper::Watch watch) : fd(fd), watch(std::move(watch)) {}
+    ~Connection() {
+      watch.reset();  // Before the descriptor can be reused
+      if (fd >= 0) ::close(fd);
+    }
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    int fd;                                 ///< -1 once handed over
+    ConnectionReaper::Watch watch;
+    std::unique_ptr<Session> session;       ///< Null for a refused connection
+    std::string input;                      ///< Received bytes after the last complete line
+    std::string pending;                    ///< Responses not yet handed to the kernel
+    std::string sending;                    ///< Bytes of the send in flight
+    std::size_t sent = 0;
+    bool receiving = false;                 ///< Multishot receive armed
+    bool send_in_flight = false;
+    bool closing = false;                   ///< No more requests are read
+    bool paused = false;                    ///< Not reading until the output backlog drains
+    std::optional<ShowingKey> handoff;      ///< Hand over instead of closing
+  };
+
+  void setup() {
+    // Single issuer with deferred task work: completions are processed only when the ring
+    // thread asks for them. The ring starts disabled so that thread, not this one, becomes
+    // its submitter. Kernels before 6.1 take the plain setup.
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_R_DISABLED | IORING_SETUP_SINGLE_ISSUER |
+                   IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = kQueueDepth * 4;
+    fd_ = io_uring_setup(kQueueDepth, &params);
+    if (fd_ < 0 && errno == EINVAL) {
+      params = io_uring_params{};
+      params.flags = IORING_SETUP_CQSIZE;
+      params.cq_entries = kQueueDepth * 4;
+      fd_ = io_uring_setup(kQueueDepth, &params);
+    }
+    if (fd_ < 0) {
+      throw errno_error("io_uring_setup");
+    }
+    disabled_ = (params.flags & IORING_SETUP_R_DISABLED) != 0;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+      throw std::runtime_error("io_uring transport: kernel lacks IORING_FEAT_SINGLE_MMAP");
+    }
+
+    rings_size_ = std::max<std::size_t>(params.sq_off.array + params.sq_entries * sizeof(std::uint32_t),
+                                        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    rings_ = ::mmap(nullptr, rings_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (rings_ == MAP_FAILED) {
+      throw errno_error("mmap rings");
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(
+        ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+      throw errno_error("mmap sqes");
+    }
+    sq_head_ = at<std::uint32_t>(rings_, params.sq_off.head);
+    sq_tail_ = at<std::uint32_t>(rings_, params.sq_off.tail);
+    sq_mask_ = *at<std::uint32_t>(rings_, params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    auto* sq_array = at<std::uint32_t>(rings_, params.sq_off.array);
+    for (std::uint32_t i = 0; i < sq_entries_; ++i) {
+      sq_array[i] = i;  // SQEs are used in order, so the indirection is the identity
+    }
+    cq_head_ = at<std::uint32_t>(rings_, params.cq_off.head);
+    cq_tail_ = at<std::uint32_t>(rings_, params.cq_off.tail);
+    cq_mask_ = *at<std::uint32_t>(rings_, params.cq_off.ring_mask);
+    cqes_ = at<io_uring_cqe>(rings_, params.cq_off.cqes);
+    sq_local_tail_ = *sq_tail_;
+
+    register_buffer_ring();
+    buffers_ = std::make_unique<char[]>(kBuffers * kBufferSize);
+    for (std::uint16_t id = 0; id < kBuffers; ++id) {
+      recycle(id);
+    }
+
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+      throw errno_error("eventfd");
+    }
+  }
+
+  /**
+   * Register the provided buffer ring. The kernel allocates it (IOU_PBUF_RING_MMAP, 6.4 and
+   * later) and the ring maps it, so both sides share the same pages. Older kernels get an
+   * anonymous shared mapping that is faulted in before the kernel pins it.
+   */
+  void register_buffer_ring() {
+    buffer_ring_size_ = kBuffers * sizeof(io_uring_buf);
+    BufferRingRegistration registration{};
+    registration.ring_entries = kBuffers;
+    registration.bgid = kBufferGroup;
+    registration.flags = kPbufRingMmap;
+    void* buffer_ring = MAP_FAILED;
+    if (io_uring_register(fd_, IORING_REGISTER_PBUF_RING, &registration, 1) == 0) {
+      buffer_ring = ::mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                           kOffPbufRing | (static_cast<std::uint64_t>(kBufferGroup) << kOffPbufShift));
+      if (buffer_ring == MAP_FAILED) {
+        throw errno_error("mmap provided buffer ring");
+      }
+    } else if (errno == EINVAL) {
+      buffer_ring = ::mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+      if (buffer_ring == MAP_FAILED) {
+        throw errno_error("mmap buffer ring");
+      }
+      std::memset(buffer_ring, 0, buffer_ring_size_);  // Fault the pages in before the kernel pins them
+      registration.ring_addr = reinterpret_cast<std::uint64_t>(buffer_ring);
+      registration.flags = 0;
+      if (io_uring_register(fd_, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        const int error = errno;
+        ::munmap(buffer_ring, buffer_ring_size_);
+        errno = error;
+        throw errno_error("register provided buffer ring");
+      }
+    } else {
+      throw errno_error("register provided buffer ring");
+    }
+    buffer_ring_ = static_cast<io_uring_buf_ring*>(buffer_ring);
+    const auto overlaps = [this](const void* start, std::size_t size) {
+      const auto* ring = reinterpret_cast<const char*>(buffer_ring_);
+      const auto* other = static_cast<const char*>(start);
+      return ring < other + size && other < ring + buffer_ring_size_;
+    };
+    if (overlaps(rings_, rings_size_) || overlaps(sqes_, sqes_size_)) {
+      throw std::runtime_error("io_uring transport: buffer ring overlaps the submission rings");
+    }
+  }
+
+  void release() {
+    if (fd_ >= 0) ::close(fd_);  // Cancels whatever is still armed, before its buffers are freed
+    connections_.clear();
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+    if (buffer_ring_) ::munmap(buffer_ring_, buffer_ring_size_);
+    if (sqes_ && sqes_ != MAP_FAILED) ::munmap(sqes_, sqes_size_);
+    if (rings_ && rings_ != MAP_FAILED) ::munmap(rings_, rings_size_);
+    if (listen_fd_ >= 0) ::close(listen_fd_);
+    wake_fd_ = fd_ = listen_fd_ = -1;
+    buffer_ring_ = nullptr;
+    sqes_ = nullptr;
+    rings_ = nullptr;
+  }
+
+  void run(std::promise<void>& ready) {
+    if (disabled_ && io_uring_register(fd_, IORING_REGISTER_ENABLE_RINGS, nullptr, 0) < 0) {
+      ready.set_exception(std::make_exception_ptr(errno_error("enable ring")));
+      return;
+    }
+    if (!buffer_ring_delivers()) {
+      use_provide_buffers();
+    }
+    if (failed_) {
+      ready.set_exception(std::make_exception_ptr(std::runtime_error("io_uring transport: ring failed on start")));
+      return;
+    }
+    ready.set_value();
+    arm_accept();
+    arm_wake();
+    while (!stopping_.load(std::memory_order_acquire) && !failed_) {
+      // Submits every send queued by the previous batch and waits for the next one
+      if (!submit(1)) {
+        break;
+      }
+      reap();
+    }
+
+    // Unblock every connection's operations, then wait until the kernel is done with their buffers
+    for (auto& [id, connection] : connections_) {
+      connection.closing = true;
+      connection.handoff.reset();
+      connection.pending.clear();
+      ::shutdown(connection.fd, SHUT_RDWR);
+    }
+    if (failed_) {
+      // The kernel can no longer be driven: stop taking connections and leave the rest to release()
+      ::close(std::exchange(listen_fd_, -1));
+      return;
+    }
+    std::erase_if(connections_, [](const auto& entry) {
+      return !entry.second.receiving && !entry.second.send_in_flight;
+    });
+    while (!connections_.empty() && submit(1)) {
+      reap();
+    }
+  }
+
+  /// Mark the ring failed and log why, once; the ring thread then winds down
+  void fail(const char* what, const char* error) {
+    if (!failed_) {
+      failed_ = true;
+      BOOKING_LOG(LogLevel::Error, "io_uring_ring_failed", {"operation", what}, {"error", error});
+    }
+  }
+
+  /// SQEs filled but not yet consumed by the kernel; more than the queue holds means the head is corrupt
+  bool queued(std::uint32_t& count) {
+    count = sq_local_tail_ - std::atomic_ref<std::uint32_t>(*sq_head_).load(std::memory_order_acquire);
+    if (count > sq_entries_) {
+      fail("submission queue", "head ahead of tail");
+      return false;
+    }
+    return true;
+  }
+
+  /// Hand queued SQEs to the kernel and, if wait is set, wait for that many completions
+  bool submit(unsigned wait) {
+    if (failed_) {
+      return false;
+    }
+    std::atomic_ref<std::uint32_t>(*sq_tail_).store(sq_local_tail_, std::memory_order_release);
+    while (true) {
+      std::uint32_t count = 0;
+      if (!queued(count)) {
+        return false;
+      }
+      if (io_uring_enter(fd_, count, wait, wait ? IORING_ENTER_GETEVENTS : 0) >= 0 || errno == EBUSY) {
+        return true;  // EBUSY: completions to reap first
+      }
+      if (errno != EINTR) {
+        fail("io_uring_enter", std::strerror(errno));
+        return false;
+      }
+    }
+  }
+
+  /// Next free SQE, cleared; once the ring has failed, a scratch entry that is never submitted
+  io_uring_sqe* next_sqe() {
+    std::uint32_t count = 0;
+    while (!failed_ && queued(count) && count == sq_entries_) {
+      // Queue full: submit without waiting. The kernel must take some entries, or the ring is stuck.
+      if (submit(0) && queued(count) && count == sq_entries_) {
+        fail("submission queue", "no progress when full");
+      }
+    }
+    io_uring_sqe* sqe = failed_ ? &scratch_sqe_ : &sqes_[sq_local_tail_++ & sq_mask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+  }
+
+  void reap() {
+    std::atomic_ref<std::uint32_t> head(*cq_head_);
+    std::uint32_t position = head.load(std::memory_order_relaxed);
+    const std::uint32_t tail = std::atomic_ref<std::uint32_t>(*cq_tail_).load(std::memory_order_acquire);
+    for (; position != tail; ++position) {
+      const io_uring_cqe cqe = cqes_[position & cq_mask_];
+      head.store(position + 1, std::memory_order_release);
+      const auto id = static_cast<std::uint32_t>(cqe.user_data);
+      switch (static_cast<Op>(cqe.user_data >> 32)) {
+        case Op::Accept: on_accept(cqe.res, cqe.flags); break;
+        case Op::Wake: arm_wake(); break;
+        case Op::Receive: on_receive(id, cqe.res, cqe.flags); break;
+        case Op::Send: on_send(id, cqe.res); break;
+        case Op::Probe: on_probe(cqe.flags); break;
+        case Op::Cancel: case Op::Provide: break;
+      }
+    }
+  }
+
+  void arm_accept() {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd_;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = user_data(Op::Accept);
+  }
+
+  void arm_wake() {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wake_fd_;
+    sqe->addr = reinterpret_cast<std::uint64_t>(&wake_value_);
+    sqe->len = sizeof(wake_value_);
+    sqe->user_data = user_data(Op::Wake);
+  }
+
+  void arm_receive(std::uint32_t id, Connection& connection) {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = connection.fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = user_data(Op::Receive, id);
+    connection.receiving = true;
+  }
+
+  void stop_receiving(std::uint32_t id, Connection& connection) {
+    if (!connection.receiving) {
+      return;
+    }
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = user_data(Op::Receive, id);
+    sqe->user_data = user_data(Op::Cancel, id);
+  }
+
+  /// Start sending the connection's pending output unless a send is in flight
+  void send(std::uint32_t id, Connection& connection) {
+    if (connection.send_in_flight || connection.pending.empty()) {
+      return;
+    }
+    connection.sending.swap(connection.pending);
+    connection.pending.clear();
+    connection.sent = 0;
+    connection.watch.expect(ConnectionReaper::Deadline::Write, limits_.write_timeout);
+    send_rest(id, connection);
+  }
+
+  /// Send what the kernel has not taken yet of the buffer being sent
+  void send_rest(std::uint32_t id, Connection& connection) {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = connection.fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(connection.sending.data() + connection.sent);
+    sqe->len = static_cast<std::uint32_t>(connection.sending.size() - connection.sent);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data(Op::Send, id);
+    connection.send_in_flight = true;
+  }
+
+  /**
+   * Check, before any client is served, that a receive lands in one of the registered ring's
+   * buffers: one byte through a socket pair. Kernels that accept the registration but fail
+   * such receives with ENOBUFS or EFAULT get buffers by IORING_OP_PROVIDE_BUFFERS instead.
+   */
+  bool buffer_ring_delivers() {
+    int pair[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+      return true;
+    }
+    const char byte = 'B';
+    bool delivers = true;
+    if (::write(pair[1], &byte, 1) == 1) {
+      io_uring_sqe* sqe = next_sqe();
+      sqe->opcode = IORING_OP_RECV;
+      sqe->fd = pair[0];
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = kBufferGroup;
+      sqe->user_data = user_data(Op::Probe);
+      std::atomic_ref<std::uint32_t> head(*cq_head_);
+      const std::uint32_t position = head.load(std::memory_order_relaxed);
+      // Nothing else is armed yet, so the first completion is the probe's
+      while (submit(1) && std::atomic_ref<std::uint32_t>(*cq_tail_).load(std::memory_order_acquire) == position) {
+      }
+      if (!failed_) {
+        const io_uring_cqe cqe = cqes_[position & cq_mask_];
+        head.store(position + 1, std::memory_order_release);
+        const auto buffer = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        delivers = cqe.res == 1 && (cqe.flags & IORING_CQE_F_BUFFER) && buffer < kBuffers &&
+                   buffers_[buffer * kBufferSize] == byte;
+        on_probe(cqe.flags);
+      }
+    }
+    ::close(pair[0]);
+    ::close(pair[1]);
+    return delivers;
+  }
+
+  /// Give back the buffer a probe completion took, if any
+  void on_probe(std::uint32_t flags) {
+    const auto buffer = static_cast<std::uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+    if ((flags & IORING_CQE_F_BUFFER) && buffer < kBuffers) {
+      recycle(buffer);
+    }
+  }
+
+  /// Replace the buffer ring by buffers handed to the kernel with IORING_OP_PROVIDE_BUFFERS
+  void use_provide_buffers() {
+    BOOKING_LOG(LogLevel::Warn, "io_uring_buffer_ring_unusable", {"fallback", "provide_buffers"});
+    io_uring_buf_reg registration{};
+    registration.bgid = kBufferGroup;
+    io_uring_register(fd_, IORING_UNREGISTER_PBUF_RING, &registration, 1);
+    provide_buffers_ = true;
+    provide(0, kBuffers);
+  }
+
+  /// Queue an IORING_OP_PROVIDE_BUFFERS of count contiguous buffers from first; sent with the next submission
+  void provide(std::uint16_t first, unsigned count) {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<std::uint64_t>(buffers_.get() + first * kBufferSize);
+    sqe->len = kBufferSize;
+    sqe->off = first;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = user_data(Op::Provide);
+  }
+
+  void recycle(std::uint16_t buffer) {
+    if (provide_buffers_) {
+      provide(buffer, 1);
+      return;
+    }
+    io_uring_buf& entry = buffer_ring_->bufs[buffer_tail_ & (kBuffers - 1)];
+    entry.addr = reinterpret_cast<std::uint64_t>(buffers_.get() + buffer * kBufferSize);
+    entry.len = kBufferSize;
+    entry.bid = buffer;
+    ++buffer_tail_;
+    std::atomic_ref<std::uint16_t>(buffer_ring_->tail).store(buffer_tail_, std::memory_order_release);
+  }
+
+  void on_accept(int result, std::uint32_t flags) {
+    if (!(flags & IORING_CQE_F_MORE) && !stopping_.load(std::memory_order_relaxed)) {
+      arm_accept();
+    }
+    if (result < 0) {
+      return;
+    }
+    if (stopping_.load(std::memory_order_relaxed)) {
+      ::close(result);
+      return;
+    }
+    const std::uint32_t id = next_id_++;
+    auto [it, inserted] = connections_.try_emplace(id, result, reaper_.watch(result));
+    Connection& connection = it->second;
+    connection.session = handler_.open(peer_address(result), connection.pending);
+    if (!connection.session) {
+      connection.closing = true;
+      send(id, connection);
+      finish(id, connection);
+      return;
+    }
+    connection.watch.expect(ConnectionReaper::Deadline::Idle, limits_.idle_timeout);
+    arm_receive(id, connection);
+  }
+
+  void on_receive(std::uint32_t id, int result, std::uint32_t flags) {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) {
+      return;
+    }
+    Connection& connection = it->second;
+    if (flags & IORING_CQE_F_BUFFER) {
+      const auto buffer = static_cast<std::uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+      if (result > 0 && !connection.closing) {
+        connection.input.append(buffers_.get() + buffer * kBufferSize, static_cast<std::size_t>(result));
+      }
+      recycle(buffer);
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+      connection.receiving = false;
+    }
+    if (result > 0 || result == -ENOBUFS || (result == -ECANCELED && !connection.closing)) {
+      serve_lines(id, connection);
+      if (!connection.receiving && !connection.closing && !connection.paused) {
+        arm_receive(id, connection);  // Terminated, e.g. the buffers ran out or a pause ended: re-arm
+      }
+    } else {
+      connection.closing = true;  // End of stream, error or cancelled
+      stop_receiving(id, connection);
+    }
+    finish(id, connection);
+  }
+
+  /// Response bytes queued on the connection and not yet taken by the kernel
+  static std::size_t backlog(const Connection& connection) {
+    return connection.pending.size() + connection.sending.size() - connection.sent;
+  }
+
+  /// Serve the complete lines received, as long as the client keeps taking the responses
+  void serve_lines(std::uint32_t id, Connection& connection) {
+    std::size_t start = 0;
+    while (!connection.closing && backlog(connection) < kMaxBacklog) {
+      const std::size_t end = connection.input.find('\n', start);
+      if (end == std::string::npos) {
+        break;
+      }
+      line_.assign(connection.input, start, end - start);
+      start = end + 1;
+      connection.handoff = connection.session->handle_line(line_, connection.pending);
+      if (connection.handoff) {
+        connection.closing = true;  // Whatever follows SUBSCRIBE_SEATS is discarded, as on the Asio path
+        stop_receiving(id, connection);
+      }
+    }
+    connection.input.erase(0, start);
+    if (!connection.closing && backlog(connection) < kMaxBacklog &&
+        connection.input.size() >= limits_.max_request_bytes) {
+      connection.session->reject_line(connection.pending);  // No newline within the limit
+      connection.closing = true;
+      connection.input.clear();
+      stop_receiving(id, connection);
+    }
+    send(id, connection);
+    // A client that does not read its responses is not read from either, as on the Asio path
+    const bool backlogged = backlog(connection) >= kMaxBacklog;
+    if (backlogged != connection.paused && !connection.closing) {
+      connection.paused = backlogged;
+      if (backlogged) {
+        stop_receiving(id, connection);
+      } else if (!connection.receiving) {
+        arm_receive(id, connection);
+      }
+    }
+  }
+
+  void on_send(std::uint32_t id, int result) {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) {
+      return;
+    }
+    Connection& connection = it->second;
+    connection.send_in_flight = false;
+    if (result < 0) {
+      connection.closing = true;
+      connection.handoff.reset();
+      connection.pending.clear();
+      stop_receiving(id, connection);
+    } else {
+      connection.sent += static_cast<std::size_t>(result);
+      if (connection.sent < connection.sending.size()) {
+        send_rest(id, connection);  // Short send: continue from where it stopped
+        return;
+      }
+      connection.sending.clear();
+      connection.sent = 0;
+      if (connection.paused) {
+        serve_lines(id, connection);  // Serve the lines held back, then read again if they fit
+      } else {
+        send(id, connection);
+      }
+      if (!connection.send_in_flight) {
+        connection.watch.expect(ConnectionReaper::Deadline::Idle, limits_.idle_timeout);  // Output drained
+      }
+    }
+    finish(id, connection);
+  }
+
+  /// Close or hand over a closing connection once the kernel holds none of its operations
+  void finish(std::uint32_t id, Connection& connection) {
+    if (!connection.closing || connection.receiving || connection.send_in_flight || !connection.pending.empty()) {
+      return;
+    }
+    if (const auto deadline = connection.watch.expired(); deadline != ConnectionReaper::Deadline::None && connection.session) {
+      connection.session->timed_out(deadline);
+    }
+    connection.watch.reset();
+    connection.session.reset();
+    if (connection.handoff) {
+      handler_.hand_over(std::exchange(connection.fd, -1), *connection.handoff);
+    }
+    connections_.erase(id);
+  }
+
+  static constexpr std::uint16_t kBufferGroup = 0;
+
+  // IORING_REGISTER_PBUF_RING argument as of Linux 6.4, which older headers declare without flags
+  struct BufferRingRegistration {
+    std::uint64_t ring_addr;
+    std::uint32_t ring_entries;
+    std::uint16_t bgid;
+    std::uint16_t flags;
+    std::uint64_t resv[3];
+  };
+  static_assert(sizeof(BufferRingRegistration) == sizeof(io_uring_buf_reg));
+  static constexpr std::uint16_t kPbufRingMmap = 1;                  // IOU_PBUF_RING_MMAP
+  static constexpr std::uint64_t kOffPbufRing = 0x80000000ULL;       // IORING_OFF_PBUF_RING
+  static constexpr unsigned kOffPbufShift = 16;                      // IORING_OFF_PBUF_SHIFT
+  static constexpr std::size_t kMaxBacklog = 64 * 1024;  ///< Output queued on a connection before it stops reading
+
+  Handler& handler_;
+  ConnectionReaper& reaper_;
+  const SessionLimits limits_;
+  int listen_fd_;
+  int fd_ = -1;
+  int wake_fd_ = -1;
+  bool disabled_ = false;
+  bool provide_buffers_ = false;  ///< Buffers given back by SQE instead of through the buffer ring
+  bool failed_ = false;           ///< The kernel can no longer be driven; set on the ring thread only
+  io_uring_sqe scratch_sqe_{};    ///< Filled instead of a queue entry once failed_
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+
+  void* rings_ = nullptr;
+  std::size_t rings_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sqes_size_ = 0;
+  std::uint32_t* sq_head_ = nullptr;
+  std::uint32_t* sq_tail_ = nullptr;
+  std::uint32_t sq_mask_ = 0;
+  std::uint32_t sq_entries_ = 0;
+  std::uint32_t sq_local_tail_ = 0;  ///< SQEs filled, published to sq_tail_ on submit
+  std::uint32_t* cq_head_ = nullptr;
+  std::uint32_t* cq_tail_ = nullptr;
+  std::uint32_t cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+
+  io_uring_buf_ring* buffer_ring_ = nullptr;
+  std::size_t buffer_ring_size_ = 0;
+  std::uint16_t buffer_tail_ = 0;
+  std::unique_ptr<char[]> buffers_;
+  eventfd_t wake_value_ = 0;
+
+  std::unordered_map<std::uint32_t, Connection> connections_;
+  std::uint32_t next_id_ = 0;
+  std::string line_;  ///< Keeps its capacity across requests
+};
+
+UringTransport::UringTransport(Handler& handler, ConnectionReaper& reaper, const SessionLimits& limits,
+                               unsigned short port, std::size_t rings)
+  : handler_(handler) {
+  std::string reason;
+  if (!available(&reason)) {
+    throw std::runtime_error("io_uring transport unavailable: " + reason);
+  }
+  for (std::size_t i = 0; i < std::max<std::size_t>(1, rings); ++i) {
+    const int listen_fd = listen_on(port_ != 0 ? port_ : port);  // Later rings join the first one's port
+    if (port_ == 0) {
+      port_ = bound_port(listen_fd);
+    }
+    rings_.push_back(std::make_unique<Ring>(handler_, reaper, limits, listen_fd));
+  }
+}
+
+UringTransport::~UringTransport() = default;
+
+void UringTransport::start() {
+  for (auto& ring : rings_) {
+    ring->start();
+  }
+}
+
+#else
+
+class UringTransport::Ring {};
+
+UringTransport::UringTransport(Handler& handler, ConnectionReaper&, const SessionLimits&, unsigned short, std::size_t)
+  : handler_(handler) {
+  throw std::runtime_error("io_uring transport unavailable: built without BOOKING_IO_URING");
+}
+
+UringTransport::~UringTransport() = default;
+
+void UringTransport::start() {}
+
+#endif
@@ -0,0 +1,193 @@
+#include "Controller/WaitingRoom.h"
+#include "Models/BookingLedger.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr int kSequenceBits = 16;
+
+// splitmix64 finalizer, spreads showing keys over the lane table
+std::uint64_t mix(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+std::uint64_t showing_key(int theater_id, int movie_id) {
+  return (std::uint64_t{static_cast<std::uint32_t>(theater_id)} << 32) | static_cast<std::uint32_t>(movie_id);
+}
+
+}
+
+WaitingRoom::WaitingRoom(double admissions_per_second, std::chrono::seconds admission_window, std::size_t max_showings)
+  : lane_count_(max_showings),
+    window_us_(std::chrono::duration_cast<std::chrono::microseconds>(admission_window).count()),
+    epoch_(std::chrono::steady_clock::now()),
+    token_key_(SipHashKey::random()) {
+  if (!(admissions_per_second > 0) || max_showings == 0) {
+    throw std::invalid_argument("Waiting room needs a positive admission rate and lane count");
+  }
+  interval_us_ = std::max<std::int64_t>(1, std::llround(1e6 / admissions_per_second));
+  lanes_ = std::make_unique<Lane[]>(lane_count_);
+  for (std::size_t i = 0; i < lane_count_; ++i) {
+    lanes_[i].key.store(kEmptyLane, std::memory_order_relaxed);
+  }
+}
+
+std::optional<QueueTicket> WaitingRoom::join(int theater_id, int movie_id) {
+  const std::uint64_t showing = showing_key(theater_id, movie_id);
+  const std::int64_t now = now_us();
+  std::int64_t admission = 0;
+  while (true) {
+    Lane* lane = find_lane(showing);
+    if (!lane && !(lane = claim_lane(showing, now))) {
+      return std::nullopt;
+    }
+
+    // Reserve the next admission time; an idle lane admits immediately
+    std::int64_t next = lane->next_admission_us.load(std::memory_order_relaxed);
+    do {
+      admission = std::max(next, now);
+    } while (!lane->next_admission_us.compare_exchange_weak(next, admission + interval_us_, std::memory_order_acq_rel));
+    // An idle lane may have been handed to another showing meanwhile; the reservation then
+    // only delays that showing's first joiner by one interval
+    if (lane->key.load(std::memory_order_acquire) == showing) {
+      break;
+    }
+  }
+
+  const std::uint64_t sequence = next_sequence_.fetch_add(1, std::memory_order_relaxed);
+  const std::uint64_t word = (static_cast<std::uint64_t>(admission) << kSequenceBits) |
+                             (sequence & ((1u << kSequenceBits) - 1));
+  return QueueTicket{BookingLedger::encode(word) + BookingLedger::encode(tag(word, showing)),
+                     status_at(admission, now)};
+}
+
+QueueStatus WaitingRoom::status(int theater_id, int movie_id, std::string_view token) const {
+  const auto decoded = decode(showing_key(theater_id, movie_id), token);
+  if (!decoded) {
+    return QueueStatus{};
+  }
+  QueueStatus status = status_at(decoded->first, now_us());
+  if (status.state == AdmissionState::Admitted) {
+    std::lock_guard<std::mutex> lock(used_mutex_);
+    if (used_.count(decoded->second)) {
+      status.state = AdmissionState::Used;
+    }
+  }
+  return status;
+}
+
+QueueStatus WaitingRoom::claim(int theater_id, int movie_id, std::string_view token) {
+  const auto decoded = decode(showing_key(theater_id, movie_id), token);
+  if (!decoded) {
+    return QueueStatus{};
+  }
+  const std::int64_t now = now_us();
+  QueueStatus status = status_at(decoded->first, now);
+  if (status.state != AdmissionState::Admitted) {
+    return status;
+  }
+  std::lock_guard<std::mutex> lock(used_mutex_);
+  // Tokens past their window report Expired on their own, so they need not be remembered
+  while (!used_order_.empty() && used_order_.front().first < now) {
+    used_.erase(used_order_.front().second);
+    used_order_.pop_front();
+  }
+  if (!used_.insert(decoded->second).second) {
+    status.state = AdmissionState::Used;
+    return status;
+  }
+  used_order_.emplace_back(decoded->first + window_us_, decoded->second);
+  return status;
+}
+
+void WaitingRoom::release(int theater_id, int movie_id, std::string_view token) {
+  if (const auto decoded = decode(showing_key(theater_id, movie_id), token)) {
+    std::lock_guard<std::mutex> lock(used_mutex_);
+    used_.erase(decoded->second); // Its used_order_ entry expires harmlessly
+  }
+}
+
+bool WaitingRoom::is_backlogged(int theater_id, int movie_id) const {
+  const Lane* lane = find_lane(showing_key(theater_id, movie_id));
+  return lane && lane->next_admission_us.load(std::memory_order_relaxed) - interval_us_ > now_us();
+}
+
+WaitingRoom::Lane* WaitingRoom::find_lane(std::uint64_t showing) const {
+  std::size_t index = mix(showing) % lane_count_;
+  for (std::size_t probe = 0; probe < lane_count_; ++probe) {
+    Lane& lane = lanes_[index];
+    const std::uint64_t key = lane.key.load(std::memory_order_acquire);
+    if (key == showing) {
+      return &lane;
+    }
+    if (key == kEmptyLane) {
+      return nullptr; // Lanes are reused but never emptied, so the probe chain ends here
+    }
+    index = (index + 1) % lane_count_;
+  }
+  return nullptr;
+}
+
+WaitingRoom::Lane* WaitingRoom::claim_lane(std::uint64_t showing, std::int64_t now) {
+  std::lock_guard<std::mutex> lock(lane_mutex_);
+  if (Lane* lane = find_lane(showing)) {
+    return lane; // Claimed by another joiner while we waited
+  }
+  // First empty or idle lane on the probe chain. A lane is idle once even a token admitted at
+  // its next admission time would have expired; its clock moves to now so it is not idle again
+  // before its new showing's first joiner gets in.
+  std::size_t index = mix(showing) % lane_count_;
+  for (std::size_t probe = 0; probe < lane_count_; ++probe) {
+    Lane& lane = lanes_[index];
+    std::int64_t next = lane.next_admission_us.load(std::memory_order_acquire);
+    if ((lane.key.load(std::memory_order_relaxed) == kEmptyLane || next + window_us_ < now) &&
+        lane.next_admission_us.compare_exchange_strong(next, std::max(next, now), std::memory_order_acq_rel)) {
+      lane.key.store(showing, std::memory_order_release);
+      return &lane;
+    }
+    index = (index + 1) % lane_count_;
+  }
+  return nullptr;
+}
+
+std::optional<std::pair<std::int64_t, std::uint64_t>> WaitingRoom::decode(std::uint64_t showing,
+                                                                         std::string_view token) const {
+  const std::size_t half = token.size() / 2;
+  if (token.size() % 2 != 0) {
+    return std::nullopt;
+  }
+  const auto word = BookingLedger::decode(token.substr(0, half));
+  const auto check = BookingLedger::decode(token.substr(half));
+  if (!word || !check || *check != tag(*word, showing)) {
+    return std::nullopt;
+  }
+  return std::make_pair(static_cast<std::int64_t>(*word >> kSequenceBits), *check);
+}
+
+std::int64_t WaitingRoom::now_us() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch_).count();
+}
+
+QueueStatus WaitingRoom::status_at(std::int64_t admission_us, std::int64_t now) const {
+  QueueStatus status;
+  if (now < admission_us) {
+    const std::int64_t wait = admission_us - now;
+    status.state = AdmissionState::Waiting;
+    status.position = static_cast<std::uint64_t>((wait + interval_us_ - 1) / interval_us_);
+    status.estimated_wait = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::microseconds(wait));
+  } else {
+    status.state = now - admission_us <= window_us_ ? AdmissionState::Admitted : AdmissionState::Expired;
+  }
+  return status;
+}
+
+std::uint64_t WaitingRoom::tag(std::uint64_t word, std::uint64_t showing) const {
+  return siphash24(token_key_, {word, showing});
+}
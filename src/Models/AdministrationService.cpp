@@ -41,10 +41,7 @@ bool AdministrationService::theater_exists(int theater_id) const {
 }
 
 void AdministrationService::schedule_movie_in_theater(int theater_id, Movie&& movie) {
-  auto theater = data_store_->get_theater(theater_id);
-  if (theater) {
-    theater->add_movie(std::move(movie));
-  } else {
+  if (!data_store_->schedule_movie(theater_id, std::move(movie))) {
     throw std::runtime_error("Theater not found: " + std::to_string(theater_id));
   }
 }
@@ -0,0 +1,98 @@
+#include "Models/BookingLedger.h"
+#include <algorithm>
+#include <mutex>
+
+namespace {
+
+constexpr char kAlphabet[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";  // Crockford base32
+constexpr std::size_t kCodeLength = 13;                          // ceil(64 / 5)
+
+int digit_value(char c) {
+  if (c >= 'a' && c <= 'z') c = static_cast<char>(c - 'a' + 'A');
+  if (c == 'O') return 0;
+  if (c == 'I' || c == 'L') return 1;
+  for (int i = 0; i < 32; ++i) {
+    if (kAlphabet[i] == c) return i;
+  }
+  return -1;
+}
+
+}
+
+BookingLedger::BookingLedger(std::size_t capacity, std::chrono::seconds retention)
+  : capacity_(std::max<std::size_t>(1, capacity)), retention_(retention),
+    code_key_(SipHashKey::random()) {}
+
+std::uint64_t BookingLedger::record(BookingRecord record) {
+  record.seats.shrink_to_fit();
+  const Clock::time_point now = Clock::now();
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  std::uint64_t code = 0;
+  do {
+    code = siphash24(code_key_, {next_sequence_.fetch_add(1, std::memory_order_relaxed)});
+  } while (records_.count(code)); // Unlike a bijection, a PRF may repeat a live code
+  records_.emplace(code, std::move(record));
+  order_.emplace_back(now, code);
+  expire(now);
+  return code;
+}
+
+void BookingLedger::expire(Clock::time_point now) {
+  // Each code leaves order_ once, so this is amortized O(1) per record()
+  while (!order_.empty() && (records_.size() > capacity_ || now - order_.front().first > retention_ ||
+                             !records_.count(order_.front().second))) {
+    records_.erase(order_.front().second);
+    order_.pop_front();
+  }
+}
+
+std::optional<BookingRecord> BookingLedger::find(std::uint64_t code) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto it = records_.find(code);
+  if (it == records_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+std::optional<BookingRecord> BookingLedger::take_if(std::uint64_t code,
+                                                    const std::function<bool(const BookingRecord&)>& step) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto it = records_.find(code);
+  if (it == records_.end() || !step(it->second)) {
+    return std::nullopt;
+  }
+  BookingRecord record = std::move(it->second);
+  records_.erase(it);
+  return record;
+}
+
+std::size_t BookingLedger::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return records_.size();
+}
+
+std::string BookingLedger::encode(std::uint64_t code) {
+  std::string text(kCodeLength, '0');
+  for (std::size_t i = kCodeLength; i-- > 0;) {
+    text[i] = kAlphabet[code & 31];
+    code >>= 5;
+  }
+  return text;
+}
+
+std::optional<std::uint64_t> BookingLedger::decode(std::string_view text) {
+  if (text.size() != kCodeLength) {
+    return std::nullopt;
+  }
+  std::uint64_t code = 0;
+  for (std::size_t i = 0; i < kCodeLength; ++i) {
+    const int value = digit_value(text[i]);
+    // The leading digit only carries the top 4 bits of the 64
+    if (value < 0 || (i == 0 && value > 15)) {
+      return std::nullopt;
+    }
+    code = (code << 5) | static_cast<std::uint64_t>(value);
+  }
+  return code;
+}
@@ -1,6 +1,10 @@
 #include "Models/BookingService.h"
+#include "Utils/Logger.h"
 #include <stdexcept>
 #include <algorithm>
+#include <ctime>
+#include <limits>
+#include <map>
 
 BookingService::BookingService(std::shared_ptr<IDataStore> data_store)
   : data_store_(data_store) {
@@ -9,20 +13,245 @@ BookingService::BookingService(std::shared_ptr<IDataStore> data_store)
   }
 }
 
+BookingService::~BookingService() {
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    stopping_ = true;
+  }
+  pending_cond_.notify_one();
+  if (booking_thread_.joinable()) {
+    booking_thread_.join(); // Bookings already queued still complete
+  }
+}
+
 std::vector<Movie> BookingService::get_all_movies() const {
   return data_store_->get_all_movies();
 }
 
+CatalogPage<Movie> BookingService::get_movies_page(const CatalogQuery& query) const {
+  return data_store_->get_movies_page(query);
+}
+
+std::uint64_t BookingService::get_catalog_version() const {
+  return data_store_->get_catalog_version();
+}
+
+std::vector<Movie> BookingService::search_movies(const std::string& query, std::size_t limit) const {
+  return data_store_->search_movies(query, limit);
+}
+
 std::vector<std::shared_ptr<ITheater>> BookingService::get_theaters_showing_movie(int movie_id) const {
   return data_store_->get_theaters_showing_movie(movie_id);
 }
 
+CatalogPage<std::shared_ptr<ITheater>> BookingService::get_theaters_page(int movie_id, const CatalogQuery& query) const {
+  return data_store_->get_theaters_page(movie_id, query);
+}
+
 std::vector<std::string> BookingService::get_available_seats(int theater_id, int movie_id) const {
   return data_store_->get_available_seats(theater_id, movie_id);
 }
 
+SeatMap BookingService::get_seat_map(int theater_id, int movie_id) const {
+  return data_store_->get_seat_map(theater_id, movie_id);
+}
+
+std::optional<std::uint64_t> BookingService::get_seat_version(int theater_id, int movie_id) const {
+  return data_store_->get_seat_version(theater_id, movie_id);
+}
+
 bool BookingService::book_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) {
-  return data_store_->book_seats(theater_id, movie_id, seat_ids);
+  return create_booking(theater_id, movie_id, seat_ids).has_value();
+}
+
+std::optional<Booking> BookingService::create_booking(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) {
+  auto theater = data_store_->get_theater(theater_id);
+  if (!theater) {
+    return std::nullopt;
+  }
+  return book_in_theater(*theater, theater_id, movie_id, seat_ids);
+}
+
+std::future<std::optional<Booking>> BookingService::book_seats_async(BookingRequest request) {
+  auto promise = std::make_shared<std::promise<std::optional<Booking>>>();
+  auto future = promise->get_future();
+  book_seats_async(std::move(request), [promise](std::optional<Booking> booking) {
+    promise->set_value(std::move(booking));
+  });
+  return future;
+}
+
+void BookingService::book_seats_async(BookingRequest request, BookingCallback on_complete) {
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_requests_.push_back(std::move(request));
+    pending_callbacks_.push_back(std::move(on_complete));
+    if (!booking_thread_.joinable()) {
+      booking_thread_ = std::thread([this]() { run_async_bookings(); });
+    }
+  }
+  pending_cond_.notify_one();
+}
+
+std::vector<std::optional<Booking>> BookingService::book_batch(const std::vector<BookingRequest>& requests) {
+  std::vector<std::optional<Booking>> results(requests.size());
+  // One theater lookup per group; requests keep their relative order inside a group
+  std::map<int, std::vector<std::size_t>> by_theater;
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    by_theater[requests[i].theater_id].push_back(i);
+  }
+  for (const auto& [theater_id, indices] : by_theater) {
+    auto theater = data_store_->get_theater(theater_id);
+    if (!theater) {
+      continue;
+    }
+    for (std::size_t i : indices) {
+      results[i] = book_in_theater(*theater, theater_id, requests[i].movie_id, requests[i].seat_ids);
+    }
+  }
+  return results;
+}
+
+std::optional<std::vector<Booking>> BookingService::book_all_or_nothing(const std::vector<BookingRequest>& requests) {
+  // Seats of every request, grouped by showing; the map keeps (theater_id, movie_id) lock order
+  struct ShowingSeats {
+    std::shared_ptr<ITheater> theater;
+    std::vector<std::string> seat_ids;
+    std::unique_ptr<SeatHold> hold;
+  };
+  std::map<std::pair<int, int>, ShowingSeats> showings;
+  std::vector<BookingRecord> records;
+  records.reserve(requests.size());
+  for (const auto& request : requests) {
+    ShowingSeats& showing = showings[{request.theater_id, request.movie_id}];
+    if (!showing.theater && !(showing.theater = data_store_->get_theater(request.theater_id))) {
+      return std::nullopt;
+    }
+    auto record = make_record(*showing.theater, request.theater_id, request.movie_id, request.seat_ids);
+    if (!record) {
+      return std::nullopt;
+    }
+    records.push_back(std::move(*record));
+    showing.seat_ids.insert(showing.seat_ids.end(), request.seat_ids.begin(), request.seat_ids.end());
+  }
+
+  // Hold every showing, check every seat, and only then book; returning early drops the holds
+  for (auto& [showing_key, showing] : showings) {
+    showing.hold = showing.theater->hold_seats(showing_key.second);
+    if (!showing.hold || !showing.hold->can_book(showing.seat_ids)) {
+      return std::nullopt;
+    }
+  }
+  for (auto& [showing_key, showing] : showings) {
+    showing.hold->book(showing.seat_ids);
+  }
+  showings.clear();
+
+  std::vector<Booking> bookings;
+  bookings.reserve(requests.size());
+  const auto created_at = static_cast<std::uint32_t>(std::time(nullptr));
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    records[i].created_at = created_at;
+    const std::uint64_t code = ledger_.record(records[i]);
+    bookings.push_back(Booking{BookingLedger::encode(code), requests[i].theater_id, requests[i].movie_id,
+                               requests[i].seat_ids, created_at});
+  }
+  return bookings;
+}
+
+void BookingService::run_async_bookings() {
+  std::vector<BookingRequest> requests;
+  std::vector<BookingCallback> callbacks;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(pending_mutex_);
+      pending_cond_.wait(lock, [this] { return stopping_ || !pending_requests_.empty(); });
+      if (pending_requests_.empty()) {
+        return; // Stopping and nothing left to book
+      }
+      requests.swap(pending_requests_);
+      callbacks.swap(pending_callbacks_);
+    }
+    auto results = book_batch(requests);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      // A throwing callback must not take the booking thread, or the other callers, down with it
+      try {
+        callbacks[i](std::move(results[i]));
+      } catch (const std::exception& e) {
+        BOOKING_LOG(LogLevel::Error, "booking_callback_failed", {"error", e.what()});
+      } catch (...) {
+        BOOKING_LOG(LogLevel::Error, "booking_callback_failed", {"error", "unknown exception"});
+      }
+    }
+    requests.clear();
+    callbacks.clear();
+  }
+}
+
+std::optional<BookingRecord> BookingService::make_record(const ITheater& theater, int theater_id, int movie_id,
+                                                        const std::vector<std::string>& seat_ids) {
+  if (seat_ids.empty()) {
+    return std::nullopt;
+  }
+  BookingRecord record;
+  record.theater_id = theater_id;
+  record.movie_id = movie_id;
+  record.seats.reserve(seat_ids.size());
+  for (const auto& seat_id : seat_ids) {
+    int index = theater.seat_index(seat_id);
+    if (index < 0 || index > std::numeric_limits<std::uint16_t>::max()) {
+      return std::nullopt;
+    }
+    record.seats.push_back(static_cast<std::uint16_t>(index));
+  }
+  return record;
+}
+
+std::optional<Booking> BookingService::book_in_theater(ITheater& theater, int theater_id, int movie_id,
+                                                       const std::vector<std::string>& seat_ids) {
+  auto record = make_record(theater, theater_id, movie_id, seat_ids);
+  if (!record || !theater.book_seats(movie_id, seat_ids)) {
+    return std::nullopt;
+  }
+  record->created_at = static_cast<std::uint32_t>(std::time(nullptr));
+  const std::uint64_t code = ledger_.record(*record);
+  return Booking{BookingLedger::encode(code), theater_id, movie_id, seat_ids, record->created_at};
+}
+
+std::optional<Booking> BookingService::lookup_booking(const std::string& confirmation_code) const {
+  auto code = BookingLedger::decode(confirmation_code);
+  if (!code) {
+    return std::nullopt;
+  }
+  auto record = ledger_.find(*code);
+  if (!record) {
+    return std::nullopt;
+  }
+  return to_booking(*code, *record);
+}
+
+bool BookingService::cancel_booking(const std::string& confirmation_code) {
+  auto code = BookingLedger::decode(confirmation_code);
+  if (!code) {
+    return false;
+  }
+  // The seats are released under the ledger's guard: concurrent cancels of one code release
+  // them once, and a failed release keeps the record
+  return ledger_.take_if(*code, [this, &code](const BookingRecord& record) {
+    Booking booking = to_booking(*code, record);
+    return data_store_->release_seats(booking.theater_id, booking.movie_id, booking.seat_ids);
+  }).has_value();
+}
+
+Booking BookingService::to_booking(std::uint64_t code, const BookingRecord& record) const {
+  Booking booking{BookingLedger::encode(code), record.theater_id, record.movie_id, {}, record.created_at};
+  if (auto theater = data_store_->get_theater(record.theater_id)) {
+    booking.seat_ids.reserve(record.seats.size());
+    for (auto index : record.seats) {
+      booking.seat_ids.push_back(theater->seat_label(index));
+    }
+  }
+  return booking;
 }
 
 bool BookingService::can_book_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) const {
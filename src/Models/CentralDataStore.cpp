@@ -1,19 +1,33 @@
 #include "Models/CentralDataStore.h"
 #include <algorithm>
+#include <limits>
 #include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+CentralDataStore::~CentralDataStore() {
+  // Theaters may outlive the store
+  for (auto& [theater_id, theater] : theaters_) {
+    theater->set_schedule_listener(nullptr);
+  }
+}
 
 void CentralDataStore::add_movie(Movie&& movie) {
-  std::unique_lock<std::shared_mutex> lock(data_mutex_);
+  std::unique_lock lock(data_mutex_);
+  title_index_.add(movie.get_id(), movie.get_name());
   movies_.insert_or_assign(movie.get_id(), std::move(movie));
+  catalog_version_.fetch_add(1, std::memory_order_release);
 }
 
 void CentralDataStore::remove_movie(int movie_id) {
-  std::unique_lock<std::shared_mutex> lock(data_mutex_);
+  std::unique_lock lock(data_mutex_);
+  title_index_.remove(movie_id);
   movies_.erase(movie_id);
+  catalog_version_.fetch_add(1, std::memory_order_release);
 }
 
 Movie CentralDataStore::get_movie(int movie_id) const {
-  std::shared_lock<std::shared_mutex> lock(data_mutex_);
+  std::shared_lock lock(data_mutex_);
   auto it = movies_.find(movie_id);
   if (it != movies_.end()) {
     return it->second;
@@ -22,38 +36,142 @@ Movie CentralDataStore::get_movie(int movie_id) const {
 }
 
 std::vector<Movie> CentralDataStore::get_all_movies() const {
-  std::shared_lock<std::shared_mutex> lock(data_mutex_);
+  std::shared_lock lock(data_mutex_);
   std::vector<Movie> result;
   result.reserve(movies_.size());
-  std::vector<std::pair<int, Movie>> sorted_movies;
-  for (const auto& pair : movies_) {
-    sorted_movies.push_back(pair);
-  }
-  std::sort(sorted_movies.begin(), sorted_movies.end(),
-    [](const auto& a, const auto& b) { return a.first < b.first; });
-  for (const auto& pair : sorted_movies) {
+  for (const auto& pair : movies_) {  // std::map already iterates in id order
     result.push_back(pair.second);
   }
   return result;
 }
 
+CatalogPage<Movie> CentralDataStore::get_movies_page(const CatalogQuery& query) const {
+  std::shared_lock lock(data_mutex_);
+  CatalogPage<Movie> page;
+  auto page_full = [&]() { return query.limit != 0 && page.items.size() == query.limit; };
+
+  if (query.theater_id) {
+    // Seek into the (theater_id, movie_id) showings index right after the cursor
+    const int theater_id = *query.theater_id;
+    auto it = query.after_id
+      ? movies_by_theater_.upper_bound({theater_id, *query.after_id})
+      : movies_by_theater_.lower_bound({theater_id, std::numeric_limits<int>::min()});
+    for (; it != movies_by_theater_.end() && it->first == theater_id; ++it) {
+      auto movie = movies_.find(it->second);
+      if (movie == movies_.end()) {
+        continue;  // scheduled but no longer in the catalog
+      }
+      if (page_full()) {
+        page.has_more = true;
+        break;
+      }
+      page.items.push_back(movie->second);
+    }
+    return page;
+  }
+
+  auto it = query.after_id ? movies_.upper_bound(*query.after_id) : movies_.begin();
+  for (; it != movies_.end(); ++it) {
+    if (page_full()) {
+      page.has_more = true;
+      break;
+    }
+    page.items.push_back(it->second);
+  }
+  return page;
+}
+
+std::uint64_t CentralDataStore::get_catalog_version() const {
+  return catalog_version_.load(std::memory_order_acquire);
+}
+
+std::vector<Movie> CentralDataStore::search_movies(const std::string& query, std::size_t limit) const {
+  std::shared_lock lock(data_mutex_);
+  std::vector<Movie> result;
+  for (int movie_id : title_index_.search(query, limit)) {
+    result.push_back(movies_.at(movie_id));
+  }
+  return result;
+}
+
 bool CentralDataStore::movie_exists(int movie_id) const {
-  std::shared_lock<std::shared_mutex> lock(data_mutex_);
+  std::shared_lock lock(data_mutex_);
   return movies_.find(movie_id) != movies_.end();
 }
 
 void CentralDataStore::add_theater(std::shared_ptr<ITheater> theater) {
-  std::unique_lock<std::shared_mutex> lock(data_mutex_);
-  theaters_[theater->get_id()] = theater;
+  // Listen first: a movie added from here on is either in get_movies() below or reported
+  theater->set_schedule_listener([this, stored = theater.get()](int movie_id) { index_showing(stored, movie_id); });
+  std::shared_ptr<ITheater> replaced;
+  {
+    std::unique_lock lock(data_mutex_);
+    const int theater_id = theater->get_id();
+    unindex_showings(theater_id);
+    for (const auto& movie : theater->get_movies()) {
+      theaters_by_movie_.emplace(movie.get_id(), theater_id);
+      movies_by_theater_.emplace(theater_id, movie.get_id());
+    }
+    auto& slot = theaters_[theater_id];
+    if (slot != theater) {
+      replaced = std::exchange(slot, theater);
+    }
+    catalog_version_.fetch_add(1, std::memory_order_release);
+  }
+  // Outside data_mutex_, which a running listener call may be waiting for
+  if (replaced) {
+    replaced->set_schedule_listener(nullptr);
+  }
 }
 
 void CentralDataStore::remove_theater(int theater_id) {
-  std::unique_lock<std::shared_mutex> lock(data_mutex_);
-  theaters_.erase(theater_id);
+  std::shared_ptr<ITheater> removed;
+  {
+    std::unique_lock lock(data_mutex_);
+    unindex_showings(theater_id);
+    auto it = theaters_.find(theater_id);
+    if (it != theaters_.end()) {
+      removed = std::move(it->second);
+      theaters_.erase(it);
+    }
+    catalog_version_.fetch_add(1, std::memory_order_release);
+  }
+  if (removed) {
+    removed->set_schedule_listener(nullptr);
+  }
+}
+
+bool CentralDataStore::schedule_movie(int theater_id, Movie&& movie) {
+  auto theater = get_theater(theater_id);
+  if (!theater) {
+    return false;
+  }
+  theater->add_movie(std::move(movie)); // Indexed by the listener set in add_theater
+  return true;
+}
+
+void CentralDataStore::index_showing(const ITheater* theater, int movie_id) {
+  std::unique_lock lock(data_mutex_);
+  const int theater_id = theater->get_id();
+  auto it = theaters_.find(theater_id);
+  if (it == theaters_.end() || it->second.get() != theater) {
+    return; // Removed or replaced meanwhile
+  }
+  theaters_by_movie_.emplace(movie_id, theater_id);
+  movies_by_theater_.emplace(theater_id, movie_id);
+  catalog_version_.fetch_add(1, std::memory_order_release);
+}
+
+void CentralDataStore::unindex_showings(int theater_id) {
+  auto first = movies_by_theater_.lower_bound({theater_id, std::numeric_limits<int>::min()});
+  auto last = first;
+  for (; last != movies_by_theater_.end() && last->first == theater_id; ++last) {
+    theaters_by_movie_.erase({last->second, theater_id});
+  }
+  movies_by_theater_.erase(first, last);
 }
 
 std::shared_ptr<ITheater> CentralDataStore::get_theater(int theater_id) const {
-  std::shared_lock<std::shared_mutex> lock(data_mutex_);
+  std::shared_lock lock(data_mutex_);
   auto it = theaters_.find(theater_id);
   if (it != theaters_.end()) {
     return it->second;
@@ -62,7 +180,7 @@ std::shared_ptr<ITheater> CentralDataStore::get_theater(int theater_id) const {
 }
 
 std::vector<std::shared_ptr<ITheater>> CentralDataStore::get_all_theaters() const {
-  std::shared_lock<std::shared_mutex> lock(data_mutex_);
+  std::shared_lock lock(data_mutex_);
   std::vector<std::shared_ptr<ITheater>> result;
   result.reserve(theaters_.size());
   for (const auto& pair : theaters_) {
@@ -72,35 +190,70 @@ std::vector<std::shared_ptr<ITheater>> CentralDataStore::get_all_theaters() cons
 }
 
 std::vector<std::shared_ptr<ITheater>> CentralDataStore::get_theaters_showing_movie(int movie_id) const {
-  std::shared_lock<std::shared_mutex> lock(data_mutex_);
-  std::vector<std::shared_ptr<ITheater>> result;
-  for (const auto& pair : theaters_) {
-    if (pair.second->shows_movie(movie_id)) {
-      result.push_back(pair.second);
+  return get_theaters_page(movie_id, CatalogQuery{}).items;
+}
+
+CatalogPage<std::shared_ptr<ITheater>> CentralDataStore::get_theaters_page(int movie_id, const CatalogQuery& query) const {
+  std::shared_lock lock(data_mutex_);
+  CatalogPage<std::shared_ptr<ITheater>> page;
+  auto it = query.after_id
+    ? theaters_by_movie_.upper_bound({movie_id, *query.after_id})
+    : theaters_by_movie_.lower_bound({movie_id, std::numeric_limits<int>::min()});
+  for (; it != theaters_by_movie_.end() && it->first == movie_id; ++it) {
+    auto theater = theaters_.find(it->second);
+    if (theater == theaters_.end()) {
+      continue;
+    }
+    if (query.limit != 0 && page.items.size() == query.limit) {
+      page.has_more = true;
+      break;
     }
+    page.items.push_back(theater->second);
   }
-  return result;
+  return page;
 }
 
 bool CentralDataStore::theater_exists(int theater_id) const {
-  std::shared_lock<std::shared_mutex> lock(data_mutex_);
+  std::shared_lock lock(data_mutex_);
   return theaters_.find(theater_id) != theaters_.end();
 }
 
 std::vector<std::string> CentralDataStore::get_available_seats(int theater_id, int movie_id) const {
-  std::shared_lock<std::shared_mutex> lock(data_mutex_);
-  auto theater = get_theater(theater_id);
+  auto theater = get_theater(theater_id);  // Takes the shared lock only for the lookup
   if (theater) {
     return theater->get_available_seats(movie_id);
   }
   return {};
 }
 
+SeatMap CentralDataStore::get_seat_map(int theater_id, int movie_id) const {
+  auto theater = get_theater(theater_id);  // Takes the shared lock only for the lookup
+  if (theater) {
+    return theater->get_seat_map(movie_id);
+  }
+  return {};
+}
+
+std::optional<std::uint64_t> CentralDataStore::get_seat_version(int theater_id, int movie_id) const {
+  auto theater = get_theater(theater_id);
+  if (!theater) {
+    return std::nullopt;
+  }
+  return theater->seat_version(movie_id);
+}
+
 bool CentralDataStore::book_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) {
-  std::shared_lock<std::shared_mutex> lock(data_mutex_);
   auto theater = get_theater(theater_id);
   if (theater) {
     return theater->book_seats(movie_id, seat_ids);
   }
   return false;
 }
+
+bool CentralDataStore::release_seats(int theater_id, int movie_id, const std::vector<std::string>& seat_ids) {
+  auto theater = get_theater(theater_id);
+  if (theater) {
+    return theater->release_seats(movie_id, seat_ids);
+  }
+  return false;
+}
@@ -9,6 +9,11 @@ bool Seat::book() {
   return booked_.compare_exchange_strong(expected,true); // this step is done as an atomic step and therefore is safe.
 }
 
+bool Seat::release() {
+  bool expected = true;
+  return booked_.compare_exchange_strong(expected,false);
+}
+
 std::string Seat::get_id() const {
   return id_;
 }
\ No newline at end of file
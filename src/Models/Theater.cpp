@@ -4,25 +4,103 @@
 #include "Factories/SeatFactory.h"
 #include <algorithm>
 #include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <thread>
 
-Theater::Theater(int id,std::string name) : id_(id), name_(std::move(name)) {}
+namespace {
+
+/// Row letters: a-z, then aa-az, ba-bz and so on, like spreadsheet columns
+std::string row_label(int row) {
+  std::string label;
+  for (++row; row > 0; row = (row - 1) / 26) {
+    label.insert(label.begin(), static_cast<char>('a' + (row - 1) % 26));
+  }
+  return label;
+}
+
+/**
+ * Row-major index of a seat ID: row letters, then a 1-based number without leading zeros
+ * @return The index, or -1 if the ID is malformed or its number is past seats_per_row
+ */
+int parse_seat_id(const std::string& seat_id, int seats_per_row) {
+  if (seats_per_row <= 0) {
+    return -1;
+  }
+  std::size_t i = 0;
+  int row = 0;
+  // Four letters already name 475,254 rows; more would overflow
+  for (; i < seat_id.size() && i < 4 && seat_id[i] >= 'a' && seat_id[i] <= 'z'; ++i) {
+    row = row * 26 + (seat_id[i] - 'a' + 1);
+  }
+  if (i == 0 || i == seat_id.size() || seat_id[i] == '0') {
+    return -1;
+  }
+  int number = 0;
+  for (; i < seat_id.size(); ++i) {
+    const char c = seat_id[i];
+    if (c < '0' || c > '9' || number > seats_per_row)
+      return -1;
+    number = number * 10 + (c - '0');
+  }
+  if (number > seats_per_row)
+    return -1;
+  return (row - 1) * seats_per_row + number - 1;
+}
+
+/// Whether a seat ID is listed twice; booking it twice would fail halfway through
+bool has_duplicate(const std::vector<std::string>& seat_ids) {
+  std::vector<const std::string*> sorted;
+  sorted.reserve(seat_ids.size());
+  for (const auto& seat_id : seat_ids) {
+    sorted.push_back(&seat_id);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+  return std::adjacent_find(sorted.begin(), sorted.end(),
+                            [](const std::string* a, const std::string* b) { return *a == *b; }) != sorted.end();
+}
+
+} // namespace
+
+Theater::Theater(int id,std::string name, int seat_count) : id_(id), seat_count_(seat_count), name_(std::move(name)), mtx_("Theater::mtx_", id) {
+  if (seat_count < 1 || seat_count > kMaxSeats) {
+    throw std::invalid_argument("Theater seat_count must be between 1 and " + std::to_string(kMaxSeats));
+  }
+}
 
 void Theater::add_movie(Movie&& movie) {
-  std::scoped_lock lock(mtx_);
-  movies_.push_back(std::move(movie));
-  initialize_seats(movie.get_id(),seat_count_);
+  const int movie_id = movie.get_id();
+  {
+    std::scoped_lock lock(mtx_);
+    movies_.push_back(std::move(movie));
+    initialize_seats(movie_id, seat_count_);
+  }
+  // Outside mtx_: the listener may call back into the theater
+  std::scoped_lock lock(listener_mtx_);
+  if (schedule_listener_) {
+    schedule_listener_(movie_id);
+  }
+}
+
+void Theater::set_schedule_listener(ScheduleListener listener) {
+  std::scoped_lock lock(listener_mtx_);
+  schedule_listener_ = std::move(listener);
 }
 
 void Theater::initialize_seats(int movie_id, int seat_count) {
-    auto& seats = seats_per_movie_[movie_id];
+    auto& showing = showings_[movie_id];
+    if (!showing) {
+        showing = std::make_unique<Showing>(id_);
+    }
+    auto& seats = showing->seats;
     seats_per_row = ceil(sqrt(seat_count));
     int num_rows = (seat_count + seats_per_row - 1) / seats_per_row;
     
     for (int row = 0; row < num_rows; ++row) {
-        char row_letter = 'a' + row;
+        const std::string row_letters = row_label(row);
         int seats_in_this_row = std::min(seats_per_row, seat_count - (row * seats_per_row));
         for (int seat = 1; seat <= seats_in_this_row; ++seat) {
-            std::string seat_id = std::string(1, row_letter) + std::to_string(seat);
+            std::string seat_id = row_letters + std::to_string(seat);
             
             // Create VIP seats for first row, regular seats for others
             if (row == 0) {
@@ -34,13 +112,18 @@ void Theater::initialize_seats(int movie_id, int seat_count) {
     }
 }
 
+Theater::Showing* Theater::find_showing(int movie_id) const {
+  std::scoped_lock lock(mtx_);
+  auto it = showings_.find(movie_id);
+  return it != showings_.end() ? it->second.get() : nullptr;
+}
 
 std::vector<std::string> Theater::get_available_seats(int movie_id) const {
-  std::scoped_lock lock(mtx_);
   std::vector<std::string> currently_available;
-  auto it = seats_per_movie_.find(movie_id);
-  if (it != seats_per_movie_.end()) {
-    for (const auto& seat_pair : it->second) {
+  const Showing* showing = find_showing(movie_id);
+  if (showing) {
+    std::scoped_lock lock(showing->mtx);
+    for (const auto& seat_pair : showing->seats) {
       if (seat_pair.second->is_available()) {
         currently_available.push_back(seat_pair.first);
       }
@@ -49,20 +132,179 @@ std::vector<std::string> Theater::get_available_seats(int movie_id) const {
   return currently_available;
 }
 
+SeatMap Theater::get_seat_map(int movie_id) const {
+  SeatMap map;
+  const Showing* showing = find_showing(movie_id);
+  if (!showing) {
+    return map;
+  }
+  {
+    std::scoped_lock lock(mtx_);
+    map.layout.seats_per_row = seats_per_row;
+    map.layout.seat_count = seat_count_;
+  }
+  map.layout.rows = (map.layout.seat_count + map.layout.seats_per_row - 1) / map.layout.seats_per_row;
+  map.bitmap.assign((map.layout.seat_count + 7) / 8, 0);
+
+  std::scoped_lock lock(showing->mtx);
+  map.version = showing->version.load(std::memory_order_relaxed);
+  for (const auto& [seat_id, seat] : showing->seats) {
+    if (!seat->is_available()) {
+      continue;
+    }
+    // Same numbering as seat_index(), without taking mtx_ per seat
+    const int index = parse_seat_id(seat_id, map.layout.seats_per_row);
+    if (index < 0 || index >= map.layout.seat_count) {
+      continue;
+    }
+    map.bitmap[index / 8] |= static_cast<std::uint8_t>(1u << (index % 8));
+    ++map.total_available;
+  }
+  return map;
+}
+
+std::optional<std::uint64_t> Theater::seat_version(int movie_id) const {
+  const Showing* showing = find_showing(movie_id);
+  if (!showing) {
+    return std::nullopt;
+  }
+  return showing->version.load(std::memory_order_acquire);
+}
+
 bool Theater::book_seats(int movie_id, const std::vector<std::string>& seat_ids){
-  std::scoped_lock lock(mtx_);
-  auto & seats = seats_per_movie_[movie_id];
+  Showing* showing = find_showing(movie_id);
+  if (!showing)
+    return false;
+
+  // Uncontended path: book directly, then serve anyone who published meanwhile
+  if (showing->mtx.try_lock()) {
+    std::lock_guard lock(showing->mtx, std::adopt_lock);
+    bool result = apply_booking(*showing, seat_ids);
+    combine_pending(*showing);
+    return result;
+  }
+
+  // Contended path: publish the request for the current lock holder to apply
+  CombiningRequest request{&seat_ids};
+  const std::size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id()) % kCombiningSlots;
+  std::size_t slot = kCombiningSlots;
+  for (std::size_t i = 0; i < kCombiningSlots; ++i) {
+    CombiningRequest* expected = nullptr;
+    std::size_t candidate = (start + i) % kCombiningSlots;
+    if (showing->slots[candidate].compare_exchange_strong(expected, &request, std::memory_order_release)) {
+      slot = candidate;
+      break;
+    }
+  }
+  if (slot == kCombiningSlots) {
+    std::scoped_lock lock(showing->mtx); // Every slot is taken, queue on the lock
+    return apply_booking(*showing, seat_ids);
+  }
+
+  while (!request.done.load(std::memory_order_acquire)) {
+    // Whoever gets the lock next becomes the combiner for everyone still waiting
+    if (showing->mtx.try_lock()) {
+      std::lock_guard lock(showing->mtx, std::adopt_lock);
+      combine_pending(*showing);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  return request.result;
+}
+
+class Theater::ShowingHold : public SeatHold {
+public:
+  explicit ShowingHold(Showing& showing) : showing_(showing), lock_(showing.mtx) {}
+
+  bool can_book(const std::vector<std::string>& seat_ids) const override {
+    for (const auto& seat_id : seat_ids) {
+      auto seat = showing_.seats.find(seat_id);
+      if (seat == showing_.seats.end() || !seat->second->is_available())
+        return false;
+    }
+    return !has_duplicate(seat_ids);
+  }
+
+  void book(const std::vector<std::string>& seat_ids) override {
+    for (const auto& seat_id : seat_ids) {
+      showing_.seats.at(seat_id)->book();
+    }
+    showing_.version.fetch_add(1, std::memory_order_release);
+  }
+
+private:
+  Showing& showing_;
+  std::unique_lock<InstrumentedMutex<std::mutex>> lock_;
+};
+
+std::unique_ptr<SeatHold> Theater::hold_seats(int movie_id) {
+  Showing* showing = find_showing(movie_id);
+  if (!showing)
+    return nullptr;
+  // Requests published for combining meanwhile are applied by whoever takes the lock next
+  return std::make_unique<ShowingHold>(*showing);
+}
+
+bool Theater::apply_booking(Showing& showing, const std::vector<std::string>& seat_ids) {
+  auto & seats = showing.seats;
   for (const auto& seatId : seat_ids) {
-    if (seats.find(seatId) == seats.end() || !seats[seatId]->is_available())
+    auto seat = seats.find(seatId);
+    if (seat == seats.end() || !seat->second->is_available())
       return false;
   }
+  if (has_duplicate(seat_ids))
+    return false;
     for (const auto& seatId : seat_ids) {
         if (!seats[seatId]->book())
             return false;
     }
+    showing.version.fetch_add(1, std::memory_order_release);
     return true;
 }
 
+void Theater::combine_pending(Showing& showing) {
+  for (auto& slot : showing.slots) {
+    CombiningRequest* request = slot.load(std::memory_order_acquire);
+    if (!request)
+      continue;
+    request->result = apply_booking(showing, *request->seat_ids);
+    slot.store(nullptr, std::memory_order_relaxed);
+    // The waiting thread may return and destroy the request right after this store
+    request->done.store(true, std::memory_order_release);
+  }
+}
+
+bool Theater::release_seats(int movie_id, const std::vector<std::string>& seat_ids) {
+  Showing* showing = find_showing(movie_id);
+  if (!showing)
+    return false;
+  std::scoped_lock lock(showing->mtx);
+  auto & seats = showing->seats;
+  for (const auto& seatId : seat_ids) {
+    auto seat = seats.find(seatId);
+    if (seat == seats.end() || seat->second->is_available())
+      return false;
+  }
+  for (const auto& seatId : seat_ids) {
+    seats.at(seatId)->release();
+  }
+  showing->version.fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+int Theater::seat_index(const std::string& seat_id) const {
+  std::scoped_lock lock(mtx_);
+  return parse_seat_id(seat_id, seats_per_row);
+}
+
+std::string Theater::seat_label(int seat_index) const {
+  std::scoped_lock lock(mtx_);
+  if (seats_per_row == 0 || seat_index < 0 || seat_index >= seat_count_)
+    return "";
+  return row_label(seat_index / seats_per_row) + std::to_string(seat_index % seats_per_row + 1);
+}
+
 int Theater::get_id() const {
   return id_;
 }
@@ -73,10 +315,16 @@ std::string Theater::get_name() const {
 
 
 bool Theater::shows_movie(int movie_id) const {
+  std::scoped_lock lock(mtx_);
   for (const auto & m : movies_) {
     if (m.get_id() == movie_id) {
       return true;
     }
   }
   return false;
-}
\ No newline at end of file
+}
+
+std::vector<Movie> Theater::get_movies() const {
+  std::scoped_lock lock(mtx_);
+  return movies_;
+}
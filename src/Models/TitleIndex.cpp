@@ -0,0 +1,106 @@
+#include "Models/TitleIndex.h"
+#include <algorithm>
+
+std::string TitleIndex::normalize(std::string_view text) {
+  std::string normalized;
+  normalized.reserve(text.size());
+  bool pending_space = false;
+  for (unsigned char c : text) {
+    const bool keep = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+    if (!keep) {
+      pending_space = !normalized.empty();
+      continue;
+    }
+    if (pending_space) {
+      normalized.push_back(' ');
+      pending_space = false;
+    }
+    normalized.push_back(static_cast<char>((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c));
+  }
+  return normalized;
+}
+
+std::vector<TitleIndex::GramKey> TitleIndex::grams_of(std::string_view normalized,
+                                                      std::size_t min_length, std::size_t max_length) {
+  std::vector<GramKey> keys;
+  for (std::size_t start = 0; start < normalized.size(); ++start) {
+    GramKey packed = 0;
+    for (std::size_t length = 1; length <= max_length && start + length <= normalized.size(); ++length) {
+      // Up to three bytes of text, with the gram length in the top byte
+      packed = (packed << 8) | static_cast<unsigned char>(normalized[start + length - 1]);
+      if (length >= min_length) {
+        keys.push_back((static_cast<GramKey>(length) << 24) | packed);
+      }
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  return keys;
+}
+
+void TitleIndex::add(int movie_id, const std::string& title) {
+  remove(movie_id);
+  std::string normalized = normalize(title);
+  for (GramKey key : grams_of(normalized, 1, kGramLength)) {
+    auto& posting = postings_[key];
+    posting.insert(std::lower_bound(posting.begin(), posting.end(), movie_id), movie_id);
+  }
+  titles_.emplace(movie_id, std::move(normalized));
+}
+
+void TitleIndex::remove(int movie_id) {
+  auto title = titles_.find(movie_id);
+  if (title == titles_.end()) {
+    return;
+  }
+  for (GramKey key : grams_of(title->second, 1, kGramLength)) {
+    auto posting = postings_.find(key);
+    if (posting == postings_.end()) {
+      continue;
+    }
+    auto& ids = posting->second;
+    auto it = std::lower_bound(ids.begin(), ids.end(), movie_id);
+    if (it != ids.end() && *it == movie_id) {
+      ids.erase(it);
+    }
+    if (ids.empty()) {
+      postings_.erase(posting);
+    }
+  }
+  titles_.erase(title);
+}
+
+std::vector<int> TitleIndex::search(std::string_view query, std::size_t limit) const {
+  std::vector<int> matches;
+  const std::string needle = normalize(query);
+  if (needle.empty() || limit == 0) {
+    return matches;
+  }
+
+  // Short queries are a single gram, longer ones are covered by their trigrams
+  const std::size_t gram_length = std::min(needle.size(), kGramLength);
+  std::vector<const std::vector<int>*> lists;
+  for (GramKey key : grams_of(needle, gram_length, gram_length)) {
+    auto posting = postings_.find(key);
+    if (posting == postings_.end()) {
+      return matches;  // some gram never occurs, nothing can match
+    }
+    lists.push_back(&posting->second);
+  }
+  std::sort(lists.begin(), lists.end(),
+    [](const auto* a, const auto* b) { return a->size() < b->size(); });
+
+  for (int candidate : *lists.front()) {
+    bool in_all = std::all_of(lists.begin() + 1, lists.end(), [candidate](const auto* ids) {
+      return std::binary_search(ids->begin(), ids->end(), candidate);
+    });
+    // Grams only prove the pieces exist; the title must contain them in sequence
+    if (in_all && (needle.size() <= kGramLength || titles_.at(candidate).find(needle) != std::string::npos)) {
+      matches.push_back(candidate);
+      if (matches.size() == limit) {
+        break;
+      }
+    }
+  }
+  return matches;
+}
@@ -12,6 +12,11 @@ bool VipSeat::book() {
     return booked_.compare_exchange_strong(expected, true);
 }
 
+bool VipSeat::release() {
+    bool expected = true;
+    return booked_.compare_exchange_strong(expected, false);
+}
+
 std::string VipSeat::get_id() const {
     return id_;
 }
@@ -1,5 +1,6 @@
-#include <iostream>
+#include <cstdlib>
 #include <memory>
+#include <string_view>
 #include <thread>
 #include "Controller/TcpServer.h"
 #include "Interfaces/IDataStore.h"
@@ -10,6 +11,7 @@
 #include "Models/AdministrationService.h"
 #include "Models/Movie.h"
 #include "Models/Theater.h"
+#include "Utils/Logger.h"
 
 int main() {
   try {
@@ -18,7 +20,7 @@ int main() {
     std::unique_ptr<IBookingService> booking_service = std::make_unique<BookingService>(data_store);
     std::unique_ptr<IAdministrationService> admin_service = std::make_unique<AdministrationService>(data_store);
 
-    std::cout << "Initializing system..." << std::endl;
+    BOOKING_LOG(LogLevel::Info, "initializing");
 
     // Setup sample movies
     Movie m1(1, "Inception");
@@ -50,23 +52,32 @@ int main() {
 
 
 
-    std::cout << "System initialized with " << booking_service->get_all_movies().size()
-              << " movies and " << admin_service->get_all_theaters().size() << " theaters." << std::endl;
+    BOOKING_LOG(LogLevel::Info, "initialized", {"movies", booking_service->get_all_movies().size()},
+                {"theaters", admin_service->get_all_theaters().size()});
 
     const unsigned short port = 12345;
     const std::size_t thread_pool_size = std::thread::hardware_concurrency();
+    ServerConfig config;
+    config.metrics_port = 9464; // Prometheus scrape endpoint: GET /metrics
+    if (const char* capture_path = std::getenv("BOOKING_CAPTURE_FILE")) {
+      config.capture_path = capture_path; // Record the traffic for client/replay
+    }
+    if (const char* unix_socket = std::getenv("BOOKING_UNIX_SOCKET")) {
+      config.unix_socket_path = unix_socket; // Local listener for a co-located gateway
+    }
+    if (const char* backend = std::getenv("BOOKING_NETWORK_BACKEND"); backend && std::string_view(backend) == "io_uring") {
+      config.network_backend = NetworkBackend::IoUring; // Falls back to Asio where unavailable
+    }
 
-    std::cout << "Creating TCP server..." << std::endl;
     boost::asio::io_context io_context;
-    TcpServer server(io_context, port, *booking_service, *admin_service, thread_pool_size);
+    TcpServer server(io_context, port, *booking_service, *admin_service, thread_pool_size, config);
 
-    std::cout << "Starting server..." << std::endl;
     server.start();
-    std::cout << "Server running. Use 'netstat -tlnp | grep " << port << "' to verify" << std::endl;
+    BOOKING_LOG(LogLevel::Info, "server_running", {"port", port}, {"threads", thread_pool_size});
 
     io_context.run();
   } catch (const std::exception& e) {
-    std::cerr << "Server error: " << e.what() << std::endl;
+    BOOKING_LOG(LogLevel::Error, "server_failed", {"error", e.what()});
     return 1;
   }
   return 0;
@@ -13,11 +13,19 @@
 #include <thread>
 #include <chrono>
 #include <boost/json.hpp>
+#include <functional>
 #include <future>
 #include <vector>
 #include <atomic>
+#include <set>
+#include <filesystem>
+#include <fstream>
 
 #include "Controller/TcpServer.h"
+#include "Controller/CommandTable.h"
+#include "Utils/Base64.h"
+#include "Utils/LockProfiler.h"
+#include "Utils/TrafficCapture.h"
 #include "Models/CentralDataStore.h"
 #include "Models/BookingService.h"
 #include "Models/AdministrationService.h"
@@ -38,6 +46,11 @@ protected:
   std::shared_ptr<CentralDataStore> data_store_;
   std::unique_ptr<BookingService> booking_service_;
   std::unique_ptr<AdministrationService> admin_service_;
+  std::string capture_path_;  ///< Set by fixtures that capture traffic
+  std::string unix_path_;     ///< Set by fixtures that listen on a Unix socket
+
+  /// Turn on the optional server features a test needs; the default server has none
+  virtual void configure(ServerConfig&) {}
 
   void SetUp() override {
     port_ = base_port_ + test_counter_++;
@@ -62,7 +75,9 @@ protected:
     admin_service_->add_theater(t1);
     admin_service_->add_theater(t2);
 
-    server_ = std::make_unique<TcpServer>(io_context_, port_, *booking_service_, *admin_service_, 2);
+    ServerConfig config;
+    configure(config);
+    server_ = std::make_unique<TcpServer>(io_context_, port_, *booking_service_, *admin_service_, 2, config);
     server_thread_ = std::make_unique<std::thread>([this]() {
       try {
         server_->start();
@@ -80,6 +95,12 @@ protected:
     if (server_thread_ && server_thread_->joinable()) {
       server_thread_->join();
     }
+    if (!capture_path_.empty()) {
+      std::filesystem::remove(capture_path_);
+    }
+    if (!unix_path_.empty()) {
+      std::filesystem::remove(unix_path_);
+    }
     std::this_thread::sleep_for(std::chrono::milliseconds(50));
   }
 
@@ -100,6 +121,49 @@ protected:
     return false;
   }
 
+  // Run the client context until the socket's pending operations finish; on timeout they are
+  // cancelled, their handlers run, and false is returned
+  static bool run_within(boost::asio::io_context& ctx, tcp::socket& socket, std::chrono::milliseconds timeout) {
+    ctx.restart();
+    ctx.run_for(timeout);
+    if (ctx.stopped()) {
+      return true;
+    }
+    boost::system::error_code ignored;
+    socket.cancel(ignored);
+    ctx.restart();
+    ctx.run();
+    return false;
+  }
+
+  // Next non-blank line from the socket, or "TIMEOUT" if none arrives in time
+  static std::string read_line_within(boost::asio::io_context& ctx, tcp::socket& socket, boost::asio::streambuf& buf,
+                                      std::chrono::milliseconds timeout = std::chrono::seconds(2)) {
+    std::string text;
+    while (text.empty()) { // Responses are followed by a blank line
+      boost::system::error_code ec;
+      boost::asio::async_read_until(socket, buf, "\n", [&ec](boost::system::error_code error, std::size_t) { ec = error; });
+      if (!run_within(ctx, socket, timeout) || ec) {
+        return "TIMEOUT";
+      }
+      std::istream is(&buf);
+      std::getline(is, text);
+    }
+    return text;
+  }
+
+  // GET a path from the metrics listener, returns the whole HTTP response
+  std::string http_get(const std::string& path) {
+    boost::asio::io_context ctx;
+    tcp::socket socket(ctx);
+    socket.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port_ + 500));
+    boost::asio::write(socket, boost::asio::buffer("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+    boost::system::error_code ec;
+    std::string response;
+    boost::asio::read(socket, boost::asio::dynamic_buffer(response), ec);
+    return response;
+  }
+
   // Helper for JSON communication only
   json::value send_and_receive_json(const json::value& req, int timeout_ms = 1000) {
     try {
@@ -138,6 +202,39 @@ protected:
 
 std::atomic<int> TcpServerFunctionalTest::test_counter_{0};
 
+// Slow admissions keep the waiting room tests deterministic
+class TcpServerWaitingRoomTest : public TcpServerFunctionalTest {
+protected:
+  void configure(ServerConfig& config) override {
+    config.waiting_room_rate = 2.0;
+  }
+};
+
+// Metrics listener on port_ + 500, tracing every request
+class TcpServerObservabilityTest : public TcpServerFunctionalTest {
+protected:
+  void configure(ServerConfig& config) override {
+    config.metrics_port = port_ + 500;
+    config.trace_sample_period = 1;
+  }
+};
+
+class TcpServerCaptureTest : public TcpServerFunctionalTest {
+protected:
+  void configure(ServerConfig& config) override {
+    capture_path_ = (std::filesystem::temp_directory_path() / ("booking_capture_" + std::to_string(port_) + ".cap")).string();
+    config.capture_path = capture_path_;
+  }
+};
+
+class TcpServerUnixSocketTest : public TcpServerFunctionalTest {
+protected:
+  void configure(ServerConfig& config) override {
+    unix_path_ = (std::filesystem::temp_directory_path() / ("booking_" + std::to_string(port_) + ".sock")).string();
+    config.unix_socket_path = unix_path_;
+  }
+};
+
 // ---- Basic JSON Protocol Tests ----
 
 TEST_F(TcpServerFunctionalTest, ListMoviesJSON) {
@@ -171,6 +268,75 @@ TEST_F(TcpServerFunctionalTest, ListSeatsJSON) {
   EXPECT_EQ(resp.at("available_seats").as_array().size(), 20);
 }
 
+TEST_F(TcpServerFunctionalTest, ListSeatsCompactFormats) {
+  json::array seats = {"a2", "b1"};
+  json::value book = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", seats}};
+  ASSERT_EQ(send_and_receive_json(book).at("status").as_string(), "BOOKED");
+
+  json::value req = {{"command", "LIST_SEATS"}, {"theater_id", 1}, {"movie_id", 1}, {"format", "bitmap"}};
+  json::value resp = send_and_receive_json(req);
+  EXPECT_EQ(resp.at("total_available").as_int64(), 18);
+  EXPECT_EQ(resp.at("layout").at("seats_per_row").as_int64(), 5);
+  auto bitmap = base64_decode(resp.at("available").as_string());
+  ASSERT_TRUE(bitmap.has_value());
+  ASSERT_EQ(bitmap->size(), 3u);
+  EXPECT_EQ((*bitmap)[0], 0xDD); // a2 (index 1) and b1 (index 5) taken
+  EXPECT_EQ((*bitmap)[1], 0xFF);
+  EXPECT_EQ((*bitmap)[2], 0x0F);
+
+  // A client holding the layout gets availability only
+  req.as_object()["format"] = "rle";
+  req.as_object()["layout_version"] = resp.at("layout_version");
+  resp = send_and_receive_json(req);
+  EXPECT_FALSE(resp.as_object().contains("layout"));
+  const auto& rows = resp.at("available").as_array();
+  ASSERT_EQ(rows.size(), 4u);
+  EXPECT_EQ(json::serialize(rows[0]), "[1,1,3]");
+  EXPECT_EQ(json::serialize(rows[1]), "[0,1,4]");
+  EXPECT_EQ(json::serialize(rows[3]), "[5]");
+
+  req.as_object()["format"] = "png";
+  EXPECT_EQ(send_and_receive_json(req).at("error").as_string(), "INVALID_REQUEST");
+}
+
+TEST_F(TcpServerFunctionalTest, ConditionalReadsAnswerNotModified) {
+  json::value seats = {{"command", "LIST_SEATS"}, {"theater_id", 1}, {"movie_id", 1}};
+  json::value resp = send_and_receive_json(seats);
+  const std::int64_t seat_version = resp.at("version").as_int64();
+  seats.as_object()["if_version"] = seat_version;
+  resp = send_and_receive_json(seats);
+  EXPECT_EQ(resp.at("status").as_string(), "NOT_MODIFIED");
+  EXPECT_EQ(resp.at("version").as_int64(), seat_version);
+
+  json::value book = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", json::array{"a1"}}};
+  ASSERT_EQ(send_and_receive_json(book).at("status").as_string(), "BOOKED");
+  resp = send_and_receive_json(seats);
+  EXPECT_EQ(resp.at("total_available").as_int64(), 19);
+  EXPECT_GT(resp.at("version").as_int64(), seat_version);
+  seats.as_object()["format"] = "bitmap";  // Every format carries the same version
+  seats.as_object()["if_version"] = resp.at("version");
+  EXPECT_EQ(send_and_receive_json(seats).at("status").as_string(), "NOT_MODIFIED");
+
+  // A showing that does not exist has no version to match
+  json::value missing = {{"command", "LIST_SEATS"}, {"theater_id", 2}, {"movie_id", 1}, {"if_version", 0}};
+  EXPECT_EQ(send_and_receive_json(missing).at("error").as_string(), "INVALID_REQUEST");
+  missing = {{"command", "LIST_SEATS"}, {"theater_id", 2}, {"movie_id", 1}};
+  EXPECT_EQ(send_and_receive_json(missing).at("error").as_string(), "INVALID_REQUEST");
+
+  // Bookings leave the catalog version alone
+  json::value movies = {{"command", "LIST_MOVIES"}};
+  const std::int64_t catalog_version = send_and_receive_json(movies).at("version").as_int64();
+  movies.as_object()["if_version"] = catalog_version;
+  EXPECT_EQ(send_and_receive_json(movies).at("status").as_string(), "NOT_MODIFIED");
+  json::value theaters = {{"command", "LIST_THEATERS"}, {"movie_id", 2}, {"if_version", catalog_version}};
+  EXPECT_EQ(send_and_receive_json(theaters).at("status").as_string(), "NOT_MODIFIED");
+
+  admin_service_->add_movie(Movie(3, "Memento"));
+  resp = send_and_receive_json(movies);
+  EXPECT_EQ(resp.at("movies").as_array().size(), 3u);
+  EXPECT_GT(resp.at("version").as_int64(), catalog_version);
+}
+
 TEST_F(TcpServerFunctionalTest, BookSeatsJSON_Success) {
   json::array seats = {"a1", "a2"};
   json::value req = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", seats}};
@@ -193,14 +359,581 @@ TEST_F(TcpServerFunctionalTest, BookSeatsJSON_Failure) {
   EXPECT_EQ(resp2.at("status").as_string(), "FAILED");
 }
 
+TEST_F(TcpServerFunctionalTest, ListMoviesPaginatedJSON) {
+  json::value first_req = {{"command", "LIST_MOVIES"}, {"limit", 1}};
+  json::value first = send_and_receive_json(first_req);
+  
+  ASSERT_FALSE(first.as_object().contains("error"));
+  ASSERT_EQ(first.at("movies").as_array().size(), 1);
+  EXPECT_EQ(first.at("next_after_id").as_int64(), 1);
+  
+  json::value next_req = {{"command", "LIST_MOVIES"}, {"limit", 1},
+                          {"after_id", first.at("next_after_id")}, {"fields", json::array{"id"}}};
+  json::value next = send_and_receive_json(next_req);
+  
+  ASSERT_FALSE(next.as_object().contains("error"));
+  auto& arr = next.at("movies").as_array();
+  ASSERT_EQ(arr.size(), 1);
+  EXPECT_EQ(arr[0].at("id").as_int64(), 2);
+  EXPECT_FALSE(arr[0].as_object().contains("name"));
+  EXPECT_FALSE(next.as_object().contains("next_after_id"));
+}
+
+TEST_F(TcpServerFunctionalTest, SearchMoviesJSON) {
+  json::value req = {{"command", "SEARCH_MOVIES"}, {"query", "matr"}, {"limit", 5}};
+  json::value resp = send_and_receive_json(req);
+  
+  ASSERT_FALSE(resp.as_object().contains("error"));
+  auto& arr = resp.at("movies").as_array();
+  ASSERT_EQ(arr.size(), 1);
+  EXPECT_EQ(arr[0].at("name").as_string(), "The Matrix");
+}
+
+TEST_F(TcpServerUnixSocketTest, BookRetryWithRequestIdReplays) {
+  json::array seats = {"a4"};
+  json::value req = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1},
+                     {"seats", seats}, {"request_id", "gw-7f3a"}};
+  
+  auto first = send_and_receive_json(req);
+  auto retry = send_and_receive_json(req);
+  
+  EXPECT_EQ(first.at("status").as_string(), "BOOKED");
+  EXPECT_EQ(retry.at("status").as_string(), "BOOKED");
+  EXPECT_EQ(json::serialize(first), json::serialize(retry));
+  
+  // Without the request id the same seats are genuinely taken
+  json::value plain = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", seats}};
+  EXPECT_EQ(send_and_receive_json(plain).at("status").as_string(), "FAILED");
+
+  // The id names that booking only: other seats under it are refused, not answered with a4
+  req.as_object()["seats"] = json::array{"a5"};
+  auto reused = send_and_receive_json(req);
+  EXPECT_EQ(reused.at("error").as_string(), "REQUEST_ID_CONFLICT");
+  EXPECT_EQ(reused.at("request_id").as_string(), "gw-7f3a");
+
+  // Seat lists that only differ in where the ids split are different bookings too
+  json::value joined = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1},
+                        {"seats", json::array{"b1:b2"}}, {"request_id", "gw-8c1d"}};
+  EXPECT_EQ(send_and_receive_json(joined).at("status").as_string(), "FAILED");
+  joined.as_object()["seats"] = json::array{"b1", "b2"};
+  EXPECT_EQ(send_and_receive_json(joined).at("error").as_string(), "REQUEST_ID_CONFLICT");
+
+  // Another client (the Unix socket is "local") has its own ids
+  boost::asio::io_context ctx;
+  boost::asio::local::stream_protocol::socket local(ctx);
+  local.connect(boost::asio::local::stream_protocol::endpoint(unix_path_));
+  boost::asio::write(local, boost::asio::buffer(json::serialize(req) + "\n"));
+  boost::asio::streambuf buf;
+  boost::asio::read_until(local, buf, "\n");
+  std::istream is(&buf);
+  std::string line;
+  std::getline(is, line);
+  EXPECT_EQ(json::parse(line).at("status").as_string(), "BOOKED") << line;
+}
+
+TEST_F(TcpServerFunctionalTest, LookupAndCancelBookingJSON) {
+  json::array seats = {"c1", "c2"};
+  json::value book_req = {{"command", "BOOK"}, {"theater_id", 2}, {"movie_id", 2}, {"seats", seats}};
+  auto booked = send_and_receive_json(book_req);
+  ASSERT_EQ(booked.at("status").as_string(), "BOOKED");
+  json::value code = booked.at("confirmation");
+  
+  auto found = send_and_receive_json({{"command", "LOOKUP_BOOKING"}, {"confirmation", code}});
+  EXPECT_EQ(found.at("status").as_string(), "FOUND");
+  EXPECT_EQ(found.at("theater_id").as_int64(), 2);
+  EXPECT_EQ(found.at("seats").as_array().size(), 2);
+  
+  auto cancelled = send_and_receive_json({{"command", "CANCEL"}, {"confirmation", code}});
+  EXPECT_EQ(cancelled.at("status").as_string(), "CANCELLED");
+  auto again = send_and_receive_json({{"command", "CANCEL"}, {"confirmation", code}});
+  EXPECT_EQ(again.at("status").as_string(), "NOT_FOUND");
+  
+  // The seats are back in the inventory
+  EXPECT_EQ(send_and_receive_json(book_req).at("status").as_string(), "BOOKED");
+}
+
+TEST_F(TcpServerWaitingRoomTest, WaitingRoomAdmitsInJoinOrder) {
+  json::value join_req = {{"command", "JOIN_QUEUE"}, {"theater_id", 1}, {"movie_id", 2}};
+  auto first = send_and_receive_json(join_req);
+  auto second = send_and_receive_json(join_req);
+  ASSERT_EQ(first.at("status").as_string(), "ADMITTED");
+  ASSERT_EQ(second.at("status").as_string(), "WAITING");
+  EXPECT_EQ(second.at("position").as_int64(), 1);
+  
+  // While someone waits, booking without an admitted token would jump the queue
+  json::array seats = {"b1"};
+  json::value book_req = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 2}, {"seats", seats}};
+  auto jumped = send_and_receive_json(book_req);
+  EXPECT_EQ(jumped.at("status").as_string(), "NOT_ADMITTED");
+  EXPECT_EQ(jumped.at("reason").as_string(), "QUEUE_REQUIRED");
+  
+  book_req.as_object()["queue_token"] = second.at("queue_token");
+  EXPECT_EQ(send_and_receive_json(book_req).at("reason").as_string(), "WAITING");
+  book_req.as_object()["queue_token"] = first.at("queue_token");
+  EXPECT_EQ(send_and_receive_json(book_req).at("status").as_string(), "BOOKED");
+  
+  // A token books once; a failed booking would have given it back
+  book_req.as_object()["seats"] = json::array{"b2"};
+  EXPECT_EQ(send_and_receive_json(book_req).at("reason").as_string(), "USED");
+  
+  // Tokens are bound to their showing
+  auto other = send_and_receive_json({{"command", "QUEUE_STATUS"}, {"theater_id", 2}, {"movie_id", 2},
+                                      {"queue_token", first.at("queue_token")}});
+  EXPECT_EQ(other.at("status").as_string(), "INVALID_TOKEN");
+  
+  // Other showings are not gated, and with nobody queued a stale token is simply ignored
+  json::value walk_in = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", seats},
+                         {"queue_token", "stale"}};
+  EXPECT_EQ(send_and_receive_json(walk_in).at("status").as_string(), "BOOKED");
+}
+
+TEST_F(TcpServerFunctionalTest, RateLimitsShedBeforeParsing) {
+  RateLimits limits;
+  limits.connection_rate = 0;
+  limits.client_rate = 1;
+  limits.client_burst = 2;
+  server_->set_rate_limits(limits);
+  
+  // The client bucket is shared by every connection from 127.0.0.1
+  json::value req = {{"command", "LIST_MOVIES"}};
+  EXPECT_TRUE(send_and_receive_json(req).as_object().contains("movies"));
+  EXPECT_TRUE(send_and_receive_json(req).as_object().contains("movies"));
+  EXPECT_EQ(send_and_receive_json(req).at("error").as_string(), "OVERLOADED");
+  
+  // Limits can be lifted on the running server
+  limits.client_rate = 0;
+  limits.max_sessions = 1;
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Let the shed session close first
+  server_->set_rate_limits(limits);
+  EXPECT_TRUE(send_and_receive_json(req).as_object().contains("movies"));
+  
+  // With one session open, the next connection is turned away at accept
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Let the previous session close
+  boost::asio::io_context ctx;
+  tcp::socket held(ctx);
+  held.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port_));
+  boost::asio::write(held, boost::asio::buffer(json::serialize(req) + "\n"));
+  boost::asio::streambuf buf;
+  boost::asio::read_until(held, buf, "\n");
+  std::istream is(&buf);
+  std::string line;
+  std::getline(is, line);
+  EXPECT_TRUE(json::parse(line).as_object().contains("movies"));
+  EXPECT_EQ(send_and_receive_json(req).at("error").as_string(), "OVERLOADED");
+}
+
+TEST_F(TcpServerObservabilityTest, StatsAndPrometheusReportRequests) {
+  json::value book = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", json::array{"a1"}}};
+  EXPECT_EQ(send_and_receive_json(book).at("status").as_string(), "BOOKED");
+  EXPECT_EQ(send_and_receive_json(book).at("status").as_string(), "FAILED");
+  json::value list = {{"command", "LIST_MOVIES"}};
+  send_and_receive_json(list);
+  
+  json::value stats_req = {{"command", "STATS"}};
+  json::value stats = send_and_receive_json(stats_req);
+  ASSERT_TRUE(stats.as_object().contains("commands")) << json::serialize(stats);
+  EXPECT_EQ(stats.at("commands").at("BOOK").at("requests").to_number<std::int64_t>(), 2);
+  EXPECT_EQ(stats.at("commands").at("LIST_MOVIES").at("requests").to_number<std::int64_t>(), 1);
+  EXPECT_TRUE(stats.at("commands").at("BOOK").at("latency_us").as_object().contains("write"));
+  EXPECT_EQ(stats.at("bookings").at("succeeded").to_number<std::int64_t>(), 1);
+  EXPECT_EQ(stats.at("bookings").at("failed").to_number<std::int64_t>(), 1);
+  EXPECT_GE(stats.at("connections").at("total").to_number<std::int64_t>(), 4);
+  EXPECT_EQ(stats.as_object().contains("lock_contention"), kLockProfilingEnabled);
+  
+  // Same figures on the Prometheus listener
+  const std::string page = http_get("/metrics");
+  EXPECT_EQ(page.rfind("HTTP/1.1 200 OK\r\n", 0), 0);
+  EXPECT_NE(page.find("booking_requests_total{command=\"BOOK\"} 2\n"), std::string::npos);
+  EXPECT_NE(page.find("booking_bookings_total{result=\"success\"} 1\n"), std::string::npos);
+}
+
+TEST_F(TcpServerObservabilityTest, TraceEndpointServesChromeTrace) {
+  json::value req = {{"command", "LIST_SEATS"}, {"theater_id", 1}, {"movie_id", 1}};
+  ASSERT_TRUE(send_and_receive_json(req).as_object().contains("available_seats"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // The write span ends after the reply
+  
+  const std::string response = http_get("/trace");
+  ASSERT_EQ(response.rfind("HTTP/1.1 200 OK\r\n", 0), 0);
+  json::value trace = json::parse(response.substr(response.find("\r\n\r\n") + 4));
+  std::set<std::string> spans;
+  for (const auto& event : trace.at("traceEvents").as_array()) {
+    const auto& args = event.at("args").as_object();
+    if (const auto* command = args.if_contains("command"); command && command->as_string() == "LIST_SEATS") {
+      spans.insert(json::value_to<std::string>(event.at("name")));
+    } else if (!args.contains("command") && args.contains("session")) {
+      spans.insert(json::value_to<std::string>(event.at("name")));
+    }
+  }
+  for (const char* span : {"accept", "pool_queue", "request", "parse", "service", "serialize", "write"}) {
+    EXPECT_TRUE(spans.count(span)) << span;
+  }
+  EXPECT_EQ(http_get("/nope").rfind("HTTP/1.1 404", 0), 0);
+}
+
+TEST_F(TcpServerCaptureTest, CaptureRecordsSessionTraffic) {
+  boost::asio::io_context ctx;
+  tcp::socket socket(ctx);
+  socket.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port_));
+  const std::string list_movies = "{\"command\":\"LIST_MOVIES\"}";
+  const std::string book = "{\"command\":\"BOOK\",\"theater_id\":1,\"movie_id\":1,\"seats\":[\"b3\"]}";
+  boost::asio::streambuf buf;
+  std::vector<std::string> responses;
+  for (const std::string& request : {list_movies, book}) {
+    boost::asio::write(socket, boost::asio::buffer(request + "\n"));
+    std::string& response = responses.emplace_back();
+    while (response.empty()) { // Skip the blank line that follows each response
+      boost::asio::read_until(socket, buf, "\n");
+      std::istream is(&buf);
+      std::getline(is, response);
+    }
+  }
+  socket.close();
+
+  // Close is recorded once the server notices the hangup, then written within a few ms
+  std::vector<CaptureRecord> session;
+  for (int attempt = 0; attempt < 100 && (session.empty() || session.back().kind != CaptureKind::Close); ++attempt) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const CaptureFile capture = TrafficCapture::read_file(capture_path_);
+    session.clear();
+    for (const auto& record : capture.records) {
+      if (record.kind == CaptureKind::Request && record.payload == list_movies) {
+        session.clear();
+        std::copy_if(capture.records.begin(), capture.records.end(), std::back_inserter(session),
+                     [&record](const CaptureRecord& r) { return r.connection == record.connection; });
+      }
+    }
+  }
+  ASSERT_EQ(session.size(), 6u);
+  const CaptureKind kinds[] = {CaptureKind::Open, CaptureKind::Request, CaptureKind::Response,
+                               CaptureKind::Request, CaptureKind::Response, CaptureKind::Close};
+  for (std::size_t i = 0; i < session.size(); ++i) {
+    EXPECT_EQ(session[i].kind, kinds[i]) << i;
+    EXPECT_GE(session[i].offset_ns, i ? session[i - 1].offset_ns : 0);
+  }
+  EXPECT_EQ(session[3].payload, book);
+  EXPECT_EQ(session[2].payload, responses[0]);
+  EXPECT_EQ(session[4].payload, responses[1]);
+}
+
+TEST_F(TcpServerFunctionalTest, BatchAnswersEveryEntryInOrder) {
+  json::value req = {{"command", "BATCH"}, {"requests", json::array{
+    json::object{{"command", "LIST_THEATERS"}, {"movie_id", 2}},
+    json::object{{"command", "LIST_SEATS"}, {"theater_id", 1}, {"movie_id", 2}},
+    json::object{{"command", "LIST_SEATS"}, {"theater_id", 1}},
+    json::object{{"command", "NOPE"}}
+  }}};
+  json::value resp = send_and_receive_json(req);
+  const auto& responses = resp.at("responses").as_array();
+  ASSERT_EQ(responses.size(), 4u);
+  EXPECT_EQ(responses[0].at("theaters").as_array().size(), 2u);
+  EXPECT_EQ(responses[1].at("total_available").as_int64(), 20);
+  EXPECT_EQ(responses[2].at("message").as_string(), "missing field: movie_id");
+  EXPECT_EQ(responses[3].at("error").as_string(), "UNKNOWN_COMMAND");
+
+  json::value nested = {{"command", "BATCH"}, {"requests", json::array{req.as_object()}}};
+  EXPECT_EQ(send_and_receive_json(nested).at("responses").as_array()[0].at("message").as_string(),
+            "BATCH cannot be nested");
+}
+
+TEST_F(TcpServerFunctionalTest, AtomicBatchBooksAllOrNothing) {
+  auto book = [](int theater_id, const char* seat) {
+    return json::object{{"command", "BOOK"}, {"theater_id", theater_id}, {"movie_id", 2}, {"seats", json::array{seat}}};
+  };
+  json::value failing = {{"command", "BATCH"}, {"atomic", true},
+                         {"requests", json::array{book(1, "a1"), book(2, "a1"), book(1, "zz9")}}};
+  json::value resp = send_and_receive_json(failing);
+  EXPECT_EQ(resp.at("status").as_string(), "FAILED");
+  EXPECT_EQ(resp.at("responses").as_array().size(), 3u);
+
+  // Rolled back: the same seats can still be booked
+  json::value ok = {{"command", "BATCH"}, {"atomic", true}, {"requests", json::array{book(1, "a1"), book(2, "a1")}}};
+  resp = send_and_receive_json(ok);
+  ASSERT_EQ(resp.at("status").as_string(), "BOOKED");
+  EXPECT_TRUE(resp.at("responses").as_array()[1].as_object().contains("confirmation"));
+
+  json::value mixed = {{"command", "BATCH"}, {"atomic", true},
+                       {"requests", json::array{book(1, "a2"), json::object{{"command", "LIST_MOVIES"}}}}};
+  EXPECT_EQ(send_and_receive_json(mixed).at("error").as_string(), "INVALID_REQUEST");
+}
+
 // ---- Error Handling Tests ----
 
+TEST_F(TcpServerFunctionalTest, SubscribeSeatsPushesCoalescedDeltas) {
+  boost::asio::io_context ctx;
+  tcp::socket socket(ctx);
+  socket.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port_));
+  boost::asio::write(socket, boost::asio::buffer(std::string(R"({"command":"SUBSCRIBE_SEATS","theater_id":1,"movie_id":1})") + "\n"));
+  boost::asio::streambuf buf;
+  auto next_line = [&]() -> json::value {
+    const std::string text = read_line_within(ctx, socket, buf);
+    if (text == "TIMEOUT") {
+      return json::object{{"error", "TIMEOUT"}};
+    }
+    return json::parse(text);
+  };
+
+  json::value ack = next_line();
+  ASSERT_EQ(ack.at("status").as_string(), "SUBSCRIBED");
+  json::value snapshot = next_line();
+  ASSERT_EQ(snapshot.at("event").as_string(), "SEATS_SNAPSHOT");
+  EXPECT_EQ(snapshot.at("total_available").as_int64(), 20);
+
+  json::value book = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", json::array{"a1", "a2"}}};
+  ASSERT_EQ(send_and_receive_json(book).at("status").as_string(), "BOOKED");
+  book.as_object()["seats"] = json::array{"b1"};
+  ASSERT_EQ(send_and_receive_json(book).at("status").as_string(), "BOOKED");
+
+  // Both bookings arrive, in one event or two depending on the window they fell in
+  std::vector<std::int64_t> booked;
+  std::int64_t total_available = 0;
+  while (booked.size() < 3) {
+    json::value delta = next_line();
+    ASSERT_EQ(delta.at("event").as_string(), "SEATS_CHANGED") << json::serialize(delta);
+    for (const auto& index : delta.at("booked").as_array()) booked.push_back(index.as_int64());
+    EXPECT_TRUE(delta.at("released").as_array().empty());
+    total_available = delta.at("total_available").as_int64();
+  }
+  EXPECT_EQ(booked, (std::vector<std::int64_t>{0, 1, 5}));
+  EXPECT_EQ(total_available, 17);
+
+  json::value stats = send_and_receive_json({{"command", "STATS"}});
+  EXPECT_EQ(stats.at("subscriptions").at("active").as_int64(), 1);
+
+  json::value missing = {{"command", "SUBSCRIBE_SEATS"}, {"theater_id", 2}, {"movie_id", 1}};
+  EXPECT_EQ(send_and_receive_json(missing).at("error").as_string(), "INVALID_REQUEST");
+  json::value batch = {{"command", "BATCH"}, {"requests", json::array{
+    {{"command", "SUBSCRIBE_SEATS"}, {"theater_id", 1}, {"movie_id", 1}}}}};
+  EXPECT_EQ(send_and_receive_json(batch).at("responses").at(0).at("error").as_string(), "INVALID_REQUEST");
+}
+
+TEST_F(TcpServerUnixSocketTest, UnixSocketServesTheSameProtocol) {
+  EXPECT_EQ(server_->port(), port_);
+  boost::asio::io_context ctx;
+  boost::asio::local::stream_protocol::socket socket(ctx);
+  socket.connect(boost::asio::local::stream_protocol::endpoint(unix_path_));
+  boost::asio::streambuf buf;
+  auto exchange = [&](const json::value& request) {
+    boost::asio::write(socket, boost::asio::buffer(json::serialize(request) + "\n"));
+    const std::size_t n = boost::asio::read_until(socket, buf, "\n\n"); // Response, then its blank line
+    std::string line(boost::asio::buffers_begin(buf.data()), boost::asio::buffers_begin(buf.data()) + n);
+    buf.consume(n);
+    return json::parse(line);
+  };
+
+  EXPECT_EQ(exchange({{"command", "LIST_MOVIES"}}).at("movies").as_array().size(), 2u);
+  json::value book = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", json::array{"a1"}}};
+  EXPECT_EQ(exchange(book).at("status").as_string(), "BOOKED");
+  // Both listeners share one inventory
+  EXPECT_EQ(send_and_receive_json(book).at("status").as_string(), "FAILED");
+  EXPECT_EQ(exchange({{"command", "FOO"}}).at("error").as_string(), "UNKNOWN_COMMAND");
+}
+
+TEST_F(TcpServerUnixSocketTest, UnixSocketPathInUseFailsStartup) {
+  boost::asio::io_context server_ctx;
+  ServerConfig config;
+  config.unix_socket_path = unix_path_;
+  EXPECT_THROW(TcpServer(server_ctx, 0, *booking_service_, *admin_service_, 1, config), std::runtime_error);
+  // The running server keeps its socket
+  boost::asio::io_context ctx;
+  boost::asio::local::stream_protocol::socket socket(ctx);
+  EXPECT_NO_THROW(socket.connect(boost::asio::local::stream_protocol::endpoint(unix_path_)));
+
+  // Nor is a file that is not a socket replaced
+  const auto file = std::filesystem::temp_directory_path() / ("booking_" + std::to_string(port_) + ".txt");
+  std::ofstream(file) << "keep";
+  config.unix_socket_path = file.string();
+  EXPECT_THROW(TcpServer(server_ctx, 0, *booking_service_, *admin_service_, 1, config), std::runtime_error);
+  EXPECT_TRUE(std::filesystem::exists(file));
+  std::filesystem::remove(file);
+
+  // A socket nobody listens on anymore is stale and replaced
+  const auto stale = std::filesystem::temp_directory_path() / ("booking_stale_" + std::to_string(port_) + ".sock");
+  {
+    boost::asio::local::stream_protocol::acceptor left_behind(ctx, stale.string());
+  }
+  ASSERT_TRUE(std::filesystem::exists(stale));
+  config.unix_socket_path = stale.string();
+  EXPECT_NO_THROW(TcpServer(server_ctx, 0, *booking_service_, *admin_service_, 1, config));
+  std::filesystem::remove(stale);
+}
+
+TEST_F(TcpServerFunctionalTest, IoUringBackendServesTheSameProtocol) {
+  // A second server on the same inventory, on io_uring where this build and kernel have it
+  boost::asio::io_context server_ctx;
+  auto work = boost::asio::make_work_guard(server_ctx);  // The rings leave the io_context idle
+  ServerConfig config;
+  config.network_backend = NetworkBackend::IoUring;
+  config.io_uring_rings = 2;
+  TcpServer server(server_ctx, 0, *booking_service_, *admin_service_, 2, config);
+  server.start();
+  std::thread server_thread([&server_ctx]() { server_ctx.run(); });
+
+  boost::asio::io_context ctx;
+  tcp::socket socket(ctx);
+  socket.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), server.port()));
+  boost::asio::streambuf buf;
+  auto next_line = [&]() -> json::value {
+    const std::string text = read_line_within(ctx, socket, buf);
+    if (text == "TIMEOUT") {
+      return json::object{{"error", "TIMEOUT"}};
+    }
+    return json::parse(text);
+  };
+
+  const bool uring = UringTransport::available();
+  boost::asio::write(socket, boost::asio::buffer(std::string(R"({"command":"STATS"})") + "\n"));
+  EXPECT_EQ(next_line().at("transport").as_string(), uring ? "io_uring" : "asio");
+
+  // Pipelined requests in one segment, one of them split across two
+  boost::asio::write(socket, boost::asio::buffer(std::string(
+    R"({"command":"LIST_MOVIES"})" "\n" R"({"command":"BOOK","theater_id":1,"movie_id":1,)")));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  boost::asio::write(socket, boost::asio::buffer(std::string(R"("seats":["a1"]})") + "\n"));
+  EXPECT_EQ(next_line().at("movies").as_array().size(), 2u);
+  EXPECT_EQ(next_line().at("status").as_string(), "BOOKED");
+  json::value book = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", json::array{"a1"}}};
+  EXPECT_EQ(send_and_receive_json(book).at("status").as_string(), "FAILED");
+
+  // SUBSCRIBE_SEATS hands the connection over to the seat subscriptions
+  boost::asio::write(socket, boost::asio::buffer(std::string(R"({"command":"SUBSCRIBE_SEATS","theater_id":1,"movie_id":1})") + "\n"));
+  ASSERT_EQ(next_line().at("status").as_string(), "SUBSCRIBED");
+  ASSERT_EQ(next_line().at("event").as_string(), "SEATS_SNAPSHOT");
+  book.as_object()["seats"] = json::array{"a2"};
+  ASSERT_EQ(send_and_receive_json(book).at("status").as_string(), "BOOKED");
+  json::value delta = next_line();
+  ASSERT_EQ(delta.at("event").as_string(), "SEATS_CHANGED") << json::serialize(delta);
+  EXPECT_EQ(json::serialize(delta.at("booked")), "[1]");
+
+  socket.close();
+  work.reset();
+  server_ctx.stop();
+  server_thread.join();
+}
+
+TEST_F(TcpServerFunctionalTest, SessionLimitsReapSlowAndOversizedClients) {
+  for (const NetworkBackend backend : {NetworkBackend::Asio, NetworkBackend::IoUring}) {
+    SCOPED_TRACE(backend == NetworkBackend::Asio ? "asio" : "io_uring");
+    boost::asio::io_context server_ctx;
+    auto work = boost::asio::make_work_guard(server_ctx);
+    ServerConfig config;
+    config.network_backend = backend;
+    config.io_uring_rings = 1;
+    config.rate_limits.connection_rate = 0;
+    config.rate_limits.client_rate = 0;
+    config.session_limits.idle_timeout = std::chrono::milliseconds(300);
+    config.session_limits.write_timeout = std::chrono::milliseconds(300);
+    config.session_limits.max_request_bytes = 4096;
+    config.reaper_tick = std::chrono::milliseconds(50);
+    TcpServer server(server_ctx, 0, *booking_service_, *admin_service_, 2, config);
+    server.start();
+    std::thread server_thread([&server_ctx]() { server_ctx.run(); });
+    const tcp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"), server.port());
+    boost::asio::io_context ctx;
+
+    // Whatever the server sends until it closes the connection, or TIMEOUT
+    auto read_to_end = [&ctx](tcp::socket& socket) {
+      std::string received;
+      boost::asio::async_read(socket, boost::asio::dynamic_buffer(received),
+                              [](boost::system::error_code, std::size_t) {});
+      if (!run_within(ctx, socket, std::chrono::seconds(3))) {
+        return std::string("TIMEOUT");
+      }
+      return received;
+    };
+
+    // A silent client, and one that goes silent after a request, are closed after the idle timeout
+    tcp::socket silent(ctx);
+    silent.connect(endpoint);
+    tcp::socket idle(ctx);
+    idle.connect(endpoint);
+    boost::asio::write(idle, boost::asio::buffer(std::string(R"({"command":"LIST_MOVIES"})") + "\n"));
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(read_to_end(silent), "");
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(250));
+    EXPECT_NE(read_to_end(idle).find("movies"), std::string::npos);
+
+    // A line over the limit is answered and the connection closed
+    tcp::socket oversized(ctx);
+    oversized.connect(endpoint);
+    boost::asio::write(oversized, boost::asio::buffer(std::string(5000, 'x')));
+    const std::string rejected = read_to_end(oversized);
+    ASSERT_NE(rejected, "TIMEOUT");
+    const json::value error = json::parse(rejected.substr(0, rejected.find('\n')));
+    EXPECT_EQ(error.at("error").as_string(), "REQUEST_TOO_LARGE");
+    EXPECT_EQ(error.at("max_bytes").as_int64(), 4096);
+
+    // A client that never reads its responses is closed after the write timeout
+    tcp::socket stalled(ctx);
+    stalled.open(tcp::v4());
+    stalled.set_option(boost::asio::socket_base::receive_buffer_size(4096));
+    stalled.connect(endpoint);
+    json::array entries;
+    for (int i = 0; i < 32; ++i) {
+      entries.push_back(json::object{{"command", "LIST_SEATS"}, {"theater_id", 1}, {"movie_id", 1}});
+    }
+    const std::string batch = json::serialize(json::object{{"command", "BATCH"}, {"requests", entries}}) + "\n";
+    std::function<void(boost::system::error_code, std::size_t)> write_next =
+      [&](boost::system::error_code ec, std::size_t) {
+        if (!ec) {
+          boost::asio::async_write(stalled, boost::asio::buffer(batch), write_next);
+        }
+      };
+    boost::asio::async_write(stalled, boost::asio::buffer(batch), write_next);
+    EXPECT_TRUE(run_within(ctx, stalled, std::chrono::seconds(5)));  // Writes until the server closes it
+
+    tcp::socket probe(ctx);
+    probe.connect(endpoint);
+    boost::asio::write(probe, boost::asio::buffer(std::string(R"({"command":"STATS"})") + "\n"));
+    boost::asio::streambuf buf;
+    boost::asio::read_until(probe, buf, "\n");
+    std::istream is(&buf);
+    std::string line;
+    std::getline(is, line);
+    const json::value stats = json::parse(line);
+    EXPECT_GE(stats.at("timeouts").at("idle").to_number<std::int64_t>(), 2) << line;
+    EXPECT_GE(stats.at("timeouts").at("write").to_number<std::int64_t>(), 1) << line;
+    EXPECT_EQ(stats.at("oversized_requests").to_number<std::int64_t>(), 1) << line;
+
+    stalled.close();
+    probe.close();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Let the probe's session close
+    work.reset();
+    server_ctx.stop();
+    server_thread.join();
+  }
+}
+
 TEST_F(TcpServerFunctionalTest, UnknownCommandJSON) {
   json::value req = {{"command", "INVALID_COMMAND"}};
   json::value resp = send_and_receive_json(req);
   
   ASSERT_TRUE(resp.as_object().contains("error"));
   EXPECT_EQ(resp.at("error").as_string(), "UNKNOWN_COMMAND");
+  EXPECT_EQ(resp.at("received_command").as_string(), "INVALID_COMMAND");
+  EXPECT_EQ(resp.at("valid_commands").as_array().size(), kCommandCount);
+}
+
+TEST_F(TcpServerFunctionalTest, SchemaErrorsNameTheField) {
+  json::value missing_req = {{"command", "LIST_SEATS"}, {"theater_id", 1}};
+  json::value missing = send_and_receive_json(missing_req);
+  EXPECT_EQ(missing.at("error").as_string(), "INVALID_REQUEST");
+  EXPECT_EQ(missing.at("message").as_string(), "missing field: movie_id");
+  EXPECT_EQ(missing.at("sample_format").as_object().size(), kCommandCount);
+
+  json::value mistyped_req = {{"command", "BOOK"}, {"theater_id", 1}, {"movie_id", 1}, {"seats", json::array{"a1", 2}}};
+  json::value mistyped = send_and_receive_json(mistyped_req);
+  EXPECT_EQ(mistyped.at("message").as_string(), "seats must be an array of strings");
+
+  // 2^32 + 1 would truncate to theater 1; ids outside int are refused, in and out of atomic batches
+  constexpr std::int64_t kWideId = 4294967297LL;
+  json::value wide_req = {{"command", "BOOK"}, {"theater_id", kWideId}, {"movie_id", 1}, {"seats", json::array{"a1"}}};
+  json::value wide = send_and_receive_json(wide_req);
+  EXPECT_EQ(wide.at("error").as_string(), "INVALID_REQUEST");
+  EXPECT_EQ(wide.at("message").as_string(), "theater_id is out of range");
+  json::value atomic = {{"command", "BATCH"}, {"atomic", true}, {"requests", json::array{wide_req}}};
+  EXPECT_EQ(send_and_receive_json(atomic).at("error").as_string(), "INVALID_REQUEST");
+  json::value page = {{"command", "LIST_MOVIES"}, {"after_id", -kWideId}};
+  EXPECT_EQ(send_and_receive_json(page).at("message").as_string(), "after_id is out of range");
 }
 
 TEST_F(TcpServerFunctionalTest, MalformedJSONHandling) {
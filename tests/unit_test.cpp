@@ -15,6 +15,15 @@
 #include <future>
 #include <chrono>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <filesystem>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include "Models/Movie.h"
 #include "Models/Seat.h"
@@ -22,6 +31,24 @@
 #include "Models/BookingService.h"
 #include "Models/AdministrationService.h"
 #include "Models/CentralDataStore.h"
+#include "Models/TitleIndex.h"
+#include "Models/BookingLedger.h"
+#include "Utils/Base64.h"
+#include "Utils/DedupTable.h"
+#include "Utils/LatencyHistogram.h"
+#include "Controller/ServerMetrics.h"
+#include "Controller/RequestTracer.h"
+#include "Controller/RequestArena.h"
+#include "Controller/CommandTable.h"
+#include "Controller/SeatSubscriptions.h"
+#include "Controller/RequestScanner.h"
+#include "Utils/LockProfiler.h"
+#include "Utils/SipHash.h"
+#include "Utils/Logger.h"
+#include "Utils/TrafficCapture.h"
+#include "Controller/WaitingRoom.h"
+#include "Controller/LoadShedder.h"
+#include "Controller/ConnectionReaper.h"
 
 // ---- Movie Tests ----
 TEST(MovieTest, ConstructorAndGetters) {
@@ -50,6 +77,14 @@ TEST(SeatTest, BookSeatTwiceFails) {
   EXPECT_FALSE(s.book()); // Second booking should fail
 }
 
+TEST(SeatTest, ReleaseOnlyBookedSeat) {
+  Seat s("a4");
+  EXPECT_FALSE(s.release()); // Nothing to release yet
+  EXPECT_TRUE(s.book());
+  EXPECT_TRUE(s.release());
+  EXPECT_TRUE(s.is_available());
+}
+
 // ---- Theater Tests ----
 TEST(TheaterTest, ConstructorAndGetters) {
   Theater t(1, "Grand Cinema");
@@ -104,6 +139,196 @@ TEST(TheaterTest, BookSeatsFailureNonExistentSeat) {
   EXPECT_FALSE(t.book_seats(m.get_id(), {"f1"})); // f1 doesn't exist in 5x4 grid
 }
 
+TEST(TheaterTest, BookSeatsFailureDuplicateSeat) {
+  Theater t(5, "Tiny Cinema");
+  t.add_movie(Movie(99, "Short Film"));
+  EXPECT_FALSE(t.book_seats(99, {"a1", "b2", "a1"}));
+  // Nothing was booked halfway, so nothing is left unreleasable
+  EXPECT_EQ(t.get_available_seats(99).size(), 20u);
+  EXPECT_EQ(t.seat_version(99), 0u);
+  EXPECT_TRUE(t.book_seats(99, {"a1", "b2"}));
+}
+
+TEST(TheaterTest, SeatIndexRoundTrip) {
+  Theater t(7, "Layout Cinema");
+  t.add_movie(Movie(1, "Layout"));
+  EXPECT_EQ(t.seat_index("a1"), 0);
+  EXPECT_EQ(t.seat_index("b3"), 7); // 5 seats per row
+  EXPECT_EQ(t.seat_label(7), "b3");
+  EXPECT_EQ(t.seat_index("a6"), -1);
+  EXPECT_EQ(t.seat_index("a01"), -1);
+  EXPECT_EQ(t.seat_index("A1"), -1);
+}
+
+TEST(TheaterTest, ReleaseSeatsIsAllOrNothing) {
+  Theater t(8, "Refund Cinema");
+  t.add_movie(Movie(1, "Refund"));
+  EXPECT_TRUE(t.book_seats(1, {"a1", "a2"}));
+  EXPECT_FALSE(t.release_seats(1, {"a1", "a3"})); // a3 was never booked
+  EXPECT_EQ(t.get_available_seats(1).size(), 18);
+  EXPECT_TRUE(t.release_seats(1, {"a1", "a2"}));
+  EXPECT_EQ(t.get_available_seats(1).size(), 20);
+}
+
+TEST(TheaterTest, SeatMapMatchesAvailableSeats) {
+  Theater t(9, "Bitmap Cinema", 23); // 5 seats per row, the last of 5 rows holds 3
+  t.add_movie(Movie(1, "Bitmap"));
+  EXPECT_TRUE(t.book_seats(1, {"a2", "b5", "e3"}));
+  SeatMap map = t.get_seat_map(1);
+  EXPECT_EQ(map.layout.rows, 5);
+  EXPECT_EQ(map.layout.seats_per_row, 5);
+  EXPECT_EQ(map.layout.seat_count, 23);
+  ASSERT_EQ(map.bitmap.size(), 3u);
+  EXPECT_EQ(map.total_available, 20);
+  for (int index = 0; index < 23; ++index) {
+    const auto available = t.get_available_seats(1);
+    const bool listed = std::find(available.begin(), available.end(), t.seat_label(index)) != available.end();
+    EXPECT_EQ(map.is_available(index), listed) << t.seat_label(index);
+  }
+  EXPECT_TRUE(t.get_seat_map(2).bitmap.empty());
+}
+
+TEST(TheaterTest, RejectsSeatCountsOutsideTheLayout) {
+  EXPECT_THROW(Theater(11, "Empty", 0), std::invalid_argument);
+  EXPECT_THROW(Theater(11, "Huge", Theater::kMaxSeats + 1), std::invalid_argument);
+  Theater t(11, "Unscheduled", 20);
+  EXPECT_EQ(t.seat_label(0), ""); // No showing yet, so no layout
+  t.add_movie(Movie(1, "Late"));
+  EXPECT_EQ(t.seat_label(19), "d5");
+  EXPECT_EQ(t.seat_label(20), "");
+  EXPECT_EQ(t.seat_label(-1), "");
+}
+
+TEST(TheaterTest, RowsPastZUseTwoLetters) {
+  Theater t(10, "Big Cinema", 2000); // 45 seats per row in 45 rows: a-z, then aa-as
+  t.add_movie(Movie(1, "Epic"));
+  EXPECT_EQ(t.seat_label(26 * 45), "aa1");
+  EXPECT_EQ(t.seat_label(1999), "as20");
+  EXPECT_EQ(t.seat_index("as20"), 1999);
+  EXPECT_EQ(t.seat_index("z45"), 25 * 45 + 44);
+  EXPECT_EQ(t.seat_index("a46"), -1);
+  EXPECT_EQ(t.seat_index("aa"), -1);
+  EXPECT_TRUE(t.book_seats(1, {"aa1", "as20"}));
+  const SeatMap map = t.get_seat_map(1);
+  EXPECT_EQ(map.layout.rows, 45);
+  EXPECT_EQ(map.total_available, 1998);
+  EXPECT_FALSE(map.is_available(26 * 45));
+  EXPECT_FALSE(map.is_available(1999));
+  EXPECT_TRUE(map.is_available(1998));
+}
+
+TEST(TheaterTest, SeatVersionCountsChanges) {
+  Theater t(9, "Versioned Cinema");
+  t.add_movie(Movie(1, "Versioned"));
+  EXPECT_EQ(t.seat_version(1), 0u);
+  EXPECT_TRUE(t.book_seats(1, {"a1", "a2"}));
+  EXPECT_FALSE(t.book_seats(1, {"a2", "a3"})); // Failed bookings change nothing
+  EXPECT_EQ(t.seat_version(1), 1u);
+  EXPECT_TRUE(t.release_seats(1, {"a1"}));
+  EXPECT_EQ(t.seat_version(1), 2u);
+  EXPECT_EQ(t.get_seat_map(1).version, 2u);
+  EXPECT_FALSE(t.seat_version(2)); // Not shown here
+}
+
+TEST(CentralDataStoreTest, CatalogVersionCountsCatalogChanges) {
+  CentralDataStore store;
+  const std::uint64_t initial = store.get_catalog_version();
+  store.add_movie(Movie(1, "Versioned"));
+  auto theater = std::make_shared<Theater>(1, "Versioned Cinema");
+  store.add_theater(theater);
+  EXPECT_TRUE(store.schedule_movie(1, Movie(1, "Versioned")));
+  EXPECT_FALSE(store.schedule_movie(2, Movie(1, "Versioned"))); // No such theater, no change
+  EXPECT_EQ(store.get_catalog_version(), initial + 3);
+
+  EXPECT_TRUE(store.book_seats(1, 1, {"a1"}));  // Seats have their own version
+  EXPECT_EQ(store.get_catalog_version(), initial + 3);
+  EXPECT_EQ(store.get_seat_version(1, 1), 1u);
+  store.remove_theater(1);
+  EXPECT_EQ(store.get_catalog_version(), initial + 4);
+}
+
+/**
+ * @brief Test that the showing indexes see movies added to a stored theater directly
+ * @test Verifies indexing through ITheater::add_movie, and that removed theaters and
+ *       theaters outliving the store are no longer tracked
+ */
+TEST(CentralDataStoreTest, IndexesMoviesAddedToStoredTheaters) {
+  auto theater = std::make_shared<Theater>(3, "Direct Cinema");
+  {
+    CentralDataStore store;
+    store.add_theater(theater);
+    const std::uint64_t version = store.get_catalog_version();
+    theater->add_movie(Movie(7, "Added Directly"));
+    ASSERT_EQ(store.get_theaters_showing_movie(7).size(), 1u);
+    EXPECT_EQ(store.get_theaters_page(7, CatalogQuery{}).items.front()->get_id(), 3);
+    EXPECT_EQ(store.get_catalog_version(), version + 1);
+
+    store.remove_theater(3);
+    theater->add_movie(Movie(8, "After Removal"));
+    EXPECT_TRUE(store.get_theaters_showing_movie(8).empty());
+    store.add_theater(theater);
+    EXPECT_EQ(store.get_theaters_showing_movie(8).size(), 1u);
+  }
+  theater->add_movie(Movie(9, "After The Store")); // Must not call into the destroyed store
+  EXPECT_TRUE(theater->shows_movie(9));
+}
+
+TEST(SeatSubscriptionsTest, DeltaListsFlippedSeats) {
+  Theater t(9, "Delta Cinema", 23);
+  t.add_movie(Movie(1, "Delta"));
+  EXPECT_TRUE(t.book_seats(1, {"a2", "c1"}));
+  const SeatMap before = t.get_seat_map(1);
+  EXPECT_TRUE(t.book_seats(1, {"a3", "e3"}));
+  EXPECT_TRUE(t.release_seats(1, {"c1"}));
+  const SeatMap after = t.get_seat_map(1);
+
+  const json::value delta = json::parse(SeatSubscriptions::delta_event({9, 1}, before, after));
+  EXPECT_EQ(delta.at("event").as_string(), "SEATS_CHANGED");
+  EXPECT_EQ(delta.at("version").as_int64(), 3);
+  EXPECT_EQ(json::serialize(delta.at("booked")), "[2,22]");  // a3, e3
+  EXPECT_EQ(json::serialize(delta.at("released")), "[10]");   // c1
+  EXPECT_EQ(delta.at("total_available").as_int64(), 20);
+
+  const json::value snapshot = json::parse(SeatSubscriptions::snapshot_event({9, 1}, after));
+  EXPECT_EQ(snapshot.at("event").as_string(), "SEATS_SNAPSHOT");
+  EXPECT_EQ(snapshot.at("layout_version").as_int64(), after.layout.version());
+  EXPECT_EQ(base64_decode(snapshot.at("available").as_string()), after.bitmap);
+}
+
+TEST(Base64Test, RoundTripsEveryPaddingLength) {
+  const std::vector<std::uint8_t> bytes{0x00, 0xFF, 0x10, 0x80, 0x7E};
+  for (std::size_t n = 0; n <= bytes.size(); ++n) {
+    std::string encoded;
+    base64_encode(bytes.data(), n, encoded);
+    EXPECT_EQ(encoded.size(), (n + 2) / 3 * 4);
+    auto decoded = base64_decode(encoded);
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(*decoded, std::vector<std::uint8_t>(bytes.begin(), bytes.begin() + n));
+  }
+  std::string hello;
+  base64_encode(reinterpret_cast<const std::uint8_t*>("hello"), 5, hello);
+  EXPECT_EQ(hello, "aGVsbG8=");
+  EXPECT_FALSE(base64_decode("aGV").has_value());
+  EXPECT_FALSE(base64_decode("a*Vs").has_value());
+}
+
+/**
+ * @brief Test SipHash-2-4 against the reference vectors of its paper
+ * @details Key 00 01 .. 0f; messages 00 01 .. (n-1) for n bytes.
+ */
+TEST(SipHashTest, MatchesReferenceVectors) {
+  const SipHashKey key{0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL};
+  std::uint8_t message[16];
+  for (std::uint8_t i = 0; i < 16; ++i) {
+    message[i] = i;
+  }
+  EXPECT_EQ(siphash24(key, message, 0), 0x726fdb47dd0e0e31ULL);
+  EXPECT_EQ(siphash24(key, message, 15), 0xa129ca6149be45e5ULL);
+  // Words hash as their little-endian bytes
+  EXPECT_EQ(siphash24(key, {0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL}), siphash24(key, message, 16));
+  EXPECT_NE(siphash24(key, {1}), siphash24(SipHashKey{1, 0}, {1}));
+}
+
 TEST(TheaterTest, ShowsMovie) {
   Theater t(6, "Test Cinema");
   Movie m1(1, "Movie1");
@@ -115,6 +340,35 @@ TEST(TheaterTest, ShowsMovie) {
   EXPECT_TRUE(t.shows_movie(2));
 }
 
+// ---- Title Index Tests ----
+TEST(TitleIndexTest, NormalizeCollapsesCaseAndPunctuation) {
+  EXPECT_EQ(TitleIndex::normalize("  The Lord Of The Ring: The Return!  "), "the lord of the ring the return");
+  EXPECT_EQ(TitleIndex::normalize("?!"), "");
+}
+
+TEST(TitleIndexTest, PrefixAndSubstringSearch) {
+  TitleIndex index;
+  index.add(1, "Inception");
+  index.add(2, "The Matrix");
+  index.add(3, "The Matrix Reloaded");
+  index.add(4, "Mad Max");
+  
+  EXPECT_EQ(index.search("matr", 10), (std::vector<int>{2, 3}));
+  EXPECT_EQ(index.search("RELOAD", 10), (std::vector<int>{3}));
+  EXPECT_EQ(index.search("ma", 10), (std::vector<int>{2, 3, 4}));
+  EXPECT_EQ(index.search("ma", 2), (std::vector<int>{2, 3}));
+  // "mat" occurs but the trigram "xma" does not, so nothing can match
+  EXPECT_TRUE(index.search("xmat", 10).empty());
+  // Punctuation in the query normalizes to the space between the words
+  EXPECT_EQ(index.search("trix-re", 10), (std::vector<int>{3}));
+  
+  index.remove(3);
+  EXPECT_EQ(index.search("matr", 10), (std::vector<int>{2}));
+  index.add(2, "Tenet");
+  EXPECT_TRUE(index.search("matr", 10).empty());
+  EXPECT_EQ(index.search("ten", 10), (std::vector<int>{2}));
+}
+
 // ---- Administration Service Tests ----
 TEST(AdministrationServiceTest, AddMovieAndGetAllMovies) {
   auto data_store = std::make_shared<CentralDataStore>();
@@ -219,6 +473,243 @@ TEST(BookingServiceTest, BookSeatsSuccessAndFailure) {
   EXPECT_FALSE(booking_svc.book_seats(30, 1, {"f1"})); // f1 doesn't exist
 }
 
+TEST(BookingServiceTest, MoviesPageFollowsCursor) {
+  auto data_store = std::make_shared<CentralDataStore>();
+  AdministrationService admin_svc(data_store);
+  BookingService booking_svc(data_store);
+  
+  for (int id : {5, 1, 3, 2, 4}) {
+    admin_svc.add_movie(Movie(id, "Movie" + std::to_string(id)));
+  }
+  
+  CatalogQuery query;
+  query.limit = 2;
+  auto first = booking_svc.get_movies_page(query);
+  ASSERT_EQ(first.items.size(), 2);
+  EXPECT_EQ(first.items[0].get_id(), 1);
+  EXPECT_EQ(first.items[1].get_id(), 2);
+  EXPECT_TRUE(first.has_more);
+  
+  query.after_id = first.items.back().get_id();
+  auto second = booking_svc.get_movies_page(query);
+  ASSERT_EQ(second.items.size(), 2);
+  EXPECT_EQ(second.items[0].get_id(), 3);
+  EXPECT_TRUE(second.has_more);
+  
+  query.after_id = second.items.back().get_id();
+  auto last = booking_svc.get_movies_page(query);
+  ASSERT_EQ(last.items.size(), 1);
+  EXPECT_EQ(last.items[0].get_id(), 5);
+  EXPECT_FALSE(last.has_more);
+}
+
+TEST(BookingServiceTest, ShowingIndexesFilterPages) {
+  auto data_store = std::make_shared<CentralDataStore>();
+  AdministrationService admin_svc(data_store);
+  BookingService booking_svc(data_store);
+  
+  admin_svc.add_movie(Movie(1, "Alien"));
+  admin_svc.add_movie(Movie(2, "Aliens"));
+  admin_svc.add_theater(std::make_shared<Theater>(10, "North"));
+  admin_svc.add_theater(std::make_shared<Theater>(20, "South"));
+  admin_svc.add_theater(std::make_shared<Theater>(30, "East"));
+  admin_svc.schedule_movie_in_theater(30, Movie(1, "Alien"));
+  admin_svc.schedule_movie_in_theater(10, Movie(1, "Alien"));
+  admin_svc.schedule_movie_in_theater(20, Movie(2, "Aliens"));
+  
+  CatalogQuery query;
+  query.limit = 1;
+  auto theaters = booking_svc.get_theaters_page(1, query);
+  ASSERT_EQ(theaters.items.size(), 1);
+  EXPECT_EQ(theaters.items[0]->get_id(), 10);
+  EXPECT_TRUE(theaters.has_more);
+  
+  query.after_id = 10;
+  theaters = booking_svc.get_theaters_page(1, query);
+  ASSERT_EQ(theaters.items.size(), 1);
+  EXPECT_EQ(theaters.items[0]->get_id(), 30);
+  EXPECT_FALSE(theaters.has_more);
+  
+  CatalogQuery by_theater;
+  by_theater.theater_id = 20;
+  auto movies = booking_svc.get_movies_page(by_theater);
+  ASSERT_EQ(movies.items.size(), 1);
+  EXPECT_EQ(movies.items[0].get_id(), 2);
+  
+  admin_svc.remove_theater(10);
+  EXPECT_EQ(booking_svc.get_theaters_showing_movie(1).size(), 1);
+}
+
+TEST(BookingServiceTest, LedgerLookupAndCancel) {
+  auto data_store = std::make_shared<CentralDataStore>();
+  AdministrationService admin_svc(data_store);
+  BookingService booking_svc(data_store);
+  
+  admin_svc.add_theater(std::make_shared<Theater>(40, "CinemaL"));
+  admin_svc.schedule_movie_in_theater(40, Movie(1, "Heat"));
+  
+  auto booking = booking_svc.create_booking(40, 1, {"b2", "b3"});
+  ASSERT_TRUE(booking.has_value());
+  EXPECT_EQ(booking->confirmation_code.size(), 13);
+  EXPECT_FALSE(booking_svc.create_booking(40, 1, {"b3"}).has_value());
+  
+  auto found = booking_svc.lookup_booking(booking->confirmation_code);
+  ASSERT_TRUE(found.has_value());
+  EXPECT_EQ(found->theater_id, 40);
+  EXPECT_EQ(found->seat_ids, (std::vector<std::string>{"b2", "b3"}));
+  
+  EXPECT_TRUE(booking_svc.cancel_booking(booking->confirmation_code));
+  EXPECT_FALSE(booking_svc.cancel_booking(booking->confirmation_code)); // Already cancelled
+  EXPECT_FALSE(booking_svc.lookup_booking(booking->confirmation_code).has_value());
+  EXPECT_TRUE(booking_svc.book_seats(40, 1, {"b3"}));
+}
+
+TEST(BookingServiceTest, BatchReturnsPerRequestResults) {
+  auto data_store = std::make_shared<CentralDataStore>();
+  AdministrationService admin_svc(data_store);
+  BookingService booking_svc(data_store);
+  
+  admin_svc.add_theater(std::make_shared<Theater>(50, "CinemaB1"));
+  admin_svc.add_theater(std::make_shared<Theater>(51, "CinemaB2"));
+  admin_svc.schedule_movie_in_theater(50, Movie(1, "Alien"));
+  admin_svc.schedule_movie_in_theater(51, Movie(1, "Alien"));
+  
+  auto results = booking_svc.book_batch({
+    {50, 1, {"a1", "a2"}},
+    {51, 1, {"a1"}},
+    {50, 1, {"a2", "a3"}},  // Overlaps the first request of the same showing
+    {99, 1, {"a1"}},        // Unknown theater
+    {50, 1, {"a3"}}
+  });
+  ASSERT_EQ(results.size(), 5);
+  EXPECT_TRUE(results[0].has_value());
+  EXPECT_TRUE(results[1].has_value());
+  EXPECT_FALSE(results[2].has_value());
+  EXPECT_FALSE(results[3].has_value());
+  EXPECT_TRUE(results[4].has_value());
+  EXPECT_TRUE(booking_svc.lookup_booking(results[4]->confirmation_code).has_value());
+}
+
+TEST(BookingServiceTest, AllOrNothingRollsBackOnFailure) {
+  auto data_store = std::make_shared<CentralDataStore>();
+  AdministrationService admin_svc(data_store);
+  BookingService booking_svc(data_store);
+  
+  admin_svc.add_theater(std::make_shared<Theater>(53, "CinemaAtomic"));
+  admin_svc.schedule_movie_in_theater(53, Movie(1, "Heat"));
+  
+  // The second request overlaps the first, so neither is kept
+  EXPECT_FALSE(booking_svc.book_all_or_nothing({{53, 1, {"a1", "a2"}}, {53, 1, {"a2"}}}).has_value());
+  EXPECT_TRUE(booking_svc.can_book_seats(53, 1, {"a1", "a2"}));
+  
+  auto bookings = booking_svc.book_all_or_nothing({{53, 1, {"a1"}}, {53, 1, {"a2"}}});
+  ASSERT_TRUE(bookings.has_value());
+  ASSERT_EQ(bookings->size(), 2u);
+  EXPECT_EQ((*bookings)[1].seat_ids, std::vector<std::string>{"a2"});
+  EXPECT_FALSE(booking_svc.can_book_seats(53, 1, {"a1"}));
+}
+
+TEST(BookingServiceTest, AllOrNothingChecksEveryShowingBeforeBooking) {
+  auto data_store = std::make_shared<CentralDataStore>();
+  AdministrationService admin_svc(data_store);
+  BookingService booking_svc(data_store);
+
+  admin_svc.add_theater(std::make_shared<Theater>(54, "CinemaHold"));
+  admin_svc.add_theater(std::make_shared<Theater>(55, "CinemaHold Two"));
+  admin_svc.schedule_movie_in_theater(54, Movie(1, "Heat"));
+  admin_svc.schedule_movie_in_theater(55, Movie(1, "Heat"));
+  ASSERT_TRUE(booking_svc.book_seats(55, 1, {"b1"}));
+  const std::uint64_t version = booking_svc.get_seat_version(54, 1).value();
+
+  // The failing entry comes last, yet nothing of the earlier ones is ever booked
+  EXPECT_FALSE(booking_svc.book_all_or_nothing({{54, 1, {"a1"}}, {54, 1, {"a2"}}, {55, 1, {"b1"}}}).has_value());
+  EXPECT_EQ(booking_svc.get_seat_version(54, 1), version);
+  EXPECT_FALSE(booking_svc.book_all_or_nothing({{54, 1, {"a1", "a3"}}, {54, 1, {"a3"}}}).has_value());
+  EXPECT_TRUE(booking_svc.can_book_seats(54, 1, {"a1", "a2", "a3"}));
+
+  // One version bump per showing, however many entries it has
+  ASSERT_TRUE(booking_svc.book_all_or_nothing({{55, 1, {"b2"}}, {54, 1, {"a1"}}, {54, 1, {"a2"}}}).has_value());
+  EXPECT_EQ(booking_svc.get_seat_version(54, 1), version + 1);
+  EXPECT_FALSE(booking_svc.can_book_seats(55, 1, {"b2"}));
+}
+
+TEST(BookingServiceTest, AsyncBookingCompletesFutureAndCallback) {
+  auto data_store = std::make_shared<CentralDataStore>();
+  AdministrationService admin_svc(data_store);
+  BookingService booking_svc(data_store);
+  
+  admin_svc.add_theater(std::make_shared<Theater>(52, "CinemaAsync"));
+  admin_svc.schedule_movie_in_theater(52, Movie(1, "Ran"));
+  
+  auto booked = booking_svc.book_seats_async({52, 1, {"c1"}});
+  std::promise<bool> callback_result;
+  booking_svc.book_seats_async({52, 1, {"c1"}}, [&callback_result](std::optional<Booking> booking) {
+    callback_result.set_value(booking.has_value());
+  });
+  
+  auto booking = booked.get();
+  ASSERT_TRUE(booking.has_value());
+  EXPECT_EQ(booking->seat_ids, (std::vector<std::string>{"c1"}));
+  EXPECT_FALSE(callback_result.get_future().get()); // Queued after the first, seat already taken
+}
+
+TEST(BookingServiceTest, AsyncBookingSurvivesThrowingCallback) {
+  auto data_store = std::make_shared<CentralDataStore>();
+  AdministrationService admin_svc(data_store);
+  BookingService booking_svc(data_store);
+
+  admin_svc.add_theater(std::make_shared<Theater>(56, "CinemaThrow"));
+  admin_svc.schedule_movie_in_theater(56, Movie(1, "Ran"));
+
+  booking_svc.book_seats_async({56, 1, {"a1"}}, [](std::optional<Booking>) {
+    throw std::runtime_error("client gone");
+  });
+  auto booked = booking_svc.book_seats_async({56, 1, {"a2"}});
+  ASSERT_EQ(booked.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_TRUE(booked.get().has_value());
+  EXPECT_FALSE(booking_svc.can_book_seats(56, 1, {"a1"}));
+}
+
+TEST(BookingLedgerTest, CodesRoundTripAndAreUnique) {
+  BookingLedger ledger;
+  std::unordered_set<std::string> codes;
+  for (int i = 0; i < 1000; ++i) {
+    auto code = ledger.record(BookingRecord{1, 1, 0, {static_cast<std::uint16_t>(i)}});
+    auto text = BookingLedger::encode(code);
+    EXPECT_EQ(BookingLedger::decode(text), code);
+    codes.insert(text);
+  }
+  EXPECT_EQ(codes.size(), 1000);
+  EXPECT_EQ(ledger.size(), 1000);
+  EXPECT_FALSE(BookingLedger::decode("not-a-code").has_value());
+  // Codes depend on the process key, not just the sequence
+  BookingLedger other;
+  EXPECT_FALSE(codes.count(BookingLedger::encode(other.record(BookingRecord{1, 1, 0, {0}}))));
+}
+
+TEST(BookingLedgerTest, DropsOldestPastCapacityOrRetention) {
+  BookingLedger bounded(2);
+  const auto first = bounded.record(BookingRecord{1, 1, 0, {0}});
+  const auto second = bounded.record(BookingRecord{1, 1, 0, {1}});
+  const auto third = bounded.record(BookingRecord{1, 1, 0, {2}});
+  EXPECT_EQ(bounded.size(), 2u);
+  EXPECT_FALSE(bounded.find(first).has_value());
+  EXPECT_TRUE(bounded.find(second).has_value());
+  EXPECT_TRUE(bounded.find(third).has_value());
+
+  // A failed step keeps the record; a successful one removes it once
+  EXPECT_FALSE(bounded.take_if(second, [](const BookingRecord&) { return false; }).has_value());
+  EXPECT_TRUE(bounded.take_if(second, [](const BookingRecord&) { return true; }).has_value());
+  EXPECT_FALSE(bounded.take_if(second, [](const BookingRecord&) { return true; }).has_value());
+
+  BookingLedger expiring(100, std::chrono::seconds(0));
+  const auto old_code = expiring.record(BookingRecord{1, 1, 0, {0}});
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  expiring.record(BookingRecord{1, 1, 0, {1}});
+  EXPECT_FALSE(expiring.find(old_code).has_value());
+  EXPECT_EQ(expiring.size(), 1u);
+}
+
 // ---- Concurrency and Thread Safety Tests ----
 
 /**
@@ -337,6 +828,38 @@ TEST(TheaterTest, ConcurrentSameSeatBookingConflict) {
   EXPECT_EQ(successful_bookings, 1);
 }
 
+/**
+ * @brief Test the combining booking path under a flash sale on one showing
+ * @details More threads than combining slots book overlapping seat pairs of the
+ *          same showing, so requests go through the direct, combined and fallback
+ *          paths. Every seat must end up booked by at most one request.
+ */
+TEST(TheaterTest, FlashSaleCombiningBooksEachSeatOnce) {
+  Theater theater(3, "Flash Sale Cinema");
+  theater.add_movie(Movie(1, "Premiere"));
+  theater.add_movie(Movie(2, "Matinee"));
+  const std::vector<std::string> seats = theater.get_available_seats(1);
+
+  const int num_threads = 100;
+  std::atomic<int> booked_seats{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&, i]() {
+      std::vector<std::string> pair{seats[i % seats.size()], seats[(i + 1) % seats.size()]};
+      if (theater.book_seats(1, pair)) {
+        booked_seats += 2;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_GT(booked_seats.load(), 0);
+  EXPECT_EQ(booked_seats.load() + theater.get_available_seats(1).size(), seats.size());
+  EXPECT_EQ(theater.get_available_seats(2).size(), seats.size()); // Other showing untouched
+}
+
 /**
  * @brief Test concurrent operations through booking service
  * @details Validates that the booking service can handle concurrent booking
@@ -387,3 +910,621 @@ TEST(BookingServiceTest, ConcurrentServiceOperations) {
   EXPECT_EQ(successful_bookings.load(), std::min(num_threads, 20));
 }
 
+
+// ---- Dedup Table Tests ----
+TEST(DedupTableTest, DuplicatesReplayFirstResult) {
+  DedupTable<std::string> table(1024, std::chrono::minutes(5));
+  int executions = 0;
+  auto compute = [&executions]() { return "result-" + std::to_string(++executions); };
+  
+  EXPECT_EQ(table.get_or_compute("req-1", compute), "result-1");
+  EXPECT_EQ(table.get_or_compute("req-1", compute), "result-1");
+  EXPECT_EQ(table.get_or_compute("req-2", compute), "result-2");
+  EXPECT_EQ(executions, 2);
+}
+
+TEST(DedupTableTest, KeyReusedForAnotherOperationIsRefused) {
+  DedupTable<std::string> table(1024, std::chrono::minutes(5));
+  int executions = 0;
+  auto compute = [&executions]() { return "result-" + std::to_string(++executions); };
+  EXPECT_EQ(table.get_or_compute("req", "BOOK 1 1 a1", compute), "result-1");
+  EXPECT_EQ(table.get_or_compute("req", "BOOK 1 1 a1", compute), "result-1");
+  EXPECT_FALSE(table.get_or_compute("req", "BOOK 1 1 a2", compute).has_value());
+  EXPECT_EQ(executions, 1);
+}
+
+TEST(DedupTableTest, FailedAttemptIsForgotten) {
+  DedupTable<int> table(1024, std::chrono::minutes(5));
+  EXPECT_THROW(table.get_or_compute("req", []() -> int { throw std::runtime_error("boom"); }),
+               std::runtime_error);
+  EXPECT_EQ(table.get_or_compute("req", []() { return 7; }), 7);
+}
+
+TEST(DedupTableTest, ExpiresAndStaysBounded) {
+  DedupTable<int> expiring(1024, std::chrono::milliseconds(0), 1);
+  int executions = 0;
+  auto compute = [&executions]() { return ++executions; };
+  expiring.get_or_compute("req", compute);
+  expiring.get_or_compute("req", compute);
+  EXPECT_EQ(executions, 2); // zero time to live: every call runs again
+  
+  DedupTable<int> bounded(8, std::chrono::minutes(5), 1);
+  for (int i = 0; i < 100; ++i) {
+    bounded.get_or_compute("req-" + std::to_string(i), [i]() { return i; });
+  }
+  EXPECT_LE(bounded.size(), 8);
+}
+
+/**
+ * @brief Test concurrent retries of the same request
+ * @details Many threads race on the same key while the first attempt is slow;
+ *          exactly one of them must execute and all must see its result.
+ * @test Verifies the dedup table never runs a keyed operation twice under contention
+ */
+TEST(DedupTableTest, ConcurrentRetriesExecuteOnce) {
+  DedupTable<int> table(1024, std::chrono::minutes(5));
+  std::atomic<int> executions{0};
+  std::vector<std::future<int>> futures;
+  
+  for (int i = 0; i < 16; ++i) {
+    futures.push_back(std::async(std::launch::async, [&table, &executions]() {
+      return table.get_or_compute("same", [&executions]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return ++executions;
+      });
+    }));
+  }
+  
+  for (auto& future : futures) {
+    EXPECT_EQ(future.get(), 1);
+  }
+  EXPECT_EQ(executions.load(), 1);
+}
+
+/**
+ * @brief Test percentile accuracy of the latency histogram
+ * @details Records 1..100000 once each; every percentile must be within the
+ *          histogram's 1/64 relative error of the exact value, and max is exact.
+ */
+TEST(LatencyHistogramTest, PercentilesWithinRelativeError) {
+  LatencyHistogram histogram;
+  for (std::uint64_t v = 1; v <= 100000; ++v) {
+    histogram.record(v);
+  }
+  EXPECT_EQ(histogram.count(), 100000);
+  EXPECT_EQ(histogram.max(), 100000);
+  EXPECT_NEAR(histogram.mean(), 50000.5, 1e-6);
+  for (double p : {50.0, 90.0, 99.0, 99.9}) {
+    const double exact = p / 100.0 * 100000;
+    EXPECT_NEAR(static_cast<double>(histogram.value_at_percentile(p)), exact, exact / 64) << "p" << p;
+  }
+  
+  LatencyHistogram other;
+  other.record(5'000'000);
+  histogram.merge(other);
+  EXPECT_EQ(histogram.value_at_percentile(100), 5'000'000);
+  EXPECT_EQ(LatencyHistogram().value_at_percentile(99), 0);
+}
+
+// ---- Waiting Room Tests ----
+
+/**
+ * @brief Test FIFO admission and token checks of the waiting room
+ * @details With 20 admissions per second, joiners are spaced 50 ms apart: the first
+ *          one is admitted immediately, the next ones wait in join order.
+ * @test Verifies positions, admission over time, token binding and backlog detection
+ */
+TEST(WaitingRoomTest, AdmitsInJoinOrderAtConfiguredRate) {
+  WaitingRoom room(20.0, std::chrono::seconds(60), 16);
+  auto first = room.join(1, 1);
+  auto second = room.join(1, 1);
+  auto third = room.join(1, 1);
+  ASSERT_TRUE(first && second && third);
+  
+  EXPECT_EQ(first->status.state, AdmissionState::Admitted);
+  EXPECT_EQ(second->status.state, AdmissionState::Waiting);
+  EXPECT_EQ(second->status.position, 1);
+  EXPECT_EQ(third->status.position, 2);
+  EXPECT_TRUE(room.is_backlogged(1, 1));
+  EXPECT_FALSE(room.is_backlogged(1, 2));
+  
+  // Tokens only verify for their own showing and cannot be altered
+  EXPECT_EQ(room.status(1, 2, first->token).state, AdmissionState::Invalid);
+  // Changing the admission time (first half) or the tag (second half) breaks the token
+  for (std::size_t i : {std::size_t{1}, std::size_t{12}, third->token.size() / 2 + 1, third->token.size() - 1}) {
+    std::string forged = third->token;
+    forged[i] = forged[i] == '0' ? '1' : '0';
+    EXPECT_EQ(room.status(1, 1, forged).state, AdmissionState::Invalid) << i;
+    EXPECT_EQ(room.claim(1, 1, forged).state, AdmissionState::Invalid) << i;
+  }
+  
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  EXPECT_EQ(room.status(1, 1, second->token).state, AdmissionState::Admitted);
+  EXPECT_EQ(room.status(1, 1, third->token).state, AdmissionState::Waiting);
+}
+
+/**
+ * @brief Test the bounded lane table
+ * @details A room sized for one showing hands out tokens for that showing only.
+ */
+TEST(WaitingRoomTest, RefusesShowingsBeyondCapacity) {
+  WaitingRoom room(10.0, std::chrono::seconds(60), 1);
+  EXPECT_TRUE(room.join(1, 1));
+  EXPECT_TRUE(room.join(1, 1));
+  EXPECT_FALSE(room.join(2, 1));
+}
+
+/**
+ * @brief Test that a lane is handed to another showing once its queue has drained
+ * @details With no admission window, the lane of showing (1, 1) is idle as soon as its
+ *          last reserved admission time has passed.
+ */
+TEST(WaitingRoomTest, ReusesIdleLanes) {
+  WaitingRoom room(10.0, std::chrono::seconds(0), 1);
+  ASSERT_TRUE(room.join(1, 1));
+  EXPECT_FALSE(room.join(2, 1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  auto ticket = room.join(2, 1);
+  ASSERT_TRUE(ticket);
+  EXPECT_EQ(ticket->status.state, AdmissionState::Admitted);
+  EXPECT_FALSE(room.is_backlogged(1, 1));
+}
+
+/**
+ * @brief Test that an admitted token books once
+ * @test Verifies claim, the USED state, release after a failed booking, and that
+ *       waiting tokens cannot be claimed
+ */
+TEST(WaitingRoomTest, TokensAreSingleUse) {
+  WaitingRoom room(1.0, std::chrono::seconds(60), 4);
+  auto first = room.join(1, 1);
+  auto second = room.join(1, 1);
+  ASSERT_TRUE(first && second);
+  
+  EXPECT_EQ(room.claim(1, 1, first->token).state, AdmissionState::Admitted);
+  EXPECT_EQ(room.claim(1, 1, first->token).state, AdmissionState::Used);
+  EXPECT_EQ(room.status(1, 1, first->token).state, AdmissionState::Used);
+  
+  room.release(1, 1, first->token);
+  EXPECT_EQ(room.claim(1, 1, first->token).state, AdmissionState::Admitted);
+  EXPECT_EQ(room.claim(1, 1, second->token).state, AdmissionState::Waiting);
+  EXPECT_EQ(room.claim(1, 2, first->token).state, AdmissionState::Invalid);
+}
+
+// ---- Load Shedding Tests ----
+
+/**
+ * @brief Test the token bucket burst and refill behavior
+ * @details At 10 events per second with a burst of 3, three back-to-back events pass,
+ *          the fourth is refused, and one more passes 100 ms later.
+ */
+TEST(TokenBucketTest, AdmitsBurstThenSustainedRate) {
+  TokenBucket bucket;
+  const auto limit = TokenBucket::Limit::per_second(10, 3);
+  const auto start = TokenBucket::Clock::now();
+  EXPECT_TRUE(bucket.try_acquire(start, limit));
+  EXPECT_TRUE(bucket.try_acquire(start, limit));
+  EXPECT_TRUE(bucket.try_acquire(start, limit));
+  EXPECT_FALSE(bucket.try_acquire(start, limit));
+  
+  const auto later = start + std::chrono::milliseconds(100);
+  EXPECT_TRUE(bucket.try_acquire(later, limit));
+  EXPECT_FALSE(bucket.try_acquire(later, limit));
+  EXPECT_TRUE(bucket.try_acquire(later, TokenBucket::Limit::per_second(0, 0))); // Unlimited
+  
+  bucket.refund(limit);
+  EXPECT_TRUE(bucket.try_acquire(later, limit));
+}
+
+/**
+ * @brief Test the session cap and runtime limit changes of the load shedder
+ */
+TEST(LoadShedderTest, CapsSessionsAndRetunes) {
+  RateLimits limits;
+  limits.max_sessions = 2;
+  LoadShedder shedder(limits, 16);
+  EXPECT_TRUE(shedder.try_open_session());
+  EXPECT_TRUE(shedder.try_open_session());
+  EXPECT_FALSE(shedder.try_open_session());
+  shedder.close_session();
+  EXPECT_TRUE(shedder.try_open_session());
+  EXPECT_EQ(shedder.active_sessions(), 2);
+  
+  limits.connection_rate = 1;
+  limits.connection_burst = 1;
+  shedder.set_limits(limits);
+  TokenBucket connection;
+  const std::size_t slot = shedder.client_slot("10.0.0.1");
+  EXPECT_TRUE(shedder.admit_request(connection, slot));
+  EXPECT_FALSE(shedder.admit_request(connection, slot));
+  
+  TokenBucket other_connection; // Separate connection budget, same client budget
+  EXPECT_TRUE(shedder.admit_request(other_connection, slot));
+  
+  // A request the client budget refuses leaves the connection budget untouched
+  limits.client_rate = 1;
+  limits.client_burst = 1;
+  shedder.set_limits(limits);
+  const std::size_t busy = shedder.client_slot("10.0.0.2");
+  TokenBucket first, second;
+  EXPECT_TRUE(shedder.admit_request(first, busy));
+  EXPECT_FALSE(shedder.admit_request(second, busy));
+  limits.client_rate = 0;
+  shedder.set_limits(limits);
+  EXPECT_TRUE(shedder.admit_request(second, busy));
+}
+
+/**
+ * @brief Test that the reaper shuts down only connections past their deadline
+ * @details Of three socket pairs, one misses its idle deadline, one has its deadline
+ *          cleared and one stops being watched before the deadline; only the first
+ *          must see end of stream.
+ */
+TEST(ConnectionReaperTest, ShutsDownConnectionsPastTheirDeadline) {
+  boost::asio::io_context io_context;
+  ConnectionReaper reaper(io_context, std::chrono::milliseconds(10));
+  int late[2], cleared[2], released[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, late), 0);
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, cleared), 0);
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, released), 0);
+  {
+    ConnectionReaper::Watch late_watch = reaper.watch(late[0]);
+    ConnectionReaper::Watch cleared_watch = reaper.watch(cleared[0]);
+    ConnectionReaper::Watch released_watch = reaper.watch(released[0]);
+    EXPECT_EQ(reaper.watched(), 3u);
+    late_watch.expect(ConnectionReaper::Deadline::Idle, std::chrono::milliseconds(30));
+    cleared_watch.expect(ConnectionReaper::Deadline::Write, std::chrono::milliseconds(30));
+    cleared_watch.expect(ConnectionReaper::Deadline::None, std::chrono::milliseconds(0));
+    released_watch.expect(ConnectionReaper::Deadline::Write, std::chrono::milliseconds(30));
+    released_watch.reset();
+    EXPECT_EQ(reaper.watched(), 2u);
+
+    io_context.run_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(late_watch.expired(), ConnectionReaper::Deadline::Idle);
+    EXPECT_EQ(cleared_watch.expired(), ConnectionReaper::Deadline::None);
+  }
+  EXPECT_EQ(reaper.watched(), 0u);
+  EXPECT_EQ(reaper.expired_total(ConnectionReaper::Deadline::Idle), 1u);
+  EXPECT_EQ(reaper.expired_total(ConnectionReaper::Deadline::Write), 0u);
+
+  char byte;
+  EXPECT_EQ(::recv(late[0], &byte, 1, MSG_DONTWAIT), 0);  // Shut down: end of stream
+  EXPECT_EQ(::recv(cleared[0], &byte, 1, MSG_DONTWAIT), -1);  // Still open, nothing to read
+  EXPECT_EQ(::recv(released[0], &byte, 1, MSG_DONTWAIT), -1);
+  for (int fd : {late[0], late[1], cleared[0], cleared[1], released[0], released[1]}) {
+    ::close(fd);
+  }
+}
+
+// ---- Server Metrics Tests ----
+
+/**
+ * @brief Test that per-thread metrics merge into one snapshot
+ * @details Four threads record 1000 requests each with every request timed; the
+ *          snapshot must count all of them per command, and the Prometheus page must
+ *          carry the same totals.
+ */
+TEST(ServerMetricsTest, MergesThreadSlotsIntoSnapshot) {
+  ServerMetrics metrics({"GET", "PUT", "INVALID"}, 1);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&metrics]() {
+      for (int i = 0; i < 1000; ++i) {
+        RequestRecorder recorder(metrics);
+        recorder.set_command(i % 2);
+        recorder.end_phase(RequestPhase::Parse);
+        recorder.end_phase(RequestPhase::Service);
+        metrics.booking_result(i % 4 == 0);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  { RequestRecorder unparsed(metrics); } // Never attributed: counted under the last name
+  metrics.connection_opened();
+  metrics.request_shed();
+  
+  const auto stats = metrics.snapshot();
+  ASSERT_EQ(stats.commands.size(), 3);
+  EXPECT_EQ(stats.commands[0].name, "GET");
+  EXPECT_EQ(stats.commands[0].requests, 2000);
+  EXPECT_EQ(stats.commands[1].requests, 2000);
+  EXPECT_EQ(stats.commands[2].requests, 1);
+  const auto& parse = stats.commands[1].phases[static_cast<std::size_t>(RequestPhase::Parse)];
+  EXPECT_EQ(parse.samples, 2000);
+  EXPECT_LE(parse.p50, parse.p999);
+  EXPECT_LE(parse.p999, parse.max);
+  EXPECT_EQ(stats.commands[1].phases[static_cast<std::size_t>(RequestPhase::Write)].samples, 0);
+  EXPECT_EQ(stats.bookings_succeeded, 1000);
+  EXPECT_EQ(stats.bookings_failed, 3000);
+  EXPECT_EQ(stats.connections_active, 1);
+  EXPECT_EQ(stats.requests_shed, 1);
+  
+  const std::string page = metrics.prometheus_text();
+  EXPECT_NE(page.find("booking_requests_total{command=\"PUT\"} 2000\n"), std::string::npos);
+  EXPECT_NE(page.find("booking_request_phase_seconds_count{command=\"GET\",phase=\"service\"} 2000\n"), std::string::npos);
+  EXPECT_NE(page.find("booking_bookings_total{result=\"failure\"} 3000\n"), std::string::npos);
+  EXPECT_NE(page.find("# TYPE booking_request_phase_seconds summary"), std::string::npos);
+}
+
+/**
+ * @brief Test that sampling times one request in sample_period while counting all
+ */
+TEST(ServerMetricsTest, SamplesPhaseTimings) {
+  ServerMetrics metrics({"GET"}, 8);
+  for (int i = 0; i < 64; ++i) {
+    RequestRecorder recorder(metrics);
+    recorder.set_command(0);
+    recorder.end_phase(RequestPhase::Parse);
+  }
+  const auto stats = metrics.snapshot();
+  ASSERT_EQ(stats.commands.size(), 1);
+  EXPECT_EQ(stats.commands[0].requests, 64);
+  EXPECT_EQ(stats.commands[0].phases[0].samples, 8);
+}
+
+/**
+ * @brief Test that traced requests leave complete spans and the ring keeps the newest events
+ * @details Two traced requests record five events each (four phases and the enclosing
+ *          request). With a 6-event ring, the dump holds the second request only: the
+ *          slot next in line for overwriting is never reported, as a writer may be in it.
+ */
+TEST(RequestTracerTest, RingKeepsNewestSpans) {
+  ServerMetrics metrics({"GET", "INVALID"}, 1);
+  RequestTracer tracer({"GET", "INVALID"}, 1, 6);
+  for (std::uint16_t sequence = 0; sequence < 2; ++sequence) {
+    RequestTrace trace(tracer, 42, sequence);
+    ASSERT_TRUE(trace.active());
+    RequestRecorder recorder(metrics, &trace);
+    recorder.set_command(0);
+    recorder.end_phase(RequestPhase::Parse);
+    recorder.end_phase(RequestPhase::Service);
+    recorder.end_phase(RequestPhase::Serialize);
+    recorder.end_phase(RequestPhase::Write);
+  }
+  
+  const std::string dump = tracer.chrome_trace_json();
+  EXPECT_EQ(dump.find("\"seq\":0"), std::string::npos);
+  EXPECT_NE(dump.find("\"name\":\"request\""), std::string::npos);
+  EXPECT_NE(dump.find("\"name\":\"write\""), std::string::npos);
+  EXPECT_NE(dump.find("\"command\":\"GET\""), std::string::npos);
+  EXPECT_NE(dump.find("\"ph\":\"X\""), std::string::npos);
+  std::size_t events = 0;
+  for (std::size_t at = dump.find("\"cat\""); at != std::string::npos; at = dump.find("\"cat\"", at + 1)) {
+    ++events;
+  }
+  EXPECT_EQ(events, 5);
+  
+  RequestTracer disabled({"GET"}, 0, 16);
+  EXPECT_FALSE(RequestTrace(disabled, 1, 0).active());
+}
+
+// ---- Request Arena Tests ----
+
+/**
+ * @brief Test parsing into and serializing from a session arena across requests
+ * @details Values built on the arena's storage serialize like any other; a malformed
+ *          request throws and leaves the arena usable for the next one.
+ */
+TEST(RequestArenaTest, ParsesAndSerializesAcrossResets) {
+  RequestArena arena(1024);
+  for (int round = 0; round < 3; ++round) {
+    arena.reset();
+    json::value request = arena.parse(R"({"command":"LIST_SEATS","theater_id":1,"movie_id":2})");
+    EXPECT_EQ(request.at("theater_id").as_int64(), 1);
+
+    json::array seats(arena.storage());
+    seats.emplace_back(json::string_view("a1"));
+    const json::value response = json::object({{"movie_id", request.at("movie_id")}, {"seats", std::move(seats)}},
+                                              arena.storage());
+    EXPECT_EQ(arena.serialize(response), "{\"movie_id\":2,\"seats\":[\"a1\"]}\n");
+  }
+  arena.reset();
+  EXPECT_THROW(arena.parse(R"({"command":)"), std::exception);
+  arena.reset();
+  EXPECT_EQ(arena.parse("[1,2]").as_array().size(), 2u);
+  EXPECT_EQ(arena.set_response("{}\n"), "{}\n");
+}
+
+// ---- Command Table Tests ----
+
+/**
+ * @brief Test that every command name hashes to its own entry and the error samples are well-formed
+ */
+TEST(CommandTableTest, FindsEveryCommandAndRejectsOthers) {
+  for (const auto& command : kCommands) {
+    const CommandSpec* found = find_command(command.name);
+    ASSERT_NE(found, nullptr) << command.name;
+    EXPECT_EQ(found->name, command.name);
+    EXPECT_EQ(found->type, command.type);
+    EXPECT_EQ(json::parse(command.sample).at("command").as_string(), command.name);
+  }
+  for (const char* name : {"", "book", "BOOK ", "LIST", "LIST_SEATSX", "STAT"}) {
+    EXPECT_EQ(find_command(name), nullptr) << name;
+  }
+  EXPECT_EQ(json::parse(sample_format_json()).as_object().size(), kCommandCount);
+  EXPECT_EQ(json::parse(command_names_json()).as_array().size(), kCommandCount);
+}
+
+// ---- Request Scanner Tests ----
+
+/**
+ * @brief Test that the scanner takes the fixed request shapes and leaves everything else to the parser
+ */
+TEST(RequestScannerTest, ScansKnownShapesAndFallsBack) {
+  auto movies = scan_request(R"({"command":"LIST_MOVIES"})");
+  ASSERT_TRUE(movies.has_value());
+  EXPECT_EQ(movies->command, ScannedCommand::ListMovies);
+
+  auto seats = scan_request(R"( { "movie_id" : 2 , "command" : "LIST_SEATS", "theater_id":10 } )");
+  ASSERT_TRUE(seats.has_value());
+  EXPECT_EQ(seats->command, ScannedCommand::ListSeats);
+  EXPECT_EQ(seats->theater_id, 10);
+  EXPECT_EQ(seats->movie_id, 2);
+
+  auto book = scan_request(R"({"command":"BOOK","seats":["a1", "b20"],"theater_id":1,"movie_id":3})");
+  ASSERT_TRUE(book.has_value());
+  EXPECT_EQ(book->command, ScannedCommand::Book);
+  ASSERT_EQ(book->seat_count, 2u);
+  EXPECT_EQ(book->seats[0], "a1");
+  EXPECT_EQ(book->seats[1], "b20");
+
+  for (const char* line : {
+           R"({"command":"LIST_MOVIES","limit":5})",                          // optional parameter
+           R"({"command":"BOOK","theater_id":1,"movie_id":3,"seats":["a1"],"request_id":"r"})",
+           R"({"command":"LIST_THEATERS"})",                                  // missing field
+           R"({"command":"LIST_THEATERS","movie_id":1,"movie_id":2})",        // duplicate key
+           R"({"command":"LIST_THEATERS","movie_id":01})",                    // leading zero
+           R"({"command":"LIST_THEATERS","movie_id":1.0})",                   // not an integer
+           R"({"command":"LIST_THEATERS","movie_id":1234567890})",            // too many digits
+           R"({"command":"BOOK","theater_id":1,"movie_id":3,"seats":["a\u0031"]})", // escape
+           R"({"command":"LIST_MOVIES"} x)",                                  // trailing garbage
+           R"({"command":"SEARCH_MOVIES","query":"a"})",                      // other command
+           R"({"command":"LIST_MOVIES")"}) {
+    EXPECT_FALSE(scan_request(line).has_value()) << line;
+  }
+}
+
+// ---- Logger Tests ----
+
+/**
+ * @brief Test level filtering, logfmt output and per-site rate limiting of the logger
+ * @details Records go to a temporary file; flush() returns once they are written.
+ *          With a burst of 2, the third record of a site is suppressed and the next one
+ *          let through reports it.
+ */
+TEST(LoggerTest, FormatsFiltersAndRateLimits) {
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  {
+    Logger logger(file);
+    logger.set_level(LogLevel::Info);
+    logger.set_rate_limit(10.0, 2.0);
+    LogSite site, other;
+    logger.log(other, LogLevel::Debug, "hidden", {});
+    logger.log(other, LogLevel::Warn, "read_failed", {{"session", 7}, {"error", "End of file"}, {"ok", false}});
+    for (int i = 0; i < 3; ++i) {
+      logger.log(site, LogLevel::Info, "burst", {{"i", i}});
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    logger.log(site, LogLevel::Info, "burst", {{"i", 3}});
+    logger.flush();
+    
+    std::rewind(file);
+    std::string text;
+    char chunk[256];
+    while (std::size_t n = std::fread(chunk, 1, sizeof(chunk), file)) {
+      text.append(chunk, n);
+    }
+    EXPECT_EQ(text.find("hidden"), std::string::npos);
+    EXPECT_NE(text.find(" WARN read_failed thread=1 session=7 error=\"End of file\" ok=false\n"), std::string::npos);
+    EXPECT_NE(text.find("burst thread=1 i=1\n"), std::string::npos);
+    EXPECT_EQ(text.find("i=2"), std::string::npos);
+    EXPECT_NE(text.find("burst thread=1 i=3 suppressed=1\n"), std::string::npos);
+    EXPECT_EQ(text[4], '-'); // Lines start with an ISO 8601 timestamp
+  }
+  std::fclose(file);
+}
+
+// ---- Traffic Capture Tests ----
+
+/**
+ * @brief Test that a capture file decodes to the recorded traffic, in time order
+ * @details Two threads record interleaved sessions; the byte limit drops what does not
+ *          fit, and a record cut short at the end of the file is ignored.
+ */
+TEST(TrafficCaptureTest, RoundTripsRecordsInTimeOrder) {
+  const std::string path = (std::filesystem::temp_directory_path() / "booking_capture_unit.cap").string();
+  {
+    TrafficCapture capture(path, 10 * TrafficCapture::kRecordHeaderSize + 64);
+    auto session = [&capture](std::uint32_t connection) {
+      capture.record(CaptureKind::Open, connection);
+      capture.record(CaptureKind::Request, connection, "{\"command\":\"LIST_MOVIES\"}");
+      capture.record(CaptureKind::Response, connection, std::string("line\0with nul", 13));
+      capture.record(CaptureKind::Close, connection);
+    };
+    std::thread other(session, 2);
+    session(1);
+    other.join();
+    capture.record(CaptureKind::Open, 3, std::string(100, 'x')); // Over the byte limit
+    EXPECT_EQ(capture.dropped(), 1u);
+    capture.flush();
+  }
+  { // Simulate a capture killed in the middle of a record
+    std::FILE* file = std::fopen(path.c_str(), "ab");
+    std::fwrite("\x01\x02\x03", 1, 3, file);
+    std::fclose(file);
+  }
+
+  const CaptureFile capture = TrafficCapture::read_file(path);
+  std::filesystem::remove(path);
+  EXPECT_GT(capture.started_unix_ns, 0u);
+  ASSERT_EQ(capture.records.size(), 8u);
+  for (std::size_t i = 1; i < capture.records.size(); ++i) {
+    EXPECT_LE(capture.records[i - 1].offset_ns, capture.records[i].offset_ns);
+  }
+  for (std::uint32_t connection : {1u, 2u}) {
+    std::vector<CaptureKind> kinds;
+    for (const auto& record : capture.records) {
+      if (record.connection != connection) continue;
+      kinds.push_back(record.kind);
+      if (record.kind == CaptureKind::Response) {
+        EXPECT_EQ(record.payload, std::string("line\0with nul", 13));
+      }
+    }
+    EXPECT_EQ(kinds, (std::vector<CaptureKind>{CaptureKind::Open, CaptureKind::Request, CaptureKind::Response,
+                                               CaptureKind::Close}));
+  }
+  EXPECT_THROW(TrafficCapture::read_file(path), std::runtime_error);
+}
+
+// ---- Lock Profiling Tests ----
+
+/**
+ * @brief Test wait and hold accounting of the instrumented mutex
+ * @details A thread holds theater 7's lock for 20 ms while another one blocks on it;
+ *          theater 3's lock is only taken uncontended. Theater 7 must rank first with
+ *          one contended acquisition and a wait close to the hold time.
+ */
+TEST(LockProfilerTest, RanksContendedTheaters) {
+  LockProfiler profiler;
+  ProfiledMutex<std::mutex> busy("Theater::Showing::mtx", 7, profiler);
+  ProfiledMutex<std::mutex> quiet("Theater::Showing::mtx", 3, profiler);
+  ProfiledMutex<std::shared_mutex> catalog("CentralDataStore::data_mutex_", -1, profiler);
+  
+  std::atomic<bool> held{false};
+  std::thread holder([&]() {
+    std::scoped_lock lock(busy);
+    held = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  });
+  while (!held) {
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(busy.try_lock());
+  { std::scoped_lock lock(busy); }
+  holder.join();
+  { std::scoped_lock lock(quiet); }
+  { std::shared_lock lock(catalog); }
+  
+  const auto theaters = profiler.top_contended_theaters();
+  ASSERT_EQ(theaters.size(), 2);
+  EXPECT_EQ(theaters[0].theater_id, 7);
+  EXPECT_EQ(theaters[0].acquisitions, 2);
+  EXPECT_EQ(theaters[0].contended, 1);
+  EXPECT_EQ(theaters[0].failed_try_locks, 1);
+  EXPECT_GE(theaters[0].max_wait_ns, 5'000'000);
+  EXPECT_EQ(theaters[1].theater_id, 3);
+  EXPECT_EQ(theaters[1].contended, 0);
+  
+  const auto sites = profiler.site_report();
+  ASSERT_EQ(sites.size(), 3);
+  EXPECT_EQ(sites[0].theater_id, 7);
+  EXPECT_GE(sites[0].hold.max_ns, 15'000'000);
+  const auto global = std::find_if(sites.begin(), sites.end(), [](const auto& site) { return site.theater_id < 0; });
+  ASSERT_NE(global, sites.end());
+  EXPECT_EQ(global->site, "CentralDataStore::data_mutex_");
+  EXPECT_EQ(global->acquisitions, 1);
+  EXPECT_EQ(global->hold.samples, 0); // Shared holds are not timed
+}